@@ -1,6 +1,7 @@
 #pragma once
 
 #include <proxiios.h>
+#include <files.h>
 #include "binfile.h"
 
 #define __throw_length_error __logging_abort
@@ -10,6 +11,10 @@
 #define EMU_MODULE_NAME "emu"
 #define FS_INTERNAL_NAME "nandfs"
 #define MAX_EMU_OPEN 16
+#define RIIVDIR_CACHE_ENTRIES 8
+#define RIIVDIR_LOOKUP_ENTRIES 16
+#define RIIVFILE_BUFFER_SIZE 0x4000
+#define RIIVFILE_BUFFERS 2
 
 namespace ProxiIOS { namespace EMU {
 	namespace Ioctl {
@@ -67,18 +72,32 @@ namespace ProxiIOS { namespace EMU {
 		u32 error_state_maybe;// 0x20 (initially zero, makes reading/writing/seeking/closing fail if non-zero)
 	};
 
+	class RiivDir;
+
 	class RiivFile
 	{
 	private:
 		char *file_name;
 		u32 file_mode;
+		RiivDir *owner;      // directory to tell about size changes, if opened for writing
+		bool written;
+		s32 start_length;    // length before the first write, -1 if nobody needed it
+		u8 *write_buffer;
+		s32 buffer_length;
+		s32 position;        // including buffered data, -1 if unknown
+		s32 file_length;     // likewise
+		void Advance(s32 written);
 	protected:
 		s32 file;
 		s32 Open();
+		s32 BufferWrite(const void *src, s32 length);
+		s32 Flush();
+		virtual s32 Commit(const void *src, s32 length);
 	public:
 		virtual s32 Read(void *dest, s32 length);
 		virtual s32 Write(const void *src, s32 length);
 		virtual s32 Seek(s32 where, s32 whence);
+		void SetOwner(RiivDir *dir);
 		RiivFile(const char *name, s32 mode);
 		RiivFile();
 		virtual ~RiivFile();
@@ -91,29 +110,14 @@ namespace ProxiIOS { namespace EMU {
 	private:
 		s32 true_fd;
 		s32 copy_fd;
+	protected:
+		virtual s32 Commit(const void *src, s32 length);
 	public:
 		virtual s32 Write(const void *src, s32 length);
 		ShadowFile(const char *nand_name, const char *ext_name);
 		virtual ~ShadowFile();
 	};
 
-	// special class for .vff files to combine writes,
-	// since they get written in 512 byte chunks
-	class VFFFile : public RiivFile
-	{
-	private:
-		const int buf_size;
-		u8 *write_buffer;
-		s32 write_pos;
-		void Flush();
-	public:
-		virtual s32 Read(void *dest, s32 length);
-		virtual s32 Write(const void *_src, s32 length);
-		virtual s32 Seek(s32 where, s32 whence);
-		VFFFile(const char *name, s32 mode);
-		virtual ~VFFFile();
-	};
-
 	class AppFile : public RiivFile
 	{
 	private:
@@ -157,8 +161,44 @@ namespace ProxiIOS { namespace EMU {
 			void CreateTik(const char* path, s32 mode);
 	};
 
+	// listing and usage totals of one external directory,
+	// kept up to date by the Note* calls instead of walking it again
+	struct RiivDirCache {
+		char *path;          // NULL if the slot is unused
+		u32 last_use;
+		char *names;         // packed ISFS names
+		s32 names_count;     // -1 if the listing isn't cached
+		u32 names_length;
+		u32 names_size;
+		bool usage_valid;
+		u32 usage_files;
+		u32 usage_bytes;
+	};
+
+	// whether an external path exists, remembered until something changes it
+	struct RiivLookup {
+		char *path;          // NULL if the slot is unused
+		u32 last_use;
+		bool exists;
+	};
+
 	class RiivDir
 	{
+	private:
+		RiivDirCache dir_cache[RIIVDIR_CACHE_ENTRIES];
+		RiivLookup lookups[RIIVDIR_LOOKUP_ENTRIES];
+		u32 cache_clock;
+		u32 open_writers;
+		RiivDirCache* FindCache(const char *path, bool create);
+		void DropCache(RiivDirCache *c);
+		int LoadListing(RiivDirCache *c, const char *ext_path);
+		void AddName(RiivDirCache *c, const char *name, u32 length);
+		s32 FindName(RiivDirCache *c, const char *name, u32 length);
+		void RemoveName(RiivDirCache *c, const char *name, u32 length);
+		RiivLookup* FindLookup(const char *path, bool create);
+		void SetLookups(const char *path, bool below, bool exists);
+		void DropLookups(const char *path);
+		int WalkUsage(const char* ext_path, u32 *files, u32 *bytes, char *next_name);
 	protected:
 		char *nand_dir, *ext_dir;
 	public:
@@ -171,6 +211,19 @@ namespace ProxiIOS { namespace EMU {
 		virtual int MoveFrom(const char* ext_path, const char* nand_path);
 		virtual int GetUsage(const char* ext_path, u32 *files, u32 *blocks, char* next_name);
 		virtual int Exists(const char *path);
+
+		int Lookup(const char *path);
+		bool Tracks(const char *path);
+		bool HasListing(const char *path);
+		bool UsageCached(const char *path);
+		void NoteCreated(const char *path, const Stats *st);
+		void NoteRemoved(const char *path, const Stats *st);
+		void NoteResized(const char *path, s32 delta);
+		void ForgetCache(const char *path);
+		// files that have been written to and not closed yet
+		void WriterOpened() { open_writers++; }
+		void WriterClosed() { open_writers--; }
+
 		RiivDir(const char* _nand_dir, const char* _ext_dir);
 		~RiivDir();
 	};
@@ -441,8 +441,11 @@ namespace ProxiIOS { namespace EMU {
 			char *path = (*it)->GetTranslatedPath(name);
 			if (path) {
 				//LogPrintf("TryOpen translated filename: %s\n", path);
-				if ((*it)->Exists(path)>=0)
+				if ((*it)->Exists(path)>=0) {
 					*x = (*it)->OpenFile(path, mode);
+					if (*x && (mode&ISFS_OPEN_WRITE))
+						(*x)->SetOwner(*it);
+				}
 				Dealloc(path);
 				return 1;
 			}
@@ -651,7 +654,7 @@ namespace ProxiIOS { namespace EMU {
 				CheckForDLCTitle(path2);
 
 			for(it = DataDirs.begin();it != DataDirs.end(); it++) {
-				Stats st;
+				Stats st, old_st;
 				char *new_path = (*it)->GetTranslatedPath(path);
 				char *new_path2 = NULL;
 				if (path2)
@@ -681,22 +684,40 @@ namespace ProxiIOS { namespace EMU {
 							attrib->attributes = 0;
 							// fallthrough
 						case Ioctl::SetAttrib:
-							if (File_Stat(new_path, &st)<0)
+							if ((*it)->Lookup(new_path)<0)
 								*result = FSErrors::FileNotFound;
 							else
 								*result = FSErrors::OK;
 							break;
 						case Ioctl::CreateDir:
 							*result = File_CreateDir(new_path);
+							if (*result>=0) {
+								st.Mode = S_IFDIR;
+								st.Size = 0;
+								(*it)->NoteCreated(new_path, &st);
+							}
 							break;
-						case Ioctl::CreateFile:
+						case Ioctl::CreateFile: {
+							// creating a file that already exists succeeds without changing anything
+							bool existed = (*it)->Tracks(new_path) && File_Stat(new_path, &st)>=0;
 							*result = (*it)->CreateFile(new_path);
+							if (*result>=0 && !existed) {
+								st.Mode = S_IFREG;
+								st.Size = 0;
+								(*it)->NoteCreated(new_path, &st);
+							}
+						}
 							break;
-						case Ioctl::Delete:
+						case Ioctl::Delete: {
+							// cached usage totals need the size of what's being deleted
+							bool known = (*it)->Tracks(new_path) && File_Stat(new_path, &st)>=0;
 							*result = (*it)->Delete(new_path);
+							if (*result>=0)
+								(*it)->NoteRemoved(new_path, known ? &st : NULL);
+						}
 							break;
 						case Ioctl::ReadDir:
-							if (File_Stat(new_path, &st)<0)
+							if (!(*it)->HasListing(new_path) && File_Stat(new_path, &st)<0)
 								*result = FSErrors::FileNotFound;
 							else {
 								u32 *out_count;
@@ -720,11 +741,33 @@ namespace ProxiIOS { namespace EMU {
 							break;
 						case Ioctl::Move:
 							if (new_path && new_path2) {
+								bool known = ((*it)->Tracks(new_path) || (*it)->Tracks(new_path2)) && File_Stat(new_path, &st)>=0;
+								bool replaced = known && File_Stat(new_path2, &old_st)>=0;
 								*result = File_Rename(new_path, new_path2);
+								if (*result>=0) {
+									(*it)->NoteRemoved(new_path, known ? &st : NULL);
+									if (replaced)
+										(*it)->NoteRemoved(new_path2, &old_st);
+									if (known && !(st.Mode&S_IFDIR))
+										(*it)->NoteCreated(new_path2, &st);
+									else
+										(*it)->ForgetCache(new_path2);
+								}
 							} else if (new_path) {
 								*result = (*it)->MoveFrom(new_path, path2);
+								if (*result>=0)
+									(*it)->ForgetCache(new_path);
 							} else if (new_path2) {
+								bool replaced = (*it)->Tracks(new_path2) && File_Stat(new_path2, &old_st)>=0;
 								*result = (*it)->MoveTo(path, new_path2);
+								if (*result>=0) {
+									if (replaced)
+										(*it)->NoteRemoved(new_path2, &old_st);
+									if ((*it)->Tracks(new_path2) && File_Stat(new_path2, &st)>=0 && !(st.Mode&S_IFDIR))
+										(*it)->NoteCreated(new_path2, &st);
+									else
+										(*it)->ForgetCache(new_path2);
+								}
 							} else {
 								*result = FSErrors::InvalidArgument;
 							}
@@ -783,7 +826,14 @@ namespace ProxiIOS { namespace EMU {
 		if (file<0 && Open()<0)
 			return FSErrors::IOError;
 
-		return File_Read(file, dest, length);
+		if (Flush()<0)
+			return FSErrors::IOError;
+		s32 ret = File_Read(file, dest, length);
+		if (ret<0)
+			position = file_length = -1;
+		else if (position>=0)
+			position += ret;
+		return ret;
 	}
 
 	s32 RiivFile::Write(const void *src, s32 length)
@@ -791,20 +841,161 @@ namespace ProxiIOS { namespace EMU {
 		if (file<0 && Open()<0)
 			return FSErrors::IOError;
 
+		// cached usage totals get the size difference when the file is closed
+		if (owner && !written) {
+			written = true;
+			owner->WriterOpened();
+			if (owner->UsageCached(file_name)) {
+				s32 pos = File_Seek(file, 0, SEEK_CUR);
+				start_length = File_Seek(file, 0, SEEK_END);
+				File_Seek(file, pos, SEEK_SET);
+			}
+		}
+
+		return BufferWrite(src, length);
+	}
+
+	s32 RiivFile::Commit(const void *src, s32 length)
+	{
 		return File_Write(file, src, length);
 	}
 
+	// there's only room for a couple of write buffers, a file holds one while it has data waiting
+	static u8 *write_buffers[RIIVFILE_BUFFERS];
+	static bool write_buffer_taken[RIIVFILE_BUFFERS];
+
+	static u8* TakeWriteBuffer()
+	{
+		for (int i=0; i < RIIVFILE_BUFFERS; i++) {
+			if (write_buffer_taken[i])
+				continue;
+			if (write_buffers[i]==NULL)
+				write_buffers[i] = (u8*)Memalign(32, RIIVFILE_BUFFER_SIZE);
+			if (write_buffers[i]==NULL)
+				break;
+			write_buffer_taken[i] = true;
+			return write_buffers[i];
+		}
+		return NULL;
+	}
+
+	static void ReturnWriteBuffer(u8 *buffer)
+	{
+		for (int i=0; i < RIIVFILE_BUFFERS; i++) {
+			if (write_buffers[i]==buffer)
+				write_buffer_taken[i] = false;
+		}
+	}
+
+	// small writes are collected and committed in one go when the buffer fills up,
+	// or before anything that needs the file to be up to date (read, seek, close).
+	// when no buffer is free they go straight to the file
+	s32 RiivFile::BufferWrite(const void *_src, s32 length)
+	{
+		const u8* src = (const u8*)_src;
+
+		if (buffer_length==0 && write_buffer==NULL && length < RIIVFILE_BUFFER_SIZE)
+			write_buffer = TakeWriteBuffer();
+
+		if (write_buffer==NULL || (buffer_length==0 && length >= RIIVFILE_BUFFER_SIZE)) {
+			s32 written = Commit(src, length);
+			if (written<0)
+				position = file_length = -1;
+			else
+				Advance(written);
+			return written;
+		}
+
+		s32 to_write = MIN(RIIVFILE_BUFFER_SIZE-buffer_length, length);
+		memcpy(write_buffer+buffer_length, src, to_write);
+		buffer_length += to_write;
+		Advance(to_write);
+		if (buffer_length==RIIVFILE_BUFFER_SIZE && Flush()<0)
+			return FSErrors::IOError;
+
+		// the rest starts over, it might not get a buffer this time
+		if (to_write < length) {
+			s32 ret = BufferWrite(src+to_write, length-to_write);
+			if (ret<0)
+				return ret;
+			to_write += ret;
+		}
+
+		return to_write;
+	}
+
+	void RiivFile::Advance(s32 written)
+	{
+		if (position<0)
+			return;
+		position += written;
+		if (file_length>=0 && position > file_length)
+			file_length = position;
+	}
+
+	s32 RiivFile::Flush()
+	{
+		s32 ret = FSErrors::OK;
+
+		if (buffer_length) {
+			ret = Commit(write_buffer, buffer_length);
+			if (ret!=buffer_length) {
+				LogPrintf("Flushing %d buffered bytes returned %d\n", buffer_length, ret);
+				position = file_length = -1;
+				ret = FSErrors::IOError;
+			}
+			buffer_length = 0;
+		}
+
+		if (write_buffer) {
+			ReturnWriteBuffer(write_buffer);
+			write_buffer = NULL;
+		}
+
+		return ret;
+	}
+
 	s32 RiivFile::Seek(s32 where, s32 whence)
 	{
 		if (file<0 && Open()<0)
 			return FSErrors::IOError;
 
-		return File_Seek(file, where, whence);
+		// seeks that don't move (like GetFileStats while appending) don't need the buffered data written out
+		if (position>=0) {
+			s32 target = -1;
+			if (whence==SEEK_SET)
+				target = where;
+			else if (whence==SEEK_CUR)
+				target = position+where;
+			else if (whence==SEEK_END && file_length>=0)
+				target = file_length+where;
+			if (target==position)
+				return position;
+		}
+
+		if (Flush()<0)
+			return FSErrors::IOError;
+		position = File_Seek(file, where, whence);
+		if (whence==SEEK_END && where==0)
+			file_length = position;
+		return position;
+	}
+
+	void RiivFile::SetOwner(RiivDir *dir)
+	{
+		owner = dir;
 	}
 
 	RiivFile::RiivFile()
 	{
 		file_name = NULL;
+		owner = NULL;
+		written = false;
+		start_length = -1;
+		write_buffer = NULL;
+		buffer_length = 0;
+		position = 0;
+		file_length = -1;
 		file = -1;
 	}
 
@@ -813,12 +1004,32 @@ namespace ProxiIOS { namespace EMU {
 		file_name = (char*)Alloc(strlen(name)+1);
 		strcpy(file_name, name);
 		file_mode = mode;
+		owner = NULL;
+		written = false;
+		start_length = -1;
+		write_buffer = NULL;
+		buffer_length = 0;
+		position = 0;
+		file_length = -1;
 
 		file = -1;
 	}
 
 	RiivFile::~RiivFile()
 	{
+		Flush();
+
+		if (written) {
+			if (start_length>=0) {
+				s32 length = File_Seek(file, 0, SEEK_END);
+				if (length<0)
+					owner->ForgetCache(file_name);
+				else
+					owner->NoteResized(file_name, length-start_length);
+			}
+			owner->WriterClosed();
+		}
+
 		Dealloc(file_name);
 
 		if (file >= 0)
@@ -843,6 +1054,9 @@ namespace ProxiIOS { namespace EMU {
 
 	ShadowFile::~ShadowFile()
 	{
+		// RiivFile's destructor can't reach Commit any more
+		Flush();
+
 		if (true_fd>=0)
 			FS_Close(true_fd);
 		if (copy_fd>=0)
@@ -850,6 +1064,13 @@ namespace ProxiIOS { namespace EMU {
 	}
 
 	s32 ShadowFile::Write(const void *src, s32 length)
+	{
+		if (true_fd<0)
+			return FSErrors::InvalidArgument;
+		return BufferWrite(src, length);
+	}
+
+	s32 ShadowFile::Commit(const void *src, s32 length)
 	{
 		if (copy_fd>=0)
 			FS_Write(copy_fd, src, length);
@@ -858,66 +1079,6 @@ namespace ProxiIOS { namespace EMU {
 		return FSErrors::InvalidArgument;
 	}
 
-	VFFFile::VFFFile(const char *name, s32 mode) :
-	RiivFile(name, mode),
-	buf_size(0x4000)
-	{
-
-		LogPrintf("New VFFFile, %s\n", name);
-		if ((mode & O_WRONLY) || (mode & O_RDWR))
-			write_buffer = (u8*)Memalign(32, buf_size);
-		else
-			write_buffer = NULL;
-		write_pos = 0;
-	}
-
-	void VFFFile::Flush()
-	{
-		if (write_pos) {
-			LogPrintf("Flushing %d bytes to VFF file\n", write_pos);
-			RiivFile::Write(write_buffer, write_pos);
-			write_pos = 0;
-		}
-	}
-
-	VFFFile::~VFFFile()
-	{
-		Flush();
-		Dealloc(write_buffer);
-	}
-
-	s32 VFFFile::Read(void *dest, s32 length)
-	{
-		Flush();
-		return RiivFile::Read(dest, length);
-	}
-
-	s32 VFFFile::Seek(s32 where, s32 whence)
-	{
-		Flush();
-		return RiivFile::Seek(where, whence);
-	}
-
-	s32 VFFFile::Write(const void *_src, s32 length)
-	{
-		const u8* src = (const u8*)_src;
-		s32 written = 0;
-		if (write_buffer==NULL)
-			return RiivFile::Write(src, length);
-
-		while (length>0) {
-			s32 to_write = MIN(buf_size-write_pos, length);
-			memcpy(write_buffer+write_pos, src+written, to_write);
-			write_pos += to_write;
-			written += to_write;
-			length -= to_write;
-			if (write_pos >= buf_size) // write_pos > buf_size should not happen
-				Flush();
-		}
-
-		return written;
-	}
-
 	s32 AppFile::Open()
 	{
 		if (binfile==NULL) {
@@ -1003,10 +1164,6 @@ namespace ProxiIOS { namespace EMU {
 		if (mode)
 			mode--;
 
-		int path_len = strlen(path);
-		if (path_len > 4 && !strcmp(path+path_len-4, ".vff"))
-			return new VFFFile(path, mode);
-
 		return new RiivFile(path, mode);
 	}
 
@@ -1022,59 +1179,35 @@ namespace ProxiIOS { namespace EMU {
 
 	int RiivDir::ReadDir(const char* ext_path, u32 *out_count, char *names, const u32 *max_count)
 	{
-		Stats st;
 		int ret = FSErrors::OK;
-		char *next_name = (char*)Memalign(32, 1024);
-		if (next_name==NULL)
+		RiivDirCache *c = FindCache(ext_path, true);
+		if (c==NULL)
 			return FSErrors::OutOfMemory;
-		char *out_names=NULL, *out=NULL;
-		// use a temp variable, because out_count and max_count may point to the same thing
-		u32 count = 0;
-		if (names && max_count[0]) {
-			// allocate temporary memory for the filenames to work around MEM1 word restriction
-			out_names = (char*)Alloc(13*max_count[0]);
-			if (out_names==NULL) {
-				Dealloc(next_name);
-				return FSErrors::OutOfMemory;
-			}
-			out = out_names;
-		}
 
-		s32 dir = File_OpenDir(ext_path);
-		if (dir<0) {
-			Dealloc(next_name);
-			Dealloc(out_names);
-			return FSErrors::InvalidArgument;
+		if (c->names_count<0) {
+			ret = LoadListing(c, ext_path);
+			if (ret<0)
+				return ret;
 		}
 
-		while (File_NextDir(dir, next_name, &st)>=0) {
-			if (st.Mode&S_IFDIR && next_name[0]=='.')
-				continue;
-
-			if (out) {
-				if (count==max_count[0]) {
-					ret = FSErrors::TooManyFiles;
-					break;
-				} else {
-					out[12] = 0;
-					strncpy(out, next_name, 12); // maximum ISFS filename is 12 chars
-					out += strlen(out)+1;
-				}
+		// use a temp variable, because out_count and max_count may point to the same thing
+		u32 count = c->names_count;
+		if (names && max_count[0]) {
+			u32 length = 0;
+			if (count > max_count[0]) {
+				count = max_count[0];
+				ret = FSErrors::TooManyFiles;
 			}
-			count++;
-		}
-		*out_count = count;
-
-		if (names && count) {
-			memcpy(names, out_names, ((out-out_names)+3)&~3);
-			LogPrintf("ReadDir: %s has %u files, %u names written\n", ext_path, *max_count, *out_count);
+			for (u32 i=0; i < count; i++)
+				length += strlen(c->names+length)+1;
+			// copy whole words to work around MEM1 word restriction
+			if (length)
+				memcpy(names, c->names, (length+3)&~3);
+			LogPrintf("ReadDir: %s has %u files, %u names written\n", ext_path, *max_count, count);
 		}
 		else
-			LogPrintf("ReadDir: %s has %u files.\n", ext_path, *out_count);
-
-		File_CloseDir(dir);
-		Dealloc(next_name);
-		Dealloc(out_names);
+			LogPrintf("ReadDir: %s has %u files.\n", ext_path, count);
+		*out_count = count;
 
 		return ret;
 	}
@@ -1134,7 +1267,7 @@ namespace ProxiIOS { namespace EMU {
 		return FSErrors::InvalidArgument;
 	}
 
-	int RiivDir::GetUsage(const char* ext_path, u32 *files, u32 *bytes, char *next_name)
+	int RiivDir::WalkUsage(const char* ext_path, u32 *files, u32 *bytes, char *next_name)
 	{
 		s32 ret = FSErrors::OK;
 		Stats st;
@@ -1158,7 +1291,7 @@ namespace ProxiIOS { namespace EMU {
 				strcpy(new_dir, ext_path);
 				strcat(new_dir, "/");
 				strcat(new_dir, next_name);
-				ret = GetUsage(new_dir, files, bytes, next_name);
+				ret = WalkUsage(new_dir, files, bytes, next_name);
 				Dealloc(new_dir);
 				if (ret<0)
 					break;
@@ -1170,16 +1303,421 @@ namespace ProxiIOS { namespace EMU {
 		return ret;
 	}
 
+	int RiivDir::GetUsage(const char* ext_path, u32 *files, u32 *bytes, char *next_name)
+	{
+		// sizes of files being written aren't final until they're closed,
+		// so only totals from before the first write get cached
+		RiivDirCache *c = FindCache(ext_path, open_writers==0);
+
+		if (c==NULL || !c->usage_valid) {
+			u32 walk_files = 0, walk_bytes = 0;
+			s32 ret = WalkUsage(ext_path, &walk_files, &walk_bytes, next_name);
+			if (ret<0)
+				return ret;
+
+			if (c==NULL || open_writers) {
+				*files += walk_files;
+				*bytes += walk_bytes;
+				return ret;
+			}
+
+			c->usage_files = walk_files;
+			c->usage_bytes = walk_bytes;
+			c->usage_valid = true;
+		}
+
+		*files += c->usage_files;
+		*bytes += c->usage_bytes;
+		return FSErrors::OK;
+	}
+
 	int RiivDir::Exists(const char* path)
 	{
-		Stats st[2];
-		if (File_Stat(path, st)>=0)
-			return 1;
+		return Lookup(path);
+	}
+
+	// length of path without any trailing slashes
+	static u32 PathLength(const char *path)
+	{
+		u32 length = strlen(path);
+		while (length && path[length-1]=='/')
+			length--;
+		return length;
+	}
+
+	// cache paths are stored without trailing slashes, and compared ignoring case like libfat does
+	static bool IsSame(const char *path, const char *dir)
+	{
+		u32 length = strlen(dir);
+		return PathLength(path)==length && !strncasecmp(path, dir, length);
+	}
+
+	static bool IsBelow(const char *path, const char *dir)
+	{
+		u32 length = PathLength(dir);
+		return !strncasecmp(path, dir, length) && path[length]=='/' && PathLength(path) > length+1;
+	}
+
+	// splits path into the directory holding it and its name
+	static u32 SplitPath(const char *path, const char **name, u32 *name_length)
+	{
+		u32 length = PathLength(path);
+		u32 parent = length;
+		while (parent && path[parent-1]!='/')
+			parent--;
+		*name = path+parent;
+		*name_length = length-parent;
+		return parent ? parent-1 : 0;
+	}
+
+	static bool IsParent(const char *path, const char *dir)
+	{
+		const char *name;
+		u32 name_length;
+		u32 length = SplitPath(path, &name, &name_length);
+		return length==strlen(dir) && !strncasecmp(path, dir, length);
+	}
+
+	RiivDirCache* RiivDir::FindCache(const char *path, bool create)
+	{
+		RiivDirCache *victim = NULL;
+		int i;
+
+		for (i=0; i < RIIVDIR_CACHE_ENTRIES; i++) {
+			RiivDirCache *c = dir_cache+i;
+			if (c->path==NULL) {
+				if (victim==NULL || victim->path)
+					victim = c;
+			} else if (IsSame(path, c->path)) {
+				c->last_use = ++cache_clock;
+				return c;
+			} else if (victim==NULL || (victim->path && c->last_use < victim->last_use))
+				victim = c;
+		}
+
+		if (!create)
+			return NULL;
+
+		DropCache(victim);
+		u32 length = PathLength(path);
+		victim->path = (char*)Alloc(length+1);
+		if (victim->path==NULL)
+			return NULL;
+		memcpy(victim->path, path, length);
+		victim->path[length] = 0;
+		victim->last_use = ++cache_clock;
+		return victim;
+	}
+
+	void RiivDir::DropCache(RiivDirCache *c)
+	{
+		Dealloc(c->path);
+		Dealloc(c->names);
+		c->path = NULL;
+		c->names = NULL;
+		c->names_count = -1;
+		c->names_length = 0;
+		c->names_size = 0;
+		c->usage_valid = false;
+	}
+
+	int RiivDir::LoadListing(RiivDirCache *c, const char *ext_path)
+	{
+		Stats st;
+		char *next_name = (char*)Memalign(32, 1024);
+		if (next_name==NULL)
+			return FSErrors::OutOfMemory;
+
+		s32 dir = File_OpenDir(ext_path);
+		if (dir<0) {
+			Dealloc(next_name);
+			return FSErrors::InvalidArgument;
+		}
+
+		c->names_count = 0;
+		c->names_length = 0;
+		while (c->names_count>=0 && File_NextDir(dir, next_name, &st)>=0) {
+			if (st.Mode&S_IFDIR && next_name[0]=='.')
+				continue;
+			AddName(c, next_name, strlen(next_name));
+		}
+
+		File_CloseDir(dir);
+		Dealloc(next_name);
+
+		return (c->names_count>=0) ? FSErrors::OK : FSErrors::OutOfMemory;
+	}
+
+	void RiivDir::AddName(RiivDirCache *c, const char *name, u32 length)
+	{
+		length = MIN(length, 12); // maximum ISFS filename is 12 chars
+
+		// keep 3 bytes spare so ReadDir can copy whole words
+		if (c->names_length+length+1+3 > c->names_size) {
+			u32 size = MAX(c->names_size*2, 13*16);
+			char *names = (char*)Alloc(size);
+			if (names==NULL) {
+				Dealloc(c->names);
+				c->names = NULL;
+				c->names_size = 0;
+				c->names_count = -1;
+				return;
+			}
+			if (c->names)
+				memcpy(names, c->names, c->names_length);
+			Dealloc(c->names);
+			c->names = names;
+			c->names_size = size;
+		}
+
+		memcpy(c->names+c->names_length, name, length);
+		c->names[c->names_length+length] = 0;
+		c->names_length += length+1;
+		c->names_count++;
+	}
+
+	s32 RiivDir::FindName(RiivDirCache *c, const char *name, u32 length)
+	{
+		length = MIN(length, 12);
+
+		for (u32 pos=0; pos < c->names_length;) {
+			u32 entry_length = strlen(c->names+pos);
+			if (entry_length==length && !strncasecmp(c->names+pos, name, length))
+				return pos;
+			pos += entry_length+1;
+		}
+
 		return -1;
 	}
 
+	void RiivDir::RemoveName(RiivDirCache *c, const char *name, u32 length)
+	{
+		s32 pos = FindName(c, name, length);
+
+		// if it was never listed the listing can't be trusted
+		if (pos<0) {
+			c->names_count = -1;
+			return;
+		}
+
+		length = strlen(c->names+pos);
+		memmove(c->names+pos, c->names+pos+length+1, c->names_length-pos-length-1);
+		c->names_length -= length+1;
+		c->names_count--;
+	}
+
+	RiivLookup* RiivDir::FindLookup(const char *path, bool create)
+	{
+		RiivLookup *victim = NULL;
+		int i;
+
+		for (i=0; i < RIIVDIR_LOOKUP_ENTRIES; i++) {
+			RiivLookup *l = lookups+i;
+			if (l->path==NULL) {
+				if (victim==NULL || victim->path)
+					victim = l;
+			} else if (IsSame(path, l->path)) {
+				l->last_use = ++cache_clock;
+				return l;
+			} else if (victim==NULL || (victim->path && l->last_use < victim->last_use))
+				victim = l;
+		}
+
+		if (!create)
+			return NULL;
+
+		Dealloc(victim->path);
+		u32 length = PathLength(path);
+		victim->path = (char*)Alloc(length+1);
+		if (victim->path==NULL)
+			return NULL;
+		memcpy(victim->path, path, length);
+		victim->path[length] = 0;
+		victim->last_use = ++cache_clock;
+		return victim;
+	}
+
+	void RiivDir::SetLookups(const char *path, bool below, bool exists)
+	{
+		for (int i=0; i < RIIVDIR_LOOKUP_ENTRIES; i++) {
+			RiivLookup *l = lookups+i;
+			if (l->path && (IsSame(l->path, path) || (below && IsBelow(l->path, path))))
+				l->exists = exists;
+		}
+	}
+
+	void RiivDir::DropLookups(const char *path)
+	{
+		for (int i=0; i < RIIVDIR_LOOKUP_ENTRIES; i++) {
+			RiivLookup *l = lookups+i;
+			if (l->path && (path==NULL || IsSame(l->path, path) || IsBelow(l->path, path))) {
+				Dealloc(l->path);
+				l->path = NULL;
+			}
+		}
+	}
+
+	// remembered File_Stat, most opens are for the same few files or for ones that don't exist
+	int RiivDir::Lookup(const char *path)
+	{
+		Stats st;
+		const char *name;
+		u32 name_length;
+		int i;
+
+		RiivLookup *l = FindLookup(path, false);
+		if (l)
+			return l->exists ? 1 : -1;
+
+		l = FindLookup(path, true);
+
+		// a cached listing of the parent answers it too, unless the name might have been truncated
+		SplitPath(path, &name, &name_length);
+		for (i=0; i < RIIVDIR_CACHE_ENTRIES; i++) {
+			RiivDirCache *c = dir_cache+i;
+			if (c->path && c->names_count>=0 && name_length<12 && name[0]!='.' && IsParent(path, c->path))
+				break;
+		}
+
+		bool exists;
+		if (i < RIIVDIR_CACHE_ENTRIES)
+			exists = FindName(dir_cache+i, name, name_length)>=0;
+		else
+			exists = File_Stat(path, &st)>=0;
+
+		if (l)
+			l->exists = exists;
+		return exists ? 1 : -1;
+	}
+
+	// whether a change to path would touch a cached listing or usage total
+	bool RiivDir::Tracks(const char *path)
+	{
+		for (int i=0; i < RIIVDIR_CACHE_ENTRIES; i++) {
+			RiivDirCache *c = dir_cache+i;
+			if (c->path && ((c->usage_valid && IsBelow(path, c->path)) || (c->names_count>=0 && IsParent(path, c->path))))
+				return true;
+		}
+		return false;
+	}
+
+	bool RiivDir::HasListing(const char *path)
+	{
+		RiivDirCache *c = FindCache(path, false);
+		return c && c->names_count>=0;
+	}
+
+	bool RiivDir::UsageCached(const char *path)
+	{
+		for (int i=0; i < RIIVDIR_CACHE_ENTRIES; i++) {
+			if (dir_cache[i].path && dir_cache[i].usage_valid && IsBelow(path, dir_cache[i].path))
+				return true;
+		}
+		return false;
+	}
+
+	// a new directory is assumed to be empty
+	void RiivDir::NoteCreated(const char *path, const Stats *st)
+	{
+		const char *name;
+		u32 name_length;
+
+		if (st==NULL) {
+			ForgetCache(path);
+			return;
+		}
+
+		SetLookups(path, false, true);
+
+		SplitPath(path, &name, &name_length);
+		for (int i=0; i < RIIVDIR_CACHE_ENTRIES; i++) {
+			RiivDirCache *c = dir_cache+i;
+			if (c->path==NULL)
+				continue;
+			if (c->names_count>=0 && IsParent(path, c->path) && !(st->Mode&S_IFDIR && name[0]=='.'))
+				AddName(c, name, name_length);
+			if (c->usage_valid && IsBelow(path, c->path) && !(st->Mode&S_IFDIR)) {
+				c->usage_files++;
+				c->usage_bytes += st->Size;
+			}
+		}
+	}
+
+	void RiivDir::NoteRemoved(const char *path, const Stats *st)
+	{
+		const char *name;
+		u32 name_length;
+
+		// whatever it was, nothing is left there
+		SetLookups(path, true, false);
+
+		if (st==NULL) {
+			ForgetCache(path);
+			return;
+		}
+
+		SplitPath(path, &name, &name_length);
+		for (int i=0; i < RIIVDIR_CACHE_ENTRIES; i++) {
+			RiivDirCache *c = dir_cache+i;
+			if (c->path==NULL)
+				continue;
+			if (st->Mode&S_IFDIR && (IsSame(c->path, path) || IsBelow(c->path, path))) {
+				DropCache(c);
+				continue;
+			}
+			if (c->names_count>=0 && IsParent(path, c->path) && !(st->Mode&S_IFDIR && name[0]=='.'))
+				RemoveName(c, name, name_length);
+			if (c->usage_valid && IsBelow(path, c->path)) {
+				// a removed directory might not have been empty
+				if (st->Mode&S_IFDIR)
+					c->usage_valid = false;
+				else {
+					c->usage_files--;
+					c->usage_bytes -= st->Size;
+				}
+			}
+		}
+	}
+
+	void RiivDir::NoteResized(const char *path, s32 delta)
+	{
+		for (int i=0; i < RIIVDIR_CACHE_ENTRIES; i++) {
+			if (dir_cache[i].path && dir_cache[i].usage_valid && IsBelow(path, dir_cache[i].path))
+				dir_cache[i].usage_bytes += delta;
+		}
+	}
+
+	// for changes the cache can't follow, NULL forgets everything
+	void RiivDir::ForgetCache(const char *path)
+	{
+		DropLookups(path);
+
+		for (int i=0; i < RIIVDIR_CACHE_ENTRIES; i++) {
+			RiivDirCache *c = dir_cache+i;
+			if (c->path==NULL)
+				continue;
+			if (path==NULL || IsSame(c->path, path) || IsBelow(c->path, path))
+				DropCache(c);
+			else if (IsBelow(path, c->path)) {
+				c->usage_valid = false;
+				if (IsParent(path, c->path))
+					c->names_count = -1;
+			}
+		}
+	}
+
 	RiivDir::RiivDir(const char* _nand_dir, const char* _ext_dir)
 	{
+		for (int i=0; i < RIIVDIR_CACHE_ENTRIES; i++) {
+			dir_cache[i].path = NULL;
+			dir_cache[i].names = NULL;
+			DropCache(dir_cache+i);
+		}
+		for (int i=0; i < RIIVDIR_LOOKUP_ENTRIES; i++)
+			lookups[i].path = NULL;
+		cache_clock = 0;
+		open_writers = 0;
+
 		nand_dir = (char*)Memalign(32, ISFS_MAXPATH_LEN);
 		ext_dir = (char*)Memalign(32, strlen(_ext_dir)+1);
 
@@ -1193,6 +1731,9 @@ namespace ProxiIOS { namespace EMU {
 
 	RiivDir::~RiivDir()
 	{
+		for (int i=0; i < RIIVDIR_CACHE_ENTRIES; i++)
+			DropCache(dir_cache+i);
+		DropLookups(NULL);
 		Dealloc(nand_dir);
 		Dealloc(ext_dir);
 	}
@@ -0,0 +1,326 @@
+// Random ISFS traffic against a redirected directory, with names in either
+// case. Every lookup, listing and usage query EMU answers, cached or not,
+// is compared against a full walk of the host directory.
+//
+//   cachetest <seed> <operations>   random run, exits non-zero on a mismatch
+//   cachetest boot                  File_* calls for a typical boot pattern
+
+#include "test.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <ctype.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace ProxiIOS::EMU;
+using std::string;
+
+#define HOST_ROOT	"/tmp/dipmodule_cachetest"
+#define NAND		"/title/00010000/52524d45/data"
+#define EXT			"/sd/save"
+#define MAX_NAMES	64
+
+static int Mismatches;
+
+static std::map<string, u64> OpenedAt; // host path -> size when opened for writing
+
+static u64 ReferenceSize(const string& host, u64 size)
+{
+	std::map<string, u64>::iterator it = OpenedAt.find(host);
+	return it == OpenedAt.end() ? size : it->second;
+}
+
+// ISFS names, as EMU truncates them, without the dot directories
+static std::multiset<string> ReferenceListing(const string& ext)
+{
+	std::multiset<string> names;
+	string host = Files_HostPath(ext.c_str());
+	DIR* dir = opendir(host.c_str());
+	while (struct dirent* entry = readdir(dir)) {
+		struct stat st;
+		stat((host + "/" + entry->d_name).c_str(), &st);
+		if (S_ISDIR(st.st_mode) && entry->d_name[0] == '.')
+			continue;
+		names.insert(string(entry->d_name).substr(0, 12));
+	}
+	closedir(dir);
+	return names;
+}
+
+static void ReferenceUsage(const string& ext, u32* files, u64* bytes)
+{
+	string host = Files_HostPath(ext.c_str());
+	DIR* dir = opendir(host.c_str());
+	while (struct dirent* entry = readdir(dir)) {
+		string path = host + "/" + entry->d_name;
+		struct stat st;
+		stat(path.c_str(), &st);
+		if (!S_ISDIR(st.st_mode)) {
+			(*files)++;
+			*bytes += ReferenceSize(path, st.st_size);
+		} else if (entry->d_name[0] != '.')
+			ReferenceUsage(ext + "/" + entry->d_name, files, bytes);
+	}
+	closedir(dir);
+}
+
+static void CheckListing(int op, const string& dir)
+{
+	static char names[MAX_NAMES * (ISFS_MAXPATH_LEN / 4)];
+	u32 count = 0;
+	u32 max = rand() % 2 ? MAX_NAMES : rand() % 6;
+	bool with_names = rand() % 2;
+
+	int ret = Emu_ReadDir((NAND + dir).c_str(), &count, with_names ? names : NULL, max);
+	std::multiset<string> want = ReferenceListing(EXT + dir);
+
+	if (!with_names || !max) {
+		if (ret < 0 || count != want.size()) {
+			printf("op %d: count of %s is %u (%d), want %zu\n", op, dir.c_str(), count, ret, want.size());
+			Mismatches++;
+		}
+		return;
+	}
+
+	std::multiset<string> got;
+	const char* name = names;
+	for (u32 i = 0; i < count; i++, name += strlen(name) + 1)
+		got.insert(name);
+
+	// a short buffer gets any max of the names, but no name twice
+	bool subset = true;
+	for (std::multiset<string>::iterator it = got.begin(); it != got.end(); it++)
+		subset &= got.count(*it) <= want.count(*it);
+
+	u32 want_count = std::min((u32)want.size(), max);
+	int want_ret = want.size() > max ? FSErrors::TooManyFiles : FSErrors::OK;
+	if (count != want_count || ret != want_ret || !subset || (want.size() <= max && got != want)) {
+		printf("op %d: listing of %s has %u (%d), want %u (%d)\n", op, dir.c_str(), count, ret, want_count, want_ret);
+		Mismatches++;
+	}
+}
+
+static void CheckUsage(int op, const string& dir)
+{
+	u32 files = 0, blocks = 0;
+	u32 want_files = 1; // the directory itself
+	u64 want_bytes = 0;
+
+	int ret = Emu_GetUsage((NAND + dir).c_str(), &files, &blocks);
+	ReferenceUsage(EXT + dir, &want_files, &want_bytes);
+	if (ret < 0 || files != want_files || blocks != (u32)(want_bytes >> 14)) {
+		printf("op %d: usage of %s is %u/%u (%d), want %u/%llu\n", op, dir.c_str(), files, blocks, ret,
+			want_files, (unsigned long long)(want_bytes >> 14));
+		Mismatches++;
+	}
+}
+
+// libfat ignores case, so names are used in either
+static string RandomName(char prefix, int count)
+{
+	char name[16];
+	sprintf(name, "/%c%d", rand() % 2 ? prefix : toupper(prefix), rand() % count);
+	return name;
+}
+
+static bool SameName(const string& a, const string& b)
+{
+	return !strcasecmp(a.c_str(), b.c_str());
+}
+
+static bool IsListed(const std::vector<string>& paths, const string& path)
+{
+	for (size_t i = 0; i < paths.size(); i++) {
+		if (SameName(paths[i], path))
+			return true;
+	}
+	return false;
+}
+
+static void CheckLookup(int op, const string& path)
+{
+	struct stat st;
+	bool want = !stat(Files_HostPath((EXT + path).c_str()).c_str(), &st);
+	bool got = Emu_GetAttrib((NAND + path).c_str()) >= 0;
+	if (got != want) {
+		printf("op %d: %s %s, want %s\n", op, path.c_str(), got ? "exists" : "is missing", want ? "exists" : "is missing");
+		Mismatches++;
+	}
+}
+
+struct OpenFile
+{
+	int Fd;
+	string Path;
+};
+
+static bool IsOpen(const std::vector<OpenFile>& open, const string& path)
+{
+	for (size_t i = 0; i < open.size(); i++) {
+		if (SameName(open[i].Path, path))
+			return true;
+	}
+	return false;
+}
+
+static int RandomRun(int seed, int ops)
+{
+	static u8 buffer[20000];
+	std::vector<string> dirs, files;
+	std::vector<OpenFile> open;
+	long lookups = 0, listings = 0, usages = 0;
+
+	srand(seed);
+	dirs.push_back("");
+	dirs.push_back("/sub");
+	files.push_back("/sub/big.dat");
+
+	for (int op = 0; op < ops; op++) {
+		int kind = rand() % 100;
+		string dir = dirs[rand() % dirs.size()];
+		string name = RandomName('f', 40);
+
+		if (kind < 12) {
+			// creating one that exists succeeds
+			if (Emu_CreateFile((NAND + dir + name).c_str()) >= 0 && !IsListed(files, dir + name))
+				files.push_back(dir + name);
+		} else if (kind < 15 && dir.size() < 12) {
+			name = RandomName('d', 6);
+			if (Emu_CreateDir((NAND + dir + name).c_str()) >= 0)
+				dirs.push_back(dir + name);
+		} else if (kind < 22 && files.size()) {
+			int i = rand() % files.size();
+			if (!IsOpen(open, files[i]) && Emu_Delete((NAND + files[i]).c_str()) >= 0)
+				files.erase(files.begin() + i);
+		} else if (kind < 24 && dirs.size() > 2) {
+			// only works on empty ones
+			int i = 2 + rand() % (dirs.size() - 2);
+			if (Emu_Delete((NAND + dirs[i]).c_str()) >= 0)
+				dirs.erase(dirs.begin() + i);
+		} else if (kind < 30 && files.size()) {
+			int i = rand() % files.size();
+			if (!IsOpen(open, files[i]) && Emu_Rename((NAND + files[i]).c_str(), (NAND + dir + name).c_str()) >= 0)
+				files[i] = dir + name;
+		} else if (kind < 36 && files.size() && open.size() < 3) {
+			OpenFile file;
+			file.Path = files[rand() % files.size()];
+			if (IsOpen(open, file.Path))
+				continue;
+			file.Fd = Emu_Open((NAND + file.Path).c_str(), ISFS_OPEN_WRITE + rand() % 2);
+			if (file.Fd < 0)
+				continue;
+			string host = Files_HostPath((EXT + file.Path).c_str());
+			struct stat st;
+			stat(host.c_str(), &st);
+			OpenedAt[host] = st.st_size;
+			if (rand() % 2)
+				Emu_Seek(file.Fd, rand() % (st.st_size + 1), SEEK_SET);
+			open.push_back(file);
+		} else if (kind < 50 && open.size()) {
+			OpenFile& file = open[rand() % open.size()];
+			u32 length = 1 + rand() % (rand() % 4 ? 600 : sizeof(buffer));
+			if (Emu_Write(file.Fd, buffer, length) != (int)length) {
+				printf("op %d: write to %s failed\n", op, file.Path.c_str());
+				Mismatches++;
+			}
+		} else if (kind < 58 && open.size()) {
+			int i = rand() % open.size();
+			Emu_Close(open[i].Fd);
+			OpenedAt.erase(Files_HostPath((EXT + open[i].Path).c_str()));
+			open.erase(open.begin() + i);
+		} else if (kind < 66) {
+			lookups++;
+			CheckLookup(op, dir + (rand() % 4 ? name : RandomName('d', 6)));
+		} else if (kind < 80) {
+			listings++;
+			CheckListing(op, dir);
+		} else {
+			usages++;
+			CheckUsage(op, dir);
+		}
+	}
+
+	while (open.size()) {
+		Emu_Close(open.back().Fd);
+		open.pop_back();
+	}
+
+	printf("seed %d: %d mismatches; %ld lookups, %ld listings and %ld usage queries cost %ld stats and %ld directory calls\n",
+		seed, Mismatches, lookups, listings, usages, FileCalls[FileCall::Stat], Files_DirCalls());
+	return Mismatches != 0;
+}
+
+// A populated save directory polled for usage and listings around a few
+// saves, roughly what the system menu and a game do at boot
+static int BootPattern()
+{
+	static char names[MAX_NAMES * (ISFS_MAXPATH_LEN / 4)];
+	static u8 buffer[512];
+	static const char* probes[] = { "/sub/s1.dat", "/sub/s2.dat", "/banner.bin", "/sub/missing", "/sub/new.dat" };
+	u32 count, files, blocks;
+
+	for (int i = 0; i < 12; i++) {
+		char command[256];
+		sprintf(command, "head -c %d /dev/urandom > %s/sub/s%d.dat", 3000 * i, Files_HostPath(EXT).c_str(), i);
+		system(command);
+	}
+	memset(FileCalls, 0, sizeof(FileCalls));
+
+	for (int round = 0; round < 3; round++) {
+		for (int i = 0; i < 20; i++) {
+			files = blocks = 0;
+			Emu_GetUsage(NAND, &files, &blocks);
+			Emu_GetUsage(NAND "/sub", &files, &blocks);
+			Emu_ReadDir(NAND, &count, NULL, 0);
+			Emu_ReadDir(NAND, &count, names, MAX_NAMES);
+			Emu_ReadDir(NAND "/sub", &count, NULL, 0);
+			Emu_ReadDir(NAND "/sub", &count, names, MAX_NAMES);
+			for (int j = 0; j < 5; j++) {
+				int fd = Emu_Open((NAND + string(probes[j])).c_str(), ISFS_OPEN_READ);
+				if (fd >= 0) {
+					Emu_Read(fd, buffer, 64);
+					Emu_Close(fd);
+				}
+			}
+		}
+
+		Emu_CreateFile(NAND "/sub/new.dat");
+		int fd = Emu_Open(NAND "/sub/new.dat", ISFS_OPEN_RW);
+		for (int i = 0; i < 16; i++)
+			Emu_Write(fd, buffer, sizeof(buffer));
+		Emu_Close(fd);
+		if (round == 1)
+			Emu_Delete(NAND "/sub/s3.dat");
+	}
+
+	printf("boot: %ld stats, %ld directory calls, %ld seeks\n",
+		FileCalls[FileCall::Stat], Files_DirCalls(), FileCalls[FileCall::Seek]);
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2 || (strcmp(argv[1], "boot") && argc < 3)) {
+		fprintf(stderr, "usage: cachetest <seed> <operations> | cachetest boot\n");
+		return 1;
+	}
+
+	Files_Reset(HOST_ROOT);
+	system("mkdir -p " HOST_ROOT EXT "/sub " HOST_ROOT EXT "/.hidden");
+	system("head -c 5000 /dev/urandom > " HOST_ROOT EXT "/a_very_long_file_name.bin");
+	system("head -c 70000 /dev/urandom > " HOST_ROOT EXT "/sub/big.dat");
+	Emu_Start(NAND, EXT);
+
+	if (!strcmp(argv[1], "boot"))
+		return BootPattern();
+	return RandomRun(atoi(argv[1]), atoi(argv[2]));
+}
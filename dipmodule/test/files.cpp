@@ -0,0 +1,241 @@
+// libfile on a host directory. Every call is counted, names match
+// case-insensitively as they do in libfat, and a file open for writing
+// reports the size it had when last closed or synced, like a FAT directory
+// entry does.
+
+#include "test.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <map>
+
+using std::string;
+
+long FileCalls[FileCall::Count];
+int FailWrites;
+
+static string Root;
+
+struct Committed
+{
+	int Writers;
+	u64 Size;
+};
+
+static std::map<string, Committed> Writing; // by host path
+static std::map<int, string> FilePaths;
+static std::map<int, bool> FileWrites;
+static std::map<int, DIR*> Dirs;
+static std::map<int, string> DirPaths;
+static int NextDir = 1;
+
+void Files_Reset(const char* root)
+{
+	Root = root;
+	system(("rm -rf " + Root + " && mkdir -p " + Root).c_str());
+	memset(FileCalls, 0, sizeof(FileCalls));
+}
+
+// Each component takes the case of an existing entry if there is one
+string Files_HostPath(const char* path)
+{
+	string host = Root;
+	while (*path == '/')
+		path++;
+
+	while (*path) {
+		const char* end = strchr(path, '/');
+		string name = end ? string(path, end - path) : string(path);
+		struct stat st;
+		if (!name.empty() && stat((host + "/" + name).c_str(), &st)) {
+			DIR* dir = opendir(host.c_str());
+			while (dir) {
+				struct dirent* entry = readdir(dir);
+				if (!entry)
+					break;
+				if (!strcasecmp(entry->d_name, name.c_str())) {
+					name = entry->d_name;
+					break;
+				}
+			}
+			if (dir)
+				closedir(dir);
+		}
+		host += "/" + name;
+		if (!end)
+			break;
+		path = end + 1;
+	}
+	return host;
+}
+
+long Files_DirCalls()
+{
+	return FileCalls[FileCall::OpenDir] + FileCalls[FileCall::NextDir] + FileCalls[FileCall::CloseDir];
+}
+
+static u64 ReportedSize(const string& host, u64 size)
+{
+	std::map<string, Committed>::iterator it = Writing.find(host);
+	if (it != Writing.end() && it->second.Writers)
+		return it->second.Size;
+	return size;
+}
+
+static void ToStats(const string& host, const struct stat* st, Stats* stats)
+{
+	stats->Identifier = st->st_ino;
+	stats->Size = ReportedSize(host, st->st_size);
+	stats->Device = 0;
+	stats->Mode = st->st_mode;
+}
+
+int File_Stat(const char* path, Stats* stats)
+{
+	FileCalls[FileCall::Stat]++;
+	string host = Files_HostPath(path);
+	struct stat st;
+	if (stat(host.c_str(), &st))
+		return -1;
+	ToStats(host, &st, stats);
+	return 0;
+}
+
+int File_CreateFile(const char* path)
+{
+	FileCalls[FileCall::CreateFile]++;
+	int fd = open(Files_HostPath(path).c_str(), O_CREAT | O_WRONLY, 0644);
+	if (fd < 0)
+		return -1;
+	close(fd);
+	return 0;
+}
+
+int File_Delete(const char* path)
+{
+	FileCalls[FileCall::Delete]++;
+	string host = Files_HostPath(path);
+	struct stat st;
+	if (stat(host.c_str(), &st))
+		return -1;
+	return S_ISDIR(st.st_mode) ? rmdir(host.c_str()) : unlink(host.c_str());
+}
+
+int File_Rename(const char* source, const char* dest)
+{
+	FileCalls[FileCall::Rename]++;
+	string host = Files_HostPath(dest);
+	struct stat st;
+	if (!stat(host.c_str(), &st))
+		return -1;
+	return rename(Files_HostPath(source).c_str(), host.c_str());
+}
+
+int File_CreateDir(const char* path)
+{
+	FileCalls[FileCall::CreateDir]++;
+	return mkdir(Files_HostPath(path).c_str(), 0755);
+}
+
+int File_OpenDir(const char* path)
+{
+	FileCalls[FileCall::OpenDir]++;
+	string host = Files_HostPath(path);
+	DIR* dir = opendir(host.c_str());
+	if (!dir)
+		return -1;
+	Dirs[NextDir] = dir;
+	DirPaths[NextDir] = host;
+	return NextDir++;
+}
+
+int File_NextDir(int dir, char* name, Stats* stats)
+{
+	FileCalls[FileCall::NextDir]++;
+	struct dirent* entry = readdir(Dirs[dir]);
+	if (!entry)
+		return -1;
+	strcpy(name, entry->d_name);
+
+	string host = DirPaths[dir] + "/" + entry->d_name;
+	struct stat st;
+	stat(host.c_str(), &st);
+	ToStats(host, &st, stats);
+	return 0;
+}
+
+int File_CloseDir(int dir)
+{
+	FileCalls[FileCall::CloseDir]++;
+	closedir(Dirs[dir]);
+	Dirs.erase(dir);
+	DirPaths.erase(dir);
+	return 0;
+}
+
+int File_Open(const char* path, int mode)
+{
+	FileCalls[FileCall::Open]++;
+	string host = Files_HostPath(path);
+	int fd = open(host.c_str(), mode & O_ACCMODE);
+	if (fd < 0)
+		return -1;
+
+	FilePaths[fd] = host;
+	FileWrites[fd] = (mode & O_ACCMODE) != O_RDONLY;
+	if (FileWrites[fd]) {
+		Committed& committed = Writing[host];
+		if (!committed.Writers++)
+			committed.Size = lseek(fd, 0, SEEK_END);
+		lseek(fd, 0, SEEK_SET);
+	}
+	return fd;
+}
+
+int File_Close(int fd)
+{
+	FileCalls[FileCall::Close]++;
+	if (FileWrites[fd]) {
+		Committed& committed = Writing[FilePaths[fd]];
+		committed.Writers--;
+		committed.Size = lseek(fd, 0, SEEK_END);
+	}
+	FilePaths.erase(fd);
+	FileWrites.erase(fd);
+	return close(fd);
+}
+
+int File_Read(int fd, void* buffer, int length)
+{
+	FileCalls[FileCall::Read]++;
+	return read(fd, buffer, length);
+}
+
+int File_Write(int fd, const void* buffer, int length)
+{
+	FileCalls[FileCall::Write]++;
+	if (FailWrites)
+		return -1;
+	return write(fd, buffer, length);
+}
+
+int File_Seek(int fd, int where, int whence)
+{
+	FileCalls[FileCall::Seek]++;
+	return lseek(fd, where, whence);
+}
+
+int File_Sync(int fd)
+{
+	FileCalls[FileCall::Sync]++;
+	if (FileWrites[fd]) {
+		off_t position = lseek(fd, 0, SEEK_CUR);
+		Writing[FilePaths[fd]].Size = lseek(fd, 0, SEEK_END);
+		lseek(fd, position, SEEK_SET);
+	}
+	return 0;
+}
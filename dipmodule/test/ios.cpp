@@ -0,0 +1,367 @@
+// Stand-ins for the IOS kernel, libios and binfile, and a fake /dev/fs that
+// hands ISFS requests to EMU::HandleFSMessage the way FilesystemHook does.
+
+#include "test.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+
+#include <algorithm>
+
+#include "binfile.h"
+
+using namespace ProxiIOS::EMU;
+
+long HeapUsed;
+long HeapPeak;
+
+static void* Track(void* data)
+{
+	if (data) {
+		HeapUsed += malloc_usable_size(data);
+		HeapPeak = std::max(HeapPeak, HeapUsed);
+	}
+	return data;
+}
+
+void* Alloc(u32 size)
+{
+	return Track(malloc(size));
+}
+
+void* Memalign(u32 align, u32 size)
+{
+	return Track(memalign(align, size));
+}
+
+bool Dealloc(void* data)
+{
+	HeapUsed -= malloc_usable_size(data);
+	free(data);
+	return true;
+}
+
+u32 HeapInfo()
+{
+	return 0;
+}
+
+int os_thread_create(u32 (*entry)(void* _arg), void* arg, void* stack_top, u32 stacksize, u32 priority, u32 detached)
+{
+	return 1;
+}
+
+int os_thread_continue(int id)
+{
+	return 0;
+}
+
+osqueue_t os_message_queue_create(void* ptr, u32 n_msgs)
+{
+	return -1;
+}
+
+s32 os_message_queue_receive(osqueue_t queue, u32* message, u32 flags)
+{
+	return -1;
+}
+
+void os_message_queue_ack(const ipcmessage* message, s32 result)
+{
+}
+
+u32 os_device_register(const char* devicename, osqueue_t queuehandle)
+{
+	return 0;
+}
+
+s32 os_open(const char* device, s32 mode)
+{
+	return IPC_ENOENT;
+}
+
+s32 os_close(s32 fd)
+{
+	return IPC_EINVAL;
+}
+
+s32 os_ioctl(s32 fd, s32 request, const void* buffer_in, s32 bytes_in, void* buffer_io, s32 bytes_io)
+{
+	return IPC_EINVAL;
+}
+
+s32 os_close_async(s32 fd, osqueue_t cb, ipcmessage* cb_data)
+{
+	return IPC_EINVAL;
+}
+
+s32 os_ioctl_async(s32 fd, s32 request, const void* buffer_in, s32 bytes_in, void* buffer_io, s32 bytes_io, osqueue_t cb, ipcmessage* cb_data)
+{
+	return IPC_EINVAL;
+}
+
+void os_sync_before_read(const void* ptr, u32 size)
+{
+}
+
+void os_sync_after_write(const void* ptr, u32 size)
+{
+}
+
+int os_get_4byte_key(int keyid, u32* buffer)
+{
+	return -1;
+}
+
+namespace std {
+	void __logging_abort(const char* message)
+	{
+		fprintf(stderr, "abort: %s\n", message);
+		abort();
+	}
+}
+
+// no NAND titles to read contents from
+BinFile* OpenBinRead(s32 file)
+{
+	return NULL;
+}
+
+BinFile* CreateBinFile(u16 index, u32* tmd_buf, u32 size, s32 file)
+{
+	return NULL;
+}
+
+void CloseBin(BinFile* bin)
+{
+}
+
+s32 SeekBin(BinFile* bin, s32 where, u32 whence)
+{
+	return -1;
+}
+
+s32 ReadBin(BinFile* bin, u8* buffer, u32 length)
+{
+	return -1;
+}
+
+s32 WriteBin(BinFile* bin, u8* buffer, u32 length)
+{
+	return -1;
+}
+
+namespace ProxiIOS {
+	Module::Module(const char* device)
+	{
+	}
+
+	int Module::Loop()
+	{
+		return 0;
+	}
+
+	int Module::HandleOpen(ipcmessage* message)
+	{
+		return 0;
+	}
+}
+
+// fake IPC
+
+#define FS_FD 0x7FFFFFF0 // anything that isn't a RiivFile
+
+EMU* Emu;
+
+static int Send(ipcmessage* message)
+{
+	int result = IPC_EINVAL;
+	if (!Emu->HandleFSMessage(message, &result))
+		return IPC_ENOENT; // would have gone to the real /dev/fs
+	return result;
+}
+
+void Emu_Start(const char* nand_dir, const char* ext_dir)
+{
+	// EMU hands out RiivFile pointers as file descriptors, so keep every
+	// allocation in brk, just above the non-PIE image
+	mallopt(M_MMAP_MAX, 0);
+
+	static u8 stack[0x1000];
+	Emu = new EMU(stack, sizeof(stack));
+
+	ioctlv vector[2];
+	ipcmessage message = {};
+	vector[0].data = (void*)nand_dir;
+	vector[1].data = (void*)ext_dir;
+	message.ioctlv.command = Ioctl::RedirectDir;
+	message.ioctlv.num_in = 2;
+	message.ioctlv.vector = vector;
+	Emu->HandleIoctlv(&message);
+}
+
+int Emu_Open(const char* path, u32 mode)
+{
+	ipcmessage message = {};
+	message.command = ProxiIOS::Ios::Open;
+	message.open.device = path;
+	message.open.mode = mode;
+	return Send(&message);
+}
+
+int Emu_Close(int fd)
+{
+	ipcmessage message = {};
+	message.command = ProxiIOS::Ios::Close;
+	message.fd = fd;
+	return Send(&message);
+}
+
+int Emu_Read(int fd, void* buffer, u32 length)
+{
+	ipcmessage message = {};
+	message.command = ProxiIOS::Ios::Read;
+	message.fd = fd;
+	message.read.data = buffer;
+	message.read.length = length;
+	return Send(&message);
+}
+
+int Emu_Write(int fd, const void* buffer, u32 length)
+{
+	ipcmessage message = {};
+	message.command = ProxiIOS::Ios::Write;
+	message.fd = fd;
+	message.write.data = buffer;
+	message.write.length = length;
+	return Send(&message);
+}
+
+int Emu_Seek(int fd, s32 where, s32 whence)
+{
+	ipcmessage message = {};
+	message.command = ProxiIOS::Ios::Seek;
+	message.fd = fd;
+	message.seek.offset = where;
+	message.seek.origin = whence;
+	return Send(&message);
+}
+
+int Emu_FileStats(int fd, ProxiIOS::ISFS::Stats* stats)
+{
+	ipcmessage message = {};
+	message.command = ProxiIOS::Ios::Ioctl;
+	message.fd = fd;
+	message.ioctl.command = Ioctl::GetFileStats;
+	message.ioctl.buffer_io = stats;
+	message.ioctl.length_io = sizeof(*stats);
+	return Send(&message);
+}
+
+static int PathIoctl(u32 command, const char* path, const char* dest = NULL)
+{
+	static char buffer[ISFS_MAXPATH_LEN * 2];
+	memset(buffer, 0, sizeof(buffer));
+	strncpy(buffer, path, ISFS_MAXPATH_LEN - 1);
+	if (dest)
+		strncpy(buffer + ISFS_MAXPATH_LEN, dest, ISFS_MAXPATH_LEN - 1);
+
+	ipcmessage message = {};
+	message.command = ProxiIOS::Ios::Ioctl;
+	message.fd = FS_FD;
+	message.ioctl.command = command;
+	message.ioctl.buffer_in = buffer;
+	message.ioctl.length_in = dest ? sizeof(buffer) : ISFS_MAXPATH_LEN;
+	return Send(&message);
+}
+
+static int AttribIoctl(u32 command, const char* path)
+{
+	static ProxiIOS::ISFS::FSattr attributes;
+	memset(&attributes, 0, sizeof(attributes));
+	strncpy(attributes.path, path, ISFS_MAXPATH_LEN - 1);
+
+	ipcmessage message = {};
+	message.command = ProxiIOS::Ios::Ioctl;
+	message.fd = FS_FD;
+	message.ioctl.command = command;
+	message.ioctl.buffer_in = &attributes;
+	message.ioctl.length_in = sizeof(attributes);
+	return Send(&message);
+}
+
+int Emu_CreateFile(const char* path)
+{
+	return AttribIoctl(Ioctl::CreateFile, path);
+}
+
+int Emu_CreateDir(const char* path)
+{
+	return AttribIoctl(Ioctl::CreateDir, path);
+}
+
+// GetAttrib itself reads the disc ID from low MEM1, SetAttrib resolves the
+// path the same way without that
+int Emu_GetAttrib(const char* path)
+{
+	return AttribIoctl(Ioctl::SetAttrib, path);
+}
+
+int Emu_Delete(const char* path)
+{
+	return PathIoctl(Ioctl::Delete, path);
+}
+
+int Emu_Rename(const char* source, const char* dest)
+{
+	return PathIoctl(Ioctl::Move, source, dest);
+}
+
+int Emu_ReadDir(const char* path, u32* count, char* names, u32 max)
+{
+	static char buffer[ISFS_MAXPATH_LEN];
+	static u32 max_count;
+	strncpy(buffer, path, ISFS_MAXPATH_LEN - 1);
+	max_count = max;
+
+	ioctlv vector[4];
+	ipcmessage message = {};
+	message.command = ProxiIOS::Ios::Ioctlv;
+	message.fd = FS_FD;
+	message.ioctlv.command = Ioctl::ReadDir;
+	message.ioctlv.vector = vector;
+	vector[0].data = buffer;
+	vector[0].len = ISFS_MAXPATH_LEN;
+	if (names) {
+		message.ioctlv.num_in = 2;
+		message.ioctlv.num_io = 2;
+		vector[1].data = &max_count;
+		vector[2].data = names;
+		vector[3].data = count;
+	} else {
+		message.ioctlv.num_in = 1;
+		message.ioctlv.num_io = 1;
+		vector[1].data = count;
+	}
+	return Send(&message);
+}
+
+int Emu_GetUsage(const char* path, u32* files, u32* blocks)
+{
+	static char buffer[ISFS_MAXPATH_LEN];
+	strncpy(buffer, path, ISFS_MAXPATH_LEN - 1);
+
+	ioctlv vector[3];
+	ipcmessage message = {};
+	message.command = ProxiIOS::Ios::Ioctlv;
+	message.fd = FS_FD;
+	message.ioctlv.command = Ioctl::GetUsage;
+	message.ioctlv.num_in = 1;
+	message.ioctlv.num_io = 2;
+	message.ioctlv.vector = vector;
+	vector[0].data = buffer;
+	vector[1].data = blocks;
+	vector[2].data = files;
+	return Send(&message);
+}
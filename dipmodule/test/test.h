@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+
+// emu.h maps __throw_length_error onto this, for the containers it uses
+namespace std { void __logging_abort(const char* message); }
+
+#include "emu.h"
+
+// files.cpp: libfile on a host directory
+namespace FileCall {
+	enum Enum {
+		Stat,
+		CreateFile,
+		Delete,
+		Rename,
+		CreateDir,
+		OpenDir,
+		NextDir,
+		CloseDir,
+		Open,
+		Close,
+		Read,
+		Write,
+		Seek,
+		Sync,
+		Count
+	};
+}
+
+extern long FileCalls[FileCall::Count];
+extern int FailWrites; // File_Write fails while it's set
+void Files_Reset(const char* root);
+std::string Files_HostPath(const char* path);
+long Files_DirCalls();
+
+// ios.cpp: an EMU with one redirected directory, driven by fake IPC
+extern long HeapUsed;
+extern long HeapPeak;
+extern ProxiIOS::EMU::EMU* Emu;
+void Emu_Start(const char* nand_dir, const char* ext_dir);
+int Emu_Open(const char* path, u32 mode);
+int Emu_Close(int fd);
+int Emu_Read(int fd, void* buffer, u32 length);
+int Emu_Write(int fd, const void* buffer, u32 length);
+int Emu_Seek(int fd, s32 where, s32 whence);
+int Emu_FileStats(int fd, ProxiIOS::ISFS::Stats* stats);
+int Emu_CreateFile(const char* path);
+int Emu_CreateDir(const char* path);
+int Emu_GetAttrib(const char* path);
+int Emu_Delete(const char* path);
+int Emu_Rename(const char* source, const char* dest);
+int Emu_ReadDir(const char* path, u32* count, char* names, u32 max);
+int Emu_GetUsage(const char* path, u32* files, u32* blocks);
@@ -0,0 +1,293 @@
+// Write patterns replayed through redirected files, checking every result
+// and the files left behind byte for byte against a model.
+//
+//   writetest   game-like traces, then random runs on several files at once
+
+#include "test.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace ProxiIOS::EMU;
+using std::string;
+
+#define HOST_ROOT	"/tmp/dipmodule_writetest"
+#define NAND		"/title/00010000/52524d45/data"
+#define EXT			"/sd/save"
+#define MAX_LENGTH	0x1F000
+#define FILES		4
+
+static int Mismatches;
+static u8 Data[0x20000];
+static u8 ReadBack[0x20000];
+
+struct Model
+{
+	string Name;
+	std::vector<u8> Bytes;
+	s32 Pos;
+	int Fd;
+
+	void Write(const u8* data, u32 length)
+	{
+		if (Bytes.size() < Pos + length)
+			Bytes.resize(Pos + length);
+		memcpy(&Bytes[Pos], data, length);
+		Pos += length;
+	}
+
+	string Path() const
+	{
+		return NAND "/" + Name;
+	}
+
+	void Open()
+	{
+		Fd = Emu_Open(Path().c_str(), ISFS_OPEN_RW);
+		Pos = 0;
+	}
+
+	// the host file has to match once it's closed
+	void Close(const char* what)
+	{
+		Emu_Close(Fd);
+		Fd = -1;
+
+		FILE* file = fopen(Files_HostPath((EXT "/" + Name).c_str()).c_str(), "rb");
+		size_t length = fread(ReadBack, 1, sizeof(ReadBack), file);
+		fclose(file);
+		if (length != Bytes.size() || memcmp(ReadBack, &Bytes[0], length)) {
+			printf("%s: %s has %zu bytes, want %zu\n", what, Name.c_str(), length, Bytes.size());
+			Mismatches++;
+		}
+	}
+
+	void CheckStats(const char* what)
+	{
+		ProxiIOS::ISFS::Stats stats;
+		Emu_FileStats(Fd, &stats);
+		if (stats.Pos != Pos || stats.Length != (s32)Bytes.size()) {
+			printf("%s: %s stats are %d/%d, want %d/%zu\n", what, Name.c_str(), stats.Pos, stats.Length, Pos, Bytes.size());
+			Mismatches++;
+		}
+	}
+};
+
+static void Create(Model* model, const char* name)
+{
+	model->Name = name;
+	model->Bytes.clear();
+	model->Bytes.reserve(MAX_LENGTH); // so the heap only grows for EMU
+	Emu_CreateFile(model->Path().c_str());
+	model->Open();
+}
+
+static void Write(Model* model, const u8* data, u32 length, const char* what)
+{
+	int ret = Emu_Write(model->Fd, data, length);
+	if (ret != (int)length) {
+		printf("%s: writing %u bytes to %s returned %d\n", what, length, model->Name.c_str(), ret);
+		Mismatches++;
+	}
+	model->Write(data, length);
+}
+
+static void Seek(Model* model, s32 where, s32 whence, const char* what)
+{
+	int ret = Emu_Seek(model->Fd, where, whence);
+	model->Pos = whence == SEEK_SET ? where : whence == SEEK_CUR ? model->Pos + where : model->Bytes.size() + where;
+	if (ret != model->Pos) {
+		printf("%s: seek in %s returned %d, want %d\n", what, model->Name.c_str(), ret, model->Pos);
+		Mismatches++;
+	}
+}
+
+static void Read(Model* model, u32 length, const char* what)
+{
+	int ret = Emu_Read(model->Fd, ReadBack, length);
+	int want = std::min<int>(length, model->Bytes.size() - model->Pos);
+	if (ret != want || memcmp(ReadBack, &model->Bytes[model->Pos], want)) {
+		printf("%s: reading %u bytes from %s returned %d, want %d\n", what, length, model->Name.c_str(), ret, want);
+		Mismatches++;
+	}
+	model->Pos += want;
+}
+
+// patterns modelled on what games do
+static void Traces()
+{
+	Model model;
+	long writes, seeks;
+
+	writes = FileCalls[FileCall::Write], seeks = FileCalls[FileCall::Seek];
+	Create(&model, "wc24.vff");
+	for (int i = 0; i < 256; i++)
+		Write(&model, Data + i * 512, 512, "VFF");
+	model.Close("VFF");
+	printf("%-52s %4ld File_Write %4ld File_Seek\n", "VFF: 512 byte sequential writes",
+		FileCalls[FileCall::Write] - writes, FileCalls[FileCall::Seek] - seeks);
+
+	writes = FileCalls[FileCall::Write], seeks = FileCalls[FileCall::Seek];
+	Create(&model, "save.bin");
+	Write(&model, Data, 32, "save");
+	for (int i = 0; i < 300; i++)
+		Write(&model, Data + 100 + i * 64, 64, "save");
+	Seek(&model, 0, SEEK_SET, "save");
+	Write(&model, Data + 77, 32, "save");
+	model.Close("save");
+	printf("%-52s %4ld File_Write %4ld File_Seek\n", "save: header, 64 byte records, header rewritten",
+		FileCalls[FileCall::Write] - writes, FileCalls[FileCall::Seek] - seeks);
+
+	writes = FileCalls[FileCall::Write], seeks = FileCalls[FileCall::Seek];
+	Create(&model, "banner.bin");
+	Write(&model, Data, 0x20, "banner");
+	for (int i = 0; i < 0x30; i++) {
+		Write(&model, Data + 0x20 + i * 0x200, 0x200, "banner");
+		model.CheckStats("banner");
+	}
+	model.Close("banner");
+	printf("%-52s %4ld File_Write %4ld File_Seek\n", "banner: 0x200 byte chunks, stats after each",
+		FileCalls[FileCall::Write] - writes, FileCalls[FileCall::Seek] - seeks);
+
+	writes = FileCalls[FileCall::Write], seeks = FileCalls[FileCall::Seek];
+	Create(&model, "log.dat");
+	for (int round = 0; round < 20; round++) {
+		if (round) {
+			model.Close("append");
+			model.Open();
+		}
+		Seek(&model, 0, SEEK_END, "append");
+		for (int i = 0; i < 10; i++)
+			Write(&model, Data + round * 1000 + i * 10, 10, "append");
+		Seek(&model, 0, SEEK_SET, "append");
+		Read(&model, sizeof(ReadBack), "append");
+	}
+	model.Close("append");
+	printf("%-52s %4ld File_Write %4ld File_Seek\n", "append: reopen, add 100 bytes, read it all back",
+		FileCalls[FileCall::Write] - writes, FileCalls[FileCall::Seek] - seeks);
+}
+
+// every open file may have data waiting, but only a couple of them get a buffer
+static void ManyFiles()
+{
+	Model models[MAX_EMU_OPEN - 1];
+	char name[16];
+
+	for (int i = 0; i < MAX_EMU_OPEN - 1; i++) {
+		sprintf(name, "many%02d.bin", i);
+		Create(models + i, name);
+	}
+
+	long used = HeapUsed;
+	HeapPeak = HeapUsed;
+	for (int round = 0; round < 8; round++) {
+		for (int i = 0; i < MAX_EMU_OPEN - 1; i++)
+			Write(models + i, Data + i * 100 + round, 100 + round, "many");
+	}
+	if (HeapPeak - used > RIIVFILE_BUFFERS * (RIIVFILE_BUFFER_SIZE + 0x40)) {
+		printf("many: writing to %d files took %ld bytes of heap\n", MAX_EMU_OPEN - 1, HeapPeak - used);
+		Mismatches++;
+	}
+
+	for (int i = 0; i < MAX_EMU_OPEN - 1; i++)
+		models[i].Close("many");
+}
+
+// buffered data that can't be written out fails whatever made it go
+static void Failures()
+{
+	Model model;
+
+	Create(&model, "fail.bin");
+	Write(&model, Data, 3000, "failure");
+	model.Close("failure");
+
+	model.Open();
+	Emu_Write(model.Fd, Data, 100);
+	FailWrites = 1;
+	int ret = Emu_Read(model.Fd, ReadBack, 100);
+	FailWrites = 0;
+	if (ret != FSErrors::IOError) {
+		printf("failure: read after a failed flush returned %d\n", ret);
+		Mismatches++;
+	}
+	Emu_Close(model.Fd);
+
+	model.Open();
+	Emu_Write(model.Fd, Data, 100);
+	FailWrites = 1;
+	ret = Emu_Seek(model.Fd, 1000, SEEK_SET);
+	FailWrites = 0;
+	if (ret != FSErrors::IOError) {
+		printf("failure: seek after a failed flush returned %d\n", ret);
+		Mismatches++;
+	}
+	Emu_Close(model.Fd);
+}
+
+// random operations on a few files at once, each starting from what the previous seed left
+static void Random(int seed)
+{
+	static const char* names[FILES] = { "rand0.bin", "rand1.bin", "rand2.bin", "rand3.bin" };
+	Model models[FILES];
+
+	srand(seed);
+	for (int i = 0; i < FILES; i++) {
+		models[i].Name = names[i];
+		Emu_CreateFile(models[i].Path().c_str());
+		FILE* file = fopen(Files_HostPath((EXT "/" + models[i].Name).c_str()).c_str(), "rb");
+		size_t length = fread(ReadBack, 1, sizeof(ReadBack), file);
+		fclose(file);
+		models[i].Bytes.assign(ReadBack, ReadBack + length);
+		models[i].Open();
+	}
+
+	for (int op = 0; op < 300; op++) {
+		Model* model = models + rand() % FILES;
+		int kind = rand() % 10;
+		if (kind < 5) {
+			u32 length = rand() % 3 ? 1 + rand() % 700 : 1 + rand() % 0x9000;
+			if (model->Pos + length <= MAX_LENGTH)
+				Write(model, Data + rand() % 0x10000, length, "random");
+		} else if (kind < 7) {
+			int whence = rand() % 3;
+			s32 where = 0;
+			if (whence == SEEK_SET)
+				where = rand() % 4 ? rand() % (model->Bytes.size() + 1) : model->Pos;
+			Seek(model, where, whence, "random");
+		} else if (kind < 8)
+			Read(model, rand() % 3000, "random");
+		else if (kind < 9)
+			model->CheckStats("random");
+		else {
+			model->Close("random");
+			model->Open();
+		}
+	}
+
+	for (int i = 0; i < FILES; i++)
+		models[i].Close("random");
+}
+
+int main(int argc, char** argv)
+{
+	Files_Reset(HOST_ROOT);
+	system("mkdir -p " HOST_ROOT EXT);
+	Emu_Start(NAND, EXT);
+
+	for (size_t i = 0; i < sizeof(Data); i++)
+		Data[i] = rand();
+
+	Traces();
+	ManyFiles();
+	Failures();
+	for (int seed = 1; seed <= 200; seed++)
+		Random(seed);
+
+	printf("%d mismatches\n", Mismatches);
+	return Mismatches != 0;
+}
@@ -0,0 +1,742 @@
+// Host bench for the file module. Runs Riivolution-like workloads through
+// libfile against FAT or exFAT images and reports modelled throughput and
+// per-call latency percentiles. Afterwards everything a workload wrote is
+// read back and compared with a shadow copy, before and after a remount,
+// and the unmounted image goes through fsck.cpp's checker. The model
+// workload does that every few hundred random calls as well.
+// See the Makefile for how to build and run it.
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/param.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "files.h"
+
+#define MOUNT_NAME		"sd"
+#define ROOT			"/mnt/" MOUNT_NAME
+
+// Ballpark figures: a class 10 SD card behind /dev/sdio and a USB 2.0 flash
+// drive behind the EHCI mass storage driver. Override them with -l.
+static const DiscModel Models[] = {
+	{ "sd", 150, 45, 85, 25 },
+	{ "usb", 600, 21, 28, 25 }
+};
+
+DiscModel Model = Models[0];
+
+namespace Ops {
+	enum Enum {
+		Open,
+		Close,
+		Read,
+		Write,
+		Seek,
+		Stat,
+		CreateFile,
+		CreateDir,
+		Delete,
+		Rename,
+		OpenDir,
+		NextDir,
+		CloseDir,
+		Count
+	};
+}
+
+static const char* OpNames[Ops::Count] = {
+	"open", "close", "read", "write", "seek", "stat", "createfile",
+	"createdir", "delete", "rename", "opendir", "nextdir", "closedir"
+};
+
+static std::vector<double> Samples[Ops::Count];
+static double Started;
+static double CallStarted;
+static int Failures;
+static int Mounted;
+static disk_phys Disk = SD_DISK;
+
+// what every file a workload touched should hold, and the ones it removed
+static std::map<std::string, std::vector<u8> > Shadow;
+static std::set<std::string> Removed;
+
+static u32 RandomState;
+
+static u32 Random()
+{
+	RandomState ^= RandomState << 13;
+	RandomState ^= RandomState >> 17;
+	RandomState ^= RandomState << 5;
+	return RandomState;
+}
+
+static u32 Random(u32 low, u32 high)
+{
+	return low + Random() % (high - low + 1);
+}
+
+// Paths and buffers are static: the module stores their addresses in u32s
+// like it would on the Starlet, so they have to stay below 4 GiB
+static char Path[MAXPATHLEN];
+static char Path2[MAXPATHLEN];
+static u8 Buffer[0x100000] ATTRIBUTE_ALIGN(32);
+
+static int Record(Ops::Enum op, double start, int ret)
+{
+	Samples[op].push_back(Clock - start);
+	return ret;
+}
+
+#define TIMED(op, call) (CallStarted = Clock, Record(op, CallStarted, call))
+
+static void Check(bool ok, const char* what)
+{
+	if (!ok) {
+		if (Failures++ < 10)
+			fprintf(stderr, "%s failed: %s\n", what, Path);
+	}
+}
+
+// Data that differs from block to block, so misplaced or stale sectors show
+static void Fill(u8* buffer, u32 length, u32 seed)
+{
+	u32 state = seed * 2654435761U | 1;
+	for (u32 i = 0; i < length; i += 4) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		memcpy(buffer + i, &state, MIN(4, length - i));
+	}
+}
+
+static void ShadowWrite(const char* path, u32 offset, const u8* data, u32 length)
+{
+	std::vector<u8>& shadow = Shadow[path];
+	if (shadow.size() < offset + length)
+		shadow.resize(offset + length);
+	memcpy(&shadow[offset], data, length);
+	Removed.erase(path);
+}
+
+static void ShadowCreate(const char* path)
+{
+	Shadow[path].clear();
+	Removed.erase(path);
+}
+
+static void ShadowDelete(const char* path)
+{
+	Shadow.erase(path);
+	Removed.insert(path);
+}
+
+static void ShadowRename(const char* path, const char* destination)
+{
+	Shadow[destination].swap(Shadow[path]);
+	Removed.erase(destination);
+	ShadowDelete(path);
+}
+
+// Untimed helpers for building the tree a workload runs on
+
+static void MakeDirs(const char* path)
+{
+	char dir[MAXPATHLEN];
+	strcpy(dir, path);
+	for (char* slash = strchr(dir + strlen(ROOT) + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+		*slash = '\0';
+		File_CreateDir(dir);
+		*slash = '/';
+	}
+	File_CreateDir(dir);
+}
+
+static void MakeFile(const char* path, u32 size)
+{
+	int fd = File_Open(path, O_CREAT | O_TRUNC | O_WRONLY);
+	Check(fd >= 0, "setup open");
+	ShadowCreate(path);
+	for (u32 done = 0; fd >= 0 && done < size; ) {
+		u32 length = MIN(size - done, sizeof(Buffer));
+		Fill(Buffer, length, Random());
+		Check(File_Write(fd, Buffer, length) == (int)length, "setup write");
+		ShadowWrite(path, done, Buffer, length);
+		done += length;
+	}
+	File_Close(fd);
+}
+
+// Riivolution launch: the launcher and EMU list every folder patch and stat
+// its files, then the game reads from random replaced files in DVD-sized
+// chunks, favouring a few hot ones.
+
+#define LAUNCH_FOLDERS	4
+#define LAUNCH_FILES	40
+
+static const char* LaunchFolders[LAUNCH_FOLDERS] = { "Stage", "Sound/stream", "Object", "Layout/common" };
+
+static void LaunchPath(char* path, int folder, int file)
+{
+	sprintf(path, ROOT "/riivolution/bench_mod/%s/file_%03d.arc", LaunchFolders[folder], file);
+}
+
+static void LaunchSetup(int iterations)
+{
+	for (int folder = 0; folder < LAUNCH_FOLDERS; folder++) {
+		sprintf(Path, ROOT "/riivolution/bench_mod/%s", LaunchFolders[folder]);
+		MakeDirs(Path);
+		for (int file = 0; file < LAUNCH_FILES; file++) {
+			LaunchPath(Path, folder, file);
+			// 4 KiB to 1 MiB, most of them small
+			MakeFile(Path, MAX(0x1000, 0x100000 >> Random(0, 10)));
+		}
+	}
+}
+
+static void LaunchRun(int iterations)
+{
+	char name[MAXPATHLEN];
+	Stats st;
+
+	for (int folder = 0; folder < LAUNCH_FOLDERS; folder++) {
+		sprintf(Path, ROOT "/riivolution/bench_mod/%s", LaunchFolders[folder]);
+		int dir = TIMED(Ops::OpenDir, File_OpenDir(Path));
+		Check(dir >= 0, "opendir");
+		while (dir >= 0 && TIMED(Ops::NextDir, File_NextDir(dir, name, &st)) == 0) {
+			sprintf(Path, ROOT "/riivolution/bench_mod/%s/%s", LaunchFolders[folder], name);
+			Check(TIMED(Ops::Stat, File_Stat(Path, &st)) >= 0, "stat");
+		}
+		if (dir >= 0)
+			TIMED(Ops::CloseDir, File_CloseDir(dir));
+	}
+
+	for (int i = 0; i < iterations * 20; i++) {
+		u32 pick = Random() % (LAUNCH_FOLDERS * LAUNCH_FILES);
+		pick = pick * (Random() % (LAUNCH_FOLDERS * LAUNCH_FILES)) / (LAUNCH_FOLDERS * LAUNCH_FILES);
+		LaunchPath(Path, pick / LAUNCH_FILES, pick % LAUNCH_FILES);
+
+		Check(TIMED(Ops::Stat, File_Stat(Path, &st)) >= 0, "stat");
+		int fd = TIMED(Ops::Open, File_Open(Path, O_RDONLY));
+		Check(fd >= 0, "open");
+		if (fd < 0)
+			continue;
+
+		u32 offset = (Random() % MAX(st.Size, 1)) & ~0x7FF;
+		TIMED(Ops::Seek, File_Seek(fd, offset, SEEK_SET));
+		for (int chunk = Random(1, 4); chunk > 0; chunk--) {
+			if (TIMED(Ops::Read, File_Read(fd, Buffer, 0x8000)) <= 0)
+				break;
+		}
+		TIMED(Ops::Close, File_Close(fd));
+	}
+}
+
+// Save redirection: a game rewrites its save the way the Wii system menu
+// expects, through a temporary file that is renamed over the old one, and
+// then sits idle long enough for the idle flush to kick in.
+
+#define SAVE_DIR		ROOT "/riivolution/save/00010000/52534245/data"
+#define SAVE_TMP		ROOT "/riivolution/save/tmp/data.bin"
+#define SAVE_SIZE		0x20000
+#define SAVE_CHUNK		0x4000
+
+static void SaveSetup(int iterations)
+{
+	MakeDirs(SAVE_DIR);
+	MakeDirs(ROOT "/riivolution/save/tmp");
+	MakeFile(SAVE_DIR "/banner.bin", 0xF0C0);
+	MakeFile(SAVE_DIR "/data.bin", SAVE_SIZE);
+}
+
+static void SaveRun(int iterations)
+{
+	Stats st;
+
+	for (int i = 0; i < iterations; i++) {
+		strcpy(Path, SAVE_DIR "/banner.bin");
+		Check(TIMED(Ops::Stat, File_Stat(Path, &st)) >= 0, "stat");
+
+		strcpy(Path, SAVE_DIR "/data.bin");
+		int fd = TIMED(Ops::Open, File_Open(Path, O_RDONLY));
+		Check(fd >= 0, "open");
+		for (int done = 0; fd >= 0 && done < SAVE_SIZE; done += SAVE_CHUNK)
+			Check(TIMED(Ops::Read, File_Read(fd, Buffer, SAVE_CHUNK)) == SAVE_CHUNK, "read");
+		TIMED(Ops::Close, File_Close(fd));
+
+		strcpy(Path, SAVE_TMP);
+		TIMED(Ops::CreateFile, File_CreateFile(Path));
+		ShadowCreate(Path);
+		fd = TIMED(Ops::Open, File_Open(Path, O_WRONLY));
+		Check(fd >= 0, "open");
+		for (int done = 0; fd >= 0 && done < SAVE_SIZE; done += SAVE_CHUNK) {
+			Fill(Buffer, SAVE_CHUNK, Random());
+			Check(TIMED(Ops::Write, File_Write(fd, Buffer, SAVE_CHUNK)) == SAVE_CHUNK, "write");
+			ShadowWrite(Path, done, Buffer, SAVE_CHUNK);
+		}
+		TIMED(Ops::Close, File_Close(fd));
+
+		strcpy(Path, SAVE_DIR "/data.bin");
+		Check(TIMED(Ops::Delete, File_Delete(Path)) >= 0, "delete");
+		ShadowDelete(Path);
+		strcpy(Path, SAVE_TMP);
+		strcpy(Path2, SAVE_DIR "/data.bin");
+		Check(TIMED(Ops::Rename, File_Rename(Path, Path2)) >= 0, "rename");
+		ShadowRename(Path, Path2);
+
+		Ios_Idle(Random(1, 8) * 1000000.0);
+	}
+}
+
+// Rip writing: a disc dump streamed to one file in DVD read sized chunks
+
+#define RIP_PATH		ROOT "/bench_rip/game.iso"
+#define RIP_CHUNK		0x8000
+
+static void RipSetup(int iterations)
+{
+	MakeDirs(ROOT "/bench_rip");
+}
+
+static void RipRun(int iterations)
+{
+	strcpy(Path, RIP_PATH);
+	int fd = TIMED(Ops::Open, File_Open(Path, O_CREAT | O_TRUNC | O_WRONLY));
+	Check(fd >= 0, "open");
+	if (fd < 0)
+		return;
+	ShadowCreate(Path);
+
+	// iterations is in MiB here
+	for (u32 done = 0; done < (u32)iterations << 20; done += RIP_CHUNK) {
+		Fill(Buffer, RIP_CHUNK, Random());
+		if (TIMED(Ops::Write, File_Write(fd, Buffer, RIP_CHUNK)) != RIP_CHUNK) {
+			Check(false, "write");
+			break;
+		}
+		ShadowWrite(Path, done, Buffer, RIP_CHUNK);
+	}
+	TIMED(Ops::Close, File_Close(fd));
+}
+
+// Model test: random calls on a handful of files, checked against the shadow
+// copy as they go. Writes land past the end of files, open files grow in
+// turns so exFAT has to turn NoFatChain runs into FAT chains, renames go
+// across directories and onto names that are taken, and every few hundred
+// calls the volume is remounted and checked.
+
+#define MODEL_DIR		ROOT "/bench_model"
+#define MODEL_FILES		16
+#define MODEL_OPEN		3
+#define MODEL_MAX		0x60000
+#define MODEL_CHECK		250
+
+static int VerifyFiles(const char* when);
+static bool Remount(bool verbose, int* problems);
+
+struct ModelFile
+{
+	int Fd;
+	int File;
+};
+
+static ModelFile ModelOpen[MODEL_OPEN];
+
+// Lookups are case insensitive, so the other spelling has to find the same file
+static void ModelPath(char* path, int file, bool other_case)
+{
+	sprintf(path, other_case ? MODEL_DIR "/%c/MODEL_%02d.BIN" : MODEL_DIR "/%c/Model_%02d.bin", 'a' + (file & 1), file / 2);
+}
+
+static bool ModelExists(int file)
+{
+	char path[MAXPATHLEN];
+	ModelPath(path, file, false);
+	return Shadow.count(path) > 0;
+}
+
+static bool ModelIsOpen(int file)
+{
+	for (int i = 0; i < MODEL_OPEN; i++) {
+		if (ModelOpen[i].Fd >= 0 && ModelOpen[i].File == file)
+			return true;
+	}
+	return false;
+}
+
+static int ModelPick(bool open)
+{
+	for (int tries = 0; tries < MODEL_FILES; tries++) {
+		int file = Random() % MODEL_FILES;
+		if (ModelIsOpen(file) == open)
+			return file;
+	}
+	return -1;
+}
+
+static void ModelOpenFile(ModelFile* slot)
+{
+	int file = ModelPick(false);
+	if (file < 0)
+		return;
+	bool truncate = !(Random() % 4);
+	ModelPath(Path, file, !(Random() % 3));
+	slot->Fd = TIMED(Ops::Open, File_Open(Path, O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0)));
+	slot->File = file;
+	Check(slot->Fd >= 0, "model open");
+
+	ModelPath(Path, file, false);
+	if (slot->Fd >= 0 && (truncate || !ModelExists(file)))
+		ShadowCreate(Path);
+}
+
+static void ModelClose(ModelFile* slot)
+{
+	if (slot->Fd >= 0)
+		Check(TIMED(Ops::Close, File_Close(slot->Fd)) >= 0, "model close");
+	slot->Fd = -1;
+}
+
+static void ModelWrite(ModelFile* slot, u32 position, u32 length)
+{
+	ModelPath(Path, slot->File, false);
+	if (position + length > MODEL_MAX)
+		return;
+	Fill(Buffer, length, Random());
+	Check(TIMED(Ops::Seek, File_Seek(slot->Fd, position, SEEK_SET)) == (int)position, "model seek");
+	Check(TIMED(Ops::Write, File_Write(slot->Fd, Buffer, length)) == (int)length, "model write");
+	ShadowWrite(Path, position, Buffer, length);
+}
+
+static void ModelRead(ModelFile* slot)
+{
+	ModelPath(Path, slot->File, false);
+	const std::vector<u8>& want = Shadow[Path];
+	u32 position = Random() % (want.size() + 0x1000);
+	u32 length = Random(1, 0x8000);
+	int expected = position < want.size() ? MIN(length, want.size() - position) : 0;
+
+	Check(TIMED(Ops::Seek, File_Seek(slot->Fd, position, SEEK_SET)) == (int)position, "model seek");
+	int ret = TIMED(Ops::Read, File_Read(slot->Fd, Buffer, length));
+	Check(ret == expected && (!ret || !memcmp(Buffer, &want[position], ret)), "model read");
+}
+
+// Closes everything, then checks the files both ways round a remount
+static void ModelCheckpoint()
+{
+	for (int i = 0; i < MODEL_OPEN; i++)
+		ModelClose(&ModelOpen[i]);
+
+	int problems;
+	int bad = VerifyFiles("model");
+	if (!Remount(false, &problems)) {
+		fprintf(stderr, "model: remount failed: %d\n", Mounted);
+		exit(1);
+	}
+	bad += VerifyFiles("model remount") + problems;
+	strcpy(Path, MODEL_DIR);
+	Check(!bad, "model checkpoint");
+}
+
+static void ModelSetup(int iterations)
+{
+	MakeDirs(MODEL_DIR "/a");
+	MakeDirs(MODEL_DIR "/b");
+	for (int i = 0; i < MODEL_OPEN; i++)
+		ModelOpen[i].Fd = -1;
+}
+
+static void ModelRun(int iterations)
+{
+	for (int step = 1; step <= iterations * 100; step++) {
+		ModelFile* slot = &ModelOpen[Random() % MODEL_OPEN];
+		u32 op = Random() % 10;
+		if (op < 6 && slot->Fd < 0) {
+			ModelOpenFile(slot);
+			if (slot->Fd < 0)
+				continue;
+		}
+
+		switch (op) {
+			case 0:
+			case 1: { // anywhere up to a few clusters past the end, odd sizes included
+				u32 size = Shadow[(ModelPath(Path, slot->File, false), Path)].size();
+				ModelWrite(slot, Random() % (size + 0x9000), Random(1, 0x6000));
+				break; }
+			case 2: // every open file grows by a bit, in turns
+				for (int round = Random(2, 4); round > 0; round--) {
+					for (int i = 0; i < MODEL_OPEN; i++) {
+						if (ModelOpen[i].Fd < 0)
+							continue;
+						ModelPath(Path, ModelOpen[i].File, false);
+						ModelWrite(&ModelOpen[i], Shadow[Path].size(), Random(0x200, 0x3000));
+					}
+				}
+				break;
+			case 3:
+			case 4:
+				ModelRead(slot);
+				break;
+			case 5:
+				ModelClose(slot);
+				break;
+			case 6: {
+				int file = ModelPick(false);
+				if (file < 0)
+					break;
+				ModelPath(Path, file, false);
+				bool exists = ModelExists(file);
+				// libfat's wrapper fails with a positive errno, so only 0 is success
+				Check(!TIMED(Ops::Delete, File_Delete(Path)) == exists, "model delete");
+				if (exists)
+					ShadowDelete(Path);
+				break; }
+			case 7:
+			case 8: {
+				int file = ModelPick(false);
+				int destination = ModelPick(false);
+				if (file < 0 || destination < 0 || file == destination || !ModelExists(file))
+					break;
+				ModelPath(Path, file, false);
+				ModelPath(Path2, destination, !(Random() % 3));
+				// renaming onto a file that exists has to fail and leave both alone
+				bool taken = ModelExists(destination);
+				Check(!TIMED(Ops::Rename, File_Rename(Path, Path2)) == !taken, "model rename");
+				ModelPath(Path2, destination, false);
+				if (!taken)
+					ShadowRename(Path, Path2);
+				break; }
+			default:
+				Ios_Idle(Random(1, 4) * 1000000.0);
+				break;
+		}
+
+		if (!(step % MODEL_CHECK))
+			ModelCheckpoint();
+	}
+	ModelCheckpoint();
+}
+
+struct Workload
+{
+	const char* Name;
+	void (*Setup)(int iterations);
+	void (*Run)(int iterations);
+	int Iterations;
+};
+
+static const Workload Workloads[] = {
+	{ "launch", LaunchSetup, LaunchRun, 50 },
+	{ "save", SaveSetup, SaveRun, 50 },
+	{ "rip", RipSetup, RipRun, 64 },
+	{ "model", ModelSetup, ModelRun, 20 }
+};
+
+static double Percentile(const std::vector<double>& sorted, double p)
+{
+	return sorted[MIN((size_t)(p * sorted.size()), sorted.size() - 1)];
+}
+
+static void Report(const Workload* workload)
+{
+	double elapsed = Clock - Started;
+	double busy = 0;
+	u64 calls = 0;
+
+	printf("%s on %s (%s), %d iterations\n", workload->Name, Disc_Filesystem(), Model.Name, workload->Iterations);
+	printf("  %-10s %7s %9s %9s %9s %9s %9s\n", "call", "count", "mean us", "p50", "p90", "p99", "max");
+	for (int op = 0; op < Ops::Count; op++) {
+		std::vector<double>& samples = Samples[op];
+		if (samples.empty())
+			continue;
+		std::sort(samples.begin(), samples.end());
+		double total = 0;
+		for (size_t i = 0; i < samples.size(); i++)
+			total += samples[i];
+		printf("  %-10s %7zu %9.0f %9.0f %9.0f %9.0f %9.0f\n", OpNames[op], samples.size(), total / samples.size(),
+			Percentile(samples, 0.5), Percentile(samples, 0.9), Percentile(samples, 0.99), samples.back());
+		calls += samples.size();
+		busy += total;
+	}
+	printf("  %llu calls, %.3f s modelled in calls (%.3f s with idle time), %.0f calls/s\n",
+		(unsigned long long)calls, busy / 1000000, elapsed / 1000000, calls / (busy / 1000000));
+	printf("  disc: %llu reads (%llu sectors), %llu writes (%llu sectors)\n",
+		(unsigned long long)Disc.Reads, (unsigned long long)Disc.ReadSectors,
+		(unsigned long long)Disc.Writes, (unsigned long long)Disc.WriteSectors);
+	printf("  module heap peak %u bytes\n", Ios_HeapPeak());
+	if (Failures)
+		printf("  %d calls FAILED\n", Failures);
+}
+
+// Untimed: reads back every file in the shadow copy and makes sure removed ones are gone
+static int VerifyFiles(const char* when)
+{
+	int bad = 0;
+	Stats st;
+
+	for (std::map<std::string, std::vector<u8> >::iterator it = Shadow.begin(); it != Shadow.end(); it++) {
+		const std::vector<u8>& want = it->second;
+		strcpy(Path, it->first.c_str());
+		if (File_Stat(Path, &st) < 0 || st.Size != want.size()) {
+			if (bad++ < 10)
+				fprintf(stderr, "verify %s: %s is %lld bytes, want %zu\n", when, Path, File_Stat(Path, &st) < 0 ? -1LL : (long long)st.Size, want.size());
+			continue;
+		}
+
+		int fd = File_Open(Path, O_RDONLY);
+		u32 done = 0;
+		while (fd >= 0 && done < want.size()) {
+			int ret = File_Read(fd, Buffer, MIN(want.size() - done, 0x8000));
+			if (ret <= 0 || memcmp(Buffer, &want[done], ret))
+				break;
+			done += ret;
+		}
+		if (fd >= 0)
+			File_Close(fd);
+		if (done != want.size() && bad++ < 10)
+			fprintf(stderr, "verify %s: %s differs from offset %u\n", when, Path, done);
+	}
+
+	for (std::set<std::string>::iterator it = Removed.begin(); it != Removed.end(); it++) {
+		strcpy(Path, it->c_str());
+		if (File_Stat(Path, &st) >= 0 && bad++ < 10)
+			fprintf(stderr, "verify %s: %s is still there\n", when, Path);
+	}
+
+	return bad;
+}
+
+// The image is checked in between, while everything is written out
+static bool Remount(bool verbose, int* problems)
+{
+	File_Unmount(Mounted);
+	*problems = Disc_Check(verbose);
+	Mounted = File_Fat_Mount(Disk, MOUNT_NAME);
+	return Mounted >= 0;
+}
+
+static int Verify()
+{
+	u64 bytes = 0;
+	for (std::map<std::string, std::vector<u8> >::iterator it = Shadow.begin(); it != Shadow.end(); it++)
+		bytes += it->second.size();
+
+	int problems;
+	int bad = VerifyFiles("before remount");
+	if (!Remount(true, &problems)) {
+		fprintf(stderr, "verify: remount failed: %d\n", Mounted);
+		return bad + 1;
+	}
+	bad += VerifyFiles("after remount");
+	if (problems)
+		printf("  fsck: %d problems FOUND\n", problems);
+
+	if (bad)
+		printf("  verify: %d of %zu files FAILED\n", bad, Shadow.size() + Removed.size());
+	else
+		printf("  verify: %zu files, %llu bytes and %zu removals match, also after a remount\n",
+			Shadow.size(), (unsigned long long)bytes, Removed.size());
+	return bad + problems;
+}
+
+static void Usage()
+{
+	fprintf(stderr,
+		"usage: bench [-d sd|usb] [-l command,read,write,ipc] [-n iterations] [-s seed] image workload...\n"
+		"  workloads: launch save rip model\n"
+		"  image: a FAT or exFAT volume, e.g. from fsimage format, with room for the workloads\n");
+	exit(1);
+}
+
+int main(int argc, char** argv)
+{
+	int iterations = 0;
+	u32 seed = 1;
+	int arg;
+
+	for (arg = 1; arg < argc && argv[arg][0] == '-'; arg++) {
+		if (arg + 1 == argc)
+			Usage();
+		const char* value = argv[++arg];
+		switch (argv[arg - 1][1]) {
+			case 'd': {
+				int i;
+				for (i = 0; i < (int)(sizeof(Models) / sizeof(Models[0])) && strcmp(Models[i].Name, value); i++)
+					;
+				if (i == sizeof(Models) / sizeof(Models[0]))
+					Usage();
+				Model = Models[i];
+				Disk = i ? USB_DISK : SD_DISK;
+				break; }
+			case 'l':
+				if (sscanf(value, "%lf,%lf,%lf,%lf", &Model.Command, &Model.ReadSector, &Model.WriteSector, &Model.Ipc) != 4)
+					Usage();
+				Model.Name = "custom";
+				break;
+			case 'n':
+				iterations = atoi(value);
+				break;
+			case 's':
+				seed = strtoul(value, NULL, 0);
+				break;
+			default:
+				Usage();
+		}
+	}
+	if (arg + 2 > argc)
+		Usage();
+
+	if (!Disc_Open(argv[arg])) {
+		fprintf(stderr, "can't open %s\n", argv[arg]);
+		return 1;
+	}
+
+	Ios_Start();
+	File_Init();
+	Mounted = File_Fat_Mount(Disk, MOUNT_NAME);
+	if (Mounted < 0) {
+		fprintf(stderr, "mount failed: %d\n", Mounted);
+		return 1;
+	}
+
+	int ret = 0;
+	for (arg++; arg < argc; arg++) {
+		const Workload* workload = null;
+		for (size_t i = 0; i < sizeof(Workloads) / sizeof(Workloads[0]); i++) {
+			if (!strcmp(Workloads[i].Name, argv[arg]))
+				workload = &Workloads[i];
+		}
+		if (!workload)
+			Usage();
+
+		Workload run = *workload;
+		if (iterations)
+			run.Iterations = iterations;
+
+		RandomState = seed;
+		run.Setup(run.Iterations);
+		// let setup writes drain before measuring
+		Ios_Idle(10000000);
+
+		for (int op = 0; op < Ops::Count; op++)
+			Samples[op].clear();
+		memset(&Disc, 0, sizeof(Disc));
+		Failures = 0;
+		Started = Clock;
+		run.Run(run.Iterations);
+		Report(&run);
+		if (Failures || Verify())
+			ret = 1;
+	}
+
+	File_Unmount(Mounted);
+	return ret;
+}
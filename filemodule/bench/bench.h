@@ -0,0 +1,45 @@
+#pragma once
+
+#include "gctypes.h"
+
+// Cost of each disc request and IPC round trip, in microseconds
+struct DiscModel
+{
+	const char* Name;
+	double Command;		// fixed cost of one read or write request
+	double ReadSector;	// per 512-byte sector read
+	double WriteSector;	// per sector written
+	double Ipc;			// PPC to IOS round trip, charged per file module call
+};
+
+struct DiscCounters
+{
+	u64 Reads;
+	u64 Writes;
+	u64 ReadSectors;
+	u64 WriteSectors;
+};
+
+extern DiscModel Model;
+extern DiscCounters Disc;
+extern double Clock; // modelled time in microseconds
+
+// disc.cpp
+bool Disc_Open(const char* image);
+const char* Disc_Filesystem();
+int Disc_Check(bool verbose);
+
+// fsck.cpp: checks a volume without libfat, returns the number of problems found
+const u8* Fs_Volume(const u8* image, u64* sectors);
+const char* Fs_Type(const u8* volume);
+int Fs_Check(const u8* volume, u64 sectors, bool verbose);
+
+// mkfs.cpp
+u8* Fs_Partition(u8* image, u64* sectors, u8 type);
+bool Fs_FormatFat32(u8* volume, u64 sectors, u32 cluster_sectors);
+bool Fs_FormatExfat(u8* volume, u64 sectors, u32 cluster_sectors, u64 partition_offset);
+
+// ios.cpp
+void Ios_Start();
+void Ios_Idle(double us);
+u32 Ios_HeapPeak();
@@ -0,0 +1,108 @@
+#include "bench.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "wiisd_io.h"
+#include "usbstorage.h"
+
+DiscCounters Disc;
+double Clock;
+
+static u8* Image;
+static u64 ImageSectors;
+
+static bool DiscStartup()
+{
+	return Image != null;
+}
+
+static bool DiscReadSectors(sec_t sector, sec_t count, void* buffer)
+{
+	if ((u64)sector + count > ImageSectors)
+		return false;
+
+	Disc.Reads++;
+	Disc.ReadSectors += count;
+	Clock += Model.Command + count * Model.ReadSector;
+	memcpy(buffer, Image + (u64)sector * 512, (u64)count * 512);
+	return true;
+}
+
+static bool DiscWriteSectors(sec_t sector, sec_t count, const void* buffer)
+{
+	if ((u64)sector + count > ImageSectors)
+		return false;
+
+	Disc.Writes++;
+	Disc.WriteSectors += count;
+	Clock += Model.Command + count * Model.WriteSector;
+	memcpy(Image + (u64)sector * 512, buffer, (u64)count * 512);
+	return true;
+}
+
+static bool DiscNothing()
+{
+	return true;
+}
+
+// Both devices read the same image, only the latency model tells them apart
+const DISC_INTERFACE __io_wiisd = {
+	DEVICE_TYPE_WII_SD,
+	FEATURE_MEDIUM_CANREAD | FEATURE_MEDIUM_CANWRITE | FEATURE_WII_SD,
+	DiscStartup,
+	DiscStartup,
+	DiscReadSectors,
+	DiscWriteSectors,
+	DiscNothing,
+	DiscNothing
+};
+
+DISC_INTERFACE __io_usbstorage = {
+	0,
+	FEATURE_MEDIUM_CANREAD | FEATURE_MEDIUM_CANWRITE | FEATURE_WII_USB,
+	DiscStartup,
+	DiscStartup,
+	DiscReadSectors,
+	DiscWriteSectors,
+	DiscNothing,
+	DiscNothing
+};
+
+bool Disc_Open(const char* image)
+{
+	int fd = open(image, O_RDWR);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) < 0 || st.st_size < 512) {
+		close(fd);
+		return false;
+	}
+
+	void* map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return false;
+
+	Image = (u8*)map;
+	ImageSectors = st.st_size / 512;
+	return true;
+}
+
+const char* Disc_Filesystem()
+{
+	u64 sectors = ImageSectors;
+	return Fs_Type(Fs_Volume(Image, &sectors));
+}
+
+// only meaningful while nothing is mounted
+int Disc_Check(bool verbose)
+{
+	u64 sectors = ImageSectors;
+	return Fs_Check(Fs_Volume(Image, &sectors), sectors, verbose);
+}
@@ -0,0 +1,633 @@
+// An independent consistency checker for the volumes the bench runs on. It
+// shares no code with libfat or the exFAT handler, so it can be trusted to
+// find what their allocators get wrong: cross-linked, lost or short chains,
+// directory entries that don't add up, a stale FSInfo, and on exFAT entry
+// sets with a bad checksum or name hash and an allocation bitmap that
+// disagrees with the chains.
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+static int Problems;
+
+static void Problem(const char* format, ...)
+{
+	if (Problems++ >= 10)
+		return;
+	va_list args;
+	va_start(args, format);
+	fprintf(stderr, "  fsck: ");
+	vfprintf(stderr, format, args);
+	fprintf(stderr, "\n");
+	va_end(args);
+}
+
+static u16 Get16(const u8* data)
+{
+	return data[0] | data[1] << 8;
+}
+
+static u32 Get32(const u8* data)
+{
+	return data[0] | data[1] << 8 | data[2] << 16 | (u32)data[3] << 24;
+}
+
+static u64 Get64(const u8* data)
+{
+	return Get32(data) | (u64)Get32(data + 4) << 32;
+}
+
+const u8* Fs_Volume(const u8* image, u64* sectors)
+{
+	// a partition table rather than a boot sector: use the first partition
+	if (memcmp(image + 3, "EXFAT   ", 8) && memcmp(image + 0x36, "FAT", 3) && memcmp(image + 0x52, "FAT", 3)) {
+		u32 start = Get32(image + 0x1C6);
+		if (start && start < *sectors) {
+			*sectors -= start;
+			return image + (u64)start * 512;
+		}
+	}
+	return image;
+}
+
+const char* Fs_Type(const u8* volume)
+{
+	return memcmp(volume + 3, "EXFAT   ", 8) ? "FAT" : "exFAT";
+}
+
+// FAT12, FAT16 and FAT32
+
+namespace {
+	struct FatVolume
+	{
+		const u8* Base;
+		u32 SectorSize;
+		u32 ClusterSectors;
+		u32 FatStart;
+		u32 RootStart;		// FAT12/16 fixed root directory, in sectors
+		u32 RootEntries;
+		u32 DataStart;
+		u32 Clusters;
+		u32 Bits;
+		u32 RootCluster;	// FAT32
+		std::vector<bool> Owned;
+		u32 Files;
+		u32 Directories;
+		u32 Fragmented;
+	};
+}
+
+static u32 FatEntry(const FatVolume* fat, u32 cluster)
+{
+	const u8* table = fat->Base + (u64)fat->FatStart * fat->SectorSize;
+	switch (fat->Bits) {
+		case 12: {
+			u16 pair = Get16(table + cluster + cluster / 2);
+			return (cluster & 1) ? pair >> 4 : pair & 0xFFF; }
+		case 16:
+			return Get16(table + cluster * 2);
+		default:
+			return Get32(table + cluster * 4) & 0x0FFFFFFF;
+	}
+}
+
+static u32 FatEndOfChain(const FatVolume* fat)
+{
+	return fat->Bits == 12 ? 0xFF8 : fat->Bits == 16 ? 0xFFF8 : 0x0FFFFFF8;
+}
+
+static u32 FatBad(const FatVolume* fat)
+{
+	return FatEndOfChain(fat) - 1;
+}
+
+// Claims every cluster of a chain, stopping at the first broken link
+static void FatChain(FatVolume* fat, u32 start, const std::string& path, std::vector<u32>* chain)
+{
+	for (u32 cluster = start; ; ) {
+		if (cluster < 2 || cluster >= fat->Clusters + 2) {
+			Problem("%s: chain links to cluster %u, out of range", path.c_str(), cluster);
+			return;
+		}
+		if (fat->Owned[cluster]) {
+			Problem("%s: cluster %u is cross-linked", path.c_str(), cluster);
+			return;
+		}
+		fat->Owned[cluster] = true;
+		chain->push_back(cluster);
+
+		u32 next = FatEntry(fat, cluster);
+		if (next >= FatEndOfChain(fat))
+			return;
+		if (next == 0 || next == FatBad(fat)) {
+			Problem("%s: chain runs into a %s cluster after %u", path.c_str(), next ? "bad" : "free", cluster);
+			return;
+		}
+		cluster = next;
+	}
+}
+
+static u8 ShortNameChecksum(const u8* entry)
+{
+	u8 sum = 0;
+	for (int i = 0; i < 11; i++)
+		sum = ((sum & 1) << 7) + (sum >> 1) + entry[i];
+	return sum;
+}
+
+static void FatDirectory(FatVolume* fat, const std::vector<u32>& chain, u32 cluster, u32 parent, const std::string& path)
+{
+	std::vector<u8> data;
+	if (chain.empty()) {
+		const u8* root = fat->Base + (u64)fat->RootStart * fat->SectorSize;
+		data.assign(root, root + fat->RootEntries * 32);
+	} else {
+		u32 bytes = fat->ClusterSectors * fat->SectorSize;
+		for (size_t i = 0; i < chain.size(); i++) {
+			const u8* start = fat->Base + ((u64)fat->DataStart + (u64)(chain[i] - 2) * fat->ClusterSectors) * fat->SectorSize;
+			data.insert(data.end(), start, start + bytes);
+		}
+	}
+
+	int long_entries = 0;
+	u8 long_checksum = 0;
+	for (size_t offset = 0; offset < data.size(); offset += 32) {
+		const u8* entry = &data[offset];
+		if (entry[0] == 0)
+			break;
+		if (entry[0] == 0xE5) {
+			if (long_entries)
+				Problem("%s: long name entries before a deleted entry", path.c_str());
+			long_entries = 0;
+			continue;
+		}
+		if (entry[11] == 0x0F) {
+			if (entry[0] & 0x40) {
+				long_entries = entry[0] & 0x3F;
+				long_checksum = entry[13];
+			} else if (!long_entries || (entry[0] & 0x3F) != long_entries - 1 || entry[13] != long_checksum) {
+				Problem("%s: long name entries out of sequence", path.c_str());
+				long_entries = 0;
+				continue;
+			} else
+				long_entries--;
+			continue;
+		}
+		if (long_entries > 1 || (long_entries == 1 && ShortNameChecksum(entry) != long_checksum))
+			Problem("%s: long name doesn't belong to %.11s", path.c_str(), entry);
+		long_entries = 0;
+		if (entry[11] & 0x08)
+			continue; // volume label
+
+		u32 start = Get16(entry + 26) | (fat->Bits == 32 ? Get16(entry + 20) << 16 : 0);
+		u32 size = Get32(entry + 28);
+		std::string name = path + "/" + std::string((const char*)entry, 11);
+
+		if (!memcmp(entry, ".          ", 11)) {
+			if (start != cluster)
+				Problem("%s: '.' points at %u, not %u", path.c_str(), start, cluster);
+			continue;
+		}
+		if (!memcmp(entry, "..         ", 11)) {
+			// the root's own cluster is written as 0
+			if (parent == fat->RootCluster ? start != 0 && start != fat->RootCluster : start != parent)
+				Problem("%s: '..' points at %u, not %u", path.c_str(), start, parent);
+			continue;
+		}
+
+		std::vector<u32> clusters;
+		if (start)
+			FatChain(fat, start, name, &clusters);
+		for (size_t i = 1; i < clusters.size(); i++) {
+			if (clusters[i] != clusters[i - 1] + 1) {
+				fat->Fragmented++;
+				break;
+			}
+		}
+
+		if (entry[11] & 0x10) {
+			fat->Directories++;
+			if (!start)
+				Problem("%s: directory without clusters", name.c_str());
+			else
+				FatDirectory(fat, clusters, start, cluster, name);
+		} else {
+			fat->Files++;
+			u32 cluster_bytes = fat->ClusterSectors * fat->SectorSize;
+			u32 need = (u32)(((u64)size + cluster_bytes - 1) / cluster_bytes);
+			if (clusters.size() != need)
+				Problem("%s: %u bytes need %u clusters, the chain has %zu", name.c_str(), size, need, clusters.size());
+		}
+	}
+}
+
+static int CheckFat(const u8* volume, u64 sectors, bool verbose)
+{
+	FatVolume fat;
+	fat.Base = volume;
+	fat.SectorSize = Get16(volume + 11);
+	fat.ClusterSectors = volume[13];
+	if (fat.SectorSize < 512 || (fat.SectorSize & (fat.SectorSize - 1)) || !fat.ClusterSectors) {
+		Problem("no FAT boot sector");
+		return Problems;
+	}
+
+	u32 reserved = Get16(volume + 14);
+	u32 fats = volume[16];
+	fat.RootEntries = Get16(volume + 17);
+	u32 total = Get16(volume + 19) ? Get16(volume + 19) : Get32(volume + 32);
+	u32 fat_sectors = Get16(volume + 22) ? Get16(volume + 22) : Get32(volume + 36);
+	u32 root_sectors = (fat.RootEntries * 32 + fat.SectorSize - 1) / fat.SectorSize;
+
+	fat.FatStart = reserved;
+	fat.RootStart = reserved + fats * fat_sectors;
+	fat.DataStart = fat.RootStart + root_sectors;
+	fat.Clusters = (total - fat.DataStart) / fat.ClusterSectors;
+	fat.Bits = fat.Clusters < 4085 ? 12 : fat.Clusters < 65525 ? 16 : 32;
+	fat.RootCluster = fat.Bits == 32 ? Get32(volume + 44) : 0;
+	fat.Owned.assign(fat.Clusters + 2, false);
+	fat.Files = fat.Directories = fat.Fragmented = 0;
+
+	if ((u64)total * fat.SectorSize > sectors * 512)
+		Problem("volume is %u sectors, the image only has room for %llu", total, (unsigned long long)(sectors * 512 / fat.SectorSize));
+	if ((u64)(fat.Clusters + 2) * fat.Bits > (u64)fat_sectors * fat.SectorSize * 8)
+		Problem("FAT is too small for %u clusters", fat.Clusters);
+
+	std::vector<u32> root;
+	if (fat.Bits == 32)
+		FatChain(&fat, fat.RootCluster, "root", &root);
+	FatDirectory(&fat, root, fat.RootCluster, fat.RootCluster, "");
+
+	u32 free = 0, lost = 0;
+	for (u32 cluster = 2; cluster < fat.Clusters + 2; cluster++) {
+		u32 entry = FatEntry(&fat, cluster);
+		if (entry == 0)
+			free++;
+		else if (!fat.Owned[cluster] && entry != FatBad(&fat)) {
+			if (!lost++)
+				Problem("cluster %u is allocated but not in any chain", cluster);
+		}
+	}
+	if (lost > 1)
+		Problem("%u lost clusters in all", lost);
+
+	if (fat.Bits == 32) {
+		const u8* info = volume + (u64)Get16(volume + 48) * fat.SectorSize;
+		u32 info_free = Get32(info + 488);
+		u32 next_free = Get32(info + 492);
+		if (Get32(info) != 0x41615252 || Get32(info + 484) != 0x61417272)
+			Problem("FSInfo signature is missing");
+		else if (info_free != free)
+			Problem("FSInfo says %u clusters are free, the FAT has %u", info_free, free);
+		if (next_free != 0xFFFFFFFF && (next_free < 2 || next_free >= fat.Clusters + 2))
+			Problem("FSInfo next free cluster %u is out of range", next_free);
+	}
+
+	if (verbose)
+		printf("  fsck: FAT%u, %u clusters, %u free, %u files, %u directories, %u fragmented\n",
+			fat.Bits, fat.Clusters, free, fat.Files, fat.Directories, fat.Fragmented);
+	return Problems;
+}
+
+// exFAT
+
+namespace {
+	struct ExfatVolume
+	{
+		const u8* Base;
+		u32 SectorShift;
+		u32 ClusterShift;
+		u32 FatStart;
+		u32 HeapStart;
+		u32 Clusters;
+		std::vector<u16> Upcase;	// flat, one entry per UTF-16 unit
+		std::vector<bool> Owned;
+		u32 Files;
+		u32 Directories;
+		u32 Fragmented;
+	};
+}
+
+static u32 ExfatClusterBytes(const ExfatVolume* exfat)
+{
+	return 1U << (exfat->SectorShift + exfat->ClusterShift);
+}
+
+static const u8* ExfatCluster(const ExfatVolume* exfat, u32 cluster)
+{
+	return exfat->Base + (((u64)exfat->HeapStart + ((u64)(cluster - 2) << exfat->ClusterShift)) << exfat->SectorShift);
+}
+
+static u32 ExfatEntry(const ExfatVolume* exfat, u32 cluster)
+{
+	return Get32(exfat->Base + ((u64)exfat->FatStart << exfat->SectorShift) + (u64)cluster * 4);
+}
+
+/*
+Claims the clusters holding length bytes. NoFatChain chains are a plain run;
+the FAT is only followed for the others, and has to end where the length
+does. With length 0 the FAT decides, as for the root directory.
+*/
+static bool ExfatChain(ExfatVolume* exfat, u32 first, u64 length, bool contiguous, const std::string& path, std::vector<u32>* chain)
+{
+	u64 clusters = (length + ExfatClusterBytes(exfat) - 1) / ExfatClusterBytes(exfat);
+	for (u32 cluster = first; length ? chain->size() < clusters : true; ) {
+		if (cluster < 2 || cluster >= exfat->Clusters + 2) {
+			Problem("%s: chain links to cluster %u, out of range", path.c_str(), cluster);
+			return false;
+		}
+		if (exfat->Owned[cluster]) {
+			Problem("%s: cluster %u is cross-linked", path.c_str(), cluster);
+			return false;
+		}
+		exfat->Owned[cluster] = true;
+		chain->push_back(cluster);
+
+		if (contiguous) {
+			cluster++;
+			continue;
+		}
+		u32 next = ExfatEntry(exfat, cluster);
+		if (next == 0xFFFFFFFF) {
+			if (length && chain->size() < clusters) {
+				Problem("%s: %llu bytes need %llu clusters, the chain has %zu", path.c_str(), (unsigned long long)length,
+					(unsigned long long)clusters, chain->size());
+				return false;
+			}
+			return true;
+		}
+		if (length && chain->size() == clusters) {
+			Problem("%s: chain goes on past its %llu clusters", path.c_str(), (unsigned long long)clusters);
+			return false;
+		}
+		if (next == 0xFFFFFFF7 || next < 2) {
+			Problem("%s: chain runs into a %s cluster after %u", path.c_str(), next < 2 ? "free" : "bad", cluster);
+			return false;
+		}
+		cluster = next;
+	}
+	return true;
+}
+
+static u16 ExfatSetChecksum(const u8* set, u32 count)
+{
+	u16 sum = 0;
+	for (u32 i = 0; i < count * 32; i++) {
+		if (i == 2 || i == 3)
+			continue;
+		sum = ((sum & 1) ? 0x8000 : 0) + (sum >> 1) + set[i];
+	}
+	return sum;
+}
+
+static u32 ExfatTableChecksum(const u8* data, u64 length)
+{
+	u32 sum = 0;
+	for (u64 i = 0; i < length; i++)
+		sum = ((sum & 1) ? 0x80000000 : 0) + (sum >> 1) + data[i];
+	return sum;
+}
+
+static std::vector<u8> ExfatRead(const ExfatVolume* exfat, const std::vector<u32>& chain, u64 length)
+{
+	std::vector<u8> data;
+	for (size_t i = 0; i < chain.size(); i++) {
+		const u8* start = ExfatCluster(exfat, chain[i]);
+		data.insert(data.end(), start, start + ExfatClusterBytes(exfat));
+	}
+	if (length && length < data.size())
+		data.resize(length);
+	return data;
+}
+
+static void ExfatUpcase(ExfatVolume* exfat, const u8* entry)
+{
+	std::vector<u32> chain;
+	u64 length = Get64(entry + 24);
+	if (!ExfatChain(exfat, Get32(entry + 20), length, false, "up-case table", &chain))
+		return;
+	std::vector<u8> table = ExfatRead(exfat, chain, length);
+	if (ExfatTableChecksum(&table[0], table.size()) != Get32(entry + 4))
+		Problem("up-case table checksum is %08x, its entry says %08x", ExfatTableChecksum(&table[0], table.size()), Get32(entry + 4));
+
+	u32 c = 0;
+	for (size_t offset = 0; offset + 1 < table.size() && c < 0x10000; offset += 2) {
+		u16 mapped = Get16(&table[offset]);
+		if (mapped == 0xFFFF && offset + 3 < table.size()) {
+			offset += 2;
+			c += Get16(&table[offset]);
+		} else
+			exfat->Upcase[c++] = mapped;
+	}
+}
+
+static void ExfatDirectory(ExfatVolume* exfat, const std::vector<u8>& data, bool root, const std::string& path, const u8** bitmap_entry)
+{
+	std::vector<std::vector<u16> > names;
+
+	for (size_t offset = 0; offset < data.size(); offset += 32) {
+		const u8* entry = &data[offset];
+		if (entry[0] == 0)
+			break;
+		if (!(entry[0] & 0x80))
+			continue;
+
+		if (entry[0] == 0x81 || entry[0] == 0x82 || entry[0] == 0x83) {
+			if (!root)
+				Problem("%s: volume entry %02x outside the root directory", path.c_str(), entry[0]);
+			else if (entry[0] == 0x81 && !*bitmap_entry)
+				*bitmap_entry = entry;
+			else if (entry[0] == 0x82)
+				ExfatUpcase(exfat, entry);
+			continue;
+		}
+		if (entry[0] != 0x85) {
+			if (entry[0] == 0xC0 || entry[0] == 0xC1)
+				Problem("%s: secondary entry %02x without a file entry", path.c_str(), entry[0]);
+			continue;
+		}
+
+		u32 secondary = entry[1];
+		const u8* stream = entry + 32;
+		if (secondary < 2 || secondary > 18 || offset + (secondary + 1) * 32 > data.size()) {
+			Problem("%s: file entry with %u secondary entries", path.c_str(), secondary);
+			continue;
+		}
+		u32 length = stream[3];
+		if (stream[0] != 0xC0 || secondary < 1 + (length + 14) / 15) {
+			Problem("%s: entry set has no stream entry or too few name entries", path.c_str());
+			continue;
+		}
+
+		// the name and its hash, folded with the volume's own table
+		std::vector<u16> name, folded;
+		bool sequence = true;
+		for (u32 i = 0; i < secondary; i++)
+			sequence &= (entry[32 + i * 32] & 0x80) != 0;
+		for (u32 c = 0; c < length; c++) {
+			const u8* part = entry + (2 + c / 15) * 32;
+			sequence &= part[0] == 0xC1;
+			name.push_back(Get16(part + 2 + (c % 15) * 2));
+			folded.push_back(exfat->Upcase[name.back()]);
+		}
+		std::string file = path + "/" + std::string(name.begin(), name.end());
+		if (!sequence)
+			Problem("%s: entry set is broken up", file.c_str());
+		if (Get16(entry + 2) != ExfatSetChecksum(entry, secondary + 1))
+			Problem("%s: entry set checksum is %04x, want %04x", file.c_str(), Get16(entry + 2), ExfatSetChecksum(entry, secondary + 1));
+		u16 hash = 0;
+		for (u32 c = 0; c < length; c++) {
+			hash = ((hash & 1) ? 0x8000 : 0) + (hash >> 1) + (folded[c] & 0xFF);
+			hash = ((hash & 1) ? 0x8000 : 0) + (hash >> 1) + (folded[c] >> 8);
+		}
+		if (Get16(stream + 4) != hash)
+			Problem("%s: name hash is %04x, want %04x", file.c_str(), Get16(stream + 4), hash);
+		for (size_t i = 0; i < names.size(); i++) {
+			if (names[i] == folded)
+				Problem("%s: name is already used in the directory", file.c_str());
+		}
+		names.push_back(folded);
+		offset += secondary * 32;
+
+		u64 valid = Get64(stream + 8);
+		u64 size = Get64(stream + 24);
+		u32 first = Get32(stream + 20);
+		bool directory = Get16(entry + 4) & 0x10;
+		if (valid > size)
+			Problem("%s: valid length %llu is past the length %llu", file.c_str(), (unsigned long long)valid, (unsigned long long)size);
+		if (!(stream[1] & 1) || !size != !first) {
+			Problem("%s: %llu bytes with first cluster %u and flags %02x", file.c_str(), (unsigned long long)size, first, stream[1]);
+			continue;
+		}
+
+		std::vector<u32> clusters;
+		if (size && !ExfatChain(exfat, first, size, stream[1] & 2, file, &clusters))
+			continue;
+		for (size_t i = 1; i < clusters.size(); i++) {
+			if (clusters[i] != clusters[i - 1] + 1) {
+				exfat->Fragmented++;
+				break;
+			}
+		}
+
+		if (directory) {
+			exfat->Directories++;
+			if (!size || size % ExfatClusterBytes(exfat) || valid != size)
+				Problem("%s: directory is %llu bytes, %llu of them valid", file.c_str(), (unsigned long long)size, (unsigned long long)valid);
+			else
+				ExfatDirectory(exfat, ExfatRead(exfat, clusters, size), false, file, bitmap_entry);
+		} else
+			exfat->Files++;
+	}
+}
+
+static int CheckExfat(const u8* volume, u64 sectors, bool verbose)
+{
+	ExfatVolume exfat;
+	exfat.Base = volume;
+	exfat.SectorShift = volume[108];
+	exfat.ClusterShift = volume[109];
+	if (exfat.SectorShift < 9 || exfat.SectorShift > 12 || exfat.SectorShift + exfat.ClusterShift > 25 || volume[105] != 1) {
+		Problem("no exFAT boot sector");
+		return Problems;
+	}
+
+	u32 sector = 1 << exfat.SectorShift;
+	u32 sum = 0;
+	for (u32 i = 0; i < 11 * sector; i++) {
+		if (i == 106 || i == 107 || i == 112)
+			continue;
+		sum = ((sum & 1) ? 0x80000000 : 0) + (sum >> 1) + volume[i];
+	}
+	for (u32 i = 0; i < sector; i += 4) {
+		if (Get32(volume + 11 * sector + i) != sum) {
+			Problem("boot region checksum is %08x, want %08x", Get32(volume + 11 * sector + i), sum);
+			break;
+		}
+	}
+
+	u64 total = Get64(volume + 72);
+	exfat.FatStart = Get32(volume + 80);
+	u32 fat_sectors = Get32(volume + 84);
+	exfat.HeapStart = Get32(volume + 88);
+	exfat.Clusters = Get32(volume + 92);
+	exfat.Owned.assign(exfat.Clusters + 2, false);
+	exfat.Files = exfat.Directories = exfat.Fragmented = 0;
+	for (u32 c = 0; c < 0x10000; c++)
+		exfat.Upcase.push_back(c);
+
+	if ((total << exfat.SectorShift) > sectors * 512)
+		Problem("volume is %llu sectors, the image only has room for %llu", (unsigned long long)total, (unsigned long long)(sectors * 512 >> exfat.SectorShift));
+	if (exfat.HeapStart + ((u64)exfat.Clusters << exfat.ClusterShift) > total)
+		Problem("%u clusters don't fit in the volume", exfat.Clusters);
+	if ((u64)(exfat.Clusters + 2) * 4 > (u64)fat_sectors << exfat.SectorShift)
+		Problem("FAT is too small for %u clusters", exfat.Clusters);
+	if (Problems)
+		return Problems;
+
+	std::vector<u32> root;
+	if (!ExfatChain(&exfat, Get32(volume + 96), 0, false, "root", &root))
+		return Problems;
+	const u8* bitmap_entry = NULL;
+	std::vector<u8> data = ExfatRead(&exfat, root, 0);
+	// the up-case table has to be loaded before any name is hashed
+	for (size_t offset = 0; offset < data.size() && data[offset]; offset += 32) {
+		if (data[offset] == 0x82) {
+			ExfatUpcase(&exfat, &data[offset]);
+			data[offset] &= ~0x80;
+			break;
+		}
+	}
+	ExfatDirectory(&exfat, data, true, "", &bitmap_entry);
+
+	if (!bitmap_entry) {
+		Problem("no allocation bitmap");
+		return Problems;
+	}
+	std::vector<u32> chain;
+	std::vector<u8> bitmap;
+	u64 length = Get64(bitmap_entry + 24);
+	if (length < (exfat.Clusters + 7) / 8)
+		Problem("allocation bitmap is %llu bytes for %u clusters", (unsigned long long)length, exfat.Clusters);
+	else if (ExfatChain(&exfat, Get32(bitmap_entry + 20), length, false, "allocation bitmap", &chain))
+		bitmap = ExfatRead(&exfat, chain, length);
+	if (bitmap.empty())
+		return Problems;
+
+	u32 free = 0, lost = 0, unmarked = 0;
+	for (u32 cluster = 2; cluster < exfat.Clusters + 2; cluster++) {
+		bool used = bitmap[(cluster - 2) >> 3] & (1 << ((cluster - 2) & 7));
+		if (!used)
+			free++;
+		if (used && !exfat.Owned[cluster]) {
+			if (!lost++)
+				Problem("cluster %u is allocated but not in any chain", cluster);
+		} else if (!used && exfat.Owned[cluster]) {
+			if (!unmarked++)
+				Problem("cluster %u is in a chain but free in the bitmap", cluster);
+		}
+	}
+	if (lost > 1)
+		Problem("%u lost clusters in all", lost);
+	if (unmarked > 1)
+		Problem("%u clusters in chains are free in the bitmap", unmarked);
+
+	if (verbose)
+		printf("  fsck: exFAT, %u clusters, %u free, %u files, %u directories, %u fragmented\n",
+			exfat.Clusters, free, exfat.Files, exfat.Directories, exfat.Fragmented);
+	return Problems;
+}
+
+int Fs_Check(const u8* volume, u64 sectors, bool verbose)
+{
+	Problems = 0;
+	if (!memcmp(volume + 3, "EXFAT   ", 8))
+		return CheckExfat(volume, sectors, verbose);
+	return CheckFat(volume, sectors, verbose);
+}
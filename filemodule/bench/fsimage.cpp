@@ -0,0 +1,91 @@
+// Makes and checks bench images without the host's mkfs and fsck tools.
+//
+//   fsimage format fat32|exfat image MiB [cluster KiB] [mbr]
+//   fsimage check image
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static u8* Map(const char* path, u64* size, bool create)
+{
+	int fd = open(path, create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+	if (fd < 0)
+		return NULL;
+
+	struct stat st;
+	if (create ? ftruncate(fd, *size) < 0 : fstat(fd, &st) < 0) {
+		close(fd);
+		return NULL;
+	}
+	if (!create)
+		*size = st.st_size;
+
+	void* map = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	return map == MAP_FAILED ? NULL : (u8*)map;
+}
+
+static void Usage()
+{
+	fprintf(stderr,
+		"usage: fsimage format fat32|exfat image MiB [cluster KiB] [mbr]\n"
+		"       fsimage check image\n");
+	exit(1);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc == 3 && !strcmp(argv[1], "check")) {
+		u64 size;
+		u8* image = Map(argv[2], &size, false);
+		if (!image) {
+			fprintf(stderr, "can't open %s\n", argv[2]);
+			return 1;
+		}
+		u64 sectors = size / 512;
+		const u8* volume = Fs_Volume(image, &sectors);
+		int problems = Fs_Check(volume, sectors, true);
+		printf("%s: %s, %d problems\n", argv[2], Fs_Type(volume), problems);
+		return problems ? 1 : 0;
+	}
+
+	if (argc < 5 || argc > 7 || strcmp(argv[1], "format"))
+		Usage();
+
+	u64 size = strtoull(argv[4], NULL, 0) << 20;
+	u32 cluster = argc > 5 ? atoi(argv[5]) : 4;
+	bool mbr = argc > 6 && !strcmp(argv[6], "mbr");
+	if (!size || !cluster)
+		Usage();
+
+	u8* image = Map(argv[3], &size, true);
+	if (!image) {
+		fprintf(stderr, "can't create %s\n", argv[3]);
+		return 1;
+	}
+
+	u64 sectors = size / 512;
+	bool ok = false;
+	if (!strcmp(argv[2], "fat32")) {
+		u8* volume = mbr ? Fs_Partition(image, &sectors, 0x0C) : image;
+		ok = Fs_FormatFat32(volume, sectors, cluster * 2);
+	} else if (!strcmp(argv[2], "exfat")) {
+		u8* volume = mbr ? Fs_Partition(image, &sectors, 0x07) : image;
+		ok = Fs_FormatExfat(volume, sectors, cluster * 2, (volume - image) / 512);
+	} else
+		Usage();
+
+	if (!ok) {
+		fprintf(stderr, "can't format a %s volume of %llu sectors with %u KiB clusters\n", argv[2], (unsigned long long)sectors, cluster);
+		unlink(argv[3]);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,460 @@
+// Stand-ins for the IOS kernel and libios, just enough to run the file module
+// in a single host process. IPC calls from libfile go straight to the
+// module's handlers and timers fire off the modelled clock.
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+#include "filemodule.h"
+#include "network.h"
+#include "gpio.h"
+#include "rtc.h"
+#include "print.h"
+
+#define MAX_TIMERS 8
+#define MAX_DEVICES 8
+
+using namespace ProxiIOS::Filesystem;
+
+static ProxiIOS::Module* Registered;
+
+// heap
+
+// libios' lwp heap assumes 32-bit pointers, so allocations come from the host
+// heap instead, held to the size the module gets on the Starlet. With
+// M_MMAP_MAX at 0 they all come from brk, just above the non-PIE image.
+#define HEAP_SIZE 0x28000 // as filemodule main.cpp
+
+static u32 HeapInUse;
+static u32 HeapHighest;
+
+static void* HeapTake(void* data)
+{
+	if (!data)
+		return null;
+	HeapInUse += malloc_usable_size(data);
+	if (HeapInUse > HEAP_SIZE) {
+		HeapInUse -= malloc_usable_size(data);
+		free(data);
+		return null;
+	}
+	HeapHighest = MAX(HeapHighest, HeapInUse);
+	return data;
+}
+
+bool InitializeHeap(void* heapspace, u32 size, u32 pagesize)
+{
+	return mallopt(M_MMAP_MAX, 0) == 1;
+}
+
+void* Alloc(u32 size)
+{
+	return HeapTake(malloc(size));
+}
+
+void* Memalign(u32 align, u32 size)
+{
+	return HeapTake(memalign(align, size));
+}
+
+bool Dealloc(void* data)
+{
+	if (data) {
+		HeapInUse -= malloc_usable_size(data);
+		free(data);
+	}
+	return true;
+}
+
+void* Realloc(void* data, u32 size, u32 oldsize)
+{
+	void* ret = Alloc(size);
+	if (ret && data) {
+		memcpy(ret, data, MIN(size, oldsize));
+		Dealloc(data);
+	}
+	return ret;
+}
+
+u32 HeapInfo()
+{
+	return HEAP_SIZE - HeapInUse;
+}
+
+u32 Ios_HeapPeak()
+{
+	return HeapHighest;
+}
+
+// timers, fired from the modelled clock
+
+struct Timer
+{
+	bool Active;
+	double Due;
+	double Repeat;
+	u32 Message;
+};
+
+static Timer Timers[MAX_TIMERS];
+
+ostimer_t os_create_timer(s32 time_us, s32 repeat_time_us, osqueue_t message_queue, u32 message)
+{
+	for (int i = 0; i < MAX_TIMERS; i++) {
+		if (Timers[i].Message)
+			continue;
+		Timers[i].Message = message;
+		os_restart_timer(i, time_us, repeat_time_us);
+		return i;
+	}
+	return IPC_EQUEUEFULL;
+}
+
+s32 os_restart_timer(ostimer_t timer_id, s32 time_us, s32 repeat_time_us)
+{
+	Timers[timer_id].Active = true;
+	Timers[timer_id].Due = Clock + time_us;
+	Timers[timer_id].Repeat = repeat_time_us;
+	return 0;
+}
+
+s32 os_stop_timer(ostimer_t timer_id)
+{
+	Timers[timer_id].Active = false;
+	return 0;
+}
+
+s32 os_destroy_timer(ostimer_t timer_id)
+{
+	memset(&Timers[timer_id], 0, sizeof(Timer));
+	return 0;
+}
+
+// Deliver every timer message that came due, like the module's queue would
+// between two requests
+static void RunTimers()
+{
+	while (true) {
+		Timer* next = null;
+		for (int i = 0; i < MAX_TIMERS; i++) {
+			if (Timers[i].Active && Timers[i].Due <= Clock && (!next || Timers[i].Due < next->Due))
+				next = &Timers[i];
+		}
+		if (!next)
+			return;
+
+		if (next->Repeat)
+			next->Due += next->Repeat;
+		else
+			next->Active = false;
+
+		int result = 0;
+		bool ack = true;
+		Registered->HandleOther(next->Message, result, ack);
+	}
+}
+
+void Ios_Idle(double us)
+{
+	double until = Clock + us;
+	while (true) {
+		double due = until;
+		for (int i = 0; i < MAX_TIMERS; i++) {
+			if (Timers[i].Active && Timers[i].Due < due)
+				due = Timers[i].Due;
+		}
+		if (Clock < due)
+			Clock = due;
+		RunTimers();
+		if (Clock >= until)
+			return;
+	}
+}
+
+void Timer_Init()
+{
+}
+
+void Timer_Sleep(u32 time)
+{
+	Ios_Idle(time);
+}
+
+// IPC, routed straight into the registered module
+
+ProxiIOS::Module::Module(const char* device)
+{
+	strncpy(Device, device, 0x20);
+	Device[0x20 - 1] = '\0';
+	Fd = -1;
+	queuehandle = 0;
+	Registered = this;
+}
+
+int ProxiIOS::Module::HandleOpen(ipcmessage* message)
+{
+	return -1;
+}
+
+static s32 Dispatch(ipcmessage* message)
+{
+	Clock += Model.Ipc;
+	RunTimers();
+
+	switch (message->command) {
+		case IOS_OPEN:
+			return Registered->HandleOpen(message);
+		case IOS_CLOSE:
+			return Registered->HandleClose(message);
+		case IOS_READ:
+			return Registered->HandleRead(message);
+		case IOS_WRITE:
+			return Registered->HandleWrite(message);
+		case IOS_SEEK:
+			return Registered->HandleSeek(message);
+		case IOS_IOCTL:
+			return Registered->HandleIoctl(message);
+		case IOS_IOCTLV:
+			return Registered->HandleIoctlv(message);
+	}
+	return IPC_EINVAL;
+}
+
+s32 os_open(const char* device, s32 mode)
+{
+	// only the file module is registered, ISFS and the rest don't exist here
+	if (strncmp(device, FILE_MODULE_NAME, FILE_MODULE_NAME_LENGTH))
+		return IPC_ENOENT;
+
+	ipcmessage message = { IOS_OPEN };
+	message.open.device = device;
+	message.open.mode = mode;
+	return Dispatch(&message);
+}
+
+s32 os_close(s32 fd)
+{
+	ipcmessage message = { IOS_CLOSE, 0, (u32)fd };
+	return Dispatch(&message);
+}
+
+s32 os_read(s32 fd, void* buffer, s32 length)
+{
+	ipcmessage message = { IOS_READ, 0, (u32)fd };
+	message.read.data = buffer;
+	message.read.length = length;
+	return Dispatch(&message);
+}
+
+s32 os_write(s32 fd, const void* buffer, s32 length)
+{
+	ipcmessage message = { IOS_WRITE, 0, (u32)fd };
+	message.write.data = buffer;
+	message.write.length = length;
+	return Dispatch(&message);
+}
+
+s32 os_seek(s32 fd, s32 where, s32 whence)
+{
+	ipcmessage message = { IOS_SEEK, 0, (u32)fd };
+	message.seek.offset = where;
+	message.seek.origin = whence;
+	return Dispatch(&message);
+}
+
+s32 os_ioctl(s32 fd, s32 request, const void* buffer_in, s32 bytes_in, void* buffer_io, s32 bytes_io)
+{
+	ipcmessage message = { IOS_IOCTL, 0, (u32)fd };
+	message.ioctl.command = request;
+	message.ioctl.buffer_in = buffer_in;
+	message.ioctl.length_in = bytes_in;
+	message.ioctl.buffer_io = buffer_io;
+	message.ioctl.length_io = bytes_io;
+	return Dispatch(&message);
+}
+
+s32 os_ioctlv(s32 fd, s32 request, s32 count_in, s32 count_out, const ioctlv* vector)
+{
+	ipcmessage message = { IOS_IOCTLV, 0, (u32)fd };
+	message.ioctlv.command = request;
+	message.ioctlv.num_in = count_in;
+	message.ioctlv.num_io = count_out;
+	message.ioctlv.vector = (ioctlv*)vector;
+	return Dispatch(&message);
+}
+
+void os_sync_before_read(const void* ptr, u32 size)
+{
+}
+
+void os_sync_after_write(const void* ptr, u32 size)
+{
+}
+
+void Ios_Start()
+{
+	InitializeHeap(null, HEAP_SIZE, 8);
+
+	static Filesystem filesystem;
+}
+
+// newlib's devoptab registry, used by libfat
+
+static const devoptab_t* Devices[MAX_DEVICES];
+static int DefaultDevice = -1;
+
+static bool DeviceMatches(const devoptab_t* device, const char* name)
+{
+	int length = strlen(device->name);
+	return !strncmp(device->name, name, length) && (name[length] == '\0' || name[length] == ':');
+}
+
+int AddDevice(const devoptab_t* device)
+{
+	for (int i = 0; i < MAX_DEVICES; i++) {
+		if (!Devices[i] || DeviceMatches(Devices[i], device->name)) {
+			Devices[i] = device;
+			return i;
+		}
+	}
+	return -1;
+}
+
+int FindDevice(const char* name)
+{
+	for (int i = 0; i < MAX_DEVICES; i++) {
+		if (Devices[i] && DeviceMatches(Devices[i], name))
+			return i;
+	}
+	return -1;
+}
+
+int RemoveDevice(const char* name)
+{
+	int index = FindDevice(name);
+	if (index < 0)
+		return -1;
+	Devices[index] = null;
+	if (DefaultDevice == index)
+		DefaultDevice = -1;
+	return 0;
+}
+
+void setDefaultDevice(int device)
+{
+	DefaultDevice = device;
+}
+
+const devoptab_t* GetDeviceOpTab(const char* name)
+{
+	if (!strchr(name, ':'))
+		return DefaultDevice < 0 ? null : Devices[DefaultDevice];
+
+	int index = FindDevice(name);
+	return index < 0 ? null : Devices[index];
+}
+
+// FatHandler selects its partition with chdir, which newlib turns into the
+// default device
+extern "C" int chdir(const char* path)
+{
+	int index = FindDevice(path);
+	if (index < 0)
+		return -1;
+	DefaultDevice = index;
+	return 0;
+}
+
+// the rest of libios, unused or idle here
+
+void RTC_Init(time_t epoch)
+{
+}
+
+void RTC_Update()
+{
+}
+
+void gpio_enable_toggle(u32 flag)
+{
+}
+
+void gpio_disable_toggle(u32 flag)
+{
+}
+
+int _vsprintf(char* buf, const char* fmt, va_list args)
+{
+	return vsprintf(buf, fmt, args);
+}
+
+// no network, so RiiFS never mounts
+
+s32 net_init()
+{
+	return -1;
+}
+
+s32 net_socket(u32 domain, u32 type, u32 protocol)
+{
+	return -1;
+}
+
+s32 net_connect(s32 s, struct sockaddr* name, socklen_t namelen)
+{
+	return -1;
+}
+
+s32 net_send(s32 s, const void* data, s32 size, u32 flags)
+{
+	return -1;
+}
+
+s32 net_sendto(s32 s, const void* data, s32 len, u32 flags, struct sockaddr* to, socklen_t tolen)
+{
+	return -1;
+}
+
+s32 net_recv(s32 s, void* mem, s32 len, u32 flags)
+{
+	return -1;
+}
+
+s32 net_recvfrom(s32 s, void* mem, s32 len, u32 flags, struct sockaddr* from, socklen_t* fromlen)
+{
+	return -1;
+}
+
+s32 net_ioctl(s32 s, u32 cmd, void* argp)
+{
+	return -1;
+}
+
+s32 net_close(s32 s)
+{
+	return -1;
+}
+
+char* inet_ntoa(struct in_addr addr)
+{
+	return null;
+}
+
+s8 inet_aton(const char* cp, struct in_addr* addr)
+{
+	return 0;
+}
+
+struct hostent* net_gethostbyname_async(const char* addrString, u32 timeout)
+{
+	return null;
+}
+
+struct hostent* net_getnbhostbyname_async(const char* addrString, u32 timeout)
+{
+	return null;
+}
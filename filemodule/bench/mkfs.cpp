@@ -0,0 +1,263 @@
+// Formats bench images, so they don't depend on the host having mkfs tools.
+// Volumes are laid out the way mkfs.fat and mkfs.exfat lay them out by default.
+
+#include "bench.h"
+
+#include <string.h>
+#include <locale.h>
+#include <wctype.h>
+
+#include <vector>
+
+static void Set16(u8* data, u16 value)
+{
+	data[0] = value;
+	data[1] = value >> 8;
+}
+
+static void Set32(u8* data, u32 value)
+{
+	Set16(data, value);
+	Set16(data + 2, value >> 16);
+}
+
+static void Set64(u8* data, u64 value)
+{
+	Set32(data, (u32)value);
+	Set32(data + 4, (u32)(value >> 32));
+}
+
+// An MBR with one partition starting at 1 MiB, returns where the volume goes
+u8* Fs_Partition(u8* image, u64* sectors, u8 type)
+{
+	const u32 start = 2048;
+	memset(image, 0, 512);
+	image[0x1BE + 4] = type;
+	Set32(image + 0x1BE + 8, start);
+	Set32(image + 0x1BE + 12, (u32)(*sectors - start));
+	image[0x1FE] = 0x55;
+	image[0x1FF] = 0xAA;
+	*sectors -= start;
+	return image + (u64)start * 512;
+}
+
+bool Fs_FormatFat32(u8* volume, u64 sectors, u32 cluster_sectors)
+{
+	const u32 reserved = 32;
+	const u32 fats = 2;
+
+	if (sectors > 0xFFFFFFFF || !cluster_sectors || cluster_sectors > 128 || (cluster_sectors & (cluster_sectors - 1)))
+		return false;
+
+	// the FAT has to cover the clusters that are left once it's taken its space
+	u32 fat_sectors = 1;
+	u32 clusters;
+	for (;;) {
+		clusters = (u32)((sectors - reserved - fats * fat_sectors) / cluster_sectors);
+		u32 need = ((clusters + 2) * 4 + 511) / 512;
+		if (need <= fat_sectors)
+			break;
+		fat_sectors = need;
+	}
+	if (clusters < 65525 || clusters >= 0x0FFFFFF0)
+		return false;
+
+	memset(volume, 0, (u64)(reserved + fats * fat_sectors + cluster_sectors) * 512);
+
+	u8* boot = volume;
+	boot[0] = 0xEB;
+	boot[1] = 0x58;
+	boot[2] = 0x90;
+	memcpy(boot + 3, "MSWIN4.1", 8);
+	Set16(boot + 11, 512);
+	boot[13] = cluster_sectors;
+	Set16(boot + 14, reserved);
+	boot[16] = fats;
+	boot[21] = 0xF8;
+	Set16(boot + 24, 63);
+	Set16(boot + 26, 255);
+	Set32(boot + 32, (u32)sectors);
+	Set32(boot + 36, fat_sectors);
+	Set32(boot + 44, 2);		// root directory cluster
+	Set16(boot + 48, 1);		// FSInfo sector
+	Set16(boot + 50, 6);		// backup boot sector
+	boot[64] = 0x80;
+	boot[66] = 0x29;
+	Set32(boot + 67, 0x20260101);
+	memcpy(boot + 71, "BENCH      ", 11);
+	memcpy(boot + 82, "FAT32   ", 8);
+	boot[510] = 0x55;
+	boot[511] = 0xAA;
+
+	u8* info = volume + 512;
+	Set32(info, 0x41615252);
+	Set32(info + 484, 0x61417272);
+	Set32(info + 488, clusters - 1);	// all but the root directory
+	Set32(info + 492, 3);
+	info[510] = 0x55;
+	info[511] = 0xAA;
+
+	memcpy(volume + 6 * 512, boot, 1024);
+
+	for (u32 i = 0; i < fats; i++) {
+		u8* fat = volume + (u64)(reserved + i * fat_sectors) * 512;
+		Set32(fat, 0x0FFFFFF8);
+		Set32(fat + 4, 0x0FFFFFFF);
+		Set32(fat + 8, 0x0FFFFFFF);	// root directory
+	}
+
+	return true;
+}
+
+// The up-case table in its compressed form, with runs of unchanged characters
+// written as 0xFFFF and a count. The mapping comes from the host's C library.
+static void ExfatUpcase(std::vector<u8>* table)
+{
+	std::vector<u16> out;
+	setlocale(LC_CTYPE, "C.UTF-8");
+
+	for (u32 c = 0; c < 0x10000; ) {
+		u32 mapped = (c >= 0xD800 && c < 0xE000) ? c : towupper(c);
+		if (mapped != c && mapped < 0x10000) {
+			out.push_back(mapped);
+			c++;
+			continue;
+		}
+
+		u32 run = c + 1;
+		while (run < 0x10000) {
+			u32 next = (run >= 0xD800 && run < 0xE000) ? run : towupper(run);
+			if (next != run && next < 0x10000)
+				break;
+			run++;
+		}
+		if (run - c > 2) {
+			out.push_back(0xFFFF);
+			out.push_back(run - c);
+		} else {
+			for (; c < run; c++)
+				out.push_back(c);
+		}
+		c = run;
+	}
+
+	setlocale(LC_CTYPE, "C");
+	table->resize(out.size() * 2);
+	for (size_t i = 0; i < out.size(); i++)
+		Set16(&(*table)[i * 2], out[i]);
+}
+
+static u32 ExfatTableChecksum(const u8* data, u32 length)
+{
+	u32 sum = 0;
+	for (u32 i = 0; i < length; i++)
+		sum = ((sum & 1) ? 0x80000000 : 0) + (sum >> 1) + data[i];
+	return sum;
+}
+
+bool Fs_FormatExfat(u8* volume, u64 sectors, u32 cluster_sectors, u64 partition_offset)
+{
+	const u32 fat_offset = 128;
+
+	if (!cluster_sectors || (cluster_sectors & (cluster_sectors - 1)) || cluster_sectors > 0x10000)
+		return false;
+	u32 cluster_shift = 0;
+	while ((1U << cluster_shift) < cluster_sectors)
+		cluster_shift++;
+	u32 cluster_bytes = cluster_sectors * 512;
+
+	// the FAT has to cover the clusters that are left, and the heap starts on a cluster boundary
+	u32 fat_sectors = 1;
+	u32 heap, clusters;
+	for (;;) {
+		heap = (fat_offset + fat_sectors + cluster_sectors - 1) & ~(cluster_sectors - 1);
+		if (heap >= sectors)
+			return false;
+		u64 count = (sectors - heap) >> cluster_shift;
+		clusters = (u32)MIN(count, 0xFFFFFFF5ULL);
+		u32 need = ((clusters + 2) * 4 + 511) / 512;
+		if (need <= fat_sectors)
+			break;
+		fat_sectors = need;
+	}
+	if (clusters < 16)
+		return false;
+
+	std::vector<u8> upcase;
+	ExfatUpcase(&upcase);
+	u32 bitmap_bytes = (clusters + 7) / 8;
+	u32 bitmap_clusters = (bitmap_bytes + cluster_bytes - 1) / cluster_bytes;
+	u32 upcase_clusters = ((u32)upcase.size() + cluster_bytes - 1) / cluster_bytes;
+	u32 bitmap_first = 2;
+	u32 upcase_first = bitmap_first + bitmap_clusters;
+	u32 root = upcase_first + upcase_clusters;
+
+	memset(volume, 0, (u64)heap * 512);
+
+	// boot region: boot sector, 8 extended boot sectors, OEM parameters, reserved, checksum
+	u8* boot = volume;
+	boot[0] = 0xEB;
+	boot[1] = 0x76;
+	boot[2] = 0x90;
+	memcpy(boot + 3, "EXFAT   ", 8);
+	Set64(boot + 64, partition_offset);
+	Set64(boot + 72, sectors);
+	Set32(boot + 80, fat_offset);
+	Set32(boot + 84, fat_sectors);
+	Set32(boot + 88, heap);
+	Set32(boot + 92, clusters);
+	Set32(boot + 96, root);
+	Set32(boot + 100, 0x20260101);
+	Set16(boot + 104, 0x0100);
+	boot[108] = 9;
+	boot[109] = cluster_shift;
+	boot[110] = 1;
+	boot[111] = 0x80;
+	boot[510] = 0x55;
+	boot[511] = 0xAA;
+	for (int i = 1; i <= 8; i++)
+		Set32(volume + i * 512 + 508, 0xAA550000);
+
+	u32 sum = 0;
+	for (u32 i = 0; i < 11 * 512; i++) {
+		if (i == 106 || i == 107 || i == 112)
+			continue;
+		sum = ((sum & 1) ? 0x80000000 : 0) + (sum >> 1) + volume[i];
+	}
+	for (u32 i = 0; i < 512; i += 4)
+		Set32(volume + 11 * 512 + i, sum);
+	memcpy(volume + 12 * 512, volume, 12 * 512);
+
+	u8* fat = volume + (u64)fat_offset * 512;
+	Set32(fat, 0xFFFFFFF8);
+	Set32(fat + 4, 0xFFFFFFFF);
+	u32 firsts[3] = { bitmap_first, upcase_first, root };
+	u32 counts[3] = { bitmap_clusters, upcase_clusters, 1 };
+	for (int i = 0; i < 3; i++) {
+		for (u32 c = 0; c < counts[i]; c++)
+			Set32(fat + (firsts[i] + c) * 4, c + 1 < counts[i] ? firsts[i] + c + 1 : 0xFFFFFFFF);
+	}
+
+	u8* data = volume + (u64)heap * 512;
+	memset(data, 0, (u64)(root - 1) * cluster_bytes);
+	u8* bitmap = data;
+	for (u32 c = 2; c <= root; c++)
+		bitmap[(c - 2) >> 3] |= 1 << ((c - 2) & 7);
+	memcpy(data + (u64)(upcase_first - 2) * cluster_bytes, &upcase[0], upcase.size());
+
+	u8* entries = data + (u64)(root - 2) * cluster_bytes;
+	entries[0] = 0x83;			// volume label
+	entries[1] = 5;
+	const char* label = "BENCH";
+	for (int i = 0; i < 5; i++)
+		Set16(entries + 2 + i * 2, label[i]);
+	entries[32] = 0x81;			// allocation bitmap
+	Set32(entries + 32 + 20, bitmap_first);
+	Set64(entries + 32 + 24, bitmap_bytes);
+	entries[64] = 0x82;			// up-case table
+	Set32(entries + 64 + 4, ExfatTableChecksum(&upcase[0], (u32)upcase.size()));
+	Set32(entries + 64 + 20, upcase_first);
+	Set64(entries + 64 + 24, upcase.size());
+
+	return true;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// Forced into every translation unit of the bench
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+// newlib's struct stat has st_spare4, glibc calls the padding something else
+#define st_spare4 __glibc_reserved
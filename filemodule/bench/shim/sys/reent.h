@@ -0,0 +1,7 @@
+#pragma once
+
+// newlib's reentrancy struct, as far as libfat uses it
+struct _reent
+{
+	int _errno;
+};
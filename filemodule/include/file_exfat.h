@@ -0,0 +1,208 @@
+#pragma once
+
+#include "filemodule.h"
+
+#define EXFAT_IDLE_TIME 4*1000*1000 // 4 seconds
+
+#define EXFAT_MAX_SECTOR		0x1000
+#define EXFAT_CACHE_SIZE		0x1000 // bytes of sector cache, at least EXFAT_CACHE_MIN sectors
+#define EXFAT_CACHE_MIN			4
+#define EXFAT_MAX_TRANSFER		0x80 // sectors per disc request
+#define EXFAT_NAME_MAX			255
+#define EXFAT_SET_MAX			19 // file + stream + 17 name entries
+#define EXFAT_ENTRY_SIZE		0x20
+#define EXFAT_NO_ENTRY			0xFFFFFFFF
+
+// Directory entry types
+#define EXFAT_ENTRY_EOD			0x00
+#define EXFAT_ENTRY_INUSE		0x80
+#define EXFAT_ENTRY_BITMAP		0x81
+#define EXFAT_ENTRY_UPCASE		0x82
+#define EXFAT_ENTRY_FILE		0x85
+#define EXFAT_ENTRY_STREAM		0xC0
+#define EXFAT_ENTRY_NAME		0xC1
+
+// Stream extension flags
+#define EXFAT_FLAG_ALLOCATION	0x01
+#define EXFAT_FLAG_NOFATCHAIN	0x02
+
+#define EXFAT_ATTR_READONLY		0x01
+#define EXFAT_ATTR_DIRECTORY	0x10
+#define EXFAT_ATTR_ARCHIVE		0x20
+
+#define EXFAT_CLUSTER_EOF		0xFFFFFFFF
+#define EXFAT_CLUSTER_FIRST		2
+
+// Identifier bit marking a contiguous file, so it can be opened by ID without walking the FAT
+#define EXFAT_ID_NOFATCHAIN		0x100000000ULL
+
+namespace ProxiIOS { namespace Filesystem {
+
+struct ExfatChain
+{
+	u32 First;
+	u32 Clusters;
+	bool Contiguous;
+
+	// last cluster looked up in a FAT chain
+	u32 CursorIndex;
+	u32 CursorCluster;
+};
+
+struct ExfatNode
+{
+	ExfatChain Data;	// clusters of the file or directory itself
+	ExfatChain Parent;	// directory holding its entry set
+	u32 Entry;			// index of the file entry in Parent, EXFAT_NO_ENTRY for the root and ID opens
+	u8 Secondary;
+	u16 Attributes;
+	u64 Length;
+	u64 ValidLength;
+};
+
+struct ExfatFileInfo : public FileInfo
+{
+	ExfatFileInfo(FilesystemHandler* system) : FileInfo(system) {
+		Position = 0;
+		Write = false;
+		Append = false;
+		Modified = false;
+	}
+
+	ExfatNode Node;
+	u64 Position;
+	bool Write;
+	bool Append;
+	bool Modified;
+};
+
+struct ExfatCacheEntry
+{
+	u32 Sector;
+	u32 LastUse;
+	bool Dirty;
+	u8* Data;
+};
+
+class ExfatHandler : public FilesystemHandler
+{
+protected:
+	int IdleCount;
+	int phys;
+
+	// Volume geometry, in sectors relative to the start of the disc
+	u32 VolumeStart;
+	u32 FatStart;
+	u32 HeapStart;
+	u32 ClusterCount;
+	u32 SectorShift;
+	u32 ClusterShift;		// sectors per cluster
+	u32 ClusterBytesShift;
+
+	ExfatNode Root;
+	ExfatChain Bitmap;
+	u32 NextFree;
+	s64 FreeClusters;		// -1 until counted
+
+	// Up-case table, stored as the sorted non-identity mappings
+	u16 UpcaseAscii[0x80];
+	u16* Upcase;
+	u32 UpcaseCount;
+
+	ExfatCacheEntry* Cache;
+	u32 CacheCount;
+	u32 CacheClock;
+	u8* CacheData;
+	u8* Bounce;
+
+	u16 Component[EXFAT_NAME_MAX];	// UTF-16 path component being looked up or created
+	u32 ComponentLength;
+	u8 SetBuffer[EXFAT_SET_MAX * EXFAT_ENTRY_SIZE];
+
+	u8* CacheSector(u32 sector, bool dirty);
+	bool CacheFlush();
+	void CacheDiscard(u32 sector, u32 count);
+	bool CacheWriteBack(u32 sector, u32 count);
+	bool DiscRead(u32 sector, u32 count, u8* buffer);
+	bool DiscWrite(u32 sector, u32 count, const u8* buffer);
+	bool ZeroCluster(u32 cluster);
+
+	u32 ClusterSector(u32 cluster) { return HeapStart + ((cluster - EXFAT_CLUSTER_FIRST) << ClusterShift); }
+	bool ValidCluster(u32 cluster) { return cluster >= EXFAT_CLUSTER_FIRST && cluster < ClusterCount + EXFAT_CLUSTER_FIRST; }
+	u32 NextCluster(u32 cluster);
+	bool SetNextCluster(u32 cluster, u32 next);
+	u32 ClusterAt(ExfatChain* chain, u32 index);
+	u32 LastCluster(ExfatChain* chain) { return ClusterAt(chain, chain->Clusters - 1); }
+
+	u8* BitmapSector(u32 cluster, bool dirty);
+	bool BitmapTest(u32 cluster);
+	bool BitmapSet(u32 cluster, u32 count, bool used);
+	u32 FreeRun(u32 cluster, u32 max);
+	u32 FindFree(u32 hint, u32 count, u32* length);
+	u32 CountFree();
+	bool Extend(ExfatChain* chain, u32 count);
+	bool FreeChain(ExfatChain* chain);
+
+	u16 UpCase(u16 c);
+	bool LoadUpcase(u32 cluster, u64 length, u32 checksum);
+	bool SetName(const char* name, int length);
+	u16 NameHash();
+
+	u8* DirEntry(ExfatChain* dir, u32 index, bool dirty);
+	u32 EntryCount(ExfatChain* dir) { return dir->Clusters << (ClusterBytesShift - 5); }
+	bool ReadSet(ExfatChain* dir, u32 index, u32 count);
+	bool WriteSet(ExfatChain* dir, u32 index, u32 count);
+	void ParseSet(ExfatNode* node);
+	bool FindEntry(ExfatNode* dir, ExfatNode* node);
+	int Resolve(const char* path, ExfatNode* node, bool parent);
+	bool ExtendDirectory(ExfatNode* dir);
+	bool Insert(ExfatNode* dir, const u8* head, ExfatNode* node);
+	bool UpdateEntry(ExfatNode* node);
+	bool Remove(ExfatNode* node);
+	bool IsEmpty(ExfatNode* dir);
+	int Create(const char* path, u16 attributes, ExfatNode* node);
+
+	int MountVolume(DISC_INTERFACE* disk);
+	u32 Transfer(ExfatFileInfo* file, u8* buffer, u32 length, bool write);
+	void NodeToStats(ExfatNode* node, Stats* st);
+
+public:
+	char Name[0x20];
+
+	ExfatHandler(Filesystem* fs) : FilesystemHandler(fs) {
+		IdleCount = -1;
+		phys = -1;
+		Upcase = NULL;
+		UpcaseCount = 0;
+		Cache = NULL;
+		CacheData = NULL;
+		Bounce = NULL;
+	}
+
+	~ExfatHandler();
+
+	int Mount(const void* options, int length);
+	int Unmount();
+	int CheckPhysical();
+
+	FileInfo* Open(const char* path, int mode);
+	int Read(FileInfo* file, u8* buffer, int length);
+	int Write(FileInfo* file, const u8* buffer, int length);
+	int Seek(FileInfo* file, int where, int whence);
+	int Tell(FileInfo* file);
+	int Sync(FileInfo* file);
+	int Close(FileInfo* file);
+
+	int Stat(const char* path, Stats* st);
+	int CreateFile(const char* path);
+	int Delete(const char* path);
+	int Rename(const char* source, const char* destination);
+	int CreateDir(const char* path);
+	FileInfo* OpenDir(const char* path);
+	int NextDir(FileInfo* dir, char* filename, Stats* st);
+	int CloseDir(FileInfo* dir);
+	int IdleTick();
+	int GetFreeSpace(u64 *free_bytes);
+};
+
+} }
@@ -83,7 +83,8 @@ namespace ProxiIOS { namespace Filesystem {
 			Ext2			= FS_EXT2,
 			SMB				= FS_SMB,
 			ISFS			= FS_ISFS,
-			RiiFS			= FS_RIIFS
+			RiiFS			= FS_RIIFS,
+			exFAT			= FS_EXFAT
 		};
 	}
 
@@ -34,7 +34,8 @@ typedef enum {
 	FS_EXT2,
 	FS_SMB,
 	FS_ISFS,
-	FS_RIIFS
+	FS_RIIFS,
+	FS_EXFAT
 } disk_fs;
 
 typedef enum {
@@ -3,11 +3,11 @@
  The cache is not visible to the user. It should be flushed
  when any file is closed or changes are made to the filesystem.
 
- This cache implements a least-used-page replacement policy. This will
- distribute sectors evenly over the pages, so if less than the maximum
- pages are used at once, they should all eventually remain in the cache.
- This also has the benefit of throwing out old sectors, so as not to keep
- too many stale pages around.
+ Pages are found through a hash of their first sector and replaced using
+ a CLOCK (second chance) policy. Every use of a page earns it another pass
+ of the clock hand, so frequently used sectors such as the FAT stay cached
+ while pages that were only read through are replaced first. Pages that come
+ back soon after being evicted are remembered and start with full chances.
 
  Copyright (c) 2006 Michael "Chishm" Chisholm
 
@@ -40,21 +40,17 @@
 #include "disc.h"
 
 #define EVICTION_HISTORY 14
+#define CACHE_MAX_CHANCES 15
+#define CACHE_READ_AHEAD_PAGES 4	// Largest read-ahead window, also the most pages written in one go
 
 typedef struct {
 	sec_t        sector;
 	unsigned int count;
-	unsigned int last_access;
+	unsigned int chances;  // passes of the clock hand left before eviction
 	bool         dirty;
 	uint8_t*     cache;
 } CACHE_ENTRY;
 
-typedef struct {
-	sec_t        sector;
-	unsigned int count;
-	unsigned int last_access;
-} EVICTION_ENTRY;
-
 typedef struct {
 	const DISC_INTERFACE* disc;
 	sec_t		          endOfPartition;
@@ -63,7 +59,16 @@ typedef struct {
 	unsigned int          bytesPerSector;
 	unsigned int          bytesPerSectorLog;
 	CACHE_ENTRY*          cacheEntries;
-	EVICTION_ENTRY        evictions[EVICTION_HISTORY];
+	unsigned int*         pageHash;      // open addressed, page index by first sector
+	unsigned int          pageHashShift;
+	unsigned int          clockHand;
+	sec_t                 evictions[EVICTION_HISTORY];
+	unsigned int          nextEviction;
+	uint8_t*              readAhead;     // sectors read past a sequential miss, also used to merge dirty pages
+	sec_t                 readAheadSector;
+	sec_t                 readAheadCount;
+	unsigned int          streamLength;  // misses in a row that each followed on from the last
+	sec_t                 streamNext;    // sector that would continue the current sequential read
 } CACHE;
 
 /*
@@ -48,6 +48,10 @@
 
 #define DIR_SEPARATOR '/'
 
+// Lookup cache geometry, each set holds the most recent names that hash to it
+#define DIR_LOOKUP_SETS 64
+#define DIR_LOOKUP_WAYS 4
+
 // File attributes
 #define ATTRIB_ARCH	0x20			// Archive
 #define ATTRIB_DIR	0x10			// Directory
@@ -75,6 +79,15 @@ typedef struct {
 	char               filename[MAX_FILENAME_LENGTH];
 } DIR_ENTRY;
 
+// A remembered path component lookup within one directory
+typedef struct _DIR_LOOKUP {
+	uint64_t           nameHash;		// Hash of the case folded name, 0 for an unused slot
+	uint32_t           dirCluster;
+	uint32_t           lastUse;
+	DIR_ENTRY_POSITION dataStart;
+	DIR_ENTRY_POSITION dataEnd;			// An offset of -1 means the name is known not to be in the directory
+} DIR_LOOKUP;
+
 // Directory entry offsets
 enum DIR_ENTRY_offset {
 	DIR_ENTRY_name = 0x00,
@@ -173,6 +186,13 @@ Fill in a stat struct based on a file entry
 */
 void _FAT_directory_entryStat (PARTITION* partition, DIR_ENTRY* entry, struct stat *st);
 
+/*
+Allocate the directory lookup cache, starting empty.
+Lookups still work without it, just more slowly.
+*/
+bool _FAT_directory_createLookupCache (PARTITION* partition);
+void _FAT_directory_destroyLookupCache (PARTITION* partition);
+
 /*
 Get volume label
 */
@@ -41,12 +41,20 @@
 
 #define FILE_MAX_SIZE ((uint32_t)0xFFFFFFFF)	// 4GiB - 1B
 
+#define FILE_MAX_EXTENTS 128	// Runs of the cluster chain that are remembered per open file
+
 typedef struct {
 	u32   cluster;
 	sec_t sector;
 	s32   byte;
 } FILE_POSITION;
 
+typedef struct {
+	uint32_t fileCluster;	// Position of the run's first cluster within the file
+	uint32_t cluster;		// First cluster of the run on disc
+	uint32_t count;			// Number of consecutive clusters in the run
+} FILE_EXTENT;
+
 struct _FILE_STRUCT;
 
 struct _FILE_STRUCT {
@@ -60,6 +68,10 @@ struct _FILE_STRUCT {
 	PARTITION*           partition;
 	struct _FILE_STRUCT* prevOpenFile;		// The previous entry in a double-linked list of open files
 	struct _FILE_STRUCT* nextOpenFile;		// The next entry in a double-linked list of open files
+	FILE_EXTENT*         extents;			// The cluster chain as runs, mapped as far as it has been needed
+	uint32_t             extentCount;
+	uint32_t             extentCapacity;
+	bool                 extentsComplete;	// The last extent ends the cluster chain
 	bool                 read;
 	bool                 write;
 	bool                 append;
@@ -43,6 +43,9 @@
 #define CLUSTERS_PER_FAT12 4085
 #define CLUSTERS_PER_FAT16 65525
 
+#define FAT_FREE_MAP_GROUPS	32768	// Size of the free cluster map in bits, the clusters are split into at most this many groups
+#define FAT_SCAN_SECTORS	32		// Sectors of the FAT read at a time when counting free clusters
+
 
 uint32_t _FAT_fat_nextCluster(PARTITION* partition, uint32_t cluster);
 
@@ -57,6 +60,9 @@ uint32_t _FAT_fat_lastCluster (PARTITION* partition, uint32_t cluster);
 
 unsigned int _FAT_fat_freeClusterCount (PARTITION* partition);
 
+bool _FAT_fat_createFreeMap (PARTITION* partition);
+void _FAT_fat_destroyFreeMap (PARTITION* partition);
+
 static inline sec_t _FAT_fat_clusterToSector (PARTITION* partition, uint32_t cluster) {
 	return (cluster >= CLUSTER_FIRST) ?
 		((cluster - CLUSTER_FIRST) * (sec_t)partition->sectorsPerCluster) + partition->dataStart :
@@ -46,6 +46,9 @@ typedef struct {
 	uint32_t firstFree;
 	uint32_t numberFreeCluster;
 	uint32_t numberLastAllocCluster;
+	bool     fsInfoDirty;		// The free cluster count has changed since the fs info sector was written
+	uint32_t* fullGroups;		// One bit per group of clusters, set once the group is known to have no free cluster
+	uint32_t groupShift;		// Clusters per group, as a power of 2
 } FAT;
 
 typedef struct {
@@ -69,6 +72,8 @@ typedef struct {
 	uint32_t              cwdCluster;			// Current working directory cluster
 	int                   openFileCount;
 	struct _FILE_STRUCT*  firstOpenFile;		// The start of a linked list of files
+	struct _DIR_LOOKUP*   lookups;				// Recent path component lookups, by directory and name hash
+	uint32_t              lookupClock;
 	mutex_t               lock;					// A lock for partition operations
 	bool                  readOnly;				// If this is set, then do not try writing to the disc
 	char                  label[12];			// Volume label
@@ -101,7 +106,7 @@ Read the fs info sector data.
 void _FAT_partition_readFSinfo(PARTITION * partition);
 
 /*
-Write the fs info sector data.
+Write the fs info sector data, if it has changed.
 */
 void _FAT_partition_writeFSinfo(PARTITION * partition);
 
@@ -3,11 +3,11 @@
  The cache is not visible to the user. It should be flushed
  when any file is closed or changes are made to the filesystem.
 
- This cache implements a least-used-page replacement policy. This will
- distribute sectors evenly over the pages, so if less than the maximum
- pages are used at once, they should all eventually remain in the cache.
- This also has the benefit of throwing out old sectors, so as not to keep
- too many stale pages around.
+ Pages are found through a hash of their first sector and replaced using
+ a CLOCK (second chance) policy. Every use of a page earns it another pass
+ of the clock hand, so frequently used sectors such as the FAT stay cached
+ while pages that were only read through are replaced first. Pages that come
+ back soon after being evicted are remembered and start with full chances.
 
  Copyright (c) 2006 Michael "Chishm" Chisholm
 
@@ -46,9 +46,78 @@
 
 #define CACHE_FREE UINT_MAX
 
+/*
+Slot of a page in the hash, the page number is spread with a Fibonacci hash
+so pages that are a power of two apart don't share a chain
+*/
+static inline unsigned int _FAT_cache_hashSlot (CACHE* cache, sec_t sector) {
+	return ((sector / cache->sectorsPerPage) * 2654435761u) >> cache->pageHashShift;
+}
+
+static inline unsigned int _FAT_cache_hashMask (CACHE* cache) {
+	return UINT_MAX >> cache->pageHashShift;
+}
+
+/*
+Returns the index of the page starting at sector, or CACHE_FREE if it isn't cached
+*/
+static unsigned int _FAT_cache_hashFind (CACHE* cache, sec_t sector) {
+	unsigned int mask = _FAT_cache_hashMask(cache);
+	unsigned int slot = _FAT_cache_hashSlot(cache, sector);
+	unsigned int page;
+
+	while ((page = cache->pageHash[slot]) != CACHE_FREE) {
+		if (cache->cacheEntries[page].sector == sector)
+			return page;
+		slot = (slot + 1) & mask;
+	}
+
+	return CACHE_FREE;
+}
+
+static void _FAT_cache_hashInsert (CACHE* cache, unsigned int page) {
+	unsigned int mask = _FAT_cache_hashMask(cache);
+	unsigned int slot = _FAT_cache_hashSlot(cache, cache->cacheEntries[page].sector);
+
+	while (cache->pageHash[slot] != CACHE_FREE)
+		slot = (slot + 1) & mask;
+
+	cache->pageHash[slot] = page;
+}
+
+/*
+Removes a page from the hash, moving back any later entries of the probe
+sequence so no tombstones are needed
+*/
+static void _FAT_cache_hashRemove (CACHE* cache, unsigned int page) {
+	unsigned int mask = _FAT_cache_hashMask(cache);
+	unsigned int slot = _FAT_cache_hashSlot(cache, cache->cacheEntries[page].sector);
+	unsigned int next, home;
+
+	while (cache->pageHash[slot] != page)
+		slot = (slot + 1) & mask;
+
+	next = slot;
+	while (true) {
+		next = (next + 1) & mask;
+		if (cache->pageHash[next] == CACHE_FREE)
+			break;
+
+		// an entry may only move back if that doesn't put it before its home slot
+		home = _FAT_cache_hashSlot(cache, cache->cacheEntries[cache->pageHash[next]].sector);
+		if (((next - home) & mask) >= ((next - slot) & mask)) {
+			cache->pageHash[slot] = cache->pageHash[next];
+			slot = next;
+		}
+	}
+
+	cache->pageHash[slot] = CACHE_FREE;
+}
+
 CACHE* _FAT_cache_constructor (unsigned int numberOfPages, unsigned int sectorsPerPage, const DISC_INTERFACE* discInterface, sec_t endOfPartition, unsigned int bytesPerSector) {
 	CACHE* cache;
 	unsigned int i;
+	unsigned int hashSize;
 	CACHE_ENTRY* cacheEntries;
 
 	if (numberOfPages < 2) {
@@ -82,9 +151,27 @@ CACHE* _FAT_cache_constructor (unsigned int numberOfPages, unsigned int sectorsP
 	cache->numberOfPages = numberOfPages;
 	cache->sectorsPerPage = sectorsPerPage;
 	cache->bytesPerSector = bytesPerSector;
+	cache->clockHand = 0;
+
+	// keep the hash at most half full so probe sequences stay short
+	cache->pageHashShift = 31;
+	for (hashSize = 2; hashSize < numberOfPages * 2; hashSize <<= 1) {
+		cache->pageHashShift--;
+	}
+
+	cache->pageHash = (unsigned int*) _FAT_mem_allocate ( sizeof(unsigned int) * hashSize);
+	if (cache->pageHash == NULL) {
+		_FAT_mem_free (cache);
+		return NULL;
+	}
+
+	for (i = 0; i < hashSize; i++) {
+		cache->pageHash[i] = CACHE_FREE;
+	}
 
 	cacheEntries = (CACHE_ENTRY*) _FAT_mem_allocate ( sizeof(CACHE_ENTRY) * numberOfPages);
 	if (cacheEntries == NULL) {
+		_FAT_mem_free (cache->pageHash);
 		_FAT_mem_free (cache);
 		return NULL;
 	}
@@ -92,16 +179,22 @@ CACHE* _FAT_cache_constructor (unsigned int numberOfPages, unsigned int sectorsP
 	for (i = 0; i < numberOfPages; i++) {
 		cacheEntries[i].sector = CACHE_FREE;
 		cacheEntries[i].count = 0;
-		cacheEntries[i].last_access = 0;
+		cacheEntries[i].chances = 0;
 		cacheEntries[i].dirty = false;
 		cacheEntries[i].cache = (uint8_t*) _FAT_mem_align ( sectorsPerPage << cache->bytesPerSectorLog );
 	}
 
-	for (i=0; i < EVICTION_HISTORY; i++) {
-		cache->evictions[i].sector = CACHE_FREE;
-		cache->evictions[i].count = 0;
-		cache->evictions[i].last_access = 0;
+	for (i = 0; i < EVICTION_HISTORY; i++) {
+		cache->evictions[i] = CACHE_FREE;
 	}
+	cache->nextEviction = 0;
+
+	// Without this buffer pages are simply read and written one at a time
+	cache->readAhead = (uint8_t*) _FAT_mem_align ( (CACHE_READ_AHEAD_PAGES * sectorsPerPage) << cache->bytesPerSectorLog );
+	cache->readAheadSector = 0;
+	cache->readAheadCount = 0;
+	cache->streamLength = 0;
+	cache->streamNext = CACHE_FREE;
 
 	cache->cacheEntries = cacheEntries;
 
@@ -118,112 +211,224 @@ void _FAT_cache_destructor (CACHE* cache) {
 		_FAT_mem_free (cache->cacheEntries[i].cache);
 	}
 	_FAT_mem_free (cache->cacheEntries);
+	_FAT_mem_free (cache->pageHash);
+	if (cache->readAhead) {
+		_FAT_mem_free (cache->readAhead);
+	}
 	_FAT_mem_free (cache);
 }
 
+/*
+Writes sectors straight to the disc, dropping anything read ahead over them
+*/
+static bool _FAT_cache_discWrite (CACHE* cache, sec_t sector, sec_t numSectors, const void* buffer) {
+	if ((cache->readAheadCount > 0) && (sector < cache->readAheadSector + cache->readAheadCount)
+		&& (cache->readAheadSector < sector + numSectors))
+	{
+		cache->readAheadCount = 0;
+	}
+
+	return _FAT_disc_writeSectors (cache->disc, sector, numSectors, buffer);
+}
+
+/*
+Writes a dirty page to disc, along with any dirty pages directly before and after
+it on the disc, so a run of them goes out in a single write
+*/
+static bool _FAT_cache_writePage (CACHE* cache, unsigned int page) {
+	CACHE_ENTRY* cacheEntries = cache->cacheEntries;
+	unsigned int sectorsPerPage = cache->sectorsPerPage;
+	unsigned int first = page;
+	unsigned int last = page;
+	unsigned int pages = 1;
+	unsigned int i;
+	sec_t count = 0;
+
+	if (cache->readAhead) {
+		while ((pages < CACHE_READ_AHEAD_PAGES) && (cacheEntries[first].sector >= sectorsPerPage)) {
+			i = _FAT_cache_hashFind(cache, cacheEntries[first].sector - sectorsPerPage);
+			if (i == CACHE_FREE || !cacheEntries[i].dirty)
+				break;
+			first = i;
+			pages++;
+		}
+		while ((pages < CACHE_READ_AHEAD_PAGES) && (cacheEntries[last].count == sectorsPerPage)) {
+			i = _FAT_cache_hashFind(cache, cacheEntries[last].sector + sectorsPerPage);
+			if (i == CACHE_FREE || !cacheEntries[i].dirty)
+				break;
+			last = i;
+			pages++;
+		}
+	}
+
+	if (pages == 1) {
+		if (!_FAT_cache_discWrite(cache, cacheEntries[page].sector, cacheEntries[page].count, cacheEntries[page].cache))
+			return false;
+		cacheEntries[page].dirty = false;
+		return true;
+	}
 
-static u32 accessCounter = 0;
+	// Gather the run in the read-ahead buffer, which loses what it held
+	cache->readAheadCount = 0;
+	for (i = first; ; i = _FAT_cache_hashFind(cache, cacheEntries[i].sector + sectorsPerPage)) {
+		memcpy(cache->readAhead + (count << cache->bytesPerSectorLog), cacheEntries[i].cache, cacheEntries[i].count << cache->bytesPerSectorLog);
+		count += cacheEntries[i].count;
+		if (i == last)
+			break;
+	}
+
+	if (!_FAT_disc_writeSectors(cache->disc, cacheEntries[first].sector, count, cache->readAhead))
+		return false;
 
-static u32 accessTime(){
-	accessCounter++;
-	return accessCounter;
+	for (i = first; ; i = _FAT_cache_hashFind(cache, cacheEntries[i].sector + sectorsPerPage)) {
+		cacheEntries[i].dirty = false;
+		if (i == last)
+			break;
+	}
+
+	return true;
 }
 
-static int _FAT_cache_getEvictionIndex(CACHE *cache, sec_t sector)
-{
-	int i;
-	EVICTION_ENTRY *entries = cache->evictions;
+/*
+Fills a page from the disc. Once a second miss in a row follows on from the one
+before, the read is taken as sequential and the following pages are read along
+with it into the read-ahead buffer, twice as many each time up to
+CACHE_READ_AHEAD_PAGES. Any other miss goes back to reading single pages.
+*/
+static bool _FAT_cache_readPage (CACHE* cache, uint8_t* dest, sec_t sector, sec_t count) {
+	unsigned int pages, i;
+	sec_t end;
+
+	if ((cache->readAheadCount > 0) && (sector >= cache->readAheadSector)
+		&& (sector + count <= cache->readAheadSector + cache->readAheadCount))
+	{
+		memcpy(dest, cache->readAhead + ((sector - cache->readAheadSector) << cache->bytesPerSectorLog), count << cache->bytesPerSectorLog);
+		cache->streamNext = sector + count;
+		return true;
+	}
 
-	for(i=0;i<EVICTION_HISTORY;i++) {
-		if (entries[i].sector == sector)
-			return i;
+	if (cache->readAhead && (sector == cache->streamNext)) {
+		cache->streamLength++;
+	} else {
+		cache->streamLength = 0;
 	}
+	cache->streamNext = sector + count;
+
+	// One page for a lone miss or the first that follows on, then 2, 4, ...
+	for (pages = 1, i = 1; (i < cache->streamLength) && (pages < CACHE_READ_AHEAD_PAGES); i++)
+		pages <<= 1;
+
+	if (pages == 1)
+		return _FAT_disc_readSectors(cache->disc, sector, count, dest);
+
+	end = sector + pages * cache->sectorsPerPage;
+	if (end > cache->endOfPartition)
+		end = cache->endOfPartition;
 
-	return -1;
+	cache->readAheadCount = 0;
+	if (!_FAT_disc_readSectors(cache->disc, sector, end - sector, cache->readAhead))
+		return false;
+	cache->readAheadSector = sector;
+	cache->readAheadCount = end - sector;
+
+	memcpy(dest, cache->readAhead, count << cache->bytesPerSectorLog);
+	return true;
 }
 
 static CACHE_ENTRY* _FAT_cache_getPage(CACHE *cache,sec_t sector)
 {
-	unsigned int i;
+	unsigned int i, j;
 	CACHE_ENTRY* cacheEntries = cache->cacheEntries;
 	unsigned int numberOfPages = cache->numberOfPages;
 	unsigned int sectorsPerPage = cache->sectorsPerPage;
-	EVICTION_ENTRY* Evictions = cache->evictions;
-
-	bool foundFree = false;
-	unsigned int oldUsed = 0;
-	unsigned int oldAccess = UINT_MAX;
-	unsigned int oldEvicted = UINT_MAX;
-	unsigned int oldEvictedAccess = 0;
-
-	for(i=0;i<numberOfPages;i++) {
-		int eviction_index = _FAT_cache_getEvictionIndex(cache, cacheEntries[i].sector);
-
-		if(sector>=cacheEntries[i].sector && sector<(cacheEntries[i].sector + cacheEntries[i].count)) {
-			cacheEntries[i].last_access = accessTime();
-			if (eviction_index>=0)
-				Evictions[eviction_index].last_access = cacheEntries[i].last_access;
-			return &(cacheEntries[i]);
-		}
 
-		if (cacheEntries[i].sector==CACHE_FREE) {
-			oldUsed = i;
-			foundFree = true;
-			break;
-		}
+	sector = (sector/sectorsPerPage)*sectorsPerPage; // align base sector to page size
 
-		if(cacheEntries[i].last_access<oldAccess) {
-			if (eviction_index>=0) {
-				EVICTION_ENTRY *evicted = Evictions+eviction_index;
-				if (evicted->count >= oldEvicted && evicted->last_access >= oldEvictedAccess)
-					continue;
-				oldAccess = UINT_MAX; // set this so any pages without eviction history will be preferred
-				oldEvicted = evicted->count;
-				oldEvictedAccess = evicted->last_access;
-			} else {
-				oldAccess = cacheEntries[i].last_access;
-				oldEvicted = 0; // prefer this page over any with eviction history
-				oldEvictedAccess = 0;
-			}
-			oldUsed = i;
-		}
+	i = _FAT_cache_hashFind(cache, sector);
+	if (i != CACHE_FREE) {
+		if (cacheEntries[i].chances < CACHE_MAX_CHANCES)
+			cacheEntries[i].chances++;
+		return &(cacheEntries[i]);
 	}
 
-	if (foundFree==false) { // something is being evicted, keep track of it
-		int eviction_index = _FAT_cache_getEvictionIndex(cache, cacheEntries[oldUsed].sector);
+	/* Advance the clock hand to the first page with no chances left, taking
+	 one from every page it passes. Free pages are always ahead of the hand,
+	 since it starts at the first page after an invalidate */
+	while (true) {
+		i = cache->clockHand;
+		if (++cache->clockHand == numberOfPages)
+			cache->clockHand = 0;
 
-		if (eviction_index<0) { // no eviction history for this page, overwrite the oldest record
-			oldEvictedAccess = UINT_MAX;
-			for (i=0;i<EVICTION_HISTORY;i++) {
-				if (cache->evictions[i].last_access < oldEvictedAccess) {
-					oldEvictedAccess = Evictions[i].last_access;
-					eviction_index = i;
-				}
-			}
-			Evictions[eviction_index].sector = cacheEntries[oldUsed].sector;
-			Evictions[eviction_index].count = 0;
+		if (cacheEntries[i].sector == CACHE_FREE || cacheEntries[i].chances == 0)
+			break;
+		cacheEntries[i].chances--;
+	}
+
+	if(cacheEntries[i].sector != CACHE_FREE) {
+		if(cacheEntries[i].dirty==true) {
+			if(!_FAT_cache_writePage(cache,i)) return NULL;
 		}
+		_FAT_cache_hashRemove(cache, i);
 
-		Evictions[eviction_index].count++;
-		Evictions[eviction_index].last_access = accessTime();
-	}
+		// something is being evicted, keep track of it
+		cache->evictions[cache->nextEviction] = cacheEntries[i].sector;
+		cache->nextEviction = (cache->nextEviction + 1) % EVICTION_HISTORY;
 
-	if(foundFree==false && cacheEntries[oldUsed].dirty==true) {
-		if(!_FAT_disc_writeSectors(cache->disc,cacheEntries[oldUsed].sector,cacheEntries[oldUsed].count,cacheEntries[oldUsed].cache)) return NULL;
-		cacheEntries[oldUsed].dirty = false;
+		cacheEntries[i].sector = CACHE_FREE;
+		cacheEntries[i].count = 0;
 	}
 
-	sector = (sector/sectorsPerPage)*sectorsPerPage; // align base sector to page size
 	sec_t next_page = sector + sectorsPerPage;
 	if(next_page > cache->endOfPartition)	next_page = cache->endOfPartition;
 
-	if(!_FAT_disc_readSectors(cache->disc,sector,next_page-sector,cacheEntries[oldUsed].cache)) return NULL;
+	if(!_FAT_cache_readPage(cache,cacheEntries[i].cache,sector,next_page-sector)) return NULL;
+
+	// pages that are only read through go first, unless they were evicted recently
+	cacheEntries[i].chances = 0;
+	for (j = 0; j < EVICTION_HISTORY; j++) {
+		if (cache->evictions[j] == sector) {
+			cache->evictions[j] = CACHE_FREE;
+			cacheEntries[i].chances = CACHE_MAX_CHANCES;
+			break;
+		}
+	}
+
+	cacheEntries[i].sector = sector;
+	cacheEntries[i].count = next_page-sector;
+	_FAT_cache_hashInsert(cache, i);
+
+	return &(cacheEntries[i]);
+}
+
+static CACHE_ENTRY* _FAT_cache_findPage(CACHE *cache, sec_t sector, sec_t count) {
+	unsigned int i;
+	CACHE_ENTRY* cacheEntries = cache->cacheEntries;
+	unsigned int numberOfPages = cache->numberOfPages;
+	unsigned int sectorsPerPage = cache->sectorsPerPage;
+	sec_t page = (sector/sectorsPerPage)*sectorsPerPage;
+
+	// look up each page of the range, unless there are more of those than cached pages
+	if ((sector + count - page) / sectorsPerPage < numberOfPages) {
+		for (; page < sector + count; page += sectorsPerPage) {
+			i = _FAT_cache_hashFind(cache, page);
+			if (i != CACHE_FREE)
+				return &cacheEntries[i];
+		}
+		return NULL;
+	}
+
+	for (i=0;i<numberOfPages;i++) {
+		bool intersect;
+		if (sector > cacheEntries[i].sector)
+			intersect = sector - cacheEntries[i].sector < cacheEntries[i].count;
+		else
+			intersect = cacheEntries[i].sector - sector < count;
 
-	cacheEntries[oldUsed].sector = sector;
-	cacheEntries[oldUsed].count = next_page-sector;
-	cacheEntries[oldUsed].last_access = accessTime();
+		if (intersect)
+			return &cacheEntries[i];
+	}
 
-	return &(cacheEntries[oldUsed]);
+	return NULL;
 }
 
 bool _FAT_cache_readSectors(CACHE *cache,sec_t sector,sec_t numSectors,void *buffer)
@@ -233,6 +438,24 @@ bool _FAT_cache_readSectors(CACHE *cache,sec_t sector,sec_t numSectors,void *buf
 	CACHE_ENTRY *entry;
 	uint8_t *dest = (uint8_t *)buffer;
 
+	// Reads at least as big as the read-ahead window go straight to the buffer, in as few reads as possible
+	if (numSectors >= CACHE_READ_AHEAD_PAGES * cache->sectorsPerPage && (u32)dest >= 0x10000000 && ((u32)dest & 0x1F)==0 && _FAT_cache_findPage(cache,sector,numSectors)==NULL) {
+		while(numSectors>0) {
+			secs_to_read = numSectors;
+#ifdef LIMIT_SECTORS
+			if(secs_to_read>LIMIT_SECTORS) secs_to_read = LIMIT_SECTORS;
+#endif
+			if(!_FAT_disc_readSectors(cache->disc,sector,secs_to_read,dest)) return false;
+
+			dest += (secs_to_read<<cache->bytesPerSectorLog);
+			sector += secs_to_read;
+			numSectors -= secs_to_read;
+		}
+		// A read carrying on from here is still sequential
+		cache->streamNext = (sector/cache->sectorsPerPage)*cache->sectorsPerPage;
+		return true;
+	}
+
 	while(numSectors>0) {
 		entry = _FAT_cache_getPage(cache,sector);
 		if(entry==NULL) return false;
@@ -340,25 +563,6 @@ bool _FAT_cache_eraseWritePartialSector (CACHE* cache, const void* buffer, sec_t
 	return true;
 }
 
-static CACHE_ENTRY* _FAT_cache_findPage(CACHE *cache, sec_t sector, sec_t count) {
-	unsigned int i;
-	CACHE_ENTRY* cacheEntries = cache->cacheEntries;
-	unsigned int numberOfPages = cache->numberOfPages;
-
-	for (i=0;i<numberOfPages;i++) {
-		bool intersect;
-		if (sector > cacheEntries[i].sector)
-			intersect = sector - cacheEntries[i].sector < cacheEntries[i].count;
-		else
-			intersect = cacheEntries[i].sector - sector < count;
-
-		if (intersect)
-			return &cacheEntries[i];
-	}
-
-	return NULL;
-}
-
 bool _FAT_cache_writeSectors (CACHE* cache, sec_t sector, sec_t numSectors, const void* buffer)
 {
 	sec_t sec;
@@ -367,7 +571,7 @@ bool _FAT_cache_writeSectors (CACHE* cache, sec_t sector, sec_t numSectors, cons
 	const uint8_t *src = (const uint8_t *)buffer;
 
 	if ((u32)src >= 0x10000000 && ((u32)src & 0x1F)==0 && _FAT_cache_findPage(cache,sector,numSectors)==NULL)
-		return _FAT_disc_writeSectors(cache->disc,sector,numSectors,src);
+		return _FAT_cache_discWrite(cache,sector,numSectors,src);
 
 	while(numSectors>0)
 	{
@@ -398,11 +602,10 @@ bool _FAT_cache_flush (CACHE* cache) {
 
 	for (i = 0; i < cache->numberOfPages; i++) {
 		if (cache->cacheEntries[i].dirty) {
-			if (!_FAT_disc_writeSectors (cache->disc, cache->cacheEntries[i].sector, cache->cacheEntries[i].count, cache->cacheEntries[i].cache)) {
+			if (!_FAT_cache_writePage (cache, i)) {
 				return false;
 			}
 		}
-		cache->cacheEntries[i].dirty = false;
 	}
 
 	return true;
@@ -413,8 +616,15 @@ void _FAT_cache_invalidate (CACHE* cache) {
 	_FAT_cache_flush(cache);
 	for (i = 0; i < cache->numberOfPages; i++) {
 		cache->cacheEntries[i].sector = CACHE_FREE;
-		cache->cacheEntries[i].last_access = 0;
+		cache->cacheEntries[i].chances = 0;
 		cache->cacheEntries[i].count = 0;
 		cache->cacheEntries[i].dirty = false;
 	}
+	for (i = 0; i <= _FAT_cache_hashMask(cache); i++) {
+		cache->pageHash[i] = CACHE_FREE;
+	}
+	cache->clockHand = 0;
+	cache->readAheadCount = 0;
+	cache->streamLength = 0;
+	cache->streamNext = CACHE_FREE;
 }
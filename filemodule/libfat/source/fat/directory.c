@@ -40,6 +40,7 @@
 #include "file_allocation_table.h"
 #include "bit_ops.h"
 #include "filetime.h"
+#include "mem_allocate.h"
 
 // Directory entry codes
 #define DIR_ENTRY_LAST 0x00
@@ -529,6 +530,233 @@ bool _FAT_directory_entryFromPosition (PARTITION* partition, DIR_ENTRY* entry) {
 }
 
 
+bool _FAT_directory_createLookupCache (PARTITION* partition) {
+	partition->lookupClock = 0;
+	partition->lookups = (DIR_LOOKUP*) _FAT_mem_allocate (DIR_LOOKUP_SETS * DIR_LOOKUP_WAYS * sizeof(DIR_LOOKUP));
+	if (partition->lookups == NULL) {
+		return false;
+	}
+	memset (partition->lookups, 0, DIR_LOOKUP_SETS * DIR_LOOKUP_WAYS * sizeof(DIR_LOOKUP));
+
+	return true;
+}
+
+void _FAT_directory_destroyLookupCache (PARTITION* partition) {
+	if (partition->lookups) {
+		_FAT_mem_free (partition->lookups);
+	}
+	partition->lookups = NULL;
+}
+
+/*
+Hash a path component the same way _FAT_directory_mbsncasecmp compares it.
+A missing name is only remembered by its hash, so this is 64 bits wide to make
+a collision hiding a real file practically impossible.
+Returns 0 if the name can't be hashed, which also marks an unused slot.
+*/
+static uint64_t _FAT_directory_lookupHash (const char* name, size_t len) {
+	uint64_t hash = 0xCBF29CE484222325ULL;	// FNV-1a
+	mbstate_t ps = {0};
+	wchar_t wc;
+	size_t bytes;
+
+	while (len > 0) {
+		bytes = mbrtowc(&wc, name, len, &ps);
+		if (bytes == 0 || (int)bytes < 0) {
+			return 0;
+		}
+		hash = (hash ^ (uint32_t)towlower(wc)) * 0x100000001B3ULL;
+		name += bytes;
+		len -= bytes;
+	}
+
+	return hash ? hash : 1;
+}
+
+static DIR_LOOKUP* _FAT_directory_lookupSet (PARTITION* partition, uint32_t dirCluster, uint64_t hash) {
+	return partition->lookups + (((uint32_t)hash ^ dirCluster) & (DIR_LOOKUP_SETS - 1)) * DIR_LOOKUP_WAYS;
+}
+
+static DIR_LOOKUP* _FAT_directory_findLookup (PARTITION* partition, uint32_t dirCluster, uint64_t hash) {
+	DIR_LOOKUP* lookup;
+	int i;
+
+	if (partition->lookups == NULL || hash == 0) {
+		return NULL;
+	}
+
+	lookup = _FAT_directory_lookupSet (partition, dirCluster, hash);
+	for (i = 0; i < DIR_LOOKUP_WAYS; i++, lookup++) {
+		if (lookup->nameHash == hash && lookup->dirCluster == dirCluster) {
+			lookup->lastUse = ++partition->lookupClock;
+			return lookup;
+		}
+	}
+	return NULL;
+}
+
+/*
+Remember the result of a lookup, replacing the least recently used slot in its set.
+entry is NULL if the name isn't in the directory.
+*/
+static void _FAT_directory_storeLookup (PARTITION* partition, uint32_t dirCluster, uint64_t hash, DIR_ENTRY* entry) {
+	DIR_LOOKUP* lookup;
+	DIR_LOOKUP* victim;
+	int i;
+
+	if (partition->lookups == NULL || hash == 0) {
+		return;
+	}
+
+	lookup = _FAT_directory_lookupSet (partition, dirCluster, hash);
+	victim = lookup;
+	for (i = 0; i < DIR_LOOKUP_WAYS; i++, lookup++) {
+		if (lookup->nameHash == hash && lookup->dirCluster == dirCluster) {
+			victim = lookup;
+			break;
+		}
+		if (lookup->lastUse < victim->lastUse) {
+			victim = lookup;
+		}
+	}
+
+	victim->nameHash = hash;
+	victim->dirCluster = dirCluster;
+	victim->lastUse = ++partition->lookupClock;
+	if (entry) {
+		victim->dataStart = entry->dataStart;
+		victim->dataEnd = entry->dataEnd;
+	} else {
+		victim->dataEnd.offset = -1;
+	}
+}
+
+/*
+Forget the missing names in a directory, since one of them may have just been created
+*/
+static void _FAT_directory_forgetMissing (PARTITION* partition, uint32_t dirCluster) {
+	int i;
+
+	if (partition->lookups == NULL) {
+		return;
+	}
+
+	for (i = 0; i < DIR_LOOKUP_SETS * DIR_LOOKUP_WAYS; i++) {
+		if ((partition->lookups[i].dataEnd.offset < 0) && (partition->lookups[i].dirCluster == dirCluster)) {
+			partition->lookups[i].nameHash = 0;
+			partition->lookups[i].lastUse = 0;
+		}
+	}
+}
+
+/*
+Forget a removed entry, and everything inside it if it was a directory
+*/
+static void _FAT_directory_forgetEntry (PARTITION* partition, DIR_ENTRY* entry) {
+	DIR_LOOKUP* lookup;
+	uint32_t cluster = CLUSTER_FREE;
+	int i;
+
+	if (partition->lookups == NULL) {
+		return;
+	}
+
+	if (_FAT_directory_isDirectory (entry)) {
+		cluster = _FAT_directory_entryGetCluster (partition, entry->entryData);
+	}
+
+	for (i = 0, lookup = partition->lookups; i < DIR_LOOKUP_SETS * DIR_LOOKUP_WAYS; i++, lookup++) {
+		if (((lookup->dataEnd.cluster == entry->dataEnd.cluster)
+				&& (lookup->dataEnd.sector == entry->dataEnd.sector)
+				&& (lookup->dataEnd.offset == entry->dataEnd.offset))
+			|| (cluster != CLUSTER_FREE && lookup->dirCluster == cluster))
+		{
+			lookup->nameHash = 0;
+			lookup->lastUse = 0;
+		}
+	}
+}
+
+/*
+Check if a directory entry is called name, by either its long name or alias
+*/
+static bool _FAT_directory_entryMatches (DIR_ENTRY* entry, const char* name, size_t nameLength) {
+	char alias[MAX_ALIAS_LENGTH];
+
+	// Check if the filename matches
+	if ((nameLength == strnlen(entry->filename, MAX_FILENAME_LENGTH))
+		&& (_FAT_directory_mbsncasecmp(name, entry->filename, nameLength) == 0)) {
+			return true;
+	}
+
+	// Check if the alias matches
+	_FAT_directory_entryGetAlias (entry->entryData, alias);
+	if ((nameLength == strnlen(alias, MAX_ALIAS_LENGTH))
+		&& (strncasecmp(name, alias, nameLength) == 0)) {
+			return true;
+	}
+
+	return false;
+}
+
+/*
+Find the entry called name in the directory starting at dirCluster.
+If needDirectory is set, files with that name are skipped.
+Remembered positions are read back and compared before being trusted, since entries
+can change in place. Only a name that matched nothing is remembered as missing.
+*/
+static bool _FAT_directory_findEntry (PARTITION* partition, DIR_ENTRY* entry, uint32_t dirCluster,
+	const char* name, size_t nameLength, bool needDirectory)
+{
+	DIR_LOOKUP* lookup;
+	uint64_t hash;
+	bool foundFile;
+	bool nameTaken = false;
+
+	if (dirCluster == FAT16_ROOT_DIR_CLUSTER) {
+		dirCluster = partition->rootDirCluster;
+	}
+
+	hash = _FAT_directory_lookupHash (name, nameLength);
+	lookup = _FAT_directory_findLookup (partition, dirCluster, hash);
+	if (lookup) {
+		if (lookup->dataEnd.offset < 0) {
+			return false;
+		}
+		entry->dataStart = lookup->dataStart;
+		entry->dataEnd = lookup->dataEnd;
+		if (_FAT_directory_entryFromPosition (partition, entry)
+			&& (entry->entryData[0] != DIR_ENTRY_FREE) && (entry->entryData[0] > 0x20)
+			&& !(entry->entryData[DIR_ENTRY_attributes] & ATTRIB_VOL)
+			&& _FAT_directory_entryMatches (entry, name, nameLength)
+			&& (!needDirectory || _FAT_directory_isDirectory (entry)))
+		{
+			return true;
+		}
+		// Stale, so search for it the slow way
+		lookup->nameHash = 0;
+		lookup->lastUse = 0;
+	}
+
+	foundFile = _FAT_directory_getFirstEntry (partition, entry, dirCluster);
+	while (foundFile) {
+		if (_FAT_directory_entryMatches (entry, name, nameLength)) {
+			if (!needDirectory || _FAT_directory_isDirectory (entry)) {
+				_FAT_directory_storeLookup (partition, dirCluster, hash, entry);
+				return true;
+			}
+			// Make sure that we aren't trying to follow a file instead of a directory in the path
+			nameTaken = true;
+		}
+		foundFile = _FAT_directory_getNextEntry (partition, entry);
+	}
+
+	if (!nameTaken) {
+		_FAT_directory_storeLookup (partition, dirCluster, hash, NULL);
+	}
+	return false;
+}
+
 
 bool _FAT_directory_entryFromPath (PARTITION* partition, DIR_ENTRY* entry, const char* path, const char* pathEnd) {
 	size_t dirnameLength;
@@ -536,7 +764,6 @@ bool _FAT_directory_entryFromPath (PARTITION* partition, DIR_ENTRY* entry, const
 	const char* nextPathPosition;
 	uint32_t dirCluster;
 	bool foundFile;
-	char alias[MAX_ALIAS_LENGTH];
 	bool found, notFound;
 
 	pathPosition = path;
@@ -588,31 +815,7 @@ bool _FAT_directory_entryFromPath (PARTITION* partition, DIR_ENTRY* entry, const
 		}
 
 		// Look for the directory within the path
-		foundFile = _FAT_directory_getFirstEntry (partition, entry, dirCluster);
-
-		while (foundFile && !found && !notFound) {			// It hasn't already found the file
-			// Check if the filename matches
-			if ((dirnameLength == strnlen(entry->filename, MAX_FILENAME_LENGTH))
-				&& (_FAT_directory_mbsncasecmp(pathPosition, entry->filename, dirnameLength) == 0)) {
-					found = true;
-			}
-
-			// Check if the alias matches
-			_FAT_directory_entryGetAlias (entry->entryData, alias);
-			if ((dirnameLength == strnlen(alias, MAX_ALIAS_LENGTH))
-				&& (strncasecmp(pathPosition, alias, dirnameLength) == 0)) {
-					found = true;
-			}
-
-			if (found && !(entry->entryData[DIR_ENTRY_attributes] & ATTRIB_DIR) && (nextPathPosition != NULL)) {
-				// Make sure that we aren't trying to follow a file instead of a directory in the path
-				found = false;
-			}
-
-			if (!found) {
-				foundFile = _FAT_directory_getNextEntry (partition, entry);
-			}
-		}
+		foundFile = _FAT_directory_findEntry (partition, entry, dirCluster, pathPosition, dirnameLength, nextPathPosition != NULL);
 
 		if (!foundFile) {
 			// Check that the search didn't get to the end of the directory
@@ -658,6 +861,8 @@ bool _FAT_directory_removeEntry (PARTITION* partition, DIR_ENTRY* entry) {
 	bool finished;
 	uint8_t entryData[DIR_ENTRY_DATA_SIZE];
 
+	_FAT_directory_forgetEntry (partition, entry);
+
 	// Create an empty directory entry to overwrite the old ones with
 	for ( entryStillValid = true, finished = false;
 		entryStillValid && !finished;
@@ -701,7 +906,10 @@ static bool _FAT_directory_findEntryGap (PARTITION* partition, DIR_ENTRY* entry,
 			_FAT_fat_clusterToSector(partition, gapEnd.cluster) + gapEnd.sector,
 			gapEnd.offset * DIR_ENTRY_DATA_SIZE, DIR_ENTRY_DATA_SIZE);
 		if (entryData[0] == DIR_ENTRY_LAST) {
-			gapStart = gapEnd;
+			// A run of free entries just before the end carries on past it
+			if (dirEntryRemain == size) {
+				gapStart = gapEnd;
+			}
 			-- dirEntryRemain;
 			endOfDirectory = true;
 		} else if (entryData[0] == DIR_ENTRY_FREE) {
@@ -752,8 +960,6 @@ static bool _FAT_directory_findEntryGap (PARTITION* partition, DIR_ENTRY* entry,
 
 static bool _FAT_directory_entryExists (PARTITION* partition, const char* name, uint32_t dirCluster) {
 	DIR_ENTRY tempEntry;
-	bool foundFile;
-	char alias[MAX_ALIAS_LENGTH];
 	size_t dirnameLength;
 
 	dirnameLength = strnlen(name, MAX_FILENAME_LENGTH);
@@ -763,23 +969,7 @@ static bool _FAT_directory_entryExists (PARTITION* partition, const char* name,
 	}
 
 	// Make sure the entry doesn't already exist
-	foundFile = _FAT_directory_getFirstEntry (partition, &tempEntry, dirCluster);
-
-	while (foundFile) {			// It hasn't already found the file
-		// Check if the filename matches
-		if ((dirnameLength == strnlen(tempEntry.filename, MAX_FILENAME_LENGTH))
-			&& (_FAT_directory_mbsncasecmp(name, tempEntry.filename, dirnameLength) == 0)) {
-				return true;
-		}
-
-		// Check if the alias matches
-		_FAT_directory_entryGetAlias (tempEntry.entryData, alias);
-		if ((strncasecmp(name, alias, MAX_ALIAS_LENGTH) == 0)) {
-				return true;
-		}
-		foundFile = _FAT_directory_getNextEntry (partition, &tempEntry);
-	}
-	return false;
+	return _FAT_directory_findEntry (partition, &tempEntry, dirCluster, name, dirnameLength, false);
 }
 
 /*
@@ -1029,6 +1219,10 @@ bool _FAT_directory_addEntry (PARTITION* partition, DIR_ENTRY* entry, uint32_t d
 		}
 	}
 
+	// Names looked up here before may now exist
+	_FAT_directory_forgetMissing (partition,
+		(dirCluster == FAT16_ROOT_DIR_CLUSTER) ? partition->rootDirCluster : dirCluster);
+
 	// Find or create space for the entry
 	if (_FAT_directory_findEntryGap (partition, entry, dirCluster, entrySize) == false) {
 		return false;
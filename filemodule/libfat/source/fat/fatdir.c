@@ -162,6 +162,7 @@ int _FAT_unlink_r (struct _reent *r, const char *path) {
 		r->_errno = EIO;
 		errorOccured = true;
 	}
+	_FAT_partition_writeFSinfo(partition);
 
 	_FAT_unlock(&partition->lock);
 	if (errorOccured) {
@@ -314,6 +315,7 @@ int _FAT_rename_r (struct _reent *r, const char *oldName, const char *newName) {
 		r->_errno = EIO;
 		return -1;
 	}
+	_FAT_partition_writeFSinfo(partition);
 
 	_FAT_unlock(&partition->lock);
 	return 0;
@@ -446,6 +448,7 @@ int _FAT_mkdir_r (struct _reent *r, const char *path, int mode) {
 		r->_errno = EIO;
 		return -1;
 	}
+	_FAT_partition_writeFSinfo(partition);
 
 	_FAT_unlock(&partition->lock);
 	return 0;
@@ -471,10 +474,8 @@ int _FAT_statvfs_r (struct _reent *r, const char *path, struct statvfs *buf)
 		_FAT_partition_createFSinfo(partition);
 	}
 
-	if(partition->filesysType == FS_FAT32)
-		freeClusterCount = partition->fat.numberFreeCluster;
-	else
-		freeClusterCount = _FAT_fat_freeClusterCount (partition);
+	// Kept up to date as clusters are allocated and freed
+	freeClusterCount = partition->fat.numberFreeCluster;
 
 	// FAT clusters = POSIX blocks
 	buf->f_bsize = partition->bytesPerClusterMask+1;		// File system block size.
@@ -44,6 +44,159 @@
 #include "lock.h"
 #include "mem_allocate.h"
 
+/*
+Forget the extent map of a file, it is mapped again as it is needed
+*/
+static void _FAT_file_clearExtents (FILE_STRUCT* file) {
+	if (file->extents) {
+		_FAT_mem_free (file->extents);
+	}
+	file->extents = NULL;
+	file->extentCount = 0;
+	file->extentCapacity = 0;
+	file->extentsComplete = false;
+}
+
+static bool _FAT_file_growExtents (FILE_STRUCT* file) {
+	FILE_EXTENT* extents;
+	uint32_t capacity = file->extentCapacity ? file->extentCapacity * 2 : 8;
+
+	if (capacity > FILE_MAX_EXTENTS) {
+		capacity = FILE_MAX_EXTENTS;
+	}
+	if (capacity == file->extentCapacity) {
+		return false;
+	}
+
+	extents = (FILE_EXTENT*) _FAT_mem_allocate (sizeof(FILE_EXTENT) * capacity);
+	if (extents == NULL) {
+		return false;
+	}
+	if (file->extents) {
+		memcpy (extents, file->extents, sizeof(FILE_EXTENT) * file->extentCount);
+		_FAT_mem_free (file->extents);
+	}
+
+	file->extents = extents;
+	file->extentCapacity = capacity;
+	return true;
+}
+
+/*
+Get the run of the cluster chain holding cluster number index of the file.
+Runs are found by binary search once mapped, otherwise the chain is followed
+on from the last mapped run until index is reached.
+Returns NULL if the chain ends before index or the map is full.
+*/
+static FILE_EXTENT* _FAT_file_mapExtent (FILE_STRUCT* file, uint32_t index) {
+	PARTITION* partition = file->partition;
+	FILE_EXTENT* extent;
+	uint32_t nextCluster;
+	uint32_t low, high, middle;
+
+	if (file->startCluster == CLUSTER_FREE) {
+		return NULL;
+	}
+
+	if (file->extentCount > 0) {
+		extent = &file->extents[file->extentCount - 1];
+		if (index < extent->fileCluster + extent->count) {
+			low = 0;
+			high = file->extentCount - 1;
+			while (low < high) {
+				middle = (low + high + 1) / 2;
+				if (file->extents[middle].fileCluster <= index) {
+					low = middle;
+				} else {
+					high = middle - 1;
+				}
+			}
+			return &file->extents[low];
+		}
+	}
+
+	while (!file->extentsComplete) {
+		if (file->extentCount == 0) {
+			nextCluster = file->startCluster;
+		} else {
+			extent = &file->extents[file->extentCount - 1];
+			nextCluster = _FAT_fat_nextCluster (partition, extent->cluster + extent->count - 1);
+			if (nextCluster == extent->cluster + extent->count) {
+				// Still contiguous, grow the current run
+				extent->count++;
+				if (index < extent->fileCluster + extent->count) {
+					return extent;
+				}
+				continue;
+			}
+		}
+
+		if (!_FAT_fat_isValidCluster (partition, nextCluster)) {
+			// End of the chain
+			file->extentsComplete = true;
+			break;
+		}
+
+		if ((file->extentCount == file->extentCapacity) && !_FAT_file_growExtents (file)) {
+			// No room for another run
+			break;
+		}
+
+		extent = &file->extents[file->extentCount];
+		extent->fileCluster = (file->extentCount > 0) ? extent[-1].fileCluster + extent[-1].count : 0;
+		extent->cluster = nextCluster;
+		extent->count = 1;
+		file->extentCount++;
+
+		if (index < extent->fileCluster + extent->count) {
+			return extent;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+Get the last cluster of the file, using the extent map as far as it goes
+*/
+static uint32_t _FAT_file_lastCluster (FILE_STRUCT* file) {
+	FILE_EXTENT* extent;
+	uint32_t cluster;
+
+	_FAT_file_mapExtent (file, UINT32_MAX);
+	if (file->extentCount == 0) {
+		return _FAT_fat_lastCluster (file->partition, file->startCluster);
+	}
+
+	extent = &file->extents[file->extentCount - 1];
+	cluster = extent->cluster + extent->count - 1;
+	if (!file->extentsComplete) {
+		cluster = _FAT_fat_lastCluster (file->partition, cluster);
+	}
+	return cluster;
+}
+
+/*
+Get the cluster following cluster number index of the file, which is cluster.
+Only goes to the FAT when the extent map can't answer.
+*/
+static uint32_t _FAT_file_nextCluster (FILE_STRUCT* file, uint32_t cluster, uint32_t index) {
+	FILE_EXTENT* extent = _FAT_file_mapExtent (file, index);
+
+	if (extent && (extent->cluster + (index - extent->fileCluster) == cluster)) {
+		if (index + 1 < extent->fileCluster + extent->count) {
+			return cluster + 1;
+		}
+		// The run may have grown to take in the next cluster
+		extent = _FAT_file_mapExtent (file, index + 1);
+		if (extent) {
+			return extent->cluster + (index + 1 - extent->fileCluster);
+		}
+	}
+
+	return _FAT_fat_nextCluster (file->partition, cluster);
+}
+
 int _FAT_open_r (struct _reent *r, void *fileStruct, const char *path, int flags, int mode) {
 	PARTITION* partition = NULL;
 	bool fileExists;
@@ -204,6 +357,12 @@ int _FAT_open_r (struct _reent *r, void *fileStruct, const char *path, int flags
 	file->dirEntryStart = dirEntry.dataStart;		// Points to the start of the LFN entries of a file, or the alias for no LFN
 	file->dirEntryEnd = dirEntry.dataEnd;
 
+	// The cluster chain is mapped when first needed
+	file->extents = NULL;
+	file->extentCount = 0;
+	file->extentCapacity = 0;
+	file->extentsComplete = false;
+
 	// Reset read/write pointer
 	file->currentPosition = 0;
 	file->rwPosition.cluster = file->startCluster;
@@ -293,6 +452,9 @@ int _FAT_syncToDisc (FILE_STRUCT* file) {
 		if (!_FAT_cache_flush(file->partition->cache)) {
 			return EIO;
 		}
+
+		// Keep the free cluster count on disc in step with the FAT
+		_FAT_partition_writeFSinfo(file->partition);
 	}
 
 	file->modified = false;
@@ -321,6 +483,7 @@ int _FAT_close_r (struct _reent *r, void *fd) {
 	}
 
 	file->inUse = false;
+	_FAT_file_clearExtents (file);
 
 	// Remove this file from the double-linked list of open files
 	file->partition->openFileCount -= 1;
@@ -408,6 +571,11 @@ ssize_t _FAT_read_r (struct _reent *r, void *fd, char *ptr, size_t len) {
 		tempVar = remain >> partition->bytesPerSectorLog;
 	}
 
+	// A whole cluster is left to the loop below, so it can go in the same read as the ones after it
+	if ((position.sector == 0) && (tempVar == partition->sectorsPerCluster)) {
+		tempVar = 0;
+	}
+
 	if ((tempVar > 0) && flagNoError) {
 		if (! _FAT_cache_readSectors (cache, _FAT_fat_clusterToSector (partition, position.cluster) + position.sector,
 			tempVar, ptr))
@@ -424,7 +592,8 @@ ssize_t _FAT_read_r (struct _reent *r, void *fd, char *ptr, size_t len) {
 	// Move onto next cluster
 	// It should get to here without reading anything if a cluster is due to be allocated
 	if ((position.sector >= partition->sectorsPerCluster) && flagNoError) {
-		tempNextCluster = _FAT_fat_nextCluster(partition, position.cluster);
+		tempNextCluster = _FAT_file_nextCluster (file, position.cluster,
+			((file->currentPosition + (len - remain)) >> partition->bytesPerClusterLog) - 1);
 		if ((remain == 0) && (tempNextCluster == CLUSTER_EOF)) {
 			position.sector = partition->sectorsPerCluster;
 		} else if (!_FAT_fat_isValidCluster(partition, tempNextCluster)) {
@@ -441,16 +610,43 @@ ssize_t _FAT_read_r (struct _reent *r, void *fd, char *ptr, size_t len) {
 		uint32_t chunkEnd;
 		uint32_t nextChunkStart = position.cluster;
 		size_t chunkSize = 0;
+		uint32_t index = (file->currentPosition + (len - remain)) >> partition->bytesPerClusterLog;
+		FILE_EXTENT* extent;
+
+		// Map as far as this read goes first, so a run isn't cut short where the map stopped growing it
+		_FAT_file_mapExtent (file, index + (remain >> partition->bytesPerClusterLog) - 1);
+		extent = _FAT_file_mapExtent (file, index);
+
+		if (extent && (extent->cluster + (index - extent->fileCluster) == position.cluster)) {
+			// Take as much of the run as is wanted in one go
+			uint32_t clusters = extent->count - (index - extent->fileCluster);
+			if (clusters > (remain >> partition->bytesPerClusterLog)) {
+				clusters = remain >> partition->bytesPerClusterLog;
+			}
+#ifdef LIMIT_SECTORS
+			if (clusters > (LIMIT_SECTORS / partition->sectorsPerCluster)) {
+				clusters = LIMIT_SECTORS / partition->sectorsPerCluster;
+			}
+			if (clusters == 0) {
+				clusters = 1;
+			}
+#endif
+			chunkEnd = position.cluster + clusters - 1;
+			chunkSize = clusters << partition->bytesPerClusterLog;
 
-		do {
-			chunkEnd = nextChunkStart;
-			nextChunkStart = _FAT_fat_nextCluster (partition, chunkEnd);
-			chunkSize += partition->bytesPerClusterMask+1;
-		} while ((nextChunkStart == chunkEnd + 1) &&
+			nextChunkStart = _FAT_file_nextCluster (file, chunkEnd, index + clusters - 1);
+		} else {
+			// Past the extent map, follow the chain one cluster at a time
+			do {
+				chunkEnd = nextChunkStart;
+				nextChunkStart = _FAT_fat_nextCluster (partition, chunkEnd);
+				chunkSize += partition->bytesPerClusterMask+1;
+			} while ((nextChunkStart == chunkEnd + 1) &&
 #ifdef LIMIT_SECTORS
-		 	(chunkSize + partition->bytesPerClusterMask < LIMIT_SECTORS << partition->bytesPerSectorLog) &&
+			 	(chunkSize + partition->bytesPerClusterMask < LIMIT_SECTORS << partition->bytesPerSectorLog) &&
 #endif
-			(chunkSize + partition->bytesPerClusterMask < remain));
+				(chunkSize + partition->bytesPerClusterMask < remain));
+		}
 
 		if (!_FAT_cache_readSectors (cache, _FAT_fat_clusterToSector (partition, position.cluster),
 				chunkSize >> partition->bytesPerSectorLog, ptr))
@@ -565,7 +761,10 @@ static bool _FAT_file_extend_r (struct _reent *r, FILE_STRUCT* file) {
 	position.sector = (file->filesize & partition->bytesPerClusterMask) >> partition->bytesPerSectorLog;
 	// It is assumed that there is always a startCluster
 	// This will be true when _FAT_file_extend_r is called from _FAT_write_r
-	position.cluster = _FAT_fat_lastCluster (partition, file->startCluster);
+	position.cluster = _FAT_file_lastCluster (file);
+
+	// Clusters are about to be added to the chain
+	file->extentsComplete = false;
 
 	remain = file->currentPosition - file->filesize;
 
@@ -668,6 +867,9 @@ ssize_t _FAT_write_r (struct _reent *r, void *fd, const char *ptr, size_t len) {
 
 	remain = len;
 
+	// Clusters may be added to the end of the chain
+	file->extentsComplete = false;
+
 	// Get a new cluster for the start of the file if required
 	if (file->startCluster == CLUSTER_FREE) {
 		tempNextCluster = _FAT_fat_linkFreeCluster (partition, CLUSTER_FREE);
@@ -867,6 +1069,7 @@ off_t _FAT_seek_r (struct _reent *r, void *fd, off_t pos, int dir) {
 	PARTITION* partition;
 	uint32_t cluster, nextCluster;
 	int clusCount;
+	FILE_EXTENT* extent;
 	off_t newPosition;
 	uint32_t position;
 
@@ -917,26 +1120,44 @@ off_t _FAT_seek_r (struct _reent *r, void *fd, off_t pos, int dir) {
 		// Calculate where the correct cluster is
 		// how many clusters from start of file
 		clusCount = position >> partition->bytesPerClusterLog;
-		cluster = file->startCluster;
-		if (position >= file->currentPosition) {
-			// start from current cluster
-			int currentCount = file->currentPosition >> partition->bytesPerClusterLog;
-			if (file->rwPosition.sector == partition->sectorsPerCluster) {
-				currentCount--;
+		extent = _FAT_file_mapExtent (file, clusCount);
+		if (extent) {
+			cluster = extent->cluster + (clusCount - extent->fileCluster);
+			clusCount = 0;
+		} else {
+			// Past the extent map, start from the furthest cluster known
+			int knownCount = 0;
+			cluster = file->startCluster;
+			if (file->extentCount > 0) {
+				extent = &file->extents[file->extentCount - 1];
+				knownCount = extent->fileCluster + extent->count - 1;
+				cluster = extent->cluster + extent->count - 1;
+			}
+			if (position >= file->currentPosition) {
+				// start from current cluster
+				int currentCount = file->currentPosition >> partition->bytesPerClusterLog;
+				if (file->rwPosition.sector == partition->sectorsPerCluster) {
+					currentCount--;
+				}
+				if (currentCount > knownCount) {
+					knownCount = currentCount;
+					cluster = file->rwPosition.cluster;
+				}
 			}
-			clusCount -= currentCount;
-			cluster = file->rwPosition.cluster;
+			clusCount -= knownCount;
 		}
 		// Calculate the sector and byte of the current position,
 		// and store them
 		file->rwPosition.sector = (position & partition->bytesPerClusterMask) >> partition->bytesPerSectorLog;
 		file->rwPosition.byte = position & partition->bytesPerSectorMask;
 
-		nextCluster = _FAT_fat_nextCluster (partition, cluster);
-		while ((clusCount > 0) && (nextCluster != CLUSTER_FREE) && (nextCluster != CLUSTER_EOF)) {
+		while (clusCount > 0) {
+			nextCluster = _FAT_fat_nextCluster (partition, cluster);
+			if ((nextCluster == CLUSTER_FREE) || (nextCluster == CLUSTER_EOF)) {
+				break;
+			}
 			clusCount--;
 			cluster = nextCluster;
-			nextCluster = _FAT_fat_nextCluster (partition, cluster);
 		}
 
 		// Check if ran out of clusters and it needs to allocate a new one
@@ -1071,6 +1292,7 @@ int _FAT_ftruncate_r (struct _reent *r, void *fd, off_t len) {
 		// Shrinking the file
 		if (len == 0) {
 			// Cutting the file down to nothing, clear all clusters used
+			_FAT_file_clearExtents (file);
 			_FAT_fat_clearLinks (partition, file->startCluster);
 			file->startCluster = CLUSTER_FREE;
 
@@ -1086,6 +1308,7 @@ int _FAT_ftruncate_r (struct _reent *r, void *fd, off_t len) {
 			// If the end falls on a cluster boundary, drop that cluster too,
 			// then set a flag to allocate a cluster as needed
 			chainLength = ((newSize-1) >> partition->bytesPerClusterLog) + 1;
+			_FAT_file_clearExtents (file);
 			lastCluster = _FAT_fat_trimChain (partition, file->startCluster, chainLength);
 
 			if (file->append) {
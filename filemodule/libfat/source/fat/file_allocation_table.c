@@ -31,8 +31,64 @@
 #include "file_allocation_table.h"
 #include "partition.h"
 #include "mem_allocate.h"
+#include "bit_ops.h"
 #include <string.h>
 
+/*
+The free cluster map only records which groups of clusters are full, so it
+stays small on big discs. A clear bit means the group may have a free cluster.
+*/
+static inline bool _FAT_fat_isGroupFull (PARTITION* partition, uint32_t cluster) {
+	uint32_t group = cluster >> partition->fat.groupShift;
+
+	if (partition->fat.fullGroups == NULL) {
+		return false;
+	}
+	return (partition->fat.fullGroups[group >> 5] >> (group & 31)) & 1;
+}
+
+static inline void _FAT_fat_setGroupFull (PARTITION* partition, uint32_t cluster, bool full) {
+	uint32_t group = cluster >> partition->fat.groupShift;
+
+	if (partition->fat.fullGroups == NULL) {
+		return;
+	}
+	if (full) {
+		partition->fat.fullGroups[group >> 5] |= 1 << (group & 31);
+	} else {
+		partition->fat.fullGroups[group >> 5] &= ~(1 << (group & 31));
+	}
+}
+
+/*
+Allocate the free cluster map, with every group possibly free.
+Allocation still works without it, just more slowly.
+*/
+bool _FAT_fat_createFreeMap (PARTITION* partition) {
+	uint32_t groups;
+
+	partition->fat.groupShift = 0;
+	while (((partition->fat.lastCluster >> partition->fat.groupShift) + 1) > FAT_FREE_MAP_GROUPS) {
+		partition->fat.groupShift++;
+	}
+	groups = (partition->fat.lastCluster >> partition->fat.groupShift) + 1;
+
+	partition->fat.fullGroups = (uint32_t*) _FAT_mem_allocate (((groups + 31) >> 5) * sizeof(uint32_t));
+	if (partition->fat.fullGroups == NULL) {
+		return false;
+	}
+	memset (partition->fat.fullGroups, 0, ((groups + 31) >> 5) * sizeof(uint32_t));
+
+	return true;
+}
+
+void _FAT_fat_destroyFreeMap (PARTITION* partition) {
+	if (partition->fat.fullGroups) {
+		_FAT_mem_free (partition->fat.fullGroups);
+	}
+	partition->fat.fullGroups = NULL;
+}
+
 /*
 Gets the cluster linked from input cluster
 */
@@ -129,6 +185,10 @@ static bool _FAT_fat_writeFatEntry (PARTITION* partition, uint32_t cluster, uint
 		return false;
 	}
 
+	if (value == CLUSTER_FREE) {
+		_FAT_fat_setGroupFull (partition, cluster, false);
+	}
+
 	switch (partition->filesysType)
 	{
 		case FS_UNKNOWN:
@@ -198,6 +258,60 @@ static bool _FAT_fat_writeFatEntry (PARTITION* partition, uint32_t cluster, uint
 	return true;
 }
 
+/*
+Find a free cluster, searching from firstFree to the end of the FAT and then
+from the start of it. Groups of clusters that are known to be full are skipped,
+and groups that turn out to be full are remembered.
+If there are no free clusters, return CLUSTER_ERROR
+*/
+static uint32_t _FAT_fat_findFreeCluster (PARTITION* partition) {
+	uint32_t firstFree;
+	uint32_t lastCluster;
+	uint32_t groupStart, groupEnd;
+	uint32_t curCluster;
+	bool loopedAroundFAT = false;
+
+	lastCluster = partition->fat.lastCluster;
+
+	// Start at first valid cluster
+	firstFree = partition->fat.firstFree;
+	if ((firstFree < CLUSTER_FIRST) || (firstFree > lastCluster)) {
+		firstFree = CLUSTER_FIRST;
+	}
+
+	while (true) {
+		groupStart = (firstFree >> partition->fat.groupShift) << partition->fat.groupShift;
+		groupEnd = groupStart + (1 << partition->fat.groupShift) - 1;
+		if (groupEnd > lastCluster) {
+			groupEnd = lastCluster;
+		}
+
+		if (!_FAT_fat_isGroupFull (partition, firstFree)) {
+			for (curCluster = firstFree; curCluster <= groupEnd; curCluster++) {
+				if (_FAT_fat_nextCluster (partition, curCluster) == CLUSTER_FREE) {
+					return curCluster;
+				}
+			}
+			// Only mark the group if all of it was searched
+			if ((firstFree <= groupStart) || (firstFree == CLUSTER_FIRST)) {
+				_FAT_fat_setGroupFull (partition, firstFree, true);
+			}
+		}
+
+		firstFree = groupEnd + 1;
+		if (firstFree > lastCluster) {
+			if (loopedAroundFAT) {
+				// If couldn't get a free cluster then return an error
+				return CLUSTER_ERROR;
+			}
+			// Try looping back to the beginning of the FAT
+			// This was suggested by loopy
+			firstFree = CLUSTER_FIRST;
+			loopedAroundFAT = true;
+		}
+	}
+}
+
 /*-----------------------------------------------------------------
 gets the first available free cluster, sets it
 to end of file, links the input cluster to it then returns the
@@ -208,7 +322,6 @@ uint32_t _FAT_fat_linkFreeCluster(PARTITION* partition, uint32_t cluster) {
 	uint32_t firstFree;
 	uint32_t curLink;
 	uint32_t lastCluster;
-	bool loopedAroundFAT = false;
 
 	lastCluster =  partition->fat.lastCluster;
 
@@ -222,33 +335,23 @@ uint32_t _FAT_fat_linkFreeCluster(PARTITION* partition, uint32_t cluster) {
 		return curLink;	// Return the current link - don't allocate a new one
 	}
 
-	// Get a free cluster
-	firstFree = partition->fat.firstFree;
-	// Start at first valid cluster
-	if (firstFree < CLUSTER_FIRST) {
-		firstFree = CLUSTER_FIRST;
-	}
-
-	// Search until a free cluster is found
-	while (_FAT_fat_nextCluster(partition, firstFree) != CLUSTER_FREE) {
-		firstFree++;
-		if (firstFree > lastCluster) {
-			if (loopedAroundFAT) {
-				// If couldn't get a free cluster then return an error
-				partition->fat.firstFree = firstFree;
-				return CLUSTER_ERROR;
-			} else {
-				// Try looping back to the beginning of the FAT
-				// This was suggested by loopy
-				firstFree = CLUSTER_FIRST;
-				loopedAroundFAT = true;
-			}
+	// Get a free cluster, carrying on from the end of the chain when possible
+	// so that large files are written in contiguous runs
+	if ((cluster >= CLUSTER_FIRST) && (cluster < lastCluster) &&
+		(_FAT_fat_nextCluster(partition, cluster + 1) == CLUSTER_FREE))
+	{
+		firstFree = cluster + 1;
+	} else {
+		firstFree = _FAT_fat_findFreeCluster(partition);
+		if (firstFree == CLUSTER_ERROR) {
+			return CLUSTER_ERROR;
 		}
+		partition->fat.firstFree = firstFree;
 	}
-	partition->fat.firstFree = firstFree;
 	if(partition->fat.numberFreeCluster)
 		partition->fat.numberFreeCluster--;
 	partition->fat.numberLastAllocCluster = firstFree;
+	partition->fat.fsInfoDirty = true;
 
 	if ((cluster >= CLUSTER_FIRST) && (cluster <= lastCluster))
 	{
@@ -321,6 +424,7 @@ bool _FAT_fat_clearLinks (PARTITION* partition, uint32_t cluster) {
 
 		if(partition->fat.numberFreeCluster < (partition->numberOfSectors/partition->sectorsPerCluster))
 			partition->fat.numberFreeCluster++;
+		partition->fat.fsInfoDirty = true;
 		// Move onto next cluster
 		cluster = nextCluster;
 	}
@@ -379,15 +483,72 @@ uint32_t _FAT_fat_lastCluster (PARTITION* partition, uint32_t cluster) {
 /*-----------------------------------------------------------------
 _FAT_fat_freeClusterCount
 Return the number of free clusters available
+FAT16 and FAT32 tables are read straight from disc several sectors at a
+time rather than entry by entry through the cache. The free cluster map
+is brought up to date on the way.
 -----------------------------------------------------------------*/
 unsigned int _FAT_fat_freeClusterCount (PARTITION* partition) {
 	unsigned int count = 0;
+	unsigned int groupCount = 0;
 	uint32_t curCluster;
+	uint32_t entry;
+	uint8_t* buffer = NULL;
+	sec_t bufferSector = 0;
+	sec_t numSectors;
+	uint32_t offset = 0;
+	int entryLog = (partition->filesysType == FS_FAT32) ? 2 : 1;
+
+	if ((partition->filesysType == FS_FAT16) || (partition->filesysType == FS_FAT32)) {
+		buffer = (uint8_t*) _FAT_mem_align (FAT_SCAN_SECTORS << partition->bytesPerSectorLog);
+		// The cache has to be written out for the FAT on disc to be current
+		if (buffer && !_FAT_cache_flush(partition->cache)) {
+			_FAT_mem_free (buffer);
+			buffer = NULL;
+		}
+	}
 
 	for (curCluster = CLUSTER_FIRST; curCluster <= partition->fat.lastCluster; curCluster++) {
-		if (_FAT_fat_nextCluster(partition, curCluster) == CLUSTER_FREE) {
+		if (buffer) {
+			offset = curCluster << entryLog;
+			if ((curCluster == CLUSTER_FIRST) ||
+				((offset >> partition->bytesPerSectorLog) >= bufferSector + FAT_SCAN_SECTORS))
+			{
+				bufferSector = offset >> partition->bytesPerSectorLog;
+				numSectors = partition->fat.sectorsPerFat - bufferSector;
+				if (numSectors > FAT_SCAN_SECTORS) {
+					numSectors = FAT_SCAN_SECTORS;
+				}
+				if (!_FAT_disc_readSectors (partition->disc, partition->fat.fatStart + bufferSector, numSectors, buffer)) {
+					// Carry on through the cache instead
+					_FAT_mem_free (buffer);
+					buffer = NULL;
+				}
+			}
+		}
+
+		if (buffer) {
+			offset -= bufferSector << partition->bytesPerSectorLog;
+			entry = (entryLog == 2) ? u8array_to_u32 (buffer, offset) : u8array_to_u16 (buffer, offset);
+		} else {
+			entry = _FAT_fat_nextCluster(partition, curCluster);
+		}
+
+		if (entry == CLUSTER_FREE) {
 			count++;
+			groupCount++;
 		}
+
+		// At the end of each group, record whether it was full
+		if ((curCluster == partition->fat.lastCluster) ||
+			(((curCluster + 1) >> partition->fat.groupShift) != (curCluster >> partition->fat.groupShift)))
+		{
+			_FAT_fat_setGroupFull (partition, curCluster, groupCount == 0);
+			groupCount = 0;
+		}
+	}
+
+	if (buffer) {
+		_FAT_mem_free (buffer);
 	}
 
 	return count;
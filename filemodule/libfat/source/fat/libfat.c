@@ -168,6 +168,7 @@ void fatSync (const char* name) {
 	partition = (PARTITION*)devops->deviceData;
 	if (partition->cache)
 		_FAT_cache_flush(partition->cache);
+	_FAT_partition_writeFSinfo(partition);
 }
 
 bool fatInit (uint32_t cacheSize, bool setAsDefaultDevice) {
@@ -353,6 +353,7 @@ PARTITION* _FAT_partition_constructor_buf (const DISC_INTERFACE* disc, uint32_t
 	partition->fat.firstFree = CLUSTER_FIRST;
 	partition->fat.numberFreeCluster = 0;
 	partition->fat.numberLastAllocCluster = 0;
+	partition->fat.fsInfoDirty = false;
 
 	if (clusterCount < CLUSTERS_PER_FAT12) {
 		partition->filesysType = FS_FAT12;	// FAT12 volume
@@ -387,6 +388,12 @@ PARTITION* _FAT_partition_constructor_buf (const DISC_INTERFACE* disc, uint32_t
 	partition->openFileCount = 0;
 	partition->firstOpenFile = NULL;
 
+	// Start with every cluster group possibly free, it is filled in by searching
+	_FAT_fat_createFreeMap(partition);
+
+	// Nothing has been looked up yet
+	_FAT_directory_createLookupCache(partition);
+
 	_FAT_partition_readFSinfo(partition);
 
 	return partition;
@@ -421,6 +428,10 @@ void _FAT_partition_destructor (PARTITION* partition) {
 	// Free memory used by the cache, writing it to disc at the same time
 	_FAT_cache_destructor (partition->cache);
 
+	_FAT_fat_destroyFreeMap (partition);
+
+	_FAT_directory_destroyLookupCache (partition);
+
 	// Unlock the partition and destroy the lock
 	_FAT_unlock(&partition->lock);
 	_FAT_lock_deinit(&partition->lock);
@@ -464,7 +475,8 @@ void _FAT_partition_createFSinfo(PARTITION * partition)
 	sectorBuffer[FSIB_bootSig_55] = 0x55;
 	sectorBuffer[FSIB_bootSig_AA] = 0xAA;
 
-	_FAT_disc_writeSectors (partition->disc, partition->fsInfoSector, 1, sectorBuffer);
+	if (_FAT_disc_writeSectors (partition->disc, partition->fsInfoSector, 1, sectorBuffer))
+		partition->fat.fsInfoDirty = false;
 
 	_FAT_mem_free(sectorBuffer);
 }
@@ -472,7 +484,11 @@ void _FAT_partition_createFSinfo(PARTITION * partition)
 void _FAT_partition_readFSinfo(PARTITION * partition)
 {
 	if(partition->filesysType != FS_FAT32)
+	{
+		// No fs info sector, so count the free clusters once and keep track from then on
+		partition->fat.numberFreeCluster = _FAT_fat_freeClusterCount(partition);
 		return;
+	}
 
 	uint8_t *sectorBuffer = (uint8_t*) _FAT_mem_align(partition->bytesPerSectorMask+1);
 	if (!sectorBuffer) return;
@@ -485,20 +501,25 @@ void _FAT_partition_readFSinfo(PARTITION * partition)
 
 	if(memcmp(sectorBuffer+FSIB_SIG1, FS_INFO_SIG1, 4) != 0 ||
 		memcmp(sectorBuffer+FSIB_SIG2, FS_INFO_SIG2, 4) != 0 ||
-		u8array_to_u32(sectorBuffer, FSIB_numberOfFreeCluster) == 0)
+		u8array_to_u32(sectorBuffer, FSIB_numberOfFreeCluster) == 0 ||
+		u8array_to_u32(sectorBuffer, FSIB_numberOfFreeCluster) > partition->fat.lastCluster - CLUSTER_FIRST + 1)
 	{
-		//sector does not yet exist, create one!
+		//sector does not yet exist or the count is unknown (0xFFFFFFFF), create one!
 		_FAT_partition_createFSinfo(partition);
 	} else {
 		partition->fat.numberFreeCluster = u8array_to_u32(sectorBuffer, FSIB_numberOfFreeCluster);
 		partition->fat.numberLastAllocCluster = u8array_to_u32(sectorBuffer, FSIB_numberLastAllocCluster);
+		// Start looking for free clusters after the last one allocated, instead of
+		// going through the whole of the used part of the FAT on the first write
+		if (_FAT_fat_isValidCluster(partition, partition->fat.numberLastAllocCluster))
+			partition->fat.firstFree = partition->fat.numberLastAllocCluster;
 	}
 	_FAT_mem_free(sectorBuffer);
 }
 
 void _FAT_partition_writeFSinfo(PARTITION * partition)
 {
-	if(partition->filesysType != FS_FAT32)
+	if(partition->filesysType != FS_FAT32 || !partition->fat.fsInfoDirty)
 		return;
 
 	uint8_t *sectorBuffer = (uint8_t*) _FAT_mem_align(partition->bytesPerSectorMask+1);
@@ -519,6 +540,7 @@ void _FAT_partition_writeFSinfo(PARTITION * partition)
 	u32_to_u8array(sectorBuffer, FSIB_numberLastAllocCluster, partition->fat.numberLastAllocCluster);
 
 	// Write first sector of disc
-	_FAT_disc_writeSectors (partition->disc, partition->fsInfoSector, 1, sectorBuffer);
+	if (_FAT_disc_writeSectors (partition->disc, partition->fsInfoSector, 1, sectorBuffer))
+		partition->fat.fsInfoDirty = false;
 	_FAT_mem_free(sectorBuffer);
 }
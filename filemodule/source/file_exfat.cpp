@@ -0,0 +1,1406 @@
+#include "file_exfat.h"
+
+#include <fcntl.h>
+#include <time.h>
+
+namespace ProxiIOS { namespace Filesystem {
+
+static const char __exfatName[] = "exfat";
+static const char __exfatSignature[] = "EXFAT   ";
+
+static inline u16 Get16(const u8* data) { return data[0] | (data[1] << 8); }
+static inline u32 Get32(const u8* data) { return Get16(data) | (Get16(data + 2) << 16); }
+static inline u64 Get64(const u8* data) { return Get32(data) | ((u64)Get32(data + 4) << 32); }
+static inline void Set16(u8* data, u16 value) { data[0] = value; data[1] = value >> 8; }
+static inline void Set32(u8* data, u32 value) { Set16(data, value); Set16(data + 2, value >> 16); }
+static inline void Set64(u8* data, u64 value) { Set32(data, value); Set32(data + 4, value >> 32); }
+
+// Same rule as libfat: only 32-byte aligned MEM2 buffers can be handed to the disc
+static inline bool DirectBuffer(const void* buffer) {
+	return (u32)buffer >= 0x10000000 && ((u32)buffer & 0x1F) == 0;
+}
+
+static u64 HexToInt(const char* hex, int length)
+{
+	u64 ret = 0;
+	for (int i = 0; i < length; i++)
+		ret = (ret << 4) + hex[i] - ((hex[i] > '9') ? ('a' - 10) : '0');
+	return ret;
+}
+
+// MS-DOS style date and time, as used by exFAT timestamps
+static u32 Timestamp()
+{
+	struct tm parts;
+	time_t epoch;
+
+	if (time(&epoch) == (time_t)-1)
+		return 0;
+	localtime_r(&epoch, &parts);
+	if (parts.tm_year < 80)
+		return 0;
+
+	return ((parts.tm_year - 80) << 25) | ((parts.tm_mon + 1) << 21) | (parts.tm_mday << 16) |
+		(parts.tm_hour << 11) | (parts.tm_min << 5) | (parts.tm_sec >> 1);
+}
+
+static u16 SetChecksum(const u8* set, u32 count)
+{
+	u16 sum = 0;
+	for (u32 i = 0; i < count * EXFAT_ENTRY_SIZE; i++) {
+		if (i == 2 || i == 3)
+			continue;
+		sum = ((sum & 1) ? 0x8000 : 0) + (sum >> 1) + set[i];
+	}
+	return sum;
+}
+
+// Converts the name entries of the set in SetBuffer to UTF-8
+static void NameToUtf8(char* dest, const u8* set)
+{
+	u32 length = MIN(set[EXFAT_ENTRY_SIZE + 3], (set[1] - 1) * 15);
+	for (u32 i = 0; i < length; i++) {
+		u32 c = Get16(set + 2 * EXFAT_ENTRY_SIZE + (i / 15) * EXFAT_ENTRY_SIZE + 2 + (i % 15) * 2);
+		if (c >= 0xD800 && c < 0xDC00 && i + 1 < length) {
+			i++;
+			u32 low = Get16(set + 2 * EXFAT_ENTRY_SIZE + (i / 15) * EXFAT_ENTRY_SIZE + 2 + (i % 15) * 2);
+			c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+		}
+		if (c < 0x80)
+			*dest++ = c;
+		else if (c < 0x800) {
+			*dest++ = 0xC0 | (c >> 6);
+			*dest++ = 0x80 | (c & 0x3F);
+		} else if (c < 0x10000) {
+			*dest++ = 0xE0 | (c >> 12);
+			*dest++ = 0x80 | ((c >> 6) & 0x3F);
+			*dest++ = 0x80 | (c & 0x3F);
+		} else {
+			*dest++ = 0xF0 | (c >> 18);
+			*dest++ = 0x80 | ((c >> 12) & 0x3F);
+			*dest++ = 0x80 | ((c >> 6) & 0x3F);
+			*dest++ = 0x80 | (c & 0x3F);
+		}
+	}
+	*dest = '\0';
+}
+
+ExfatHandler::~ExfatHandler()
+{
+	Dealloc(Upcase);
+	Dealloc(CacheData);
+	Dealloc(Bounce);
+	delete[] Cache;
+}
+
+u8* ExfatHandler::CacheSector(u32 sector, bool dirty)
+{
+	ExfatCacheEntry* victim = Cache;
+	for (u32 i = 0; i < CacheCount; i++) {
+		ExfatCacheEntry* entry = Cache + i;
+		if (entry->LastUse && entry->Sector == sector) {
+			entry->LastUse = ++CacheClock;
+			entry->Dirty |= dirty;
+			return entry->Data;
+		}
+		if (entry->LastUse < victim->LastUse)
+			victim = entry;
+	}
+
+	DISC_INTERFACE* disk = Module->Disk[phys];
+	if (victim->Dirty && !disk->writeSectors(victim->Sector, 1, victim->Data))
+		return NULL;
+	victim->Dirty = false;
+	if (!disk->readSectors(sector, 1, victim->Data)) {
+		victim->LastUse = 0;
+		return NULL;
+	}
+	victim->Sector = sector;
+	victim->LastUse = ++CacheClock;
+	victim->Dirty = dirty;
+	return victim->Data;
+}
+
+bool ExfatHandler::CacheFlush()
+{
+	return CacheWriteBack(0, 0xFFFFFFFF);
+}
+
+void ExfatHandler::CacheDiscard(u32 sector, u32 count)
+{
+	for (u32 i = 0; i < CacheCount; i++) {
+		if (Cache[i].LastUse && Cache[i].Sector - sector < count) {
+			Cache[i].LastUse = 0;
+			Cache[i].Dirty = false;
+		}
+	}
+}
+
+bool ExfatHandler::CacheWriteBack(u32 sector, u32 count)
+{
+	DISC_INTERFACE* disk = Module->Disk[phys];
+	for (u32 i = 0; i < CacheCount; i++) {
+		if (Cache[i].Dirty && Cache[i].Sector - sector < count) {
+			if (!disk->writeSectors(Cache[i].Sector, 1, Cache[i].Data))
+				return false;
+			Cache[i].Dirty = false;
+		}
+	}
+	return true;
+}
+
+bool ExfatHandler::DiscRead(u32 sector, u32 count, u8* buffer)
+{
+	DISC_INTERFACE* disk = Module->Disk[phys];
+
+	// the disc has to see anything still dirty in the cache first
+	if (!CacheWriteBack(sector, count))
+		return false;
+
+	bool direct = DirectBuffer(buffer);
+	while (count) {
+		u32 sectors = MIN(count, direct ? EXFAT_MAX_TRANSFER : CacheCount);
+		if (!disk->readSectors(sector, sectors, direct ? buffer : Bounce))
+			return false;
+		if (!direct)
+			memcpy(buffer, Bounce, sectors << SectorShift);
+		sector += sectors;
+		count -= sectors;
+		buffer += sectors << SectorShift;
+	}
+	return true;
+}
+
+// Writes whole sectors, or zeros when buffer is NULL
+bool ExfatHandler::DiscWrite(u32 sector, u32 count, const u8* buffer)
+{
+	DISC_INTERFACE* disk = Module->Disk[phys];
+
+	CacheDiscard(sector, count);
+
+	bool direct = buffer && DirectBuffer(buffer);
+	if (!buffer)
+		memset(Bounce, 0, CacheCount << SectorShift);
+	while (count) {
+		u32 sectors = MIN(count, direct ? EXFAT_MAX_TRANSFER : CacheCount);
+		if (buffer && !direct)
+			memcpy(Bounce, buffer, sectors << SectorShift);
+		if (!disk->writeSectors(sector, sectors, direct ? buffer : Bounce))
+			return false;
+		sector += sectors;
+		count -= sectors;
+		if (buffer)
+			buffer += sectors << SectorShift;
+	}
+	return true;
+}
+
+bool ExfatHandler::ZeroCluster(u32 cluster)
+{
+	return DiscWrite(ClusterSector(cluster), 1 << ClusterShift, NULL);
+}
+
+u32 ExfatHandler::NextCluster(u32 cluster)
+{
+	u32 shift = SectorShift - 2;
+	u8* data = CacheSector(FatStart + (cluster >> shift), false);
+	if (!data)
+		return 0;
+	return Get32(data + ((cluster & ((1 << shift) - 1)) << 2));
+}
+
+bool ExfatHandler::SetNextCluster(u32 cluster, u32 next)
+{
+	u32 shift = SectorShift - 2;
+	u8* data = CacheSector(FatStart + (cluster >> shift), true);
+	if (!data)
+		return false;
+	Set32(data + ((cluster & ((1 << shift) - 1)) << 2), next);
+	return true;
+}
+
+/*
+Returns the cluster at an index into a chain, or 0 past its end. Contiguous
+(NoFatChain) chains are plain arithmetic; FAT chains are walked from the
+last lookup so sequential access only reads each FAT sector once.
+*/
+u32 ExfatHandler::ClusterAt(ExfatChain* chain, u32 index)
+{
+	if (index >= chain->Clusters)
+		return 0;
+
+	if (chain->Contiguous) {
+		u32 cluster = chain->First + index;
+		return ValidCluster(cluster) ? cluster : 0;
+	}
+
+	if (!chain->CursorCluster || index < chain->CursorIndex) {
+		chain->CursorIndex = 0;
+		chain->CursorCluster = chain->First;
+	}
+	while (chain->CursorIndex < index) {
+		u32 next = NextCluster(chain->CursorCluster);
+		if (!ValidCluster(next))
+			return 0;
+		chain->CursorCluster = next;
+		chain->CursorIndex++;
+	}
+	return ValidCluster(chain->CursorCluster) ? chain->CursorCluster : 0;
+}
+
+// Returns the cached bitmap sector holding a cluster's bit
+u8* ExfatHandler::BitmapSector(u32 cluster, bool dirty)
+{
+	u32 offset = (cluster - EXFAT_CLUSTER_FIRST) >> 3;
+	u32 bitmapCluster = ClusterAt(&Bitmap, offset >> ClusterBytesShift);
+	if (!bitmapCluster)
+		return NULL;
+	return CacheSector(ClusterSector(bitmapCluster) + ((offset >> SectorShift) & ((1 << ClusterShift) - 1)), dirty);
+}
+
+bool ExfatHandler::BitmapTest(u32 cluster)
+{
+	u8* data = BitmapSector(cluster, false);
+	if (!data)
+		return true;
+	u32 bit = (cluster - EXFAT_CLUSTER_FIRST) & ((8 << SectorShift) - 1);
+	return data[bit >> 3] & (1 << (bit & 7));
+}
+
+bool ExfatHandler::BitmapSet(u32 cluster, u32 count, bool used)
+{
+	u32 mask = (8 << SectorShift) - 1;
+	while (count) {
+		u8* data = BitmapSector(cluster, true);
+		if (!data)
+			return false;
+		for (u32 bit = (cluster - EXFAT_CLUSTER_FIRST) & mask; count && bit <= mask; bit++, cluster++, count--) {
+			u8 flag = 1 << (bit & 7);
+			if (!(data[bit >> 3] & flag) == !used)
+				continue;
+			data[bit >> 3] ^= flag;
+			if (FreeClusters >= 0)
+				FreeClusters += used ? -1 : 1;
+		}
+	}
+	return true;
+}
+
+// Counts free clusters starting at cluster, up to max
+u32 ExfatHandler::FreeRun(u32 cluster, u32 max)
+{
+	u32 mask = (8 << SectorShift) - 1;
+	u32 run = 0;
+	while (run < max && ValidCluster(cluster)) {
+		u8* data = BitmapSector(cluster, false);
+		if (!data)
+			break;
+		for (u32 bit = (cluster - EXFAT_CLUSTER_FIRST) & mask; bit <= mask && run < max && ValidCluster(cluster); bit++, cluster++, run++) {
+			if (data[bit >> 3] & (1 << (bit & 7)))
+				return run;
+		}
+	}
+	return run;
+}
+
+/*
+Scans the allocation bitmap from hint for the first free run that can hold
+count clusters, skipping fully allocated bytes. When nothing is that long
+the largest run seen is returned instead. Returns 0 when the volume is full.
+*/
+u32 ExfatHandler::FindFree(u32 hint, u32 count, u32* length)
+{
+	u32 mask = (8 << SectorShift) - 1;
+	u32 run = 0, start = 0;
+	u32 best = 0, bestStart = 0;
+	u32 cluster = ValidCluster(hint) ? hint : EXFAT_CLUSTER_FIRST;
+
+	for (u32 scanned = 0; scanned < ClusterCount; ) {
+		if (!ValidCluster(cluster)) {
+			cluster = EXFAT_CLUSTER_FIRST;
+			run = 0;
+		}
+		u8* data = BitmapSector(cluster, false);
+		if (!data)
+			break;
+		u32 bit = (cluster - EXFAT_CLUSTER_FIRST) & mask;
+		u32 end = MIN(mask + 1, bit + ClusterCount + EXFAT_CLUSTER_FIRST - cluster);
+		for (; bit < end && scanned < ClusterCount; bit++, cluster++, scanned++) {
+			if (!(bit & 7) && end - bit >= 8 && data[bit >> 3] == 0xFF) {
+				run = 0;
+				bit += 7;
+				cluster += 7;
+				scanned += 7;
+				continue;
+			}
+			if (data[bit >> 3] & (1 << (bit & 7))) {
+				run = 0;
+				continue;
+			}
+			if (!run++)
+				start = cluster;
+			if (run > best) {
+				best = run;
+				bestStart = start;
+				if (run >= count) {
+					*length = run;
+					return start;
+				}
+			}
+		}
+	}
+
+	*length = best;
+	return best ? bestStart : 0;
+}
+
+u32 ExfatHandler::CountFree()
+{
+	static const u8 zeros[0x10] = { 4, 3, 3, 2, 3, 2, 2, 1, 3, 2, 2, 1, 2, 1, 1, 0 };
+	u32 mask = (8 << SectorShift) - 1;
+	u32 free = 0;
+
+	for (u32 cluster = EXFAT_CLUSTER_FIRST; ValidCluster(cluster); ) {
+		u8* data = BitmapSector(cluster, false);
+		if (!data)
+			return 0;
+		u32 bits = MIN(mask + 1, ClusterCount + EXFAT_CLUSTER_FIRST - cluster);
+		u32 bit;
+		for (bit = 0; bit + 8 <= bits; bit += 8)
+			free += zeros[data[bit >> 3] & 0x0F] + zeros[data[bit >> 3] >> 4];
+		for (; bit < bits; bit++)
+			free += !(data[bit >> 3] & (1 << (bit & 7)));
+		cluster += bits;
+	}
+	return free;
+}
+
+/*
+Grows a chain by count clusters. The clusters straight after the chain are
+taken when free, so a file written sequentially stays contiguous and keeps
+its NoFatChain flag without a single FAT write. Only when the chain has to
+jump elsewhere is it converted to a real FAT chain.
+*/
+bool ExfatHandler::Extend(ExfatChain* chain, u32 count)
+{
+	while (count) {
+		u32 last = chain->Clusters ? LastCluster(chain) : 0;
+		u32 start = 0, run = 0;
+
+		if (last) {
+			run = FreeRun(last + 1, count);
+			if (run)
+				start = last + 1;
+		} else if (chain->Clusters)
+			return false;
+		if (!run) {
+			start = FindFree(last ? last + 1 : NextFree, count, &run);
+			if (!start)
+				return false;
+			run = MIN(run, count);
+		}
+		if (!BitmapSet(start, run, true))
+			return false;
+
+		if (!chain->Clusters) {
+			chain->First = start;
+			chain->Contiguous = true;
+		} else if (chain->Contiguous && start != last + 1) {
+			for (u32 cluster = chain->First; cluster < last; cluster++) {
+				if (!SetNextCluster(cluster, cluster + 1))
+					return false;
+			}
+			chain->Contiguous = false;
+		}
+		if (!chain->Contiguous) {
+			if (last && !SetNextCluster(last, start))
+				return false;
+			for (u32 i = 0; i < run; i++) {
+				if (!SetNextCluster(start + i, i + 1 < run ? start + i + 1 : EXFAT_CLUSTER_EOF))
+					return false;
+			}
+		}
+
+		chain->Clusters += run;
+		count -= run;
+		NextFree = start + run;
+	}
+	return true;
+}
+
+bool ExfatHandler::FreeChain(ExfatChain* chain)
+{
+	if (chain->Contiguous) {
+		if (chain->Clusters && !BitmapSet(chain->First, chain->Clusters, false))
+			return false;
+	} else {
+		u32 cluster = chain->First;
+		for (u32 i = 0; i < chain->Clusters && ValidCluster(cluster); i++) {
+			u32 next = NextCluster(cluster);
+			if (!BitmapSet(cluster, 1, false))
+				return false;
+			cluster = next;
+		}
+	}
+
+	chain->First = 0;
+	chain->Clusters = 0;
+	chain->Contiguous = true;
+	chain->CursorCluster = 0;
+	return true;
+}
+
+u16 ExfatHandler::UpCase(u16 c)
+{
+	if (c < 0x80)
+		return UpcaseAscii[c];
+
+	u32 low = 0, high = UpcaseCount;
+	while (low < high) {
+		u32 middle = (low + high) / 2;
+		if (Upcase[middle * 2] == c)
+			return Upcase[middle * 2 + 1];
+		if (Upcase[middle * 2] < c)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return c;
+}
+
+/*
+The volume's up-case table is stored compressed, with runs of identity
+mappings collapsed. Only the mappings that actually change a character are
+kept (around a thousand for the standard table), so case folding costs a
+few KB of the module heap instead of 128 KB for a flat table.
+*/
+bool ExfatHandler::LoadUpcase(u32 cluster, u64 length, u32 checksum)
+{
+	ExfatChain chain = { cluster, (u32)((length + (1 << ClusterBytesShift) - 1) >> ClusterBytesShift), false, 0, 0 };
+	u32 sectorMask = (1 << SectorShift) - 1;
+
+	for (int pass = 0; pass < 2; pass++) {
+		u32 sum = 0, count = 0, c = 0;
+		bool skip = false;
+		u8* data = NULL;
+
+		for (u32 offset = 0; offset + 1 < length && c < 0x10000; offset += 2) {
+			if (!data || !(offset & sectorMask)) {
+				u32 index = ClusterAt(&chain, offset >> ClusterBytesShift);
+				if (!index || !(data = CacheSector(ClusterSector(index) + ((offset >> SectorShift) & ((1 << ClusterShift) - 1)), false)))
+					return false;
+			}
+			const u8* value = data + (offset & sectorMask);
+			for (int i = 0; i < 2 && !pass; i++)
+				sum = ((sum & 1) ? 0x80000000 : 0) + (sum >> 1) + value[i];
+
+			u16 mapped = Get16(value);
+			if (skip) {
+				c += mapped;
+				skip = false;
+			} else if (mapped == 0xFFFF)
+				skip = true;
+			else {
+				if (mapped != c) {
+					if (pass) {
+						Upcase[count * 2] = c;
+						Upcase[count * 2 + 1] = mapped;
+					}
+					count++;
+				}
+				c++;
+			}
+		}
+
+		if (!pass) {
+			if (sum != checksum || !count)
+				return false;
+			Upcase = (u16*)Alloc(count * 2 * sizeof(u16));
+			if (!Upcase)
+				return false;
+			UpcaseCount = count;
+		}
+	}
+
+	for (u32 i = 0; i < UpcaseCount && Upcase[i * 2] < 0x80; i++)
+		UpcaseAscii[Upcase[i * 2]] = Upcase[i * 2 + 1];
+	return true;
+}
+
+// Converts a UTF-8 path component into Component
+bool ExfatHandler::SetName(const char* name, int length)
+{
+	ComponentLength = 0;
+	for (int i = 0; i < length; ) {
+		u32 c = (u8)name[i++];
+		int extra = 0;
+		if (c >= 0xF0) {
+			c &= 0x07;
+			extra = 3;
+		} else if (c >= 0xE0) {
+			c &= 0x0F;
+			extra = 2;
+		} else if (c >= 0xC0) {
+			c &= 0x1F;
+			extra = 1;
+		} else if (c >= 0x80)
+			return false;
+		while (extra--) {
+			if (i >= length || ((u8)name[i] & 0xC0) != 0x80)
+				return false;
+			c = (c << 6) | (name[i++] & 0x3F);
+		}
+
+		if (c < 0x20 || (c < 0x80 && strchr("\"*/:<>?\\|", c)))
+			return false;
+		if (c >= 0x10000) {
+			if (ComponentLength + 2 > EXFAT_NAME_MAX)
+				return false;
+			c -= 0x10000;
+			Component[ComponentLength++] = 0xD800 | (c >> 10);
+			Component[ComponentLength++] = 0xDC00 | (c & 0x3FF);
+		} else {
+			if (ComponentLength == EXFAT_NAME_MAX)
+				return false;
+			Component[ComponentLength++] = c;
+		}
+	}
+	return ComponentLength > 0;
+}
+
+u16 ExfatHandler::NameHash()
+{
+	u16 hash = 0;
+	for (u32 i = 0; i < ComponentLength; i++) {
+		u16 c = UpCase(Component[i]);
+		hash = ((hash & 1) ? 0x8000 : 0) + (hash >> 1) + (c & 0xFF);
+		hash = ((hash & 1) ? 0x8000 : 0) + (hash >> 1) + (c >> 8);
+	}
+	return hash;
+}
+
+u8* ExfatHandler::DirEntry(ExfatChain* dir, u32 index, bool dirty)
+{
+	u32 offset = index * EXFAT_ENTRY_SIZE;
+	u32 cluster = ClusterAt(dir, offset >> ClusterBytesShift);
+	if (!cluster)
+		return NULL;
+	u8* data = CacheSector(ClusterSector(cluster) + ((offset >> SectorShift) & ((1 << ClusterShift) - 1)), dirty);
+	if (!data)
+		return NULL;
+	return data + (offset & ((1 << SectorShift) - 1));
+}
+
+bool ExfatHandler::ReadSet(ExfatChain* dir, u32 index, u32 count)
+{
+	for (u32 i = 0; i < count; i++) {
+		u8* entry = DirEntry(dir, index + i, false);
+		if (!entry)
+			return false;
+		memcpy(SetBuffer + i * EXFAT_ENTRY_SIZE, entry, EXFAT_ENTRY_SIZE);
+	}
+	return true;
+}
+
+// Writes SetBuffer back with a fresh checksum, primary entry last
+bool ExfatHandler::WriteSet(ExfatChain* dir, u32 index, u32 count)
+{
+	Set16(SetBuffer + 2, SetChecksum(SetBuffer, count));
+	for (u32 i = 1; i <= count; i++) {
+		u32 entryIndex = i % count;
+		u8* entry = DirEntry(dir, index + entryIndex, true);
+		if (!entry)
+			return false;
+		memcpy(entry, SetBuffer + entryIndex * EXFAT_ENTRY_SIZE, EXFAT_ENTRY_SIZE);
+	}
+	return true;
+}
+
+void ExfatHandler::ParseSet(ExfatNode* node)
+{
+	const u8* stream = SetBuffer + EXFAT_ENTRY_SIZE;
+
+	node->Secondary = SetBuffer[1];
+	node->Attributes = Get16(SetBuffer + 4);
+	node->ValidLength = Get64(stream + 8);
+	node->Length = Get64(stream + 24);
+	node->Data.First = Get32(stream + 20);
+	node->Data.Contiguous = stream[1] & EXFAT_FLAG_NOFATCHAIN;
+	node->Data.Clusters = ValidCluster(node->Data.First) ? (u32)((node->Length + (1 << ClusterBytesShift) - 1) >> ClusterBytesShift) : 0;
+	node->Data.CursorIndex = 0;
+	node->Data.CursorCluster = 0;
+}
+
+/*
+Looks up Component in a directory. Entry sets are rejected on the stream
+entry's name length and hash before any name entries are compared.
+*/
+bool ExfatHandler::FindEntry(ExfatNode* dir, ExfatNode* node)
+{
+	ExfatChain* chain = &dir->Data;
+	u16 hash = NameHash();
+	u32 count = EntryCount(chain);
+
+	for (u32 i = 0; i < count; i++) {
+		u8* entry = DirEntry(chain, i, false);
+		if (!entry || entry[0] == EXFAT_ENTRY_EOD)
+			return false;
+		if (entry[0] != EXFAT_ENTRY_FILE)
+			continue;
+		u32 secondary = entry[1];
+		if (secondary < 2 || secondary >= EXFAT_SET_MAX)
+			continue;
+
+		entry = DirEntry(chain, i + 1, false);
+		if (!entry || entry[0] != EXFAT_ENTRY_STREAM || entry[3] != ComponentLength || Get16(entry + 4) != hash)
+			continue;
+
+		bool match = true;
+		for (u32 c = 0; c < ComponentLength && match; c++) {
+			if (!(c % 15)) {
+				entry = DirEntry(chain, i + 2 + c / 15, false);
+				if (!entry || entry[0] != EXFAT_ENTRY_NAME)
+					break;
+			}
+			match = UpCase(Get16(entry + 2 + (c % 15) * 2)) == UpCase(Component[c]);
+		}
+		if (!match || !entry || entry[0] != EXFAT_ENTRY_NAME)
+			continue;
+
+		if (!ReadSet(chain, i, secondary + 1))
+			return false;
+		ParseSet(node);
+		node->Parent = *chain;
+		node->Entry = i;
+		return true;
+	}
+	return false;
+}
+
+/*
+Walks a path from the root directory. With parent set the walk stops
+before the last component, leaving its name in Component and the
+directory that should hold it in node.
+*/
+int ExfatHandler::Resolve(const char* path, ExfatNode* node, bool parent)
+{
+	ExfatNode child;
+
+	*node = Root;
+	while (*path == '/')
+		path++;
+
+	while (*path) {
+		const char* end = strchr(path, '/');
+		if (!end)
+			end = path + strlen(path);
+		if (!SetName(path, end - path))
+			return -1;
+		while (*end == '/')
+			end++;
+		if (parent && !*end)
+			return 0;
+		if (!(node->Attributes & EXFAT_ATTR_DIRECTORY))
+			return -1;
+
+		path = end;
+		if (ComponentLength == 1 && Component[0] == '.')
+			continue;
+		if (!FindEntry(node, &child))
+			return -1;
+		*node = child;
+	}
+
+	return parent ? -1 : 0;
+}
+
+bool ExfatHandler::ExtendDirectory(ExfatNode* dir)
+{
+	if (!Extend(&dir->Data, 1) || !ZeroCluster(LastCluster(&dir->Data)))
+		return false;
+
+	dir->Length = dir->ValidLength = (u64)dir->Data.Clusters << ClusterBytesShift;
+	if (dir->Entry == EXFAT_NO_ENTRY) {
+		Root = *dir;
+		return true;
+	}
+	return UpdateEntry(dir);
+}
+
+/*
+Creates an entry set named Component in a directory. head holds the file
+and stream entries; the name, its hash and the checksum are filled in here.
+*/
+bool ExfatHandler::Insert(ExfatNode* dir, const u8* head, ExfatNode* node)
+{
+	u32 count = 2 + (ComponentLength + 14) / 15;
+	u32 total = EntryCount(&dir->Data);
+	u32 run = 0, slot = 0;
+
+	for (u32 i = 0; run < count; i++) {
+		if (i == total) {
+			if (!ExtendDirectory(dir))
+				return false;
+			total = EntryCount(&dir->Data);
+		}
+		u8* entry = DirEntry(&dir->Data, i, false);
+		if (!entry)
+			return false;
+		if (entry[0] & EXFAT_ENTRY_INUSE)
+			run = 0;
+		else if (!run++)
+			slot = i;
+	}
+
+	memset(SetBuffer, 0, count * EXFAT_ENTRY_SIZE);
+	memcpy(SetBuffer, head, 2 * EXFAT_ENTRY_SIZE);
+	SetBuffer[1] = count - 1;
+	SetBuffer[EXFAT_ENTRY_SIZE + 3] = ComponentLength;
+	Set16(SetBuffer + EXFAT_ENTRY_SIZE + 4, NameHash());
+	for (u32 c = 0; c < ComponentLength; c++) {
+		u8* entry = SetBuffer + (2 + c / 15) * EXFAT_ENTRY_SIZE;
+		entry[0] = EXFAT_ENTRY_NAME;
+		Set16(entry + 2 + (c % 15) * 2, Component[c]);
+	}
+
+	if (!WriteSet(&dir->Data, slot, count))
+		return false;
+
+	ParseSet(node);
+	node->Parent = dir->Data;
+	node->Entry = slot;
+	return true;
+}
+
+bool ExfatHandler::UpdateEntry(ExfatNode* node)
+{
+	if (node->Entry == EXFAT_NO_ENTRY)
+		return true;
+
+	u32 count = node->Secondary + 1;
+	if (!ReadSet(&node->Parent, node->Entry, count) || SetBuffer[0] != EXFAT_ENTRY_FILE || SetBuffer[EXFAT_ENTRY_SIZE] != EXFAT_ENTRY_STREAM)
+		return false;
+
+	u32 now = Timestamp();
+	Set16(SetBuffer + 4, node->Attributes);
+	Set32(SetBuffer + 12, now);
+	Set32(SetBuffer + 16, now);
+	SetBuffer[21] = 0;
+
+	u8* stream = SetBuffer + EXFAT_ENTRY_SIZE;
+	stream[1] = EXFAT_FLAG_ALLOCATION;
+	if (node->Data.Clusters && node->Data.Contiguous)
+		stream[1] |= EXFAT_FLAG_NOFATCHAIN;
+	Set64(stream + 8, node->ValidLength);
+	Set32(stream + 20, node->Data.Clusters ? node->Data.First : 0);
+	Set64(stream + 24, node->Length);
+
+	return WriteSet(&node->Parent, node->Entry, count);
+}
+
+bool ExfatHandler::Remove(ExfatNode* node)
+{
+	for (u32 i = 0; i <= node->Secondary; i++) {
+		u8* entry = DirEntry(&node->Parent, node->Entry + i, true);
+		if (!entry)
+			return false;
+		entry[0] &= ~EXFAT_ENTRY_INUSE;
+	}
+	return true;
+}
+
+bool ExfatHandler::IsEmpty(ExfatNode* dir)
+{
+	u32 count = EntryCount(&dir->Data);
+	for (u32 i = 0; i < count; i++) {
+		u8* entry = DirEntry(&dir->Data, i, false);
+		if (!entry)
+			return false;
+		if (entry[0] == EXFAT_ENTRY_EOD)
+			break;
+		if (entry[0] == EXFAT_ENTRY_FILE)
+			return false;
+	}
+	return true;
+}
+
+int ExfatHandler::Create(const char* path, u16 attributes, ExfatNode* node)
+{
+	ExfatNode dir;
+	if (Resolve(path, &dir, true) < 0 || !(dir.Attributes & EXFAT_ATTR_DIRECTORY) || FindEntry(&dir, node))
+		return -1;
+
+	u8 head[2 * EXFAT_ENTRY_SIZE];
+	u32 now = Timestamp();
+	memset(head, 0, sizeof(head));
+	head[0] = EXFAT_ENTRY_FILE;
+	Set16(head + 4, attributes);
+	Set32(head + 8, now);
+	Set32(head + 12, now);
+	Set32(head + 16, now);
+
+	u8* stream = head + EXFAT_ENTRY_SIZE;
+	stream[0] = EXFAT_ENTRY_STREAM;
+	stream[1] = EXFAT_FLAG_ALLOCATION;
+
+	ExfatChain chain = { 0, 0, true, 0, 0 };
+	if (attributes & EXFAT_ATTR_DIRECTORY) {
+		if (!Extend(&chain, 1))
+			return -1;
+		if (!ZeroCluster(chain.First)) {
+			FreeChain(&chain);
+			return -1;
+		}
+		stream[1] |= EXFAT_FLAG_NOFATCHAIN;
+		Set64(stream + 8, 1 << ClusterBytesShift);
+		Set32(stream + 20, chain.First);
+		Set64(stream + 24, 1 << ClusterBytesShift);
+	}
+
+	if (!Insert(&dir, head, node)) {
+		FreeChain(&chain);
+		return -1;
+	}
+	return 0;
+}
+
+void ExfatHandler::NodeToStats(ExfatNode* node, Stats* st)
+{
+	st->Identifier = node->Data.Clusters ? node->Data.First : 0;
+	if (node->Data.Clusters && node->Data.Contiguous)
+		st->Identifier |= EXFAT_ID_NOFATCHAIN;
+	st->Size = node->Length;
+	st->Device = Module->Disk[phys]->ioType;
+	st->Mode = ((node->Attributes & EXFAT_ATTR_DIRECTORY) ? S_IFDIR : S_IFREG) |
+		(S_IRUSR | S_IRGRP | S_IROTH) |
+		((node->Attributes & EXFAT_ATTR_READONLY) ? 0 : (S_IWUSR | S_IWGRP | S_IWOTH));
+}
+
+int ExfatHandler::Mount(const void* options, int length)
+{
+	if (length < 4)
+		return Errors::Unrecognized;
+
+	memcpy(&phys, options, sizeof(int));
+
+	if (length > 4) { // optional forced fs name
+		strcpy(Name, (const char*)options + 4);
+	} else
+		strcpy(Name, __exfatName);
+
+	// fatMount shuts the disc down when it fails, so it has to be started again
+	DISC_INTERFACE* disk = Module->Disk[phys];
+	if (!disk->startup() || !disk->isInserted())
+		return Errors::DiskNotMounted;
+
+	int ret = MountVolume(disk);
+	if (ret < 0) {
+		disk->shutdown();
+		return ret;
+	}
+
+	strcpy(MountPoint, "/mnt/");
+	strcat(MountPoint, Name);
+
+	IdleCount = 0;
+
+	return Errors::Success;
+}
+
+int ExfatHandler::MountVolume(DISC_INTERFACE* disk)
+{
+	u8* boot = (u8*)Memalign(32, EXFAT_MAX_SECTOR);
+	if (!boot)
+		return Errors::OutOfMemory;
+
+	// The volume is either the whole disc or one of the primary MBR partitions
+	bool found = false;
+	u32 activeFat = 0;
+	VolumeStart = 0;
+	if (disk->readSectors(0, 1, boot)) {
+		found = !memcmp(boot + 3, __exfatSignature, 8);
+		if (!found && boot[0x1FE] == 0x55 && boot[0x1FF] == 0xAA) {
+			u32 starts[4];
+			for (int i = 0; i < 4; i++)
+				starts[i] = Get32(boot + 0x1BE + i * 0x10 + 8);
+			for (int i = 0; i < 4 && !found; i++) {
+				if (starts[i] && disk->readSectors(starts[i], 1, boot) && !memcmp(boot + 3, __exfatSignature, 8)) {
+					VolumeStart = starts[i];
+					found = true;
+				}
+			}
+		}
+	}
+
+	if (found) {
+		SectorShift = boot[108];
+		ClusterShift = boot[109];
+		found = boot[105] == 1 && SectorShift >= 9 && SectorShift <= 12 && SectorShift + ClusterShift <= 25;
+	}
+	if (found) {
+		u32 fatLength = Get32(boot + 84);
+		FatStart = VolumeStart + Get32(boot + 80);
+		activeFat = Get16(boot + 106) & 1; // VolumeFlags, second FAT and bitmap active
+		if (activeFat)
+			FatStart += fatLength;
+		HeapStart = VolumeStart + Get32(boot + 88);
+		ClusterCount = Get32(boot + 92);
+		ClusterBytesShift = SectorShift + ClusterShift;
+
+		Root.Data.First = Get32(boot + 96);
+		Root.Data.Contiguous = false;
+	}
+	Dealloc(boot);
+	if (!found)
+		return Errors::DiskNotMounted;
+
+	CacheCount = MAX(EXFAT_CACHE_MIN, EXFAT_CACHE_SIZE >> SectorShift);
+	Cache = new ExfatCacheEntry[CacheCount];
+	CacheData = (u8*)Memalign(32, CacheCount << SectorShift);
+	Bounce = (u8*)Memalign(32, CacheCount << SectorShift);
+	if (!Cache || !CacheData || !Bounce)
+		return Errors::OutOfMemory;
+	for (u32 i = 0; i < CacheCount; i++) {
+		Cache[i].Sector = 0;
+		Cache[i].LastUse = 0;
+		Cache[i].Dirty = false;
+		Cache[i].Data = CacheData + (i << SectorShift);
+	}
+	CacheClock = 0;
+
+	// The root directory has no entry of its own, so its length comes from the FAT
+	Root.Data.Clusters = 0xFFFFFFFF;
+	Root.Data.CursorCluster = 0;
+	u32 clusters = 0;
+	while (ClusterAt(&Root.Data, clusters))
+		clusters++;
+	if (!clusters)
+		return Errors::DiskNotMounted;
+	Root.Data.Clusters = clusters;
+	Root.Entry = EXFAT_NO_ENTRY;
+	Root.Secondary = 0;
+	Root.Attributes = EXFAT_ATTR_DIRECTORY;
+	Root.Length = Root.ValidLength = (u64)clusters << ClusterBytesShift;
+
+	u32 upcaseCluster = 0, upcaseChecksum = 0;
+	u64 upcaseLength = 0;
+	Bitmap.Clusters = 0;
+	u32 count = EntryCount(&Root.Data);
+	for (u32 i = 0; i < count; i++) {
+		u8* entry = DirEntry(&Root.Data, i, false);
+		if (!entry)
+			return Errors::DiskNotMounted;
+		if (entry[0] == EXFAT_ENTRY_EOD)
+			break;
+		if (entry[0] == EXFAT_ENTRY_BITMAP && (entry[1] & 1) == activeFat && !Bitmap.Clusters) {
+			Bitmap.First = Get32(entry + 20);
+			Bitmap.Clusters = (u32)((Get64(entry + 24) + (1 << ClusterBytesShift) - 1) >> ClusterBytesShift);
+			Bitmap.Contiguous = false;
+			Bitmap.CursorCluster = 0;
+		} else if (entry[0] == EXFAT_ENTRY_UPCASE) {
+			upcaseChecksum = Get32(entry + 4);
+			upcaseCluster = Get32(entry + 20);
+			upcaseLength = Get64(entry + 24);
+		}
+	}
+	if (!Bitmap.Clusters || ((u64)Bitmap.Clusters << ClusterBytesShift) < (ClusterCount + 7) / 8)
+		return Errors::DiskNotMounted;
+
+	// Without a usable up-case table names are folded as ASCII
+	for (u32 c = 0; c < 0x80; c++)
+		UpcaseAscii[c] = (c >= 'a' && c <= 'z') ? c - ('a' - 'A') : c;
+	if (upcaseCluster && !LoadUpcase(upcaseCluster, upcaseLength, upcaseChecksum)) {
+		Dealloc(Upcase);
+		Upcase = NULL;
+		UpcaseCount = 0;
+	}
+
+	NextFree = EXFAT_CLUSTER_FIRST;
+	FreeClusters = -1;
+
+	return Errors::Success;
+}
+
+int ExfatHandler::Unmount()
+{
+	CacheFlush();
+	Module->Disk[phys]->shutdown();
+	IdleCount = -1;
+	return 0;
+}
+
+int ExfatHandler::CheckPhysical()
+{
+	if (phys<0 || !Module->Disk[phys]->isInserted())
+		return -1;
+	return 0;
+}
+
+FileInfo* ExfatHandler::Open(const char* path, int mode)
+{
+	IdleCount = 0;
+
+	ExfatFileInfo* file = new ExfatFileInfo(this);
+	if (!file)
+		return null;
+	ExfatNode* node = &file->Node;
+
+	if (!strncmp(path, FILE_ID_PATH, FILE_ID_PATH_LEN)) {
+		if (mode != O_RDONLY) {
+			delete file;
+			return null;
+		}
+		// No entry to read the size from, so like FAT the file is as large as it can be
+		u64 id = HexToInt(path + FILE_ID_PATH_LEN, 0x10);
+		node->Data.First = (u32)id;
+		node->Data.Clusters = 0xFFFFFFFF;
+		node->Data.Contiguous = id & EXFAT_ID_NOFATCHAIN;
+		node->Data.CursorCluster = 0;
+		node->Entry = EXFAT_NO_ENTRY;
+		node->Attributes = EXFAT_ATTR_READONLY;
+		node->Length = node->ValidLength = 0xCFFFFFF0;
+		return file;
+	}
+
+	int access = mode & O_ACCMODE;
+	file->Write = access == O_WRONLY || access == O_RDWR;
+	file->Append = mode & O_APPEND;
+
+	if (Resolve(path, node, false) < 0) {
+		if (!(mode & O_CREAT) || Create(path, EXFAT_ATTR_ARCHIVE, node) < 0) {
+			delete file;
+			return null;
+		}
+	} else if (((mode & O_CREAT) && (mode & O_EXCL)) || (node->Attributes & EXFAT_ATTR_DIRECTORY) ||
+		node->Entry == EXFAT_NO_ENTRY || (file->Write && (node->Attributes & EXFAT_ATTR_READONLY))) {
+		delete file;
+		return null;
+	}
+
+	if ((mode & O_TRUNC) && file->Write && node->Length) {
+		if (!FreeChain(&node->Data)) {
+			delete file;
+			return null;
+		}
+		node->Length = node->ValidLength = 0;
+		UpdateEntry(node);
+	}
+
+	return file;
+}
+
+/*
+Moves data between the buffer and the file's clusters at its position.
+Physically consecutive clusters are merged into one disc request, and
+partial sectors go through the cache. A NULL buffer writes zeros.
+*/
+u32 ExfatHandler::Transfer(ExfatFileInfo* file, u8* buffer, u32 length, bool write)
+{
+	ExfatChain* chain = &file->Node.Data;
+	u32 sectorSize = 1 << SectorShift;
+	u32 clusterSize = 1 << ClusterBytesShift;
+	u32 done = 0;
+
+	while (done < length) {
+		u32 index = (u32)(file->Position >> ClusterBytesShift);
+		u32 cluster = ClusterAt(chain, index);
+		if (!cluster)
+			break;
+
+		u32 offset = (u32)file->Position & (clusterSize - 1);
+		u32 run = clusterSize - offset;
+		for (u32 next = 1; run < length - done && ClusterAt(chain, index + next) == cluster + next; next++)
+			run += clusterSize;
+		u32 chunk = MIN(run, length - done);
+
+		u32 sector = ClusterSector(cluster) + (offset >> SectorShift);
+		u32 within = offset & (sectorSize - 1);
+		u8* data = buffer ? buffer + done : NULL;
+		if (within || chunk < sectorSize) {
+			chunk = MIN(chunk, sectorSize - within);
+			u8* cached = CacheSector(sector, write);
+			if (!cached)
+				break;
+			if (!write)
+				memcpy(data, cached + within, chunk);
+			else if (data)
+				memcpy(cached + within, data, chunk);
+			else
+				memset(cached + within, 0, chunk);
+		} else {
+			chunk &= ~(sectorSize - 1);
+			if (!(write ? DiscWrite(sector, chunk >> SectorShift, data) : DiscRead(sector, chunk >> SectorShift, data)))
+				break;
+		}
+
+		done += chunk;
+		file->Position += chunk;
+	}
+
+	return done;
+}
+
+int ExfatHandler::Read(FileInfo* file, u8* buffer, int length)
+{
+	ExfatFileInfo* info = (ExfatFileInfo*)file;
+	ExfatNode* node = &info->Node;
+	IdleCount = 0;
+
+	if (length < 0)
+		return -1;
+	if (info->Position >= node->Length)
+		return 0;
+	if ((u64)length > node->Length - info->Position)
+		length = (int)(node->Length - info->Position);
+
+	// everything past the valid data length reads as zero
+	u32 valid = 0;
+	if (info->Position < node->ValidLength)
+		valid = (u32)MIN((u64)length, node->ValidLength - info->Position);
+	u32 ret = Transfer(info, buffer, valid, false);
+	if (ret < valid)
+		return ret ? (int)ret : -1;
+
+	memset(buffer + valid, 0, length - valid);
+	info->Position += length - valid;
+	return length;
+}
+
+int ExfatHandler::Write(FileInfo* file, const u8* buffer, int length)
+{
+	ExfatFileInfo* info = (ExfatFileInfo*)file;
+	ExfatNode* node = &info->Node;
+	IdleCount = 0;
+
+	if (!info->Write || length < 0)
+		return -1;
+	if (!length)
+		return 0;
+	if (info->Append)
+		info->Position = node->Length;
+
+	u32 clusters = (u32)((info->Position + length + (1 << ClusterBytesShift) - 1) >> ClusterBytesShift);
+	if (clusters > node->Data.Clusters && !Extend(&node->Data, clusters - node->Data.Clusters)) {
+		// out of space, write whatever still fits
+		u64 allocated = (u64)node->Data.Clusters << ClusterBytesShift;
+		if (info->Position >= allocated) {
+			// keep whatever was allocated covered by the file's length
+			if (allocated > node->Length) {
+				node->Length = allocated;
+				info->Modified = true;
+			}
+			return -1;
+		}
+		length = (int)MIN((u64)length, allocated - info->Position);
+	}
+	info->Modified = true;
+
+	// zero the gap between the valid data and a write past it
+	if (info->Position > node->ValidLength) {
+		u64 position = info->Position;
+		u32 gap = (u32)(position - node->ValidLength);
+		info->Position = node->ValidLength;
+		u32 zeroed = Transfer(info, NULL, gap, true);
+		node->ValidLength = info->Position;
+		if (zeroed < gap) {
+			info->Position = position;
+			return -1;
+		}
+	}
+
+	u32 ret = Transfer(info, (u8*)buffer, length, true);
+	if (info->Position > node->ValidLength)
+		node->ValidLength = info->Position;
+	if (node->ValidLength > node->Length)
+		node->Length = node->ValidLength;
+
+	return ret ? (int)ret : -1;
+}
+
+int ExfatHandler::Seek(FileInfo* file, int where, int whence)
+{
+	ExfatFileInfo* info = (ExfatFileInfo*)file;
+	s64 position;
+
+	switch (whence) {
+		case SEEK_SET:
+			position = where;
+			break;
+		case SEEK_CUR:
+			position = (s64)info->Position + where;
+			break;
+		case SEEK_END:
+			position = (s64)info->Node.Length + where;
+			break;
+		default:
+			return -1;
+	}
+
+	if (position < 0)
+		return -1;
+
+	info->Position = position;
+	return (int)position;
+}
+
+int ExfatHandler::Tell(FileInfo* file)
+{
+	return (int)((ExfatFileInfo*)file)->Position;
+}
+
+int ExfatHandler::Sync(FileInfo* file)
+{
+	ExfatFileInfo* info = (ExfatFileInfo*)file;
+	IdleCount = 0;
+
+	if (info->Modified) {
+		if (!UpdateEntry(&info->Node))
+			return -1;
+		info->Modified = false;
+	}
+	return CacheFlush() ? 0 : -1;
+}
+
+int ExfatHandler::Close(FileInfo* file)
+{
+	int ret = Sync(file);
+	delete file;
+	return ret;
+}
+
+int ExfatHandler::Stat(const char* path, Stats* stats)
+{
+	ExfatNode node;
+	if (Resolve(path, &node, false) < 0)
+		return -1;
+
+	NodeToStats(&node, stats);
+	return 0;
+}
+
+int ExfatHandler::CreateFile(const char* path)
+{
+	ExfatNode node;
+	IdleCount = 0;
+	if (Resolve(path, &node, false) >= 0)
+		return (node.Attributes & EXFAT_ATTR_DIRECTORY) ? -1 : Errors::Success;
+	int ret = Create(path, EXFAT_ATTR_ARCHIVE, &node) < 0 ? -1 : Errors::Success;
+
+	// metadata goes out now like libfat does, not on the next idle tick
+	return CacheFlush() ? ret : -1;
+}
+
+int ExfatHandler::Delete(const char* path)
+{
+	ExfatNode node;
+	IdleCount = 0;
+
+	if (Resolve(path, &node, false) < 0 || node.Entry == EXFAT_NO_ENTRY)
+		return -1;
+	if ((node.Attributes & EXFAT_ATTR_DIRECTORY) && !IsEmpty(&node))
+		return -1;
+
+	int ret = (!Remove(&node) || !FreeChain(&node.Data)) ? -1 : 0;
+	return CacheFlush() ? ret : -1;
+}
+
+int ExfatHandler::Rename(const char* path, const char* destination)
+{
+	ExfatNode node, dir, existing;
+	u8 head[2 * EXFAT_ENTRY_SIZE];
+	IdleCount = 0;
+
+	if (Resolve(path, &node, false) < 0 || node.Entry == EXFAT_NO_ENTRY || !ReadSet(&node.Parent, node.Entry, 2))
+		return -1;
+	memcpy(head, SetBuffer, sizeof(head));
+
+	if (Resolve(destination, &dir, true) < 0 || !(dir.Attributes & EXFAT_ATTR_DIRECTORY) || FindEntry(&dir, &existing))
+		return -1;
+
+	// the new entry set goes in before the old one is dropped
+	int ret = (!Insert(&dir, head, &existing) || !Remove(&node)) ? -1 : 0;
+	return CacheFlush() ? ret : -1;
+}
+
+int ExfatHandler::CreateDir(const char* path)
+{
+	ExfatNode node;
+	IdleCount = 0;
+	int ret = Create(path, EXFAT_ATTR_DIRECTORY, &node) < 0 ? -1 : 0;
+	return CacheFlush() ? ret : -1;
+}
+
+FileInfo* ExfatHandler::OpenDir(const char* path)
+{
+	IdleCount = 0;
+
+	ExfatFileInfo* dir = new ExfatFileInfo(this);
+	if (!dir)
+		return null;
+	if (Resolve(path, &dir->Node, false) < 0 || !(dir->Node.Attributes & EXFAT_ATTR_DIRECTORY)) {
+		delete dir;
+		return null;
+	}
+
+	return dir;
+}
+
+int ExfatHandler::NextDir(FileInfo* dir, char* filename, Stats* stats)
+{
+	ExfatFileInfo* info = (ExfatFileInfo*)dir;
+	ExfatChain* chain = &info->Node.Data;
+	u32 count = EntryCount(chain);
+
+	for (u32 i = (u32)info->Position; i < count; i++) {
+		u8* entry = DirEntry(chain, i, false);
+		if (!entry || entry[0] == EXFAT_ENTRY_EOD)
+			break;
+		if (entry[0] != EXFAT_ENTRY_FILE)
+			continue;
+		u32 secondary = entry[1];
+		if (secondary < 2 || secondary >= EXFAT_SET_MAX || !ReadSet(chain, i, secondary + 1) ||
+			SetBuffer[EXFAT_ENTRY_SIZE] != EXFAT_ENTRY_STREAM)
+			continue;
+
+		ExfatNode node;
+		ParseSet(&node);
+		NameToUtf8(filename, SetBuffer);
+		if (stats)
+			NodeToStats(&node, stats);
+		info->Position = i + 1 + secondary;
+		return 0;
+	}
+
+	info->Position = count;
+	return -1;
+}
+
+int ExfatHandler::CloseDir(FileInfo* dir)
+{
+	delete dir;
+	IdleCount = 0;
+	return 0;
+}
+
+int ExfatHandler::IdleTick()
+{
+	if (IdleCount < 0)
+		return -1;
+
+	if (IdleCount++ > (EXFAT_IDLE_TIME/FSIDLE_TICK)) {
+		CacheFlush();
+		IdleCount = 0;
+	}
+	return 0;
+}
+
+int ExfatHandler::GetFreeSpace(u64 *free_bytes)
+{
+	IdleCount = 0;
+	if (FreeClusters < 0)
+		FreeClusters = CountFree();
+	*free_bytes = (u64)FreeClusters << ClusterBytesShift;
+	return 0;
+}
+
+} }
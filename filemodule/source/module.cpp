@@ -4,6 +4,7 @@
 #include "gpio.h"
 
 #include "file_fat.h"
+#include "file_exfat.h"
 #include "file_riifs.h"
 #include "file_isfs.h"
 
@@ -103,6 +104,9 @@ namespace ProxiIOS { namespace Filesystem {
 					case Filesystems::FAT:
 						system = new FatHandler(this);
 						break;
+					case Filesystems::exFAT:
+						system = new ExfatHandler(this);
+						break;
 					case Filesystems::RiiFS:
 						system = new RiiHandler(this);
 						break;
@@ -115,6 +119,12 @@ namespace ProxiIOS { namespace Filesystem {
 
 				os_sync_before_read(message->ioctl.buffer_io, message->ioctl.length_io);
 				int ret = system->Mount(message->ioctl.buffer_io, message->ioctl.length_io);
+				if (ret < 0 && fs == Filesystems::FAT) {
+					// SDXC cards come formatted as exFAT, which libfat can't mount
+					delete system;
+					system = new ExfatHandler(this);
+					ret = system->Mount(message->ioctl.buffer_io, message->ioctl.length_io);
+				}
 				if (ret < 0) {
 					delete system;
 					return ret;
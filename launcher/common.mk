@@ -146,7 +146,16 @@ define binrules =
 	@echo $$(notdir $$<)
 	@$$(bin2o)
 endef
-$(foreach ext,$(BIN_EXTS),$(eval $(call binrules,$(ext))))
+$(foreach ext,$(filter-out png,$(BIN_EXTS)),$(eval $(call binrules,$(ext))))
+
+# PNGs matching BAKE_PNGS are embedded as RGBA8 TPLs under their original
+# name, so GuiImageData can use them without decoding anything at runtime
+define bakepng
+mkdir -p baked && gxtexconv -i $< colfmt=6 -o baked/$(<F) > /dev/null && bin2s -a 32 -H `(echo $(<F) | tr . _)`.h baked/$(<F) | $(AS) -o $(<F).o
+endef
+%.png.o: %.png
+	@echo $(notdir $<)
+	@$(if $(filter $(BAKE_PNGS),$(<F)),$(bakepng),$(bin2o))
 
 DEPENDS := $(OFILES:.o=.d)
 -include $(DEPENDS)
@@ -0,0 +1,120 @@
+/*
+ * deltasig - publishes the block signature the updater uses to rebuild a
+ * changed file from the copy already on the SD card.
+ *
+ * The signature is a 36 byte header (magic, version, block size, file size,
+ * SHA-1 of the whole file) followed by one entry per block: the rsync style
+ * rolling checksum and the first 8 bytes of the block's SHA-1. The last block
+ * is hashed over its real length. All values are big endian.
+ *
+ * Upload it next to the file as <url>.sig; the client fetches the blocks it
+ * is missing from the file itself with Range requests.
+ *
+ * usage: deltasig [-b blocksize] <file> <out.sig>
+ */
+
+#include <openssl/sha.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Must match update.cpp
+#define DELTA_MAGIC			0x52524453 // 'RRDS'
+#define DELTA_VERSION		1
+#define DELTA_BLOCK_SIZE	0x1000
+#define DELTA_STRONG_SIZE	8
+
+static void put32(unsigned char *p, unsigned int value)
+{
+	p[0] = value >> 24;
+	p[1] = value >> 16;
+	p[2] = value >> 8;
+	p[3] = value;
+}
+
+static unsigned int weak_checksum(const unsigned char *data, unsigned int length)
+{
+	unsigned int a = 0, b = 0;
+	for (unsigned int i = 0; i < length; i++) {
+		a += data[i];
+		b += (length - i) * data[i];
+	}
+	return (a & 0xFFFF) | (b << 16);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int blocksize = DELTA_BLOCK_SIZE;
+	int arg = 1;
+	if (argc == 5 && !strcmp(argv[1], "-b")) {
+		blocksize = strtoul(argv[2], NULL, 0);
+		arg = 3;
+	}
+	if (argc - arg != 2 || blocksize == 0) {
+		fprintf(stderr, "usage: %s [-b blocksize] <file> <out.sig>\n", argv[0]);
+		return 1;
+	}
+
+	FILE *in = fopen(argv[arg], "rb");
+	if (!in) {
+		perror(argv[arg]);
+		return 1;
+	}
+	fseek(in, 0, SEEK_END);
+	long size = ftell(in);
+	fseek(in, 0, SEEK_SET);
+	if (size < 0 || size > 0xFFFFFFFFL) {
+		fprintf(stderr, "%s: unsupported size\n", argv[arg]);
+		fclose(in);
+		return 1;
+	}
+
+	unsigned int blocks = (size + blocksize - 1) / blocksize;
+	unsigned char *block = malloc(blocksize);
+	unsigned char *entries = malloc((size_t)blocks * (4 + DELTA_STRONG_SIZE) + 1);
+	if (!block || !entries) {
+		fclose(in);
+		return 1;
+	}
+
+	SHA_CTX whole;
+	SHA1_Init(&whole);
+	for (unsigned int i = 0; i < blocks; i++) {
+		size_t length = fread(block, 1, blocksize, in);
+		if (length == 0) {
+			fprintf(stderr, "%s: read error\n", argv[arg]);
+			fclose(in);
+			return 1;
+		}
+		SHA1_Update(&whole, block, length);
+
+		unsigned char strong[SHA_DIGEST_LENGTH];
+		SHA1(block, length, strong);
+		unsigned char *entry = entries + (size_t)i * (4 + DELTA_STRONG_SIZE);
+		put32(entry, weak_checksum(block, length));
+		memcpy(entry + 4, strong, DELTA_STRONG_SIZE);
+	}
+	fclose(in);
+
+	unsigned char header[36];
+	put32(header + 0x00, DELTA_MAGIC);
+	put32(header + 0x04, DELTA_VERSION);
+	put32(header + 0x08, blocksize);
+	put32(header + 0x0C, size);
+	SHA1_Final(header + 0x10, &whole);
+
+	FILE *out = fopen(argv[arg + 1], "wb");
+	if (!out) {
+		perror(argv[arg + 1]);
+		return 1;
+	}
+	int ret = fwrite(header, 1, sizeof(header), out) != sizeof(header);
+	if (fwrite(entries, 4 + DELTA_STRONG_SIZE, blocks, out) != blocks)
+		ret = 1;
+	if (fclose(out))
+		ret = 1;
+
+	free(block);
+	free(entries);
+	return ret;
+}
@@ -4,6 +4,7 @@
 #include <gctypes.h>
 #define TCP_CONNECT_TIMEOUT 5000
 #define TCP_BLOCK_SIZE (16 * 1024)
+#define TCP_WINDOW_SIZE (32 * 1024)
 #define TCP_BLOCK_RECV_TIMEOUT 4000
 #define TCP_BLOCK_SEND_TIMEOUT 4000
 
@@ -15,6 +16,8 @@ bool tcp_read (const s32 s, u8 **buffer, const u32 length);
 bool tcp_write (const s32 s, const u8 *buffer, const u32 length);
 
 #define HTTP_TIMEOUT 300000
+#define HTTP_RING_SIZE (64 * 1024)
+#define HTTP_LINE_LENGTH 0x100
 
 typedef enum {
 	HTTPR_OK,
@@ -22,10 +25,16 @@ typedef enum {
 	HTTPR_ERR_REQUEST,
 	HTTPR_ERR_STATUS,
 	HTTPR_ERR_TOOBIG,
-	HTTPR_ERR_RECEIVE
+	HTTPR_ERR_RECEIVE,
+	HTTPR_ERR_ABORTED
 } http_res;
 
+// Called for each piece of the body as it arrives, return false to abort
+typedef bool (*http_sink) (void *userdata, const u8 *data, const u32 length);
+
 bool http_request (const char *url, const u32 max_size);
+bool http_request_stream (const char *url, http_sink sink, void *userdata);
+void http_close (void);
 bool http_get_result (u32 *http_status, u8 **content, u32 *length);
 
 #endif
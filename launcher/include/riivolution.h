@@ -17,6 +17,11 @@ struct DiscNode
 	DiscNode* GetParent();
 } __attribute__((packed));
 
+// Cached listing of an expanded folder patch, kept inside the folder itself
+#define FOLDER_MANIFEST_NAME ".riivolution_manifest"
+#define FOLDER_MANIFEST_MAGIC 0x52464D46 // "RFMF"
+#define FOLDER_MANIFEST_VERSION 2
+
 namespace PatchType { enum Enum {
 	Patch = 0,
 	Shift,
@@ -140,6 +140,19 @@ struct RiiDisc
 	std::map<std::string, RiiPatch> Patches;
 };
 
+// An XML read off a device but not parsed yet, parsing needs the disc ID
+struct RiiXMLFile
+{
+	char* Data;
+	int Length;
+	std::string RootPath;
+	std::string RootFS;
+	int FS;
+};
+
+void PrefetchXMLs(const char* rootpath, const char* rootfs, int fs, std::vector<RiiXMLFile>* files);
+bool PrefetchXMLs(int mnt, std::vector<RiiXMLFile>* files);
+void ParseXMLs(std::vector<RiiXMLFile>* files, std::vector<RiiDisc>* discs);
 void ParseXMLs(const char* rootpath, const char* rootfs, int fs, std::vector<RiiDisc>* discs);
 bool ParseXMLs(int mnt, std::vector<RiiDisc>* discs);
 bool ParseXML(const char* xmldata, int length, std::vector<RiiDisc>* discs, const char* rootpath, const char* rootfs, int fs);
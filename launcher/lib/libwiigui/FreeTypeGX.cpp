@@ -102,6 +102,13 @@ FreeTypeGX::FreeTypeGX(FT_UInt pixelSize, uint8_t textureFormat, uint8_t vertexI
 	this->setCompatibilityMode(FTGX_COMPATIBILITY_DEFAULT_TEVOP_GX_PASSCLR | FTGX_COMPATIBILITY_DEFAULT_VTXDESC_GX_NONE);
 	this->ftPointSize = pixelSize;
 	this->ftKerningEnabled = FT_HAS_KERNING(ftFace);
+
+	// Wide enough for about eight glyphs per shelf
+	this->atlasWidth = FTGX_ATLAS_MIN_WIDTH;
+	while(this->atlasWidth < FTGX_ATLAS_MAX_WIDTH && this->atlasWidth < pixelSize * 8)
+		this->atlasWidth <<= 1;
+	this->atlasClock = 0;
+	this->atlasDirty = false;
 }
 
 /**
@@ -198,14 +205,13 @@ void FreeTypeGX::setDefaultMode()
 /**
  * Clears all loaded font glyph data.
  *
- * This routine clears all members of the font map structure and frees all allocated memory back to the system.
+ * This routine clears all members of the font map structure and frees all atlas pages back to the system.
  */
 void FreeTypeGX::unloadFont()
 {
-	if(this->fontData.size() == 0)
-		return;
-	for(std::map<wchar_t, ftgxCharData>::iterator i = this->fontData.begin(); i != this->fontData.end(); i++)
-		free(i->second.glyphDataTexture);
+	for(std::vector<ftgxAtlasPage>::iterator i = this->atlasPages.begin(); i != this->atlasPages.end(); i++)
+		free(i->texture);
+	this->atlasPages.clear();
 	this->fontData.clear();
 }
 
@@ -274,10 +280,224 @@ uint16_t FreeTypeGX::adjustTextureHeight(uint16_t textureHeight, uint8_t texture
 }
 
 /**
- * Caches the given font glyph in the instance font texture buffer.
+ * Returns the size of the tiled texture data of an atlas page.
+ *
+ * @param height	The page height in pixels, a multiple of the texture format's tile height.
+ * @return The size of the page texture data in bytes.
+ */
+uint32_t FreeTypeGX::getAtlasPageSize(uint16_t height)
+{
+	uint32_t tileBytes = this->textureFormat == GX_TF_RGBA8 ? 64 : 32;
+	return (this->atlasWidth / adjustTextureWidth(1, this->textureFormat)) * (height / adjustTextureHeight(1, this->textureFormat)) * tileBytes;
+}
+
+/**
+ * Grows the texture data buffer of an atlas page.
+ *
+ * Tiles are stored row by row, so the glyphs already on the page keep their place and only new tile rows are added.
+ *
+ * @param page	The page to grow.
+ * @param height	The new page height in pixels.
+ * @return True if the page could be grown.
+ */
+bool FreeTypeGX::growAtlasPage(ftgxAtlasPage *page, uint16_t height)
+{
+	uint32_t oldSize = page->texture ? this->getAtlasPageSize(page->height) : 0;
+	uint32_t newSize = this->getAtlasPageSize(height);
+
+	uint8_t *texture = (uint8_t *)memalign(32, newSize);
+	if(!texture)
+		return false;
+	if(oldSize)
+		memcpy(texture, page->texture, oldSize);
+	memset(texture + oldSize, 0x00, newSize - oldSize);
+	DCFlushRange(texture, newSize);
+
+	if(page->texture)
+	{
+		// Strings drawn earlier in this frame may still be reading the old buffer
+		GX_DrawDone();
+		free(page->texture);
+	}
+	page->texture = texture;
+	page->height = height;
+	this->atlasDirty = true;
+	return true;
+}
+
+/**
+ * Empties an atlas page so that it can be packed again.
+ *
+ * Glyphs which were on the page keep their metrics and are written back into the atlas the next time they are drawn.
+ *
+ * @param pageIndex	Index of the page to empty.
+ */
+void FreeTypeGX::evictAtlasPage(uint16_t pageIndex)
+{
+	// The page is about to be overwritten, let the GPU finish with it first
+	GX_DrawDone();
+
+	for(std::map<wchar_t, ftgxCharData>::iterator i = this->fontData.begin(); i != this->fontData.end(); i++)
+	{
+		if(i->second.atlasPage == pageIndex)
+			i->second.atlasPage = FTGX_ATLAS_NONE;
+	}
+	this->atlasPages[pageIndex].shelves.clear();
+	this->atlasPages[pageIndex].used = 0;
+}
+
+/**
+ * Finds room for a glyph texture within the atlas.
+ *
+ * Glyphs are packed onto the best fitting shelf with room left. Failing that a new shelf is opened, growing the page
+ * or adding a new one as needed. Once FTGX_ATLAS_MAX_PAGES pages are full the least recently drawn page is emptied,
+ * skipping pages used by the string currently being drawn.
+ *
+ * @param charData	The glyph to place, its texture size must already be set.
+ * @return True if the glyph was given a place in the atlas.
+ */
+bool FreeTypeGX::placeGlyph(ftgxCharData *charData)
+{
+	uint16_t width = charData->textureWidth;
+	uint16_t height = charData->textureHeight;
+
+	if(width > this->atlasWidth || height > FTGX_ATLAS_MAX_WIDTH)
+		return false;
+
+	int bestPage = -1, bestShelf = -1;
+	for(uint16_t p = 0; p < this->atlasPages.size(); p++)
+	{
+		std::vector<ftgxAtlasShelf> &shelves = this->atlasPages[p].shelves;
+		for(uint16_t s = 0; s < shelves.size(); s++)
+		{
+			if(shelves[s].height < height || shelves[s].x + width > this->atlasWidth)
+				continue;
+			if(bestPage < 0 || shelves[s].height < this->atlasPages[bestPage].shelves[bestShelf].height)
+			{
+				bestPage = p;
+				bestShelf = s;
+			}
+		}
+	}
+
+	if(bestPage < 0)
+	{
+		for(uint16_t p = 0; p < this->atlasPages.size() && bestPage < 0; p++)
+		{
+			ftgxAtlasPage *page = &this->atlasPages[p];
+			if(page->used + height > FTGX_ATLAS_MAX_WIDTH)
+				continue;
+
+			if(page->used + height > page->height)
+			{
+				uint16_t newHeight = page->height;
+				while(newHeight < page->used + height)
+					newHeight += FTGX_ATLAS_MIN_HEIGHT;
+				if(newHeight > FTGX_ATLAS_MAX_WIDTH)
+					newHeight = FTGX_ATLAS_MAX_WIDTH;
+				if(!this->growAtlasPage(page, newHeight))
+					continue;
+			}
+			bestPage = p;
+		}
+
+		if(bestPage < 0)
+		{
+			int victim = -1;
+			if(this->atlasPages.size() >= FTGX_ATLAS_MAX_PAGES)
+			{
+				for(uint16_t p = 0; p < this->atlasPages.size(); p++)
+				{
+					if(this->atlasPages[p].lastUse == this->atlasClock)
+						continue;
+					if(victim < 0 || this->atlasPages[p].lastUse < this->atlasPages[victim].lastUse)
+						victim = p;
+				}
+			}
+
+			if(victim >= 0)
+			{
+				this->evictAtlasPage(victim);
+				bestPage = victim;
+			}
+			else
+			{
+				// Only goes past the page limit if the current string needs every page
+				ftgxAtlasPage newPage;
+				newPage.texture = NULL;
+				newPage.height = 0;
+				newPage.used = 0;
+				newPage.lastUse = this->atlasClock;
+				this->atlasPages.push_back(newPage);
+				bestPage = this->atlasPages.size() - 1;
+			}
+
+			ftgxAtlasPage *page = &this->atlasPages[bestPage];
+			if(page->height < height)
+			{
+				uint16_t newHeight = page->height ? page->height : FTGX_ATLAS_MIN_HEIGHT;
+				while(newHeight < height)
+					newHeight += FTGX_ATLAS_MIN_HEIGHT;
+				if(!this->growAtlasPage(page, newHeight))
+				{
+					if(!page->texture)
+						this->atlasPages.pop_back();
+					return false;
+				}
+			}
+		}
+
+		ftgxAtlasPage *page = &this->atlasPages[bestPage];
+		ftgxAtlasShelf shelf = { page->used, height, 0 };
+		page->shelves.push_back(shelf);
+		page->used += height;
+		bestShelf = page->shelves.size() - 1;
+	}
+
+	ftgxAtlasPage *page = &this->atlasPages[bestPage];
+	ftgxAtlasShelf *shelf = &page->shelves[bestShelf];
+	charData->atlasPage = bestPage;
+	charData->atlasX = shelf->x;
+	charData->atlasY = shelf->y;
+	shelf->x += width;
+	page->lastUse = this->atlasClock;
+	return true;
+}
+
+/**
+ * Copies a converted glyph texture into its place in the atlas.
+ *
+ * Glyph textures and atlas positions are whole tiles, so each tile row of the glyph is a single copy.
+ *
+ * @param glyphTexture	The glyph texture in the instance texture format.
+ * @param charData	The glyph, already placed with placeGlyph.
+ */
+void FreeTypeGX::copyGlyphToAtlas(uint32_t *glyphTexture, ftgxCharData *charData)
+{
+	uint16_t tileWidth = adjustTextureWidth(1, this->textureFormat);
+	uint16_t tileHeight = adjustTextureHeight(1, this->textureFormat);
+	uint32_t tileBytes = this->textureFormat == GX_TF_RGBA8 ? 64 : 32;
+	uint32_t pageTiles = this->atlasWidth / tileWidth;
+	uint32_t rowBytes = (charData->textureWidth / tileWidth) * tileBytes;
+
+	ftgxAtlasPage *page = &this->atlasPages[charData->atlasPage];
+	uint8_t *src = (uint8_t *)glyphTexture;
+
+	for(uint16_t row = 0; row < charData->textureHeight / tileHeight; row++)
+	{
+		uint8_t *dst = page->texture + ((charData->atlasY / tileHeight + row) * pageTiles + charData->atlasX / tileWidth) * tileBytes;
+		memcpy(dst, src, rowBytes);
+		DCFlushRange(dst, rowBytes);
+		src += rowBytes;
+	}
+	this->atlasDirty = true;
+}
+
+/**
+ * Caches the given font glyph in the instance font texture atlas.
  *
- * This routine renders and stores the requested glyph's bitmap and relevant information into its own quickly addressible
- * structure within an instance-specific map.
+ * This routine renders the requested glyph's bitmap into the atlas and stores its relevant information into its own
+ * quickly addressible structure within an instance-specific map.
  *
  * @param charCode	The requested glyph's character code.
  * @return A pointer to the allocated font structure.
@@ -306,9 +526,12 @@ ftgxCharData *FreeTypeGX::cacheGlyphData(wchar_t charCode)
 				(s16)ftSlot->bitmap_top,
 				(s16)ftSlot->bitmap_top,
 				(s16)(glyphBitmap->rows - ftSlot->bitmap_top),
-				NULL
+				FTGX_ATLAS_NONE,
+				0,
+				0
 			};
-			this->loadGlyphData(glyphBitmap, &this->fontData[charCode]);
+			if(textureWidth && textureHeight && this->placeGlyph(&this->fontData[charCode]))
+				this->loadGlyphData(glyphBitmap, &this->fontData[charCode]);
 
 			return &this->fontData[charCode];
 		}
@@ -321,6 +544,7 @@ ftgxCharData *FreeTypeGX::cacheGlyphData(wchar_t charCode)
  *
  * This routine locates each character in the configured font face and renders the glyph's bitmap.
  * Each bitmap and relevant information is loaded into its own quickly addressible structure within an instance-specific map.
+ * Fonts with more glyphs than fit in FTGX_ATLAS_MAX_PAGES pages only keep the most recently cached ones resident.
  */
 uint16_t FreeTypeGX::cacheGlyphDataComplete()
 {
@@ -329,6 +553,8 @@ uint16_t FreeTypeGX::cacheGlyphDataComplete()
 	FT_ULong charCode = FT_Get_First_Char( ftFace, &gIndex );
 	while ( gIndex != 0 )
 	{
+		// Each glyph is a string of its own, so earlier pages can be evicted once the limit is reached
+		this->atlasClock++;
 		if(this->cacheGlyphData(charCode) != NULL)
 			i++;
 		charCode = FT_Get_Next_Char( ftFace, charCode, &gIndex );
@@ -337,10 +563,11 @@ uint16_t FreeTypeGX::cacheGlyphDataComplete()
 }
 
 /**
- * Loads the rendered bitmap into the relevant structure's data buffer.
+ * Loads the rendered bitmap into the glyph's place in the atlas.
  *
- * This routine does a simple byte-wise copy of the glyph's rendered 8-bit grayscale bitmap into the structure's buffer.
- * Each byte is converted from the bitmap's intensity value into the a uint32_t RGBA value.
+ * This routine does a simple byte-wise copy of the glyph's rendered 8-bit grayscale bitmap into a temporary buffer.
+ * Each byte is converted from the bitmap's intensity value into the a uint32_t RGBA value, and the converted texture
+ * is then copied into the atlas page.
  *
  * @param bmp	A pointer to the most recently rendered glyph's bitmap.
  * @param charData	A pointer to an allocated ftgxCharData structure whose data represent that of the last rendered glyph.
@@ -359,32 +586,36 @@ void FreeTypeGX::loadGlyphData(FT_Bitmap *bmp, ftgxCharData *charData)
 		}
 	}
 
+	uint32_t *glyphTexture;
 	switch(this->textureFormat)
 	{
 		case GX_TF_I4:
-			charData->glyphDataTexture = Metaphrasis::convertBufferToI4(glyphData, charData->textureWidth, charData->textureHeight);
+			glyphTexture = Metaphrasis::convertBufferToI4(glyphData, charData->textureWidth, charData->textureHeight);
 			break;
 		case GX_TF_I8:
-			charData->glyphDataTexture = Metaphrasis::convertBufferToI8(glyphData, charData->textureWidth, charData->textureHeight);
+			glyphTexture = Metaphrasis::convertBufferToI8(glyphData, charData->textureWidth, charData->textureHeight);
 			break;
 		case GX_TF_IA4:
-			charData->glyphDataTexture = Metaphrasis::convertBufferToIA4(glyphData, charData->textureWidth, charData->textureHeight);
+			glyphTexture = Metaphrasis::convertBufferToIA4(glyphData, charData->textureWidth, charData->textureHeight);
 			break;
 		case GX_TF_IA8:
-			charData->glyphDataTexture = Metaphrasis::convertBufferToIA8(glyphData, charData->textureWidth, charData->textureHeight);
+			glyphTexture = Metaphrasis::convertBufferToIA8(glyphData, charData->textureWidth, charData->textureHeight);
 			break;
 		case GX_TF_RGB565:
-			charData->glyphDataTexture = Metaphrasis::convertBufferToRGB565(glyphData, charData->textureWidth, charData->textureHeight);
+			glyphTexture = Metaphrasis::convertBufferToRGB565(glyphData, charData->textureWidth, charData->textureHeight);
 			break;
 		case GX_TF_RGB5A3:
-			charData->glyphDataTexture = Metaphrasis::convertBufferToRGB5A3(glyphData, charData->textureWidth, charData->textureHeight);
+			glyphTexture = Metaphrasis::convertBufferToRGB5A3(glyphData, charData->textureWidth, charData->textureHeight);
 			break;
 		case GX_TF_RGBA8:
 		default:
-			charData->glyphDataTexture = Metaphrasis::convertBufferToRGBA8(glyphData, charData->textureWidth, charData->textureHeight);
+			glyphTexture = Metaphrasis::convertBufferToRGBA8(glyphData, charData->textureWidth, charData->textureHeight);
 			break;
 	}
 	free(glyphData);
+
+	this->copyGlyphToAtlas(glyphTexture, charData);
+	free(glyphTexture);
 }
 
 /**
@@ -446,8 +677,8 @@ int16_t FreeTypeGX::getStyleOffsetHeight(ftgxDataOffset *offset, uint16_t format
 /**
  * Processes the supplied text string and prints the results at the specified coordinates.
  *
- * This routine processes each character of the supplied text string, loads the relevant preprocessed bitmap buffer,
- * a texture from said buffer, and loads the resultant texture into the EFB.
+ * This routine processes each character of the supplied text string, makes sure its glyph is resident in the atlas,
+ * and then loads the resultant quads into the EFB with one texture load and one quad batch per atlas page used.
  *
  * @param x	Screen X coordinate at which to output the text.
  * @param y Screen Y coordinate at which to output the text. Note that this value corresponds to the text string origin and not the top or bottom of the glyphs.
@@ -457,30 +688,61 @@ int16_t FreeTypeGX::getStyleOffsetHeight(ftgxDataOffset *offset, uint16_t format
  * @return The number of characters printed.
  */
 uint16_t FreeTypeGX::drawText(int16_t x, int16_t y, wchar_t *text, GXColor color, uint16_t textStyle)
+{
+	uint16_t textWidth = 0;
+	ftgxDataOffset offset;
+
+	if(textStyle & (FTGX_JUSTIFY_MASK | FTGX_STYLE_MASK))
+		textWidth = this->getWidth(text);
+	if(textStyle & (FTGX_ALIGN_MASK | FTGX_STYLE_MASK))
+		this->getOffset(text, &offset);
+
+	return this->drawText(x, y, text, textWidth, &offset, color, textStyle);
+}
+
+/**
+ * Prints the supplied text string using previously measured metrics.
+ *
+ * This routine behaves like drawText but takes the string width and offsets from the caller instead of measuring
+ * the string again, for callers which draw the same string every frame.
+ *
+ * @param x	Screen X coordinate at which to output the text.
+ * @param y Screen Y coordinate at which to output the text.
+ * @param text	NULL terminated string to output.
+ * @param textWidth	Width of the string as returned by getWidth.
+ * @param textOffset	Offsets of the string as returned by getOffset.
+ * @param color	Optional color to apply to the text characters. If not specified default value is ftgxWhite: (GXColor){0xff, 0xff, 0xff, 0xff}
+ * @param textStyle	Flags which specify any styling which should be applied to the rendered string.
+ * @return The number of characters printed.
+ */
+uint16_t FreeTypeGX::drawText(int16_t x, int16_t y, wchar_t *text, uint16_t textWidth, ftgxDataOffset *textOffset, GXColor color, uint16_t textStyle)
 {
 	uint16_t strLength = wcslen(text);
 	uint16_t x_pos = x, printed = 0;
 	uint16_t x_offset = 0, y_offset = 0;
-	GXTexObj glyphTexture;
 	FT_Vector pairDelta;
-	ftgxDataOffset offset;
+
+	// Pages stamped with the current clock hold glyphs of this string and are never evicted while it is drawn
+	this->atlasClock++;
 
 	if(textStyle & FTGX_JUSTIFY_MASK)
 	{
-		x_offset = this->getStyleOffsetWidth(this->getWidth(text), textStyle);
+		x_offset = this->getStyleOffsetWidth(textWidth, textStyle);
 	}
 	if(textStyle & FTGX_ALIGN_MASK)
 	{
-		this->getOffset(text, &offset);
-		y_offset = this->getStyleOffsetHeight(&offset, textStyle);
+		y_offset = this->getStyleOffsetHeight(textOffset, textStyle);
 	}
 
+	this->drawQueue.clear();
+
 	for (uint16_t i = 0; i < strLength; i++)
 	{
 		ftgxCharData* glyphData = NULL;
-		if( this->fontData.find(text[i]) != this->fontData.end() )
+		std::map<wchar_t, ftgxCharData>::iterator cached = this->fontData.find(text[i]);
+		if( cached != this->fontData.end() && (cached->second.atlasPage != FTGX_ATLAS_NONE || !cached->second.textureWidth) )
 		{
-			glyphData = &this->fontData[text[i]];
+			glyphData = &cached->second;
 		}
 		else
 		{
@@ -495,18 +757,50 @@ uint16_t FreeTypeGX::drawText(int16_t x, int16_t y, wchar_t *text, GXColor color
 				x_pos += pairDelta.x >> 6;
 			}
 
-			GX_InitTexObj(&glyphTexture, glyphData->glyphDataTexture, glyphData->textureWidth, glyphData->textureHeight, this->textureFormat, GX_CLAMP, GX_CLAMP, GX_FALSE);
-			this->copyTextureToFramebuffer(&glyphTexture, glyphData->textureWidth, glyphData->textureHeight, x_pos + glyphData->renderOffsetX + x_offset, y - glyphData->renderOffsetY + y_offset, color);
+			if(glyphData->atlasPage != FTGX_ATLAS_NONE)
+			{
+				this->atlasPages[glyphData->atlasPage].lastUse = this->atlasClock;
+				ftgxGlyphQuad quad = { glyphData, (int16_t)(x_pos + glyphData->renderOffsetX + x_offset), (int16_t)(y - glyphData->renderOffsetY + y_offset) };
+				this->drawQueue.push_back(quad);
+			}
 
 			x_pos += glyphData->glyphAdvanceX;
 			printed++;
 		}
 	}
 
+	if(!this->drawQueue.empty())
+	{
+		if(this->atlasDirty)
+		{
+			GX_InvalidateTexAll();
+			this->atlasDirty = false;
+		}
+
+		GX_SetTevOp (GX_TEVSTAGE0, GX_MODULATE);
+		GX_SetVtxDesc (GX_VA_TEX0, GX_DIRECT);
+
+		for (uint16_t page = 0; page < this->atlasPages.size(); page++)
+		{
+			if(this->atlasPages[page].lastUse != this->atlasClock)
+				continue;
+
+			uint16_t quadCount = 0;
+			for (uint16_t i = 0; i < this->drawQueue.size(); i++)
+			{
+				if(this->drawQueue[i].glyph->atlasPage == page)
+					quadCount++;
+			}
+			if(quadCount)
+				this->copyAtlasPageToFramebuffer(page, quadCount, color);
+		}
+
+		this->setDefaultMode();
+	}
+
 	if(textStyle & FTGX_STYLE_MASK)
 	{
-		this->getOffset(text, &offset);
-		this->drawTextFeature(x + x_offset, y + y_offset, this->getWidth(text), &offset, textStyle, color);
+		this->drawTextFeature(x + x_offset, y + y_offset, textWidth, textOffset, textStyle, color);
 	}
 
 	return printed;
@@ -656,44 +950,59 @@ void FreeTypeGX::getOffset(wchar_t const *text, ftgxDataOffset* offset)
 }
 
 /**
- * Copies the supplied texture quad to the EFB.
+ * Copies the queued glyph quads of one atlas page to the EFB.
  *
- * This routine uses the in-built GX quad builder functions to define the texture bounds and location on the EFB target.
+ * This routine uses the in-built GX quad builder functions to define the glyph bounds within the page and their locations
+ * on the EFB target, loading the page texture once for all of them.
  *
- * @param texObj	A pointer to the glyph's initialized texture object.
- * @param texWidth	The pixel width of the texture object.
- * @param texHeight	The pixel height of the texture object.
- * @param screenX	The screen X coordinate at which to output the rendered texture.
- * @param screenY	The screen Y coordinate at which to output the rendered texture.
+ * @param pageIndex	Index of the atlas page to draw from.
+ * @param quadCount	The number of queued quads on that page.
  * @param color	Color to apply to the texture.
  */
-void FreeTypeGX::copyTextureToFramebuffer(GXTexObj *texObj, f32 texWidth, f32 texHeight, int16_t screenX, int16_t screenY, GXColor color)
+void FreeTypeGX::copyAtlasPageToFramebuffer(uint16_t pageIndex, uint16_t quadCount, GXColor color)
 {
-	GX_LoadTexObj(texObj, GX_TEXMAP0);
-	GX_InvalidateTexAll();
-
-	GX_SetTevOp (GX_TEVSTAGE0, GX_MODULATE);
-	GX_SetVtxDesc (GX_VA_TEX0, GX_DIRECT);
-
-	GX_Begin(GX_QUADS, this->vertexIndex, 4);
-	GX_Position2s16(screenX, screenY);
-	GX_Color4u8(color.r, color.g, color.b, color.a);
-	GX_TexCoord2f32(0.0f, 0.0f);
+	ftgxAtlasPage *page = &this->atlasPages[pageIndex];
+	GXTexObj pageTexture;
 
-	GX_Position2s16(texWidth + screenX, screenY);
-	GX_Color4u8(color.r, color.g, color.b, color.a);
-	GX_TexCoord2f32(1.0f, 0.0f);
+	GX_InitTexObj(&pageTexture, page->texture, this->atlasWidth, page->height, this->textureFormat, GX_CLAMP, GX_CLAMP, GX_FALSE);
+	// Glyphs are drawn texel for texel, filtering would only blend in the neighbouring glyphs
+	GX_InitTexObjFilterMode(&pageTexture, GX_NEAR, GX_NEAR);
+	GX_LoadTexObj(&pageTexture, GX_TEXMAP0);
 
-	GX_Position2s16(texWidth + screenX, texHeight + screenY);
-	GX_Color4u8(color.r, color.g, color.b, color.a);
-	GX_TexCoord2f32(1.0f, 1.0f);
+	f32 scaleX = 1.0f / this->atlasWidth;
+	f32 scaleY = 1.0f / page->height;
 
-	GX_Position2s16(screenX, texHeight + screenY);
-	GX_Color4u8(color.r, color.g, color.b, color.a);
-	GX_TexCoord2f32(0.0f, 1.0f);
+	GX_Begin(GX_QUADS, this->vertexIndex, quadCount * 4);
+	for (uint16_t i = 0; i < this->drawQueue.size(); i++)
+	{
+		ftgxCharData *glyph = this->drawQueue[i].glyph;
+		if(glyph->atlasPage != pageIndex)
+			continue;
+
+		int16_t screenX = this->drawQueue[i].screenX;
+		int16_t screenY = this->drawQueue[i].screenY;
+		f32 s0 = glyph->atlasX * scaleX;
+		f32 t0 = glyph->atlasY * scaleY;
+		f32 s1 = (glyph->atlasX + glyph->textureWidth) * scaleX;
+		f32 t1 = (glyph->atlasY + glyph->textureHeight) * scaleY;
+
+		GX_Position2s16(screenX, screenY);
+		GX_Color4u8(color.r, color.g, color.b, color.a);
+		GX_TexCoord2f32(s0, t0);
+
+		GX_Position2s16(glyph->textureWidth + screenX, screenY);
+		GX_Color4u8(color.r, color.g, color.b, color.a);
+		GX_TexCoord2f32(s1, t0);
+
+		GX_Position2s16(glyph->textureWidth + screenX, glyph->textureHeight + screenY);
+		GX_Color4u8(color.r, color.g, color.b, color.a);
+		GX_TexCoord2f32(s1, t1);
+
+		GX_Position2s16(screenX, glyph->textureHeight + screenY);
+		GX_Color4u8(color.r, color.g, color.b, color.a);
+		GX_TexCoord2f32(s0, t1);
+	}
 	GX_End();
-
-	this->setDefaultMode();
 }
 
 /**
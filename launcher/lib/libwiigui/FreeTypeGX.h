@@ -161,9 +161,18 @@
 #include <string.h>
 #include <wchar.h>
 #include <map>
+#include <vector>
 
 #define MAX_FONT_SIZE 100
 
+#define FTGX_ATLAS_MIN_WIDTH	128		/**< Narrowest glyph atlas page, used by small font sizes. */
+#define FTGX_ATLAS_MAX_WIDTH	512		/**< Widest glyph atlas page and tallest height a page may grow to. */
+#define FTGX_ATLAS_MIN_HEIGHT	32		/**< Initial glyph atlas page height, and the step it grows by whenever a new shelf does not fit. */
+#ifndef FTGX_ATLAS_MAX_PAGES
+#define FTGX_ATLAS_MAX_PAGES	4		/**< Number of atlas pages per font size before the least recently drawn page is evicted. */
+#endif
+#define FTGX_ATLAS_NONE			0xffff	/**< Page index of a glyph which is not currently resident in the atlas. */
+
 /*! \struct ftgxCharData_
  *
  * Font face character glyph relevant data structure.
@@ -180,9 +189,43 @@ typedef struct ftgxCharData_ {
 	int16_t renderOffsetMax;	/**< Texture Y axis bearing maximum value. */
 	int16_t renderOffsetMin;	/**< Texture Y axis bearing minimum value. */
 
-	uint32_t* glyphDataTexture;	/**< Glyph texture bitmap data buffer. */
+	uint16_t atlasPage;			/**< Index of the atlas page holding the glyph texture, FTGX_ATLAS_NONE if evicted. */
+	uint16_t atlasX;			/**< X position of the glyph texture within its atlas page. */
+	uint16_t atlasY;			/**< Y position of the glyph texture within its atlas page. */
 } ftgxCharData;
 
+/*! \struct ftgxAtlasShelf_
+ *
+ * Horizontal strip of an atlas page which glyphs of similar height are packed into from left to right.
+ */
+typedef struct ftgxAtlasShelf_ {
+	uint16_t y;			/**< Top of the shelf within the page. */
+	uint16_t height;	/**< Height of the shelf, set by the first glyph placed on it. */
+	uint16_t x;			/**< Left edge of the free space remaining on the shelf. */
+} ftgxAtlasShelf;
+
+/*! \struct ftgxAtlasPage_
+ *
+ * Shared texture page holding the tiled texture data of many glyphs.
+ */
+typedef struct ftgxAtlasPage_ {
+	uint8_t* texture;					/**< Tiled texture data buffer. */
+	uint16_t height;					/**< Allocated height of the texture data buffer in pixels. */
+	uint16_t used;						/**< Height taken up by shelves so far. */
+	uint32_t lastUse;					/**< Draw stamp of the last string drawn from this page. */
+	std::vector<ftgxAtlasShelf> shelves;	/**< Shelves allocated within the page. */
+} ftgxAtlasPage;
+
+/*! \struct ftgxGlyphQuad_
+ *
+ * Glyph quad queued by drawText until every glyph of the string is resident.
+ */
+typedef struct ftgxGlyphQuad_ {
+	ftgxCharData *glyph;	/**< Glyph to draw. */
+	int16_t screenX;		/**< Screen X coordinate of the quad. */
+	int16_t screenY;		/**< Screen Y coordinate of the quad. */
+} ftgxGlyphQuad;
+
 /*! \struct ftgxDataOffset_
  *
  * Offset structure which hold both a maximum and minimum value.
@@ -261,6 +304,12 @@ class FreeTypeGX {
 		uint32_t compatibilityMode;	/**< Compatibility mode for default tev operations and vertex descriptors. */
 		std::map<wchar_t, ftgxCharData> fontData; /**< Map which holds the glyph data structures for the corresponding characters. */
 
+		uint16_t atlasWidth;	/**< Width of every atlas page of this font size. */
+		uint32_t atlasClock;	/**< Draw stamp, advanced once per drawn string. */
+		bool atlasDirty;		/**< Flag indicating glyphs were written to the atlas since the texture cache was last invalidated. */
+		std::vector<ftgxAtlasPage> atlasPages;	/**< Atlas pages holding the cached glyph textures. */
+		std::vector<ftgxGlyphQuad> drawQueue;	/**< Quads of the string being drawn, kept to reuse its allocation. */
+
 		static uint16_t adjustTextureWidth(uint16_t textureWidth, uint8_t textureFormat);
 		static uint16_t adjustTextureHeight(uint16_t textureHeight, uint8_t textureFormat);
 
@@ -272,10 +321,16 @@ class FreeTypeGX {
 		uint16_t cacheGlyphDataComplete();
 		void loadGlyphData(FT_Bitmap *bmp, ftgxCharData *charData);
 
+		uint32_t getAtlasPageSize(uint16_t height);
+		bool growAtlasPage(ftgxAtlasPage *page, uint16_t height);
+		void evictAtlasPage(uint16_t pageIndex);
+		bool placeGlyph(ftgxCharData *charData);
+		void copyGlyphToAtlas(uint32_t *glyphTexture, ftgxCharData *charData);
+
 		void setDefaultMode();
 
 		void drawTextFeature(int16_t x, int16_t y, uint16_t width, ftgxDataOffset *offsetData, uint16_t format, GXColor color);
-		void copyTextureToFramebuffer(GXTexObj *texObj, f32 texWidth, f32 texHeight, int16_t screenX, int16_t screenY, GXColor color);
+		void copyAtlasPageToFramebuffer(uint16_t pageIndex, uint16_t quadCount, GXColor color);
 		void copyFeatureToFramebuffer(f32 featureWidth, f32 featureHeight, int16_t screenX, int16_t screenY,  GXColor color);
 
 	public:
@@ -287,6 +342,7 @@ class FreeTypeGX {
 
 		uint16_t drawText(int16_t x, int16_t y, wchar_t *text, GXColor color = ftgxWhite, uint16_t textStyling = FTGX_NULL);
 		uint16_t drawText(int16_t x, int16_t y, wchar_t const *text, GXColor color = ftgxWhite, uint16_t textStyling = FTGX_NULL);
+		uint16_t drawText(int16_t x, int16_t y, wchar_t *text, uint16_t textWidth, ftgxDataOffset *textOffset, GXColor color = ftgxWhite, uint16_t textStyling = FTGX_NULL);
 
 		uint16_t getWidth(wchar_t *text);
 		uint16_t getWidth(wchar_t const *text);
@@ -105,6 +105,12 @@ enum
 	SCROLL_HORIZONTAL
 };
 
+typedef struct _textline {
+	wchar_t * text;
+	u16 width;
+	ftgxDataOffset offset;
+} TextLine;
+
 typedef struct _paddata {
 	u16 btns_d;
 	u16 btns_u;
@@ -498,8 +504,10 @@ class GuiImageData
 	public:
 		//!Constructor
 		//!Converts the image data to RGBA8 - expects PNG format
+		//!Decoded textures are shared between all GuiImageData made from the same PNG
 		//!\param i Image data
-		GuiImageData(const u8 * i);
+		//!\param async Decode on the background thread, the texture is transparent until then
+		GuiImageData(const u8 * i, bool async = true);
 		//!Destructor
 		~GuiImageData();
 		//!Gets a pointer to the image data
@@ -511,10 +519,16 @@ class GuiImageData
 		//!Gets the image height
 		//!\return image height
 		int GetHeight();
+		//!Blocks until the image data has been decoded
+		void Wait();
+		//!Queues an image for decoding so a later GuiImageData finds it cached
+		//!\param i Image data
+		static void Prefetch(const u8 * i);
 	protected:
 		u8 * data; //!< Image data
 		int height; //!< Height of image
 		int width; //!< Width of image
+		void * cache; //!< Shared decoded texture
 };
 
 //!Display, manage, and manipulate images in the GUI
@@ -642,6 +656,11 @@ class GuiText : public GuiElement
 		//!Constantly called to draw the text
 		void Draw();
 	protected:
+		//!Drops the cached line layout, it is rebuilt on the next Draw()
+		void ClearLayout();
+		//!Splits the text into lines and measures them for the given font size
+		void UpdateLayout(int newSize);
+
 		wchar_t* origText; //!< Unicode text value
 		int size; //!< Font size
 		int maxWidth; //!< Maximum width of the generated text object (for text wrapping)
@@ -653,6 +672,8 @@ class GuiText : public GuiElement
 		int textScrollDelay; //!< Scrolling speed
 		u16 style; //!< FreeTypeGX style attributes
 		GXColor color; //!< Font color
+		std::vector<TextLine> textLines; //!< Cached lines of text with their measured width and offsets
+		int layoutSize; //!< Font size textLines was laid out for, 0 if there is no layout
 };
 
 //!Display, manage, and manipulate buttons in the GUI. Buttons can have images, icons, text, and sound set (all of which are optional)
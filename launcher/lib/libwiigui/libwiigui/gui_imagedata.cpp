@@ -10,49 +10,292 @@
 
 #include "gui.h"
 
+// Unreferenced textures are kept around up to this size, so re-entering a
+// menu reuses them instead of decoding the PNG again
+#ifndef IMAGE_CACHE_IDLE_SIZE
+#define IMAGE_CACHE_IDLE_SIZE (4 * 1024 * 1024)
+#endif
+#define IMAGE_DECODE_STACK_SIZE (32 * 1024)
+#define IMAGE_DECODE_PRIORITY 50
+
+// PNGs listed in BAKE_PNGS are converted to single texture TPLs at build time
+#define TPL_MAGIC 0x0020AF30
+
+struct TPLHeader
+{
+	u32 magic;
+	u32 count;
+	u32 table; // offset of the image table
+};
+
+struct TPLImage
+{
+	u16 height;
+	u16 width;
+	u32 format;
+	u32 data; // offset from the start of the file
+};
+
+enum
+{
+	IMAGE_QUEUED,
+	IMAGE_DECODING,
+	IMAGE_READY
+};
+
+struct ImageCacheEntry
+{
+	const u8 * source;
+	u8 * data;
+	int width;
+	int height;
+	int length;
+	int references;
+	int state;
+	bool baked; // data points into the embedded texture
+	u32 lastuse;
+	ImageCacheEntry * next; // decode queue
+};
+
+static std::vector<ImageCacheEntry *> imagecache;
+static ImageCacheEntry * decodehead = NULL;
+static ImageCacheEntry * decodetail = NULL;
+static u32 imagecacheclock = 0;
+
+static mutex_t imagecachelock = LWP_MUTEX_NULL;
+static cond_t decodequeued = LWP_COND_NULL;
+static cond_t decodefinished = LWP_COND_NULL;
+static lwp_t decodethread = LWP_THREAD_NULL;
+static u8 decodestack[IMAGE_DECODE_STACK_SIZE] ATTRIBUTE_ALIGN(32);
+
+static void DecodeImage(ImageCacheEntry * entry)
+{
+	IMGCTX ctx = PNGU_SelectImageFromBuffer(entry->source);
+	if(!ctx)
+		return;
+
+	// On failure the texture simply stays transparent
+	if(PNGU_DecodeTo4x4RGBA8 (ctx, entry->width, entry->height, entry->data, 255) == PNGU_OK)
+		DCFlushRange(entry->data, entry->length);
+	PNGU_ReleaseImageContext (ctx);
+}
+
+static void * DecodeThread(void * arg)
+{
+	LWP_MutexLock(imagecachelock);
+	while(true)
+	{
+		while(!decodehead)
+			LWP_CondWait(decodequeued, imagecachelock);
+
+		ImageCacheEntry * entry = decodehead;
+		decodehead = entry->next;
+		if(!decodehead)
+			decodetail = NULL;
+		entry->next = NULL;
+		entry->state = IMAGE_DECODING;
+		LWP_MutexUnlock(imagecachelock);
+
+		DecodeImage(entry);
+
+		LWP_MutexLock(imagecachelock);
+		entry->state = IMAGE_READY;
+		LWP_CondBroadcast(decodefinished);
+	}
+	LWP_MutexUnlock(imagecachelock);
+
+	return NULL;
+}
+
+static void InitImageCache()
+{
+	if(imagecachelock != LWP_MUTEX_NULL)
+		return;
+
+	LWP_MutexInit(&imagecachelock, false);
+	LWP_CondInit(&decodequeued);
+	LWP_CondInit(&decodefinished);
+}
+
+/**
+ * Drops the least recently used idle textures until they fit the idle budget.
+ * Must be called with the cache locked.
+ */
+static void TrimImageCache()
+{
+	while(true)
+	{
+		int idle = 0;
+		std::vector<ImageCacheEntry *>::iterator oldest = imagecache.end();
+		for(std::vector<ImageCacheEntry *>::iterator entry = imagecache.begin(); entry != imagecache.end(); entry++)
+		{
+			if((*entry)->references || (*entry)->state != IMAGE_READY)
+				continue;
+			idle += (*entry)->length;
+			if(oldest == imagecache.end() || (*entry)->lastuse < (*oldest)->lastuse)
+				oldest = entry;
+		}
+
+		if(idle <= IMAGE_CACHE_IDLE_SIZE || oldest == imagecache.end())
+			return;
+
+		if(!(*oldest)->baked)
+			free((*oldest)->data);
+		delete *oldest;
+		imagecache.erase(oldest);
+	}
+}
+
+static ImageCacheEntry * AcquireImage(const u8 * img, bool async, bool reference)
+{
+	InitImageCache();
+
+	LWP_MutexLock(imagecachelock);
+
+	for(std::vector<ImageCacheEntry *>::iterator entry = imagecache.begin(); entry != imagecache.end(); entry++)
+	{
+		if((*entry)->source == img)
+		{
+			if(reference)
+				(*entry)->references++;
+			(*entry)->lastuse = ++imagecacheclock;
+			LWP_MutexUnlock(imagecachelock);
+			return *entry;
+		}
+	}
+
+	const TPLHeader * tpl = (const TPLHeader *)img;
+	if(tpl->magic == TPL_MAGIC)
+	{
+		// Already tiled, GX can read it straight from the binary
+		const TPLImage * baked = (const TPLImage *)(img + *(const u32 *)(img + tpl->table));
+		u8 * data = (u8 *)img + baked->data;
+		if(tpl->count != 1 || baked->format != GX_TF_RGBA8 || (u32)data % 32)
+		{
+			LWP_MutexUnlock(imagecachelock);
+			return NULL;
+		}
+		DCFlushRange(data, baked->width * baked->height * 4);
+
+		ImageCacheEntry * entry = new ImageCacheEntry;
+		entry->source = img;
+		entry->data = data;
+		entry->width = baked->width;
+		entry->height = baked->height;
+		entry->length = 0;
+		entry->references = reference ? 1 : 0;
+		entry->state = IMAGE_READY;
+		entry->baked = true;
+		entry->lastuse = ++imagecacheclock;
+		entry->next = NULL;
+		imagecache.push_back(entry);
+
+		LWP_MutexUnlock(imagecachelock);
+		return entry;
+	}
+
+	PNGUPROP imgProp;
+	IMGCTX ctx = PNGU_SelectImageFromBuffer(img);
+	if(!ctx)
+	{
+		LWP_MutexUnlock(imagecachelock);
+		return NULL;
+	}
+	int res = PNGU_GetImageProperties(ctx, &imgProp);
+	PNGU_ReleaseImageContext (ctx);
+
+	// PNGU_DecodeTo4x4RGBA8 only handles whole tiles
+	if(res != PNGU_OK || imgProp.imgWidth % 4 || imgProp.imgHeight % 4)
+	{
+		LWP_MutexUnlock(imagecachelock);
+		return NULL;
+	}
+
+	int len = imgProp.imgWidth * imgProp.imgHeight * 4;
+	if(len%32) len += (32-len%32);
+	u8 * data = (u8 *)memalign (32, len);
+	if(!data)
+	{
+		LWP_MutexUnlock(imagecachelock);
+		return NULL;
+	}
+	memset(data, 0, len);
+	DCFlushRange(data, len);
+
+	ImageCacheEntry * entry = new ImageCacheEntry;
+	entry->source = img;
+	entry->data = data;
+	entry->width = imgProp.imgWidth;
+	entry->height = imgProp.imgHeight;
+	entry->length = len;
+	entry->references = reference ? 1 : 0;
+	entry->baked = false;
+	entry->lastuse = ++imagecacheclock;
+	entry->next = NULL;
+	imagecache.push_back(entry);
+
+	if(async && decodethread == LWP_THREAD_NULL)
+	{
+		if(LWP_CreateThread(&decodethread, DecodeThread, NULL, decodestack, IMAGE_DECODE_STACK_SIZE, IMAGE_DECODE_PRIORITY) < 0)
+			decodethread = LWP_THREAD_NULL;
+	}
+
+	if(async && decodethread != LWP_THREAD_NULL)
+	{
+		entry->state = IMAGE_QUEUED;
+		if(decodetail)
+			decodetail->next = entry;
+		else
+			decodehead = entry;
+		decodetail = entry;
+		LWP_CondSignal(decodequeued);
+		LWP_MutexUnlock(imagecachelock);
+	}
+	else
+	{
+		entry->state = IMAGE_DECODING;
+		LWP_MutexUnlock(imagecachelock);
+
+		DecodeImage(entry);
+
+		LWP_MutexLock(imagecachelock);
+		entry->state = IMAGE_READY;
+		LWP_CondBroadcast(decodefinished);
+		LWP_MutexUnlock(imagecachelock);
+	}
+
+	return entry;
+}
+
+static void ReleaseImage(ImageCacheEntry * entry)
+{
+	LWP_MutexLock(imagecachelock);
+	entry->references--;
+	entry->lastuse = ++imagecacheclock;
+	TrimImageCache();
+	LWP_MutexUnlock(imagecachelock);
+}
+
 /**
  * Constructor for the GuiImageData class.
  */
-GuiImageData::GuiImageData(const u8 * img)
+GuiImageData::GuiImageData(const u8 * img, bool async)
 {
 	data = NULL;
 	width = 0;
 	height = 0;
+	cache = NULL;
 
 	if(img)
 	{
-		PNGUPROP imgProp;
-		IMGCTX ctx = PNGU_SelectImageFromBuffer(img);
-
-		if(!ctx)
+		ImageCacheEntry * entry = AcquireImage(img, async, true);
+		if(!entry)
 			return;
 
-		int res = PNGU_GetImageProperties(ctx, &imgProp);
-
-		if(res == PNGU_OK)
-		{
-			int len = imgProp.imgWidth * imgProp.imgHeight * 4;
-			if(len%32) len += (32-len%32);
-			data = (u8 *)memalign (32, len);
-
-			if(data)
-			{
-				res = PNGU_DecodeTo4x4RGBA8 (ctx, imgProp.imgWidth, imgProp.imgHeight, data, 255);
-
-				if(res == PNGU_OK)
-				{
-					width = imgProp.imgWidth;
-					height = imgProp.imgHeight;
-					DCFlushRange(data, len);
-				}
-				else
-				{
-					free(data);
-					data = NULL;
-				}
-			}
-		}
-		PNGU_ReleaseImageContext (ctx);
+		cache = entry;
+		data = entry->data;
+		width = entry->width;
+		height = entry->height;
 	}
 }
 
@@ -61,7 +304,8 @@ GuiImageData::GuiImageData(const u8 * img)
  */
 GuiImageData::~GuiImageData()
 {
-	free(data);
+	if(cache)
+		ReleaseImage((ImageCacheEntry *)cache);
 }
 
 u8 * GuiImageData::GetImage()
@@ -78,3 +322,50 @@ int GuiImageData::GetHeight()
 {
 	return height;
 }
+
+void GuiImageData::Wait()
+{
+	ImageCacheEntry * entry = (ImageCacheEntry *)cache;
+	if(!entry)
+		return;
+
+	LWP_MutexLock(imagecachelock);
+	if(entry->state == IMAGE_QUEUED)
+	{
+		// Still waiting its turn, decode it here rather than behind the rest of the queue
+		ImageCacheEntry ** link = &decodehead;
+		ImageCacheEntry * previous = NULL;
+		while(*link != entry)
+		{
+			previous = *link;
+			link = &(*link)->next;
+		}
+		*link = entry->next;
+		if(decodetail == entry)
+			decodetail = previous;
+		entry->next = NULL;
+		entry->state = IMAGE_DECODING;
+		LWP_MutexUnlock(imagecachelock);
+
+		DecodeImage(entry);
+
+		LWP_MutexLock(imagecachelock);
+		entry->state = IMAGE_READY;
+		LWP_CondBroadcast(decodefinished);
+	}
+	while(entry->state != IMAGE_READY)
+		LWP_CondWait(decodefinished, imagecachelock);
+	LWP_MutexUnlock(imagecachelock);
+}
+
+void GuiImageData::Prefetch(const u8 * img)
+{
+	if(!img)
+		return;
+
+	AcquireImage(img, true, false);
+
+	LWP_MutexLock(imagecachelock);
+	TrimImageCache();
+	LWP_MutexUnlock(imagecachelock);
+}
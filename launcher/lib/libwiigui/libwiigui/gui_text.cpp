@@ -34,6 +34,7 @@ GuiText::GuiText(const char * t, int s, GXColor c)
 	maxWidth = 0;
 	wrap = false;
 	textDyn = NULL;
+	layoutSize = 0;
 	textScroll = SCROLL_NONE;
 	textScrollPos = 0;
 	textScrollInitialDelay = TEXT_SCROLL_INITIAL_DELAY;
@@ -56,6 +57,7 @@ GuiText::GuiText(const s16 * t, int s, GXColor c)
 	maxWidth = 0;
 	wrap = false;
 	textDyn = NULL;
+	layoutSize = 0;
 	textScroll = SCROLL_NONE;
 	textScrollPos = 0;
 	textScrollInitialDelay = TEXT_SCROLL_INITIAL_DELAY;
@@ -81,6 +83,7 @@ GuiText::GuiText(const char * t)
 	maxWidth = presetMaxWidth;
 	wrap = false;
 	textDyn = NULL;
+	layoutSize = 0;
 	textScroll = SCROLL_NONE;
 	textScrollPos = 0;
 	textScrollInitialDelay = TEXT_SCROLL_INITIAL_DELAY;
@@ -103,6 +106,7 @@ GuiText::GuiText(const s16 * t)
 	maxWidth = presetMaxWidth;
 	wrap = false;
 	textDyn = NULL;
+	layoutSize = 0;
 	textScroll = SCROLL_NONE;
 	textScrollPos = 0;
 	textScrollInitialDelay = TEXT_SCROLL_INITIAL_DELAY;
@@ -122,6 +126,7 @@ GuiText::~GuiText()
 {
 	delete[] origText;
 	free(textDyn);
+	ClearLayout();
 }
 
 void GuiText::SetText(const char * t)
@@ -129,6 +134,8 @@ void GuiText::SetText(const char * t)
 	delete[] origText;
 	free(textDyn);
 
+	ClearLayout();
+
 	origText = NULL;
 	textDyn = NULL;
 	textScrollPos = 0;
@@ -143,6 +150,8 @@ void GuiText::SetText(const s16 * t)
 	delete[] origText;
 	free(textDyn);
 
+	ClearLayout();
+
 	origText = NULL;
 	textDyn = NULL;
 	textScrollPos = 0;
@@ -165,17 +174,20 @@ void GuiText::SetPresets(int sz, GXColor c, int w, u16 s, int h, int v)
 void GuiText::SetFontSize(int s)
 {
 	size = s;
+	ClearLayout();
 }
 
 void GuiText::SetMaxWidth(int width)
 {
 	maxWidth = width;
+	ClearLayout();
 }
 
 void GuiText::SetWrap(bool w, int width)
 {
 	wrap = w;
 	maxWidth = width;
+	ClearLayout();
 }
 
 void GuiText::SetScroll(int s)
@@ -185,6 +197,7 @@ void GuiText::SetScroll(int s)
 
 	free(textDyn);
 	textDyn = NULL;
+	ClearLayout();
 
 	textScroll = s;
 	textScrollPos = 0;
@@ -236,6 +249,108 @@ void GuiText::SetAlignment(int hor, int vert)
 	alignmentVert = vert;
 }
 
+void GuiText::ClearLayout()
+{
+	for(u32 i=0; i < textLines.size(); i++)
+		delete[] textLines[i].text;
+	textLines.clear();
+	layoutSize = 0;
+}
+
+/**
+ * Splits the text into the lines Draw() shows and measures each one, so
+ * that drawing a frame does not have to wrap or measure the text again
+ */
+void GuiText::UpdateLayout(int newSize)
+{
+	ClearLayout();
+
+	if(maxWidth > 0 && wrap && textScroll != SCROLL_HORIZONTAL)
+	{
+		u8 maxChar = (maxWidth*2.0) / newSize;
+		int txtlen = wcslen(origText);
+		int i = 0;
+		int ch = 0;
+		int linenum = 0;
+		int lastSpace = -1;
+		int lastSpaceIndex = -1;
+		std::vector<wchar_t *> textrow;
+
+		while(ch < txtlen)
+		{
+			if(i == 0 && linenum == (int)textrow.size())
+				textrow.push_back(new wchar_t[txtlen + 1]);
+
+			if (origText[ch] == L'\n') {
+				textrow[linenum][i] = L'\0';
+				i = 0;
+				linenum++;
+				ch++;
+				continue;
+			}
+
+			textrow[linenum][i] = origText[ch];
+			textrow[linenum][i+1] = L'\0';
+
+			if(origText[ch] == L' ' || ch == txtlen-1)
+			{
+				if(wcslen(textrow[linenum]) >= maxChar)
+				{
+					if(lastSpace >= 0)
+					{
+						textrow[linenum][lastSpaceIndex] = 0; // discard space, and everything after
+						ch = lastSpace; // go backwards to the last space
+						lastSpace = -1; // we have used this space
+						lastSpaceIndex = -1;
+					}
+					linenum++;
+					i = -1;
+				}
+				else if(ch == txtlen-1)
+				{
+					linenum++;
+				}
+			}
+			if(origText[ch] == L' ' && i >= 0)
+			{
+				lastSpace = ch;
+				lastSpaceIndex = i;
+			}
+			ch++;
+			i++;
+		}
+
+		for(i=0; i < (int)textrow.size(); i++)
+		{
+			if(i < linenum)
+			{
+				TextLine line;
+				line.text = textrow[i];
+				textLines.push_back(line);
+			}
+			else
+			{
+				delete[] textrow[i]; // started but never finished
+			}
+		}
+	}
+	else
+	{
+		wchar_t * text = maxWidth > 0 ? textDyn : origText;
+		TextLine line;
+		line.text = new wchar_t[wcslen(text) + 1];
+		wcscpy(line.text, text);
+		textLines.push_back(line);
+	}
+
+	for(u32 i=0; i < textLines.size(); i++)
+	{
+		textLines[i].width = fontSystem[newSize]->getWidth(textLines[i].text);
+		fontSystem[newSize]->getOffset(textLines[i].text, &textLines[i].offset);
+	}
+	layoutSize = newSize;
+}
+
 /**
  * Draw the text on screen
  */
@@ -265,14 +380,14 @@ void GuiText::Draw()
 
 	if(maxWidth > 0)
 	{
-		wchar_t * tmpText = wcsdup(origText);
 		u8 maxChar = (maxWidth*2.0) / newSize;
 
 		if(!textDyn)
 		{
-			if(wcslen(tmpText) > maxChar)
-				tmpText[maxChar] = L'\0';
-			textDyn = wcsdup(tmpText);
+			textDyn = wcsdup(origText);
+			if(wcslen(textDyn) > maxChar)
+				textDyn[maxChar] = L'\0';
+			ClearLayout();
 		}
 
 		if(textScroll == SCROLL_HORIZONTAL)
@@ -294,6 +409,7 @@ void GuiText::Draw()
 						textScrollInitialDelay = TEXT_SCROLL_INITIAL_DELAY;
 					}
 
+					wchar_t * tmpText = wcsdup(origText);
 					wcsncpy(tmpText, &origText[textScrollPos], maxChar-1);
 					tmpText[maxChar-1] = L'\0';
 
@@ -306,87 +422,24 @@ void GuiText::Draw()
 						wcsncat(&tmpText[dynlen+2], origText, maxChar - dynlen - 2);
 					}
 					free(textDyn);
-					textDyn = wcsdup(tmpText);
+					textDyn = tmpText;
+					ClearLayout();
 				}
 			}
-			if(textDyn)
-				fontSystem[currentSize]->drawText(this->GetLeft(), this->GetTop(), textDyn, c, style);
 		}
-		else if(wrap)
-		{
-			int lineheight = newSize + 6;
-			int txtlen = wcslen(origText);
-			int i = 0;
-			int ch = 0;
-			int linenum = 0;
-			int lastSpace = -1;
-			int lastSpaceIndex = -1;
-			wchar_t * textrow[20];
-
-			while(ch < txtlen)
-			{
-				if(i == 0)
-					textrow[linenum] = new wchar_t[txtlen + 1];
+	}
 
-				if (origText[ch] == L'\n') {
-					textrow[linenum][i] = L'\0';
-					i = 0;
-					linenum++;
-					ch++;
-					continue;
-				}
+	if(layoutSize != newSize)
+		UpdateLayout(newSize);
 
-				textrow[linenum][i] = origText[ch];
-				textrow[linenum][i+1] = L'\0';
+	int voffset = 0;
+	int lineheight = newSize + 6;
 
-				if(origText[ch] == L' ' || ch == txtlen-1)
-				{
-					if(wcslen(textrow[linenum]) >= maxChar)
-					{
-						if(lastSpace >= 0)
-						{
-							textrow[linenum][lastSpaceIndex] = 0; // discard space, and everything after
-							ch = lastSpace; // go backwards to the last space
-							lastSpace = -1; // we have used this space
-							lastSpaceIndex = -1;
-						}
-						linenum++;
-						i = -1;
-					}
-					else if(ch == txtlen-1)
-					{
-						linenum++;
-					}
-				}
-				if(origText[ch] == L' ' && i >= 0)
-				{
-					lastSpace = ch;
-					lastSpaceIndex = i;
-				}
-				ch++;
-				i++;
-			}
+	if(maxWidth > 0 && wrap && textScroll != SCROLL_HORIZONTAL && alignmentVert == ALIGN_MIDDLE)
+		voffset = -(lineheight*(int)textLines.size())/2 + lineheight/2;
 
-			int voffset = 0;
+	for(int i=0; i < (int)textLines.size(); i++)
+		fontSystem[currentSize]->drawText(GetLeft(), GetTop()+voffset+i*lineheight, textLines[i].text, textLines[i].width, &textLines[i].offset, c, style);
 
-			if(alignmentVert == ALIGN_MIDDLE)
-				voffset = -(lineheight*linenum)/2 + lineheight/2;
-
-			for(i=0; i < linenum; i++)
-			{
-				fontSystem[currentSize]->drawText(GetLeft(), GetTop()+voffset+i*lineheight, textrow[i], c, style);
-				delete[] textrow[i];
-			}
-		}
-		else
-		{
-			fontSystem[currentSize]->drawText(GetLeft(), GetTop(), textDyn, c, style);
-		}
-		free(tmpText);
-	}
-	else
-	{
-		fontSystem[currentSize]->drawText(GetLeft(), GetTop(), origText, c, style);
-	}
 	UpdateEffects();
 }
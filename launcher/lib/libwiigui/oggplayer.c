@@ -238,8 +238,12 @@ static ov_callbacks callbacks = {
 
 /* OGG control */
 
-#define READ_SAMPLES 4096 // samples that it must read before to send
-#define MAX_PCMOUT 4096 // minimum size to read ogg samples
+#define RING_SAMPLES 4096 // samples in each ring block handed to ASND
+#define RING_BLOCKS 16 // blocks in the PCM ring
+#define RING_IN_FLIGHT 2 // submitted blocks ASND may still be reading (playing and queued)
+#define START_BLOCKS 2 // blocks decoded before the voice is (re)started
+#define OGG_LEAD_TIME 500 // milliseconds of audio the decoder keeps ahead of playback
+
 typedef struct
 {
 	OggVorbis_File vf;
@@ -254,10 +258,19 @@ typedef struct
 	int volume;
 	int seek_time;
 
-	/* OGG buffer control */
-	short pcmout[2][READ_SAMPLES + MAX_PCMOUT * 2]; /* take 4k out of the data segment, not the stack */
-	int pcmout_pos;
-	int pcm_indx;
+	/* PCM ring, single producer (decode thread) and single consumer (ASND callback).
+	 ring_write is only advanced by the decoder and ring_read only by whoever
+	 submits to the voice, both are free running block counters */
+	short ring[RING_BLOCKS][RING_SAMPLES] ATTRIBUTE_ALIGN(32);
+	int ring_len[RING_BLOCKS]; // bytes decoded into each block
+	u32 ring_epoch[RING_BLOCKS]; // seek generation each block was decoded in
+	volatile u32 ring_write;
+	volatile u32 ring_read;
+	volatile u32 ring_free; // oldest block ASND may still be reading
+	u32 ring_playing; // last block handed to ASND
+	volatile u32 epoch;
+	volatile u32 seek_block; // ring_write when the last seek was done
+	u32 lead_blocks;
 
 } private_data_ogg;
 
@@ -268,7 +281,7 @@ static private_data_ogg private_ogg;
 #define STACKSIZE		8192
 
 static u8 oggplayer_stack[STACKSIZE];
-static lwpq_t oggplayer_queue = LWP_TQUEUE_NULL;
+static sem_t oggplayer_sem = LWP_SEM_NULL; // posted whenever the decoder has work to do
 static lwp_t h_oggplayer = LWP_THREAD_NULL;
 static int ogg_thread_running = 0;
 
@@ -283,160 +296,174 @@ static void ogg_add_callback(int voice)
 	if (private_ogg.flag & 128)
 		return; // Ogg is paused
 
-	if (private_ogg.pcm_indx >= READ_SAMPLES)
+	u32 read = private_ogg.ring_read;
+
+	// blocks decoded before a seek are dropped unplayed
+	while (read != private_ogg.ring_write
+			&& private_ogg.ring_epoch[read % RING_BLOCKS] != private_ogg.epoch)
+		read++;
+
+	if (read != private_ogg.ring_write)
 	{
-		if (ASND_AddVoice(0,
-				(void *) private_ogg.pcmout[private_ogg.pcmout_pos],
-				private_ogg.pcm_indx << 1) == 0)
+		int block = read % RING_BLOCKS;
+		if (ASND_AddVoice(0, (void *) private_ogg.ring[block],
+				private_ogg.ring_len[block]) == 0)
 		{
-			private_ogg.pcmout_pos ^= 1;
-			private_ogg.pcm_indx = 0;
-			private_ogg.flag = 0;
-			LWP_ThreadSignal(oggplayer_queue);
+			// skipped blocks may still be playing, only the one before this is released
+			private_ogg.ring_free = private_ogg.ring_playing;
+			private_ogg.ring_playing = read;
+			read++;
 		}
 	}
-	else
+
+	if (read != private_ogg.ring_read)
 	{
-		if (private_ogg.flag & 64)
-		{
-			private_ogg.flag &= ~64;
-			LWP_ThreadSignal(oggplayer_queue);
-		}
+		private_ogg.ring_read = read;
+		LWP_SemPost(oggplayer_sem);
+	}
+}
+
+/* Decodes into the next free ring block, returns 1 once the block is complete */
+static int ogg_fill_block(private_data_ogg * priv, int * fill)
+{
+	int block = priv->ring_write % RING_BLOCKS;
+	long ret = ov_read(&priv->vf, (void *) &priv->ring[block][*fill >> 1],
+			sizeof(priv->ring[block]) - *fill, &priv->current_section);
+
+	if (ret == 0 || (ret < 0 && ret != OV_HOLE))
+	{
+		/* EOF, or an error in the stream which we treat the same way */
+		if (priv->mode & 1)
+			ov_time_seek(&priv->vf, 0); // repeat, without a gap
+		else
+			priv->eof = 1; // stops
+		return priv->eof && *fill > 0;
 	}
+	if (ret < 0)
+		return 0; // hole in the stream, nothing decoded
+
+	/* we don't bother dealing with sample rate changes, etc, but
+	 you'll have to*/
+	*fill += ret;
+	return *fill == sizeof(priv->ring[block]);
+}
+
+static void ogg_start_voice(private_data_ogg * priv)
+{
+	u32 read = priv->ring_read;
+
+	while (read != priv->ring_write && priv->ring_epoch[read % RING_BLOCKS] != priv->epoch)
+		read++;
+	if (read == priv->ring_write)
+	{
+		priv->ring_read = read;
+		return;
+	}
+
+	// the voice is idle so the callback is not running, the decoder may submit
+	int block = read % RING_BLOCKS;
+	priv->ring_free = read;
+	priv->ring_playing = read;
+	priv->ring_read = read + 1;
+	ASND_SetVoice(0, priv->vi->channels == 2 ? VOICE_STEREO_16BIT : VOICE_MONO_16BIT,
+			priv->vi->rate, 0, (void *) priv->ring[block], priv->ring_len[block],
+			priv->volume, priv->volume, ogg_add_callback);
 }
 
 static void * ogg_player_thread(private_data_ogg * priv)
 {
-	int first_time = 1;
-	long ret;
+	int fill = 0;
 
 	//init
-	LWP_InitQueue(&oggplayer_queue);
-
 	priv[0].vi = ov_info(&priv[0].vf, -1);
 
 	ASND_Pause(0);
 
-	priv[0].pcm_indx = 0;
-	priv[0].pcmout_pos = 0;
+	priv[0].ring_write = 0;
+	priv[0].ring_read = 0;
+	priv[0].ring_free = 0;
+	priv[0].ring_playing = 0;
+	priv[0].epoch = 0;
+	priv[0].seek_block = 0;
 	priv[0].eof = 0;
 	priv[0].flag = 0;
 	priv[0].current_section = 0;
 
+	priv[0].lead_blocks = (priv[0].vi->rate * priv[0].vi->channels / 1000 * OGG_LEAD_TIME
+			+ RING_SAMPLES - 1) / RING_SAMPLES;
+	if (priv[0].lead_blocks < START_BLOCKS)
+		priv[0].lead_blocks = START_BLOCKS;
+	if (priv[0].lead_blocks > RING_BLOCKS - RING_IN_FLIGHT - 1)
+		priv[0].lead_blocks = RING_BLOCKS - RING_IN_FLIGHT - 1;
+
 	ogg_thread_running = 1;
 
-	while (!priv[0].eof && ogg_thread_running)
+	while (ogg_thread_running)
 	{
-		if (priv[0].flag)
-			LWP_ThreadSleep(oggplayer_queue); // wait only when i have samples to send
+		if (priv[0].seek_time >= 0)
+		{
+			ov_time_seek(&priv[0].vf, priv[0].seek_time);
+			priv[0].seek_time = -1;
+			priv[0].eof = 0;
+			fill = 0;
+			priv[0].seek_block = priv[0].ring_write;
+			priv[0].epoch++; // the callback drops whatever was decoded before
+		}
 
-		if (priv[0].flag == 0) // wait to all samples are sent
+		u32 queued = priv[0].ring_write - priv[0].ring_read;
+
+		if (!priv[0].eof && queued < priv[0].lead_blocks
+				&& priv[0].ring_write - priv[0].ring_free < RING_BLOCKS)
 		{
-			if (ASND_TestPointer(0, priv[0].pcmout[priv[0].pcmout_pos])
-					&& ASND_StatusVoice(0) != SND_UNUSED)
-			{
-				priv[0].flag |= 64;
-				continue;
-			}
-			if (priv[0].pcm_indx < READ_SAMPLES)
+			if (ogg_fill_block(&priv[0], &fill))
 			{
-				priv[0].flag = 3;
-
-				if (priv[0].seek_time >= 0)
-				{
-					ov_time_seek(&priv[0].vf, priv[0].seek_time);
-					priv[0].seek_time = -1;
-				}
-
-				ret
-						= ov_read(
-								&priv[0].vf,
-								(void *) &priv[0].pcmout[priv[0].pcmout_pos][priv[0].pcm_indx],
-								MAX_PCMOUT,/*0,2,1,*/&priv[0].current_section);
-				priv[0].flag &= 192;
-				if (ret == 0)
-				{
-					/* EOF */
-					if (priv[0].mode & 1)
-						ov_time_seek(&priv[0].vf, 0); // repeat
-					else
-						priv[0].eof = 1; // stops
-				}
-				else if (ret < 0)
-				{
-					/* error in the stream.  Not a problem, just reporting it in
-					 case we (the app) cares.  In this case, we don't. */
-					if (ret != OV_HOLE)
-					{
-						if (priv[0].mode & 1)
-							ov_time_seek(&priv[0].vf, 0); // repeat
-						else
-							priv[0].eof = 1; // stops
-					}
-				}
-				else
-				{
-					/* we don't bother dealing with sample rate changes, etc, but
-					 you'll have to*/
-					priv[0].pcm_indx += ret >> 1; //get 16 bits samples
-				}
+				int block = priv[0].ring_write % RING_BLOCKS;
+				priv[0].ring_len[block] = fill;
+				priv[0].ring_epoch[block] = priv[0].epoch;
+				fill = 0;
+				priv[0].ring_write++; // publish, the block is complete
 			}
-			else
-				priv[0].flag = 1;
 		}
 
-		if (priv[0].flag == 1)
+		if (!(priv[0].flag & 128) && ASND_StatusVoice(0) == SND_UNUSED)
 		{
-			if (ASND_StatusVoice(0) == SND_UNUSED || first_time)
-			{
-				first_time = 0;
-				if (priv[0].vi->channels == 2)
-				{
-					ASND_SetVoice(0, VOICE_STEREO_16BIT, priv[0].vi->rate, 0,
-							(void *) priv[0].pcmout[priv[0].pcmout_pos],
-							priv[0].pcm_indx << 1, priv[0].volume,
-							priv[0].volume, ogg_add_callback);
-					priv[0].pcmout_pos ^= 1;
-					priv[0].pcm_indx = 0;
-					priv[0].flag = 0;
-				}
-				else
-				{
-					ASND_SetVoice(0, VOICE_MONO_16BIT, priv[0].vi->rate, 0,
-							(void *) priv[0].pcmout[priv[0].pcmout_pos],
-							priv[0].pcm_indx << 1, priv[0].volume,
-							priv[0].volume, ogg_add_callback);
-					priv[0].pcmout_pos ^= 1;
-					priv[0].pcm_indx = 0;
-					priv[0].flag = 0;
-				}
-			}
+			queued = priv[0].ring_write - priv[0].ring_read;
+			if (queued >= START_BLOCKS || (priv[0].eof && queued))
+				ogg_start_voice(&priv[0]);
 		}
-		usleep(100);
+
+		queued = priv[0].ring_write - priv[0].ring_read;
+
+		// the callback plays out what is left in the ring on its own
+		if (priv[0].eof && (queued == 0 || ASND_StatusVoice(0) != SND_UNUSED))
+			break;
+
+		// decode ahead until the lead is full, then sleep until a block is played
+		if (priv[0].eof || queued >= priv[0].lead_blocks
+				|| priv[0].ring_write - priv[0].ring_free >= RING_BLOCKS)
+			LWP_SemWait(oggplayer_sem);
 	}
 	ov_clear(&priv[0].vf);
 	priv[0].fd = -1;
-	priv[0].pcm_indx = 0;
 
 	return 0;
 }
 
 void StopOgg()
 {
-	ASND_StopVoice(0);
 	ogg_thread_running = 0;
 
 	if(h_oggplayer != LWP_THREAD_NULL)
 	{
-		if(oggplayer_queue != LWP_TQUEUE_NULL)
-			LWP_ThreadSignal(oggplayer_queue);
+		LWP_SemPost(oggplayer_sem);
 		LWP_JoinThread(h_oggplayer, NULL);
 		h_oggplayer = LWP_THREAD_NULL;
 	}
-	if(oggplayer_queue != LWP_TQUEUE_NULL)
+	ASND_StopVoice(0); // after the join, so the decoder can't restart it
+	if(oggplayer_sem != LWP_SEM_NULL)
 	{
-		LWP_CloseQueue(oggplayer_queue);
-		oggplayer_queue = LWP_TQUEUE_NULL;
+		LWP_SemDestroy(oggplayer_sem);
+		oggplayer_sem = LWP_SEM_NULL;
 	}
 }
 
@@ -469,9 +496,14 @@ int PlayOgg(char * buf, int buflen, int time_pos, int mode)
 		return -1;
 	}
 
+	LWP_SemInit(&oggplayer_sem, 0, RING_BLOCKS);
+
 	if (LWP_CreateThread(&h_oggplayer, (void *) ogg_player_thread,
 			&private_ogg, oggplayer_stack, STACKSIZE, 80) == -1)
 	{
+		h_oggplayer = LWP_THREAD_NULL;
+		LWP_SemDestroy(oggplayer_sem);
+		oggplayer_sem = LWP_SEM_NULL;
 		ogg_thread_running = 0;
 		ov_clear(&private_ogg.vf);
 		private_ogg.fd = -1;
@@ -490,11 +522,10 @@ void PauseOgg(int pause)
 	{
 		if (private_ogg.flag & 128)
 		{
-			private_ogg.flag |= 64;
 			private_ogg.flag &= ~128;
 			if (ogg_thread_running > 0)
 			{
-				LWP_ThreadSignal(oggplayer_queue);
+				LWP_SemPost(oggplayer_sem); // restarts the voice if it ran dry
 			}
 		}
 	}
@@ -521,9 +552,20 @@ void SetVolumeOgg(int volume)
 s32 GetTimeOgg()
 {
 	int ret;
+	u32 playing;
 	if (ogg_thread_running == 0 || private_ogg.fd < 0)
 		return 0;
 	ret = ((s32) ov_time_tell(&private_ogg.vf));
+
+	// blocks decoded before the last seek are not ahead of the new position
+	playing = private_ogg.ring_playing;
+	if ((s32) (playing - private_ogg.seek_block) < 0)
+		playing = private_ogg.seek_block;
+
+	// the decoder runs ahead of what is heard by the blocks still in the ring
+	if (private_ogg.vi && private_ogg.vi->rate)
+		ret -= (private_ogg.ring_write - playing) * (RING_SAMPLES
+				/ private_ogg.vi->channels) * 1000 / private_ogg.vi->rate;
 	if (ret < 0)
 		ret = 0;
 
@@ -533,7 +575,11 @@ s32 GetTimeOgg()
 void SetTimeOgg(s32 time_pos)
 {
 	if (time_pos >= 0)
+	{
 		private_ogg.seek_time = time_pos;
+		if (ogg_thread_running > 0)
+			LWP_SemPost(oggplayer_sem);
+	}
 }
 
 #endif
@@ -70,6 +70,31 @@ s32 tcp_socket (void) {
 	return s;
 }
 
+// Blocks until the socket is ready for events or the timeout, counted from
+// start_time, runs out. Returns > 0 when ready.
+static s32 tcp_wait (const s32 s, const u32 events, const u64 start_time, const u32 timeout) {
+	struct pollsd sd;
+	s64 left;
+	s32 res;
+
+	left = (s64) timeout - ticks_to_millisecs (diff_ticks (start_time, gettime ()));
+	if (left <= 0)
+		return 0;
+
+	sd.socket = s;
+	sd.events = events;
+	sd.revents = 0;
+
+	res = net_poll (&sd, 1, left);
+	if (res < 0) {
+		debug_printf ("net_poll failed: %d\n", res);
+		return res;
+	}
+
+	// Errors and hangups are left for the following read or write to report
+	return res;
+}
+
 s32 tcp_connect (char *host, const u16 port) {
 	struct hostent *hp;
 	struct sockaddr_in sa;
@@ -94,14 +119,6 @@ s32 tcp_connect (char *host, const u16 port) {
 
 	t = gettime ();
 	while (true) {
-		if (ticks_to_millisecs (diff_ticks (t, gettime ())) >
-				TCP_CONNECT_TIMEOUT) {
-			debug_printf ("tcp_connect timeout\n");
-			net_close (s);
-
-			return -ETIMEDOUT;
-		}
-
 		res = net_connect (s, (struct sockaddr *) &sa,
 							sizeof (struct sockaddr_in));
 
@@ -110,9 +127,15 @@ s32 tcp_connect (char *host, const u16 port) {
 				break;
 
 			if (res == -EINPROGRESS || res == -EALREADY) {
-				usleep (20 * 1000);
+				// Writable once the handshake is done, connect again to collect the result
+				res = tcp_wait (s, POLLOUT, t, TCP_CONNECT_TIMEOUT);
+				if (res > 0)
+					continue;
 
-				continue;
+				debug_printf ("tcp_connect timeout\n");
+				net_close (s);
+
+				return res < 0 ? res : -ETIMEDOUT;
 			}
 
 			debug_printf ("net_connect failed: %d\n", res);
@@ -135,21 +158,21 @@ char * tcp_readln (const s32 s, const u16 max_length, const u64 start_time, cons
 
 	buf = (char *) malloc (max_length);
 
+	// Reads a byte at a time so nothing past the line is consumed, callers
+	// reading more than a few lines should use a buffered reader instead
 	c = 0;
 	ret = NULL;
 	while (true) {
-		if (ticks_to_millisecs (diff_ticks (start_time, gettime ())) > timeout)
-			break;
-
 		res = net_read (s, &buf[c], 1);
 
-		if ((res == 0) || (res == -EAGAIN)) {
-			usleep (20 * 1000);
+		if (res == -EAGAIN) {
+			if (tcp_wait (s, POLLIN, start_time, timeout) > 0)
+				continue;
 
-			continue;
+			break;
 		}
 
-		if (res < 0) {
+		if (res <= 0) {
 			debug_printf ("tcp_readln failed: %d\n", res);
 
 			break;
@@ -190,26 +213,22 @@ bool tcp_read (const s32 s, u8 **buffer, const u32 length) {
 
 	t = gettime ();
 	while (left) {
-		if (ticks_to_millisecs (diff_ticks (t, gettime ())) >
-				TCP_BLOCK_RECV_TIMEOUT) {
-			debug_printf ("tcp_read timeout\n");
-
-			break;
-		}
-
 		block = left;
-		if (block > 2048)
-			block = 2048;
+		if (block > TCP_WINDOW_SIZE)
+			block = TCP_WINDOW_SIZE;
 
 		res = net_read (s, p, block);
 
-		if ((res == 0) || (res == -EAGAIN)) {
-			usleep (20 * 1000);
+		if (res == -EAGAIN) {
+			if (tcp_wait (s, POLLIN, t, TCP_BLOCK_RECV_TIMEOUT) > 0)
+				continue;
 
-			continue;
+			debug_printf ("tcp_read timeout\n");
+
+			break;
 		}
 
-		if (res < 0) {
+		if (res <= 0) {
 			debug_printf ("net_read failed: %d\n", res);
 
 			break;
@@ -241,22 +260,18 @@ bool tcp_write (const s32 s, const u8 *buffer, const u32 length) {
 
 	t = gettime ();
 	while (left) {
-		if (ticks_to_millisecs (diff_ticks (t, gettime ())) >
-				TCP_BLOCK_SEND_TIMEOUT) {
-
-			debug_printf ("tcp_write timeout\n");
-			break;
-		}
-
 		block = left;
-		if (block > 2048)
-			block = 2048;
+		if (block > TCP_WINDOW_SIZE)
+			block = TCP_WINDOW_SIZE;
 
 		res = net_write (s, p, block);
 
-		if ((res == 0) || (res == -56)) {
-			usleep (20 * 1000);
-			continue;
+		if ((res == 0) || (res == -EAGAIN) || (res == -56)) {
+			if (tcp_wait (s, POLLOUT, t, TCP_BLOCK_SEND_TIMEOUT) > 0)
+				continue;
+
+			debug_printf ("tcp_write timeout\n");
+			break;
 		}
 
 		if (res < 0) {
@@ -295,85 +310,359 @@ bool http_split_url (char **host, char **path, const char *url) {
 	return true;
 }
 
-bool http_request (const char *url, const u32 max_size) {
-	int linecount;
+typedef struct {
+	s32 s;
+	u8 *data;
+	u32 head;
+	u32 count;
+} http_ring;
+
+// Reads whatever fits in the free space after the tail of the ring
+static bool ring_fill (http_ring *ring) {
+	u32 tail, space;
+	s64 t;
+	s32 res;
+
+	tail = (ring->head + ring->count) % HTTP_RING_SIZE;
+	space = HTTP_RING_SIZE - ring->count;
+	if (tail + space > HTTP_RING_SIZE)
+		space = HTTP_RING_SIZE - tail;
+
+	t = gettime ();
+	while (true) {
+		res = net_read (ring->s, ring->data + tail, space);
+
+		if (res == -EAGAIN) {
+			if (tcp_wait (ring->s, POLLIN, t, TCP_BLOCK_RECV_TIMEOUT) > 0)
+				continue;
+
+			debug_printf ("ring_fill timeout\n");
+
+			return false;
+		}
+
+		// 0 is the server closing the connection
+		if (res <= 0) {
+			debug_printf ("net_read failed: %d\n", res);
+
+			return false;
+		}
+
+		ring->count += res;
+
+		return true;
+	}
+}
+
+// Copies the next CRLF terminated line (without the CRLF) into line
+static bool ring_readln (http_ring *ring, char *line, const u32 max_length) {
+	u32 i = 0;
+
+	while (true) {
+		for (; i < ring->count; i++) {
+			if (ring->data[(ring->head + i) % HTTP_RING_SIZE] != '\n')
+				continue;
+
+			if (i >= max_length)
+				return false;
+
+			for (u32 j = 0; j < i; j++)
+				line[j] = ring->data[(ring->head + j) % HTTP_RING_SIZE];
+			line[i] = 0;
+			if (i && line[i - 1] == '\r')
+				line[i - 1] = 0;
+
+			ring->head = (ring->head + i + 1) % HTTP_RING_SIZE;
+			ring->count -= i + 1;
+
+			return true;
+		}
+
+		if (ring->count == HTTP_RING_SIZE || !ring_fill (ring))
+			return false;
+	}
+}
+
+// Hands the next length bytes to the sink, a contiguous span at a time
+static bool ring_drain (http_ring *ring, u32 length, http_sink sink, void *userdata) {
+	u32 block;
+
+	while (length) {
+		if (!ring->count && !ring_fill (ring)) {
+			result = HTTPR_ERR_RECEIVE;
+
+			return false;
+		}
+
+		block = ring->count;
+		if (block > length)
+			block = length;
+		if (ring->head + block > HTTP_RING_SIZE)
+			block = HTTP_RING_SIZE - ring->head;
+
+		if (!sink (userdata, ring->data + ring->head, block)) {
+			result = HTTPR_ERR_ABORTED;
+
+			return false;
+		}
+
+		ring->head = (ring->head + block) % HTTP_RING_SIZE;
+		ring->count -= block;
+		length -= block;
+	}
+
+	return true;
+}
+
+static bool http_read_chunked (http_ring *ring, http_sink sink, void *userdata) {
+	char line[HTTP_LINE_LENGTH];
+	u32 size;
+
+	while (true) {
+		if (!ring_readln (ring, line, sizeof (line))) {
+			result = HTTPR_ERR_RECEIVE;
+
+			return false;
+		}
+
+		// Chunk extensions after the size are ignored
+		if (sscanf (line, "%x", &size) != 1) {
+			result = HTTPR_ERR_RECEIVE;
+
+			return false;
+		}
+
+		if (!size)
+			break;
+
+		if (!ring_drain (ring, size, sink, userdata))
+			return false;
+
+		if (!ring_readln (ring, line, sizeof (line)) || line[0]) {
+			result = HTTPR_ERR_RECEIVE;
+
+			return false;
+		}
+	}
+
+	// Skip the trailer
+	do {
+		if (!ring_readln (ring, line, sizeof (line))) {
+			result = HTTPR_ERR_RECEIVE;
+
+			return false;
+		}
+	} while (line[0]);
+
+	return true;
+}
+
+// The connection of the last streamed request stays open for the next one
+// to the same host, until the server asks to close it, something goes wrong
+// or the caller is done with it and calls http_close
+static http_ring http_conn = { -1, NULL, 0, 0 };
+static char *http_conn_host = NULL;
+static u16 http_conn_port;
+
+void http_close (void) {
+	if (http_conn.s >= 0)
+		net_close (http_conn.s);
+	http_conn.s = -1;
+	free (http_conn.data);
+	http_conn.data = NULL;
+	free (http_conn_host);
+	http_conn_host = NULL;
+}
+
+static bool http_open (bool *reused) {
+	*reused = http_conn.s >= 0 && http_conn_port == http_port && !strcmp (http_conn_host, http_host);
+	if (*reused)
+		return true;
+
+	http_close ();
+
+	s32 s = tcp_connect (http_host, http_port);
+	if (s < 0)
+		return false;
+
+	http_conn.s = s;
+	http_conn.data = (u8 *) malloc (HTTP_RING_SIZE);
+	http_conn.head = 0;
+	http_conn.count = 0;
+	http_conn_host = strdup (http_host);
+	http_conn_port = http_port;
+	if (!http_conn.data || !http_conn_host) {
+		http_close ();
+		return false;
+	}
+
+	return true;
+}
+
+bool http_request_stream (const char *url, http_sink sink, void *userdata) {
+	char line[HTTP_LINE_LENGTH];
+	bool chunked, keepalive, reused, b;
+	int linecount, attempt;
+
 	if (!http_split_url(&http_host, &http_path, url)) return false;
 
 	http_port = 80;
-	http_max_size = max_size;
-	
+
 	http_status = 404;
 	content_length = 0;
 	http_data = NULL;
-
-	int s = tcp_connect (http_host, http_port);
-//	debug_printf("tcp_connect(%s, %hu) = %d\n", http_host, http_port, s);
-	if (s < 0) {
-		result = HTTPR_ERR_CONNECT;
-		return false;
-	}
+	chunked = false;
 
 	char *request = (char *) malloc (1024);
 	char *r = request;
 	r += sprintf (r, "GET %s HTTP/1.1\r\n", http_path);
 	r += sprintf (r, "Host: %s\r\n", http_host);
+	r += sprintf (r, "Connection: keep-alive\r\n");
 	r += sprintf (r, "Cache-Control: no-cache\r\n\r\n");
 
-//	debug_printf("request = %s\n", request);
+	// A kept connection may have been dropped by the server in the meantime,
+	// in which case the request is sent again on a fresh one
+	for (attempt = 0; attempt < 2; attempt++) {
+		if (!http_open (&reused)) {
+			free (request);
+			result = HTTPR_ERR_CONNECT;
+			return false;
+		}
+
+		b = tcp_write (http_conn.s, (u8 *) request, strlen (request)) &&
+			ring_readln (&http_conn, line, sizeof (line));
+		if (b)
+			break;
 
-	bool b = tcp_write (s, (u8 *) request, strlen (request));
-//	debug_printf("tcp_write returned %d\n", b);
+		http_close ();
+		if (!reused)
+			break;
+	}
 
 	free (request);
-	linecount = 0;
+
+	if (!b) {
+		result = HTTPR_ERR_REQUEST;
+		return false;
+	}
+
+	sscanf (line, "HTTP/1.%*u %u", &http_status);
+	// HTTP/1.0 servers close unless they say otherwise
+	keepalive = strncmp (line, "HTTP/1.0", 8) != 0;
 
 	for (linecount=0; linecount < 32; linecount++) {
-	  char *line = tcp_readln(s, 0xff, gettime(), HTTP_TIMEOUT);
-//		debug_printf("tcp_readln returned %p (%s)\n", line, line?line:"(null)");
-		if (!line) {
+		if (!ring_readln (&http_conn, line, sizeof (line))) {
 			http_status = 404;
 			result = HTTPR_ERR_REQUEST;
-			break;
+			http_close ();
+			return false;
 		}
 
-		if (strlen (line) < 1) {
-			free (line);
-			line = NULL;
+		if (!line[0])
 			break;
-		}
 
-		sscanf (line, "HTTP/1.%*u %u", &http_status);
 		sscanf (line, "Content-Length: %u", &content_length);
-
-		free (line);
-		line = NULL;
-
+		if (!strncasecmp (line, "Transfer-Encoding:", 18) && strstr (line + 18, "chunked"))
+			chunked = true;
+		if (!strncasecmp (line, "Connection:", 11)) {
+			if (strstr (line + 11, "close"))
+				keepalive = false;
+			else if (strstr (line + 11, "keep-alive"))
+				keepalive = true;
+		}
 	}
-//	debug_printf("content_length = %d, status = %d, linecount = %d\n", content_length, http_status, linecount);
-	if (linecount == 32 || !content_length) http_status = 404;
+
+	if (linecount == 32 || (!content_length && !chunked)) http_status = 404;
 	if (http_status != 200) {
 		result = HTTPR_ERR_STATUS;
-		net_close (s);
+		http_close ();
 		return false;
 	}
-	if (content_length > http_max_size) {
-		result = HTTPR_ERR_TOOBIG;
-		net_close (s);
+
+	if (chunked) {
+		content_length = 0;
+		b = http_read_chunked (&http_conn, sink, userdata);
+	} else
+		b = ring_drain (&http_conn, content_length, sink, userdata);
+
+	// An aborted body is still in flight, the connection can't be reused
+	if (!b || !keepalive)
+		http_close ();
+
+	if (b)
+		result = HTTPR_OK;
+
+	return b;
+}
+
+typedef struct {
+	u8 *data;
+	u32 length;
+	u32 capacity;
+	u32 max_size;
+} http_buffer;
+
+static bool http_buffer_sink (void *userdata, const u8 *data, const u32 length) {
+	http_buffer *buffer = (http_buffer *) userdata;
+	u32 capacity;
+	u8 *grown;
+
+	if (content_length > buffer->max_size || length > buffer->max_size - buffer->length)
 		return false;
+
+	if (buffer->length + length > buffer->capacity) {
+		// Sized up front when the length is known, doubled for chunked bodies
+		capacity = content_length ? content_length : buffer->capacity * 2;
+		if (capacity < buffer->length + length)
+			capacity = buffer->length + length;
+		if (capacity < 0x1000)
+			capacity = 0x1000;
+		if (capacity > buffer->max_size)
+			capacity = buffer->max_size;
+
+		grown = (u8 *) memalign (32, capacity);
+		if (!grown)
+			return false;
+		if (buffer->data) {
+			memcpy (grown, buffer->data, buffer->length);
+			free (buffer->data);
+		}
+		buffer->data = grown;
+		buffer->capacity = capacity;
 	}
-	http_data = (u8 *) memalign(32, content_length);
-	b = tcp_read (s, &http_data, content_length);
+
+	memcpy (buffer->data + buffer->length, data, length);
+	buffer->length += length;
+
+	return true;
+}
+
+bool http_request (const char *url, const u32 max_size) {
+	http_buffer buffer;
+	bool b;
+
+	http_max_size = max_size;
+
+	buffer.data = NULL;
+	buffer.length = 0;
+	buffer.capacity = 0;
+	buffer.max_size = max_size;
+
+	b = http_request_stream (url, http_buffer_sink, &buffer);
+
+	// One-shot requests don't keep the connection or its ring around
+	http_close ();
+
 	if (!b) {
-		free (http_data);
-		http_data = NULL;
-		result = HTTPR_ERR_RECEIVE;
-		net_close (s);
+		// The buffering sink only gives up when the body doesn't fit
+		if (result == HTTPR_ERR_ABORTED)
+			result = HTTPR_ERR_TOOBIG;
+		free (buffer.data);
 		return false;
 	}
 
-	result = HTTPR_OK;
-
-	net_close (s);
+	http_data = buffer.data;
+	content_length = buffer.length;
 
 	return true;
 }
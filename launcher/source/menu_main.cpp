@@ -27,9 +27,13 @@ static volatile int exitRequested2 = 0;
 
 using std::string;
 
+// A page is only a window into its section's options, the rows showing it
+// are bound when the page is opened
 struct Page {
-	string Name;
-	vector<RiiOption*> Options;
+	RiiSection* Section;
+	u32 First;
+	u32 Count;
+	int Number; // 0 if the section fits on one page
 };
 
 RiiDisc Disc;
@@ -38,6 +42,15 @@ vector<int> ToMount;
 
 static vector<Page> Pages;
 
+static string PageName(Page* page)
+{
+	if (!page->Number)
+		return page->Section->Name;
+
+	char num[0x10]; sprintf(num, "", page->Number);
+	return page->Section->Name + " [" + num + "]";
+}
+
 
 extern "C" {
 	extern u8 arrow_left_png[];
@@ -71,6 +84,25 @@ extern "C" {
 	extern u8 rebooting_png[];
 }
 
+// Images of the screens a menu can lead to, decoded in the background while it is shown
+static u8* const MainMenuImages[] = {
+	optionsover_png, optionsover2_png, updateover_png, updateover2_png, launchover_png, launchover2_png,
+	exitover_png, exitover2_png, installover_png, installover2_png, NULL
+};
+static u8* const MainMenuNextImages[] = {
+	back_png, backover_png, arrow_left_png, arrow_active_left_png, arrow_right_png, arrow_active_right_png,
+	updateconfirm_png, yes_png, yesselect_png, no_png, noselect_png, NULL
+};
+static u8* const UpdateConfirmNextImages[] = {
+	updating_png, rebooting_png, NULL
+};
+
+static void PrefetchImages(u8* const* images)
+{
+	for (; *images; images++)
+		GuiImageData::Prefetch(*images);
+}
+
 #define UNSELECT_ALL() { \
 	for (int unselect = Window->GetSelected(); unselect >= 0; unselect = Window->GetSelected()) \
 		Window->GetGuiElementAt(unselect)->ResetState(); \
@@ -80,16 +112,18 @@ struct PageViewer {
 	u32 PageNumber;
 	Page* Current;
 
-	GuiText** Title;
-	GuiText** ChoiceText;
-	GuiText** ChoiceOverText;
-	GuiButton** Choice;
-	GuiImage** LeftArrowImage;
-	GuiImage** LeftArrowOverImage;
-	GuiImage** RightArrowImage;
-	GuiImage** RightArrowOverImage;
-	GuiButton** LeftArrow;
-	GuiButton** RightArrow;
+	// One row per option slot, kept for the life of the viewer and rebound
+	// to the options of whichever page is open
+	GuiText* Title[OPTIONS_PER_PAGE];
+	GuiText* ChoiceText[OPTIONS_PER_PAGE];
+	GuiText* ChoiceOverText[OPTIONS_PER_PAGE];
+	GuiButton* Choice[OPTIONS_PER_PAGE];
+	GuiImage* LeftArrowImage[OPTIONS_PER_PAGE];
+	GuiImage* LeftArrowOverImage[OPTIONS_PER_PAGE];
+	GuiImage* RightArrowImage[OPTIONS_PER_PAGE];
+	GuiImage* RightArrowOverImage[OPTIONS_PER_PAGE];
+	GuiButton* LeftArrow[OPTIONS_PER_PAGE];
+	GuiButton* RightArrow[OPTIONS_PER_PAGE];
 
 	GuiText* PageText;
 	GuiText* PageNumberText;
@@ -151,6 +185,8 @@ struct PageViewer {
 			Window->Append(RightButton);
 		}
 
+		CreateRows();
+
 		if (Pages.size())
 			SetPage(0);
 	}
@@ -177,7 +213,7 @@ struct PageViewer {
 			delete RightArrowOverImageData;
 		}
 
-		CleanPage();
+		DestroyRows();
 	}
 
 	const char* GetChoiceText(RiiOption* option)
@@ -191,94 +227,27 @@ struct PageViewer {
 		return option->Choices[option->Default - 1].Name.c_str();
 	}
 
-	void CleanPage()
+	RiiOption* GetOption(u32 index)
 	{
-		if (!Current)
-			return;
-
-		HaltGui();
-
-		for (u32 i = 0; i < Current->Options.size(); i++) {
-			Window->Remove(Title[i]);
-			Window->Remove(Choice[i]);
-			Window->Remove(LeftArrow[i]);
-			Window->Remove(RightArrow[i]);
-
-			delete Title[i];
-			delete Choice[i];
-			delete ChoiceText[i];
-			delete ChoiceOverText[i];
-			delete LeftArrowImage[i];
-			delete LeftArrowOverImage[i];
-			delete RightArrowImage[i];
-			delete RightArrowOverImage[i];
-			delete RightArrow[i];
-			delete LeftArrow[i];
-		}
-
-		delete[] Title;
-		delete[] ChoiceText;
-		delete[] ChoiceOverText;
-		delete[] Choice;
-		delete[] LeftArrowImage;
-		delete[] LeftArrowOverImage;
-		delete[] RightArrowImage;
-		delete[] RightArrowOverImage;
-		delete[] LeftArrow;
-		delete[] RightArrow;
-
-		Current = NULL;
-
-		ResumeGui();
+		return &Current->Section->Options[Current->First + index];
 	}
 
-	void SetPage(u32 page)
+	void CreateRows()
 	{
-		CleanPage();
-
-		if (page >= Pages.size())
-			return;
-
 		HaltGui();
 
-		PageNumber = page;
-		Current = &Pages[PageNumber];
-
-		Subtitle->SetText(Current->Name.c_str());
-
-		if (Pages.size() > 1) {
-			char pagenum[0x10];
-			sprintf(pagenum, "", PageNumber + 1);
-			PageNumberText->SetText(pagenum);
-		}
-
-		int options = Current->Options.size();
-		Title = new GuiText*[options];
-		ChoiceText = new GuiText*[options];
-		ChoiceOverText = new GuiText*[options];
-		Choice = new GuiButton*[options];
-		LeftArrowImage = new GuiImage*[options];
-		LeftArrowOverImage = new GuiImage*[options];
-		RightArrowImage = new GuiImage*[options];
-		RightArrowOverImage = new GuiImage*[options];
-		LeftArrow = new GuiButton*[options];
-		RightArrow = new GuiButton*[options];
-
-
-		u32 i = 0;
-		for (vector<RiiOption*>::iterator iter = Current->Options.begin(); iter != Current->Options.end(); iter++, i++) {
+		for (u32 i = 0; i < OPTIONS_PER_PAGE; i++) {
 			int y = 72 + i * OPTION_FONT_HEIGHT;
-			RiiOption* option = *iter;
 
-			GuiText* title = new GuiText(option->Name.c_str(), OPTION_FONT_SIZE, (GXColor){255, 255, 255, 255}); Title[i] = title;
+			GuiText* title = new GuiText("", OPTION_FONT_SIZE, (GXColor){255, 255, 255, 255}); Title[i] = title;
 			title->SetAlignment(ALIGN_LEFT, ALIGN_TOP);
 			title->SetPosition(39, y);
 			Window->Append(title);
 
-			GuiText* choiceText = new GuiText(GetChoiceText(option), OPTION_FONT_SIZE, (GXColor){255, 255, 255, 255}); ChoiceText[i] = choiceText;
+			GuiText* choiceText = new GuiText("", OPTION_FONT_SIZE, (GXColor){255, 255, 255, 255}); ChoiceText[i] = choiceText;
 			choiceText->SetAlignment(ALIGN_LEFT, ALIGN_TOP);
 			choiceText->SetPosition(0, 0);
-			GuiText* choiceOverText = new GuiText(GetChoiceText(option), OPTION_FONT_SIZE, (GXColor){0, 140, 255, 255}); ChoiceOverText[i] = choiceOverText;
+			GuiText* choiceOverText = new GuiText("", OPTION_FONT_SIZE, (GXColor){0, 140, 255, 255}); ChoiceOverText[i] = choiceOverText;
 			choiceOverText->SetAlignment(ALIGN_LEFT, ALIGN_TOP);
 			choiceOverText->SetPosition(0, 0);
 
@@ -310,6 +279,83 @@ struct PageViewer {
 			rightArrow->SetPosition(604, y + OPTION_ARROW_OFFSET);
 			rightArrow->SetTrigger(&Trigger[Triggers::Select]);
 			Window->Append(rightArrow);
+
+			ShowRow(i, false);
+		}
+
+		ResumeGui();
+	}
+
+	void DestroyRows()
+	{
+		HaltGui();
+
+		for (u32 i = 0; i < OPTIONS_PER_PAGE; i++) {
+			Window->Remove(Title[i]);
+			Window->Remove(Choice[i]);
+			Window->Remove(LeftArrow[i]);
+			Window->Remove(RightArrow[i]);
+
+			delete Title[i];
+			delete Choice[i];
+			delete ChoiceText[i];
+			delete ChoiceOverText[i];
+			delete LeftArrowImage[i];
+			delete LeftArrowOverImage[i];
+			delete RightArrowImage[i];
+			delete RightArrowOverImage[i];
+			delete RightArrow[i];
+			delete LeftArrow[i];
+		}
+
+		Current = NULL;
+
+		ResumeGui();
+	}
+
+	void ShowRow(u32 index, bool show)
+	{
+		GuiButton* buttons[] = { Choice[index], LeftArrow[index], RightArrow[index] };
+
+		Title[index]->SetVisible(show);
+		for (u32 i = 0; i < sizeof(buttons) / sizeof(*buttons); i++) {
+			buttons[i]->SetVisible(show);
+			if (show)
+				buttons[i]->SetState(STATE_DEFAULT);
+			else
+				buttons[i]->SetState(STATE_DISABLED);
+		}
+	}
+
+	void SetPage(u32 page)
+	{
+		if (page >= Pages.size())
+			return;
+
+		HaltGui();
+
+		PageNumber = page;
+		Current = &Pages[PageNumber];
+
+		Subtitle->SetText(PageName(Current).c_str());
+
+		if (Pages.size() > 1) {
+			char pagenum[0x10];
+			sprintf(pagenum, "", PageNumber + 1);
+			PageNumberText->SetText(pagenum);
+		}
+
+		for (u32 i = 0; i < OPTIONS_PER_PAGE; i++) {
+			if (i >= Current->Count) {
+				ShowRow(i, false);
+				continue;
+			}
+
+			RiiOption* option = GetOption(i);
+			Title[i]->SetText(option->Name.c_str());
+			ChoiceText[i]->SetText(GetChoiceText(option));
+			ChoiceOverText[i]->SetText(GetChoiceText(option));
+			ShowRow(i, true);
 		}
 
 		ResumeGui();
@@ -333,19 +379,20 @@ struct PageViewer {
 		if (!Current)
 			return;
 
-		for (u32 i = 0; i < Current->Options.size(); i++) {
+		for (u32 i = 0; i < Current->Count; i++) {
+			RiiOption* option = GetOption(i);
 			if (RightArrow[i]->GetState() == STATE_CLICKED || Choice[i]->GetState() == STATE_CLICKED) {
 				UNSELECT_ALL();
 				if (RightArrow[i]->GetState() == STATE_CLICKED)
 					RightArrow[i]->SetState(STATE_SELECTED, RightArrow[i]->GetStateChan());
 				if (Choice[i]->GetState() == STATE_CLICKED)
 					Choice[i]->SetState(STATE_SELECTED, Choice[i]->GetStateChan());
-				SetOption(i, Current->Options[i], Wrap(Current->Options[i]->Default + 1, Current->Options[i]->Choices.size() + 1));
+				SetOption(i, option, Wrap(option->Default + 1, option->Choices.size() + 1));
 			}
 			if (LeftArrow[i]->GetState() == STATE_CLICKED) {
 				UNSELECT_ALL();
 				LeftArrow[i]->SetState(STATE_SELECTED, LeftArrow[i]->GetStateChan());
-				SetOption(i, Current->Options[i], Wrap(Current->Options[i]->Default - 1, Current->Options[i]->Choices.size() + 1));
+				SetOption(i, option, Wrap(option->Default - 1, option->Choices.size() + 1));
 			}
 		}
 	}
@@ -372,17 +419,42 @@ struct PageViewer {
 	}
 };
 
-Menus::Enum MenuMount()
-{
+// Device mounting and XML reading only talk to the file module, so they run
+// here while the main thread brings up DI and waits for the disc.
+static lwp_t discoverythread = LWP_THREAD_NULL;
+static u8 discoverystack[0x8000] ATTRIBUTE_ALIGN(32);
+static vector<RiiXMLFile> DiscoveredXMLs;
 
-	Haxx_Mount(&Mounted);
+static void* DiscoverXMLs(void*)
+{
+	if (!Mounted.size())
+		Haxx_Mount(&Mounted);
 	Launcher_ScrubPlaytimeEntry();
 
-	while (!Mounted.size()) {
-		HaltGui(); Subtitle->SetText("Insert SD/USB..."); ResumeGui();
-		Haxx_Mount(&Mounted);
+	for (vector<int>::iterator mount = Mounted.begin(); mount != Mounted.end(); mount++)
+		PrefetchXMLs(*mount, &DiscoveredXMLs);
+
+	return NULL;
+}
+
+static void JoinDiscovery()
+{
+	if (discoverythread == LWP_THREAD_NULL)
+		return;
+
+	LWP_JoinThread(discoverythread, NULL);
+	discoverythread = LWP_THREAD_NULL;
+}
+
+Menus::Enum MenuMount()
+{
+	PrefetchImages(MainMenuImages);
+
+	DiscoveredXMLs.clear();
+	if (LWP_CreateThread(&discoverythread, DiscoverXMLs, NULL, discoverystack, sizeof(discoverystack), 64) < 0) {
+		discoverythread = LWP_THREAD_NULL;
+		DiscoverXMLs(NULL);
 	}
-	HaltGui(); Subtitle->SetText(""); ResumeGui();
 
 	LauncherStatus::Enum status;
 
@@ -420,10 +492,22 @@ Menus::Enum MenuInit()
 		}
 	} while (status != LauncherStatus::OK);
 
-	vector<RiiDisc> discs;
-	for (vector<int>::iterator mount = Mounted.begin(); mount != Mounted.end(); mount++) {
-		ParseXMLs(*mount, &discs);
+	JoinDiscovery();
+
+	while (!Mounted.size()) {
+		HaltGui(); Subtitle->SetText("Insert SD/USB..."); ResumeGui();
+		DiscoverXMLs(NULL);
 	}
+	HaltGui(); Subtitle->SetText(""); ResumeGui();
+
+	// Re-entering after a disc swap, the XMLs from startup are already used up
+	if (!DiscoveredXMLs.size()) {
+		for (vector<int>::iterator mount = Mounted.begin(); mount != Mounted.end(); mount++)
+			PrefetchXMLs(*mount, &DiscoveredXMLs);
+	}
+
+	vector<RiiDisc> discs;
+	ParseXMLs(&DiscoveredXMLs, &discs);
 	for (vector<int>::iterator tomount = ToMount.begin(); tomount != ToMount.end(); tomount++) {
 		bool found = false;
 		for (vector<int>::iterator mount = Mounted.begin(); mount != Mounted.end(); mount++) {
@@ -462,32 +546,25 @@ Menus::Enum MenuInit()
 	return Menus::Main;
 }
 
-#define PAGENUM(page, pagenum) { \
-	char num[0x10]; sprintf(num, "", pagenum); \
-	page.Name = section->Name + " [" + num + "]"; \
-}
-
 static void PreparePages()
 {
 	Pages.clear();
 	for (vector<RiiSection>::iterator section = Disc.Sections.begin(); section != Disc.Sections.end(); section++) {
+		u32 options = section->Options.size();
 		Page page;
-		int pagenum = 1;
-		for (vector<RiiOption>::iterator option = section->Options.begin(); option != section->Options.end(); option++) {
-			if (page.Options.size() == OPTIONS_PER_PAGE) {
-				PAGENUM(page, pagenum++);
-				Pages.push_back(page);
-				page = Page();
-			}
-
-			page.Options.push_back(&*option);
-		}
-
-		if (pagenum > 1) {
-			PAGENUM(page, pagenum);
-		} else
-			page.Name = section->Name;
-		Pages.push_back(page);
+		page.Section = &*section;
+		page.First = 0;
+		page.Number = options > OPTIONS_PER_PAGE ? 1 : 0;
+
+		do {
+			page.Count = options - page.First;
+			if (page.Count > OPTIONS_PER_PAGE)
+				page.Count = OPTIONS_PER_PAGE;
+			Pages.push_back(page);
+
+			page.First += OPTIONS_PER_PAGE;
+			page.Number++;
+		} while (page.First < options);
 	}
 }
 
@@ -541,6 +618,8 @@ Menus::Enum MenuUpdateConfirm()
 	GuiImage* NoTestaImage;
 	GuiImage* NoTestaOverImage;
 
+	PrefetchImages(UpdateConfirmNextImages);
+
 	UpdateConfirmTestaImageData = new GuiImageData(updateconfirm_png);
 	YesTestaImageData = new GuiImageData(yes_png);
 	YesTestaOverImageData = new GuiImageData(yesselect_png);
@@ -695,6 +774,8 @@ Menus::Enum MenuMain()
 	GuiImage* ExitTestaImage;
 	GuiImage* ExitTestaOverImage;
 
+	PrefetchImages(MainMenuNextImages);
+
 	OptionsTestaImageData = new GuiImageData(optionsover_png);
 	OptionsTestaOverImageData = new GuiImageData(optionsover2_png);
 	UpdateTestaImageData = new GuiImageData(updateover_png);
@@ -451,40 +451,143 @@ static void RVL_Patch(RiiFilePatch* file, string commonfs, bool stat=false, u64
 	}
 }
 
-static void RVL_Patch(RiiFolderPatch* folder, string commonfs)
+struct FolderManifestHeader
 {
-	string external = folder->External;
-	if (commonfs.size() && !external.compare(0, commonfs.size(), commonfs, 0, commonfs.size()))
-		external = external.substr(commonfs.size());
+	u32 Magic;
+	u32 Version;
+	u32 Recursive;
+	u32 Entries;
+	u32 Length; // Of the records that follow, each a u32 size and a NUL-terminated relative path
+};
+
+static void RVL_PatchFolderFile(RiiFolderPatch* folder, string external, string commonfs, const char* name, u32 size, bool stat=false, u64 identifier=0)
+{
+	RiiFilePatch file;
+	file.Create = folder->Create;
+	file.Resize = folder->Resize;
+	file.Offset = 0;
+	file.FileOffset = 0;
+	file.Length = folder->Length ? folder->Length : size;
+	file.Disc = PathCombine(folder->Disc, name);
+	file.External = PathCombine(external, name);
+	RVL_Patch(&file, commonfs, stat, identifier);
+}
 
+// Patches each file as the walk finds it, and appends it to the manifest records
+static bool RVL_WalkFolder(RiiFolderPatch* folder, string external, string commonfs, string relative, string* records, u32* entries)
+{
 	char fdirname[MAXPATHLEN];
-	int fdir = File_OpenDir(external.c_str());
+	int fdir = File_OpenDir(PathCombine(external, relative).c_str());
 	if (fdir < 0)
-		return;
-	Stats stats;
-	while (!File_NextDir(fdir, fdirname, &stats)) {
+		return false;
+	Stats st;
+	while (!File_NextDir(fdir, fdirname, &st)) {
 		if (fdirname[0] == '.')
 			continue;
-		if (stats.Mode & S_IFDIR) {
-			if (folder->Recursive){
-				RiiFolderPatch newfolder = *folder;
-				newfolder.Disc = PathCombine(newfolder.Disc, fdirname);
-				newfolder.External = PathCombine(external, fdirname);
-				RVL_Patch(&newfolder, commonfs);
-			}
-		} else {
-			RiiFilePatch file;
-			file.Create = folder->Create;
-			file.Resize = folder->Resize;
-			file.Offset = 0;
-			file.FileOffset = 0;
-			file.Length = folder->Length ? folder->Length : stats.Size;
-			file.Disc = PathCombine(folder->Disc, fdirname);
-			file.External = PathCombine(external, fdirname);
-			RVL_Patch(&file, commonfs, true, stats.Identifier);
+		string name = PathCombine(relative, fdirname);
+		if (st.Mode & S_IFDIR) {
+			if (folder->Recursive)
+				RVL_WalkFolder(folder, external, commonfs, name, records, entries);
+			continue;
 		}
+		RVL_PatchFolderFile(folder, external, commonfs, name.c_str(), st.Size, true, st.Identifier);
+		u32 size = st.Size;
+		records->append((const char*)&size, sizeof(size));
+		records->append(name.c_str(), name.size() + 1);
+		(*entries)++;
 	}
 	File_CloseDir(fdir);
+	return true;
+}
+
+// Folder patches keep a listing of their files inside the folder itself, so
+// warm launches read one file instead of walking every directory. Only paths
+// and sizes are kept: the files are added by path, and the DIP module looks
+// each one up again, so a stale listing can't hand it clusters that were
+// freed. The updater deletes the listing whenever it touches the folder.
+static bool RVL_PatchFolderManifest(RiiFolderPatch* folder, string external, string commonfs)
+{
+	string path = PathCombine(external, FOLDER_MANIFEST_NAME);
+	Stats st;
+	if (File_Stat(path.c_str(), &st) || st.Size < sizeof(FolderManifestHeader))
+		return false;
+	int fd = File_Open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	u8* data = (u8*)memalign(0x20, ROUND_UP(st.Size, 0x20));
+	if (!data) {
+		File_Close(fd);
+		return false;
+	}
+	int read = File_Read(fd, data, st.Size);
+	File_Close(fd);
+
+	FolderManifestHeader* header = (FolderManifestHeader*)data;
+	const char* records = (const char*)(header + 1);
+	const char* end = (const char*)data + read;
+	bool valid = read == (int)st.Size && header->Magic == FOLDER_MANIFEST_MAGIC && header->Version == FOLDER_MANIFEST_VERSION &&
+		header->Recursive == (u32)folder->Recursive && header->Length == st.Size - sizeof(FolderManifestHeader);
+
+	// Check every record before patching anything, a bad listing falls back to the walk
+	const char* record = records;
+	for (u32 i = 0; valid && i < header->Entries; i++) {
+		const char* name = record + sizeof(u32);
+		const char* nul = name < end ? (const char*)memchr(name, '\0', end - name) : NULL;
+		if (!nul || nul == name)
+			valid = false;
+		else
+			record = nul + 1;
+	}
+	valid = valid && record == end;
+
+	record = records;
+	for (u32 i = 0; valid && i < header->Entries; i++) {
+		u32 size;
+		memcpy(&size, record, sizeof(size));
+		const char* name = record + sizeof(size);
+		RVL_PatchFolderFile(folder, external, commonfs, name, size);
+		record = name + strlen(name) + 1;
+	}
+	free(data);
+	return valid;
+}
+
+static void RVL_SaveFolderManifest(RiiFolderPatch* folder, string external, string* records, u32 entries)
+{
+	FolderManifestHeader header;
+	header.Magic = FOLDER_MANIFEST_MAGIC;
+	header.Version = FOLDER_MANIFEST_VERSION;
+	header.Recursive = folder->Recursive;
+	header.Entries = entries;
+	header.Length = records->size();
+
+	string path = PathCombine(external, FOLDER_MANIFEST_NAME);
+	File_CreateFile(path.c_str());
+	int fd = File_Open(path.c_str(), O_WRONLY | O_TRUNC);
+	if (fd < 0)
+		return;
+	bool written = File_Write(fd, &header, sizeof(header)) == sizeof(header);
+	if (written && records->size())
+		written = File_Write(fd, records->data(), records->size()) == (int)records->size();
+	File_Close(fd);
+
+	if (!written)
+		File_Delete(path.c_str()); // Never leave a partial listing behind
+}
+
+static void RVL_Patch(RiiFolderPatch* folder, string commonfs)
+{
+	string external = folder->External;
+	if (commonfs.size() && !external.compare(0, commonfs.size(), commonfs, 0, commonfs.size()))
+		external = external.substr(commonfs.size());
+
+	if (RVL_PatchFolderManifest(folder, external, commonfs))
+		return;
+
+	string records;
+	u32 entries = 0;
+	if (RVL_WalkFolder(folder, external, commonfs, "", &records, &entries))
+		RVL_SaveFolderManifest(folder, external, &records, entries);
 }
 
 static void RVL_Patch(RiiSavegamePatch* save, string commonfs)
@@ -676,6 +779,7 @@ void RVL_Unmount()
 }
 
 #define MEM_PHYSICAL_OR_K0(addr) ((addr) | 0x80000000)
+#define MEM1_END ((void*)0x817FFFFF)
 
 static void* FindInBuffer(void* memory, void* end, void* pattern, int patternlength, int align)
 {
@@ -686,69 +790,275 @@ static void* FindInBuffer(void* memory, void* end, void* pattern, int patternlen
 
 	return NULL;
 }
-static void RVL_Patch(RiiMemoryPatch* memory, map<string, string>* params)
+
+// All search and ocarina patterns of a launch are matched in a single pass.
+// Each pattern is keyed by its first word in a small hash table, so every
+// scanned position costs one lookup instead of one memcmp per patch.
+struct MemorySearch
 {
-	if (memory->Ocarina || (memory->Search && !memory->Original) || !memory->Offset || !memory->GetLength())
-		return;
+	u8* Pattern;
+	u32 Length;
+	u8* Start;
+	u32 Align;
+	u32 Anchor;
+	int Next;
+	u8* Found;
+};
+
+// Range an applied patch has written to, searches that overlap one are redone
+struct MemoryWrite
+{
+	u8* Start;
+	u32 Length;
+};
 
-	memory->Offset = (int)MEM_PHYSICAL_OR_K0(memory->Offset);
+struct PendingMemoryPatch
+{
+	RiiMemoryPatch* Patch;
+	string ValueFile;
+	void* Value;
+	int Search;
+};
 
-	if (memory->Search) {
-		// TODO: Searching in MEM2? Too bad.
-		void* ret = FindInBuffer((void*)memory->Offset, (void*)0x817FFFFF, memory->Original, memory->Length, memory->Align);
-		if (!ret)
-			return;
-		memory->Offset = (int)ret;
+static u32 MemorySearch_GCD(u32 a, u32 b)
+{
+	while (b) {
+		u32 t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+static int MemorySearch_Add(vector<MemorySearch>* searches, void* pattern, u32 length, void* start, u32 align)
+{
+	MemorySearch search;
+	search.Pattern = (u8*)pattern;
+	search.Length = length;
+	search.Start = (u8*)start;
+	search.Align = align;
+	search.Anchor = 0;
+	search.Next = -1;
+	search.Found = NULL;
+	searches->push_back(search);
+	return searches->size() - 1;
+}
+
+static void MemorySearch_Run(vector<MemorySearch>* searches, void* end)
+{
+	u8* scanstart = NULL;
+	u32 step = 0;
+	u32 remaining = 0;
+
+	for (vector<MemorySearch>::iterator search = searches->begin(); search != searches->end(); search++) {
+		if (!search->Align)
+			continue; // Would never advance
+		if (search->Length < sizeof(u32)) {
+			// Too short to anchor on, these are rare enough to scan for alone
+			search->Found = (u8*)FindInBuffer(search->Start, end, search->Pattern, search->Length, search->Align);
+			continue;
+		}
+		if (!scanstart || search->Start < scanstart)
+			scanstart = search->Start;
+		step = MemorySearch_GCD(step, search->Align);
+		remaining++;
 	}
 
-	if (memory->Original && memcmp((void*)memory->Offset, memory->Original, memory->GetLength()))
+	if (!remaining)
 		return;
 
-	string valuefile = memory->ValueFile;
-	ApplyParams(&valuefile, params);
-	void* value = memory->GetValue(valuefile);
-	if (value) {
-		memcpy((void*)memory->Offset, value, memory->GetLength());
-		DCFlushRange((void*)memory->Offset, memory->GetLength());
-		if (!memory->Value)
-			free(value);
+	// Every candidate position of every pattern must land on the scan grid
+	for (vector<MemorySearch>::iterator search = searches->begin(); search != searches->end(); search++) {
+		if (search->Align && search->Length >= sizeof(u32))
+			step = MemorySearch_GCD(step, (u32)(search->Start - scanstart));
+	}
+
+	u32 bits = 1;
+	while ((1U << bits) < remaining * 2)
+		bits++;
+	vector<int> buckets(1 << bits, -1);
+
+	for (u32 i = 0; i < searches->size(); i++) {
+		MemorySearch* search = &(*searches)[i];
+		if (!search->Align || search->Length < sizeof(u32))
+			continue;
+		memcpy(&search->Anchor, search->Pattern, sizeof(u32));
+		u32 bucket = (search->Anchor * 0x9E3779B1) >> (32 - bits);
+		search->Next = buckets[bucket];
+		buckets[bucket] = i;
+	}
+
+	for (u8* pos = scanstart; remaining && pos < (u8*)end - sizeof(u32); pos += step) {
+		u32 word;
+		memcpy(&word, pos, sizeof(u32));
+		for (int i = buckets[(word * 0x9E3779B1) >> (32 - bits)]; i >= 0; i = (*searches)[i].Next) {
+			MemorySearch* search = &(*searches)[i];
+			if (search->Found || search->Anchor != word || pos < search->Start || (u32)(pos - search->Start) % search->Align)
+				continue;
+			if (pos + search->Length >= (u8*)end)
+				continue;
+			if (!memcmp(pos + sizeof(u32), search->Pattern + sizeof(u32), search->Length - sizeof(u32))) {
+				search->Found = pos;
+				remaining--;
+			}
+		}
 	}
 }
 
-static void RVL_Patch(RiiMemoryPatch* memory, map<string, string>* params, void* mem, u32 length)
+// First position before limit where a write could have made a new match.
+// Matches at positions no write touched were all found by the single pass.
+static u8* MemorySearch_Rescan(MemorySearch* search, vector<MemoryWrite>* writes, u8* limit)
 {
-	if ((!memory->Ocarina && !memory->Search) || (memory->Search && !memory->Align) || (memory->Ocarina && !memory->Offset) || !memory->GetLength())
-		return;
+	for (vector<MemoryWrite>::iterator write = writes->begin(); write != writes->end(); write++) {
+		u8* pos = search->Start;
+		if (write->Start > search->Start + search->Length - 1)
+			pos = write->Start - search->Length + 1;
+		u32 skew = (u32)(pos - search->Start) % search->Align;
+		if (skew)
+			pos += search->Align - skew;
+		for (; pos < limit && pos < write->Start + write->Length; pos += search->Align) {
+			if (!memcmp(pos, search->Pattern, search->Length)) {
+				limit = pos;
+				break;
+			}
+		}
+	}
 
-	memory->Offset = (int)MEM_PHYSICAL_OR_K0(memory->Offset);
+	return limit;
+}
 
-	string valuefile = memory->ValueFile;
-	ApplyParams(&valuefile, params);
-	void* value = memory->GetValue(valuefile);
-	if (!value)
-		return;
+static void* MemorySearch_Get(vector<MemorySearch>* searches, int index, void* end, vector<MemoryWrite>* writes)
+{
+	MemorySearch* search = &(*searches)[index];
+
+	// An earlier patch may have created a match before this one, or overwritten it,
+	// in which case the search carries on past it as FindInBuffer would have
+	u8* last = (u8*)end - search->Length;
+	u8* found = search->Found ? search->Found : last;
+	u8* first = MemorySearch_Rescan(search, writes, found);
+	if (first < found)
+		return first;
+	if (!search->Found)
+		return NULL;
+	if (!memcmp(found, search->Pattern, search->Length))
+		return found;
+	return FindInBuffer(found + search->Align, end, search->Pattern, search->Length, search->Align);
+}
+
+static void MemorySearch_Wrote(vector<MemoryWrite>* writes, void* start, u32 length)
+{
+	MemoryWrite write;
+	write.Start = (u8*)start;
+	write.Length = length;
+	writes->push_back(write);
+}
+
+static void RVL_PatchMemory(vector<PendingMemoryPatch>* pending)
+{
+	vector<MemorySearch> searches;
+	for (vector<PendingMemoryPatch>::iterator entry = pending->begin(); entry != pending->end(); entry++) {
+		RiiMemoryPatch* memory = entry->Patch;
+		entry->Search = -1;
+		if (memory->Ocarina || (memory->Search && !memory->Original) || !memory->Offset || !memory->GetLength()) {
+			entry->Patch = NULL;
+			continue;
+		}
+
+		memory->Offset = (int)MEM_PHYSICAL_OR_K0(memory->Offset);
+
+		// TODO: Searching in MEM2? Too bad.
+		if (memory->Search)
+			entry->Search = MemorySearch_Add(&searches, memory->Original, memory->Length, (void*)memory->Offset, memory->Align);
+	}
+
+	MemorySearch_Run(&searches, MEM1_END);
+
+	vector<MemoryWrite> writes;
+	for (vector<PendingMemoryPatch>::iterator entry = pending->begin(); entry != pending->end(); entry++) {
+		RiiMemoryPatch* memory = entry->Patch;
+		if (!memory)
+			continue;
 
-	if (memory->Ocarina) {
-		void* ocarina = FindInBuffer(mem, (u8*)mem + length, value, memory->GetLength(), 4);
-		if (ocarina) {
-			u32* blr;
-			for (blr = (u32*)ocarina; (u8*)blr < (u8*)mem + length && *blr != 0x4E800020; blr++)
-				;
-			if ((u8*)blr < (u8*)mem + length)
-				*blr = ((memory->Offset - (int)blr) & 0x03FFFFFC) | 0x48000000;
+		if (entry->Search >= 0) {
+			void* ret = MemorySearch_Get(&searches, entry->Search, MEM1_END, &writes);
+			if (!ret)
+				continue;
+			memory->Offset = (int)ret;
 		}
-	} else /* if (memory->Search) */ {
-		void* ret = FindInBuffer(mem, (u8*)mem + length, memory->Original, memory->Length, memory->Align);
-		if (ret)
-			memcpy(ret, value, memory->GetLength());
+
+		if (memory->Original && memcmp((void*)memory->Offset, memory->Original, memory->GetLength()))
+			continue;
+
+		void* value = memory->GetValue(entry->ValueFile);
+		if (value) {
+			memcpy((void*)memory->Offset, value, memory->GetLength());
+			DCFlushRange((void*)memory->Offset, memory->GetLength());
+			MemorySearch_Wrote(&writes, (void*)memory->Offset, memory->GetLength());
+			if (!memory->Value)
+				free(value);
+		}
+	}
+}
+
+static void RVL_PatchMemory(vector<PendingMemoryPatch>* pending, void* mem, u32 length)
+{
+	vector<MemorySearch> searches;
+	void* end = (u8*)mem + length;
+	for (vector<PendingMemoryPatch>::iterator entry = pending->begin(); entry != pending->end(); entry++) {
+		RiiMemoryPatch* memory = entry->Patch;
+		entry->Value = NULL;
+		entry->Search = -1;
+		if ((!memory->Ocarina && !memory->Search) || (memory->Search && (!memory->Align || !memory->Original)) || (memory->Ocarina && !memory->Offset) || !memory->GetLength())
+			continue;
+
+		memory->Offset = (int)MEM_PHYSICAL_OR_K0(memory->Offset);
+
+		// Loading the value may update Length, so it has to happen before the search is queued
+		entry->Value = memory->GetValue(entry->ValueFile);
+		if (!entry->Value)
+			continue;
+
+		if (memory->Ocarina)
+			entry->Search = MemorySearch_Add(&searches, entry->Value, memory->GetLength(), mem, 4);
+		else
+			entry->Search = MemorySearch_Add(&searches, memory->Original, memory->Length, mem, memory->Align);
 	}
 
-	if (!memory->Value)
-		free(value);
+	MemorySearch_Run(&searches, end);
+
+	vector<MemoryWrite> writes;
+	for (vector<PendingMemoryPatch>::iterator entry = pending->begin(); entry != pending->end(); entry++) {
+		RiiMemoryPatch* memory = entry->Patch;
+		if (!entry->Value)
+			continue;
+
+		void* found = MemorySearch_Get(&searches, entry->Search, end, &writes);
+		if (memory->Ocarina) {
+			if (found) {
+				u32* blr;
+				for (blr = (u32*)found; (u8*)blr < (u8*)end && *blr != 0x4E800020; blr++)
+					;
+				if ((u8*)blr < (u8*)end) {
+					*blr = ((memory->Offset - (int)blr) & 0x03FFFFFC) | 0x48000000;
+					MemorySearch_Wrote(&writes, blr, sizeof(u32));
+				}
+			}
+		} else /* if (memory->Search) */ {
+			if (found) {
+				memcpy(found, entry->Value, memory->GetLength());
+				MemorySearch_Wrote(&writes, found, memory->GetLength());
+			}
+		}
+
+		if (!memory->Value)
+			free(entry->Value);
+	}
 }
 
 void RVL_PatchMemory(RiiDisc* disc, void* memory, u32 length)
 {
+	vector<PendingMemoryPatch> pending;
+
 	for (vector<RiiSection>::iterator section = disc->Sections.begin(); section != disc->Sections.end(); section++) {
 		for (vector<RiiOption>::iterator option = section->Options.begin(); option != section->Options.end(); option++) {
 			if (option->Default == 0)
@@ -764,10 +1074,13 @@ void RVL_PatchMemory(RiiDisc* disc, void* memory, u32 length)
 				params.insert(patch->Params.begin(), patch->Params.end());
 				RiiPatch* mem = &disc->Patches[patch->ID];
 				for (vector<RiiMemoryPatch>::iterator mempatch = mem->Memory.begin(); mempatch != mem->Memory.end(); mempatch++) {
-					if (memory)
-						RVL_Patch(&*mempatch, &params, memory, length);
-					else
-						RVL_Patch(&*mempatch, &params);
+					PendingMemoryPatch entry;
+					entry.Patch = &*mempatch;
+					entry.ValueFile = mempatch->ValueFile;
+					entry.Value = NULL;
+					entry.Search = -1;
+					ApplyParams(&entry.ValueFile, &params);
+					pending.push_back(entry);
 				}
 				if (patch->Params.size()) {
 					map<string, string>::iterator endi = params.begin();
@@ -778,4 +1091,9 @@ void RVL_PatchMemory(RiiDisc* disc, void* memory, u32 length)
 			}
 		}
 	}
+
+	if (memory)
+		RVL_PatchMemory(&pending, memory, length);
+	else
+		RVL_PatchMemory(&pending);
 }
@@ -143,7 +143,7 @@ static string AbsolutePathCombine(string path, string file, string rootfs)
 		return false; // Not an xml document
 
 
-bool ParseXMLs(int mnt, vector<RiiDisc>* discs)
+bool PrefetchXMLs(int mnt, vector<RiiXMLFile>* files)
 {
 	char mountpoint[MAXPATHLEN];
 	if (File_GetMountPoint(mnt, mountpoint, sizeof(mountpoint)) >= 0) {
@@ -151,17 +151,27 @@ bool ParseXMLs(int mnt, vector<RiiDisc>* discs)
 
 		strcpy(mountpath, mountpoint);
 		strcat(mountpath, RIIVOLUTION_PATH);
-		ParseXMLs(mountpath, mountpoint, mnt, discs);
+		PrefetchXMLs(mountpath, mountpoint, mnt, files);
 
 		strcpy(mountpath, mountpoint);
 		strcat(mountpath, RIIVOLUTION_PATH2);
-		ParseXMLs(mountpath, mountpoint, mnt, discs);
+		PrefetchXMLs(mountpath, mountpoint, mnt, files);
 	} else
 		return false;
 
 	return true;
 }
 
+bool ParseXMLs(int mnt, vector<RiiDisc>* discs)
+{
+	vector<RiiXMLFile> files;
+	if (!PrefetchXMLs(mnt, &files))
+		return false;
+
+	ParseXMLs(&files, discs);
+	return true;
+}
+
 bool ParseXML(const char* xmldata, int length, vector<RiiDisc>* discs, const char* rootpath, const char* rootfs, int fs)
 {
 	TRIM_XML();
@@ -568,7 +578,7 @@ RiiDisc CombineDiscs(vector<RiiDisc>* discs)
 	return ret;
 }
 
-void ParseXMLs(const char* rootpath, const char* rootfs, int fs, vector<RiiDisc>* discs)
+void PrefetchXMLs(const char* rootpath, const char* rootfs, int fs, vector<RiiXMLFile>* files)
 {
 	int dir = File_OpenDir(rootpath);
 	if (dir < 0)
@@ -587,17 +597,39 @@ void ParseXMLs(const char* rootpath, const char* rootfs, int fs, vector<RiiDisc>
 			if (fd < 0)
 				continue;
 			char* xmldata = (char*)memalign(0x20, ROUND_UP(st.Size, 0x20));
-			if (!xmldata)
+			if (!xmldata) {
+				File_Close(fd);
 				continue;
-			int read = File_Read(fd, xmldata, st.Size);
+			}
+			RiiXMLFile file;
+			file.Data = xmldata;
+			file.Length = File_Read(fd, xmldata, st.Size);
+			file.RootPath = rootpath;
+			file.RootFS = rootfs;
+			file.FS = fs;
 			File_Close(fd);
-			ParseXML(xmldata, read, discs, rootpath, rootfs, fs);
-			free(xmldata);
+			files->push_back(file);
 		}
 	}
 	File_CloseDir(dir);
 }
 
+void ParseXMLs(vector<RiiXMLFile>* files, vector<RiiDisc>* discs)
+{
+	for (vector<RiiXMLFile>::iterator file = files->begin(); file != files->end(); file++) {
+		ParseXML(file->Data, file->Length, discs, file->RootPath.c_str(), file->RootFS.c_str(), file->FS);
+		free(file->Data);
+	}
+	files->clear();
+}
+
+void ParseXMLs(const char* rootpath, const char* rootfs, int fs, vector<RiiDisc>* discs)
+{
+	vector<RiiXMLFile> files;
+	PrefetchXMLs(rootpath, rootfs, fs, &files);
+	ParseXMLs(&files, discs);
+}
+
 struct RiiConfig { string ID; int Default; };
 bool ParseConfigXML(const char* xmldata, int length, RiiDisc* disc)
 {
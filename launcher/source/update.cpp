@@ -4,6 +4,7 @@
 #include <mbedtls/sha1.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
 #include <gctypes.h>
 #include <gccore.h>
@@ -21,12 +22,15 @@
 #include "menu.h"
 #include "launcher.h"
 #include "riivolution_config.h"
+#include <map>
 
 #include "init.h"
 #include <unistd.h>
 #include <files.h>
 
 using std::vector;
+using std::string;
+using std::map;
 
 RiiDisc Disc2;
 vector<int> Mounted2;
@@ -90,36 +94,290 @@ int compareVersions(const char *localVersion, const char *onlineVersion) {
     return 0;
 }
 
-// Modify downloadFile function to create directory if needed
-void downloadFile(const char *url, const char *outputFilename) {
-    CURL *curl;
-    CURLcode res;
+// Folder patches cache their listing in a manifest inside the folder, drop
+// every one above a file we touched so the next launch re-enumerates.
+static void InvalidateFolderManifests(const char *path) {
+    char directory[MAX_PATH_LENGTH];
+    char manifest[MAX_PATH_LENGTH];
+    strncpy(directory, path, sizeof(directory) - 1);
+    directory[sizeof(directory) - 1] = '\0';
 
-    curl_global_init(CURL_GLOBAL_DEFAULT);
-    curl = curl_easy_init();
+    char *slash;
+    while ((slash = strrchr(directory, '/')) != NULL) {
+        *slash = '\0';
+        snprintf(manifest, sizeof(manifest), "%s/%s", directory, FOLDER_MANIFEST_NAME);
+        unlink(manifest);
+    }
+}
 
-    if (curl) {
+// Files are fetched this many at a time over a shared connection pool
+#define MAX_CONCURRENT_DOWNLOADS 4
+#define MAX_DOWNLOAD_ATTEMPTS 3
 
-        FILE *fp = fopen(outputFilename, "wb");
-        if (fp == NULL) {
-            printf("Error opening file %s for writing.\n", outputFilename);
-            return;
-        }
+// Downloads land in <path>.part and are only renamed over <path> once they
+// are complete, so an interrupted update never leaves a truncated file.
+// The ETag of the response is kept in <path>.etag so a later attempt can
+// resume the part with a Range request, guarded by If-Range.
+#define PART_SUFFIX ".part"
+#define ETAG_SUFFIX ".etag"
 
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
+struct DownloadJob {
+    string url;
+    string path;
+    FILE *fp;
+    int attempts;
+    bool failed;
+    const u8 *expected; // SHA-1 the file must have, or NULL
+    SHA1_CTX sha;
+    curl_slist *headers;
 
-        res = curl_easy_perform(curl);
+    DownloadJob() : fp(NULL), attempts(0), failed(false), expected(NULL), headers(NULL) { }
+};
 
-        if (res != CURLE_OK)
-            fprintf(stderr, "curl_easy_perform() failed: %s\n", curl_easy_strerror(res));
+static size_t JobWriteCallback(void *contents, size_t size, size_t nmemb, void *userp) {
+    DownloadJob *job = (DownloadJob *)userp;
+    if (job->expected)
+        SHA1Update(&job->sha, (unsigned char *)contents, size * nmemb);
+    return fwrite(contents, size, nmemb, job->fp);
+}
 
-        curl_easy_cleanup(curl);
+static size_t JobHeaderCallback(char *buffer, size_t size, size_t nitems, void *userp) {
+    DownloadJob *job = (DownloadJob *)userp;
+    size_t length = size * nitems;
+    if (length <= 5 || strncasecmp(buffer, "ETag:", 5))
+        return length;
+
+    string etag(buffer + 5, length - 5);
+    size_t start = etag.find_first_not_of(" \t");
+    size_t end = etag.find_last_not_of(" \t\r\n");
+    if (start == string::npos || end - start + 1 >= MAX_FIELD_LENGTH)
+        return length;
+
+    FILE *fp = fopen((job->path + ETAG_SUFFIX).c_str(), "w");
+    if (fp) {
+        fputs(etag.substr(start, end - start + 1).c_str(), fp);
         fclose(fp);
     }
+    return length;
+}
+
+static void discardPart(DownloadJob *job) {
+    unlink((job->path + PART_SUFFIX).c_str());
+    unlink((job->path + ETAG_SUFFIX).c_str());
+}
+
+// Opens the part file, returning how much of it is already there
+static curl_off_t openPart(DownloadJob *job, char *etag) {
+    string part = job->path + PART_SUFFIX;
+    struct stat st;
+    etag[0] = '\0';
+    if (!stat(part.c_str(), &st) && st.st_size > 0) {
+        FILE *fp = fopen((job->path + ETAG_SUFFIX).c_str(), "r");
+        if (fp) {
+            if (!fgets(etag, MAX_FIELD_LENGTH, fp))
+                etag[0] = '\0';
+            fclose(fp);
+        }
+    }
+
+    if (etag[0] == '\0') {
+        job->fp = fopen(part.c_str(), "wb");
+        return 0;
+    }
+
+    job->fp = fopen(part.c_str(), "r+b");
+    if (job->fp == NULL)
+        return 0;
 
-    curl_global_cleanup();
+    // The hash covers the whole file, so feed it what we already have
+    if (job->expected) {
+        unsigned char buffer[0x1000];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), job->fp)) > 0)
+            SHA1Update(&job->sha, buffer, read);
+    }
+    fseek(job->fp, 0, SEEK_END);
+    return ftell(job->fp);
+}
+
+static bool startDownload(CURLM *multi, CURL *curl, DownloadJob *job) {
+    char etag[MAX_FIELD_LENGTH];
+    if (job->expected)
+        SHA1Init(&job->sha);
+    curl_off_t offset = openPart(job, etag);
+    if (job->fp == NULL) {
+        printf("Error opening file %s for writing.\n", job->path.c_str());
+        return false;
+    }
+    job->attempts++;
+
+    // If the file changed since the part was written the server sends all of
+    // it instead, which curl reports as CURLE_RANGE_ERROR
+    job->headers = NULL;
+    if (offset) {
+        string ifrange = string("If-Range: ") + etag;
+        job->headers = curl_slist_append(NULL, ifrange.c_str());
+        printf("Resuming %s at %lld KB\n", job->path.c_str(), (long long)(offset / 1024));
+    }
+
+    curl_easy_setopt(curl, CURLOPT_URL, job->url.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, JobWriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, job);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, JobHeaderCallback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, job);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, job->headers);
+    curl_easy_setopt(curl, CURLOPT_RESUME_FROM_LARGE, offset);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, job);
+    curl_multi_add_handle(multi, curl);
+    return true;
+}
+
+// Moves a finished part over the real file. FAT can't rename over an
+// existing file, so the old one is removed first; until then the previous
+// version stays intact.
+static bool finishPart(DownloadJob *job) {
+    string part = job->path + PART_SUFFIX;
+    unlink(job->path.c_str());
+    if (rename(part.c_str(), job->path.c_str())) {
+        printf("Error renaming %s.\n", part.c_str());
+        return false;
+    }
+    unlink((job->path + ETAG_SUFFIX).c_str());
+    return true;
+}
+
+// Downloads every job, keeping up to MAX_CONCURRENT_DOWNLOADS transfers in
+// flight. The easy handles are reused between files so their connections
+// stay open. Returns the number of files that could not be downloaded.
+static int downloadFiles(vector<DownloadJob> &jobs) {
+    if (jobs.empty())
+        return 0;
+
+    CURLM *multi = curl_multi_init();
+    if (multi == NULL)
+        return jobs.size();
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)MAX_CONCURRENT_DOWNLOADS);
+
+    vector<CURL *> idle;
+    for (int i = 0; i < MAX_CONCURRENT_DOWNLOADS && i < (int)jobs.size(); i++) {
+        CURL *curl = curl_easy_init();
+        if (curl)
+            idle.push_back(curl);
+    }
+    int handles = idle.size();
+
+    vector<DownloadJob *> pending;
+    for (vector<DownloadJob>::reverse_iterator job = jobs.rbegin(); job != jobs.rend(); job++)
+        pending.push_back(&*job);
+
+    int finished = 0;
+    int failed = 0;
+    int running = 0;
+    curl_off_t received = 0;
+    while (finished < (int)jobs.size()) {
+        while (!idle.empty() && !pending.empty()) {
+            DownloadJob *job = pending.back();
+            pending.pop_back();
+            if (startDownload(multi, idle.back(), job)) {
+                idle.pop_back();
+                running++;
+            } else {
+                job->failed = true;
+                finished++;
+                failed++;
+            }
+        }
+
+        if (running == 0) {
+            // Nothing in flight and nothing startable, every handle failed to init
+            if (handles == 0) {
+                for (vector<DownloadJob *>::iterator job = pending.begin(); job != pending.end(); job++)
+                    (*job)->failed = true;
+                failed += pending.size();
+            }
+            break;
+        }
+
+        curl_multi_perform(multi, &running);
+
+        CURLMsg *msg;
+        int queued;
+        while ((msg = curl_multi_info_read(multi, &queued)) != NULL) {
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+
+            CURL *curl = msg->easy_handle;
+            CURLcode res = msg->data.result;
+            DownloadJob *job;
+            curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char **)&job);
+            curl_multi_remove_handle(multi, curl);
+            idle.push_back(curl);
+            fclose(job->fp);
+            job->fp = NULL;
+            curl_slist_free_all(job->headers);
+            job->headers = NULL;
+
+            curl_off_t size = 0;
+            curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &size);
+            received += size;
+
+            bool ok = res == CURLE_OK;
+            // An error response (a 404 for an unpublished file, say) won't change on a retry
+            bool retry = res != CURLE_HTTP_RETURNED_ERROR;
+            if (res != CURLE_OK) {
+                fprintf(stderr, "Downloading %s failed: %s\n", job->url.c_str(), curl_easy_strerror(res));
+
+                // The part is stale (file changed) or already too long, start over
+                long code = 0;
+                curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+                if (res == CURLE_RANGE_ERROR || code == 416) {
+                    discardPart(job);
+                    retry = true;
+                }
+            } else if (job->expected) {
+                sha1 hash;
+                SHA1Final(hash, &job->sha);
+                if (memcmp(hash, job->expected, sizeof(hash))) {
+                    fprintf(stderr, "Downloading %s failed: SHA-1 mismatch\n", job->url.c_str());
+                    discardPart(job);
+                    ok = false;
+                }
+            }
+            if (ok)
+                ok = finishPart(job);
+
+            if (!ok) {
+                // Whatever made it into the part is kept for the next attempt
+                if (retry && job->attempts < MAX_DOWNLOAD_ATTEMPTS) {
+                    pending.push_back(job);
+                    continue;
+                }
+                job->failed = true;
+                failed++;
+            } else
+                printf("Downloaded: %s (%d/%d, %lld KB)\n", job->path.c_str(), finished + 1, (int)jobs.size(), (long long)(received / 1024));
+            InvalidateFolderManifests(job->path.c_str());
+            finished++;
+        }
+
+        // The loop above may have freed handles for pending jobs, only block if it didn't
+        if (finished < (int)jobs.size() && (idle.empty() || pending.empty()))
+            curl_multi_wait(multi, NULL, 0, 1000, NULL);
+    }
+
+    for (vector<CURL *>::iterator curl = idle.begin(); curl != idle.end(); curl++)
+        curl_easy_cleanup(*curl);
+    curl_multi_cleanup(multi);
+
+    return failed;
+}
+
+void downloadFile(const char *url, const char *outputFilename) {
+    vector<DownloadJob> jobs(1);
+    jobs[0].url = url;
+    jobs[0].path = outputFilename;
+    downloadFiles(jobs);
 }
 
 void updateLocalVersion(const char *newVersion) {
@@ -137,13 +395,13 @@ void downloadFilesFromVersionFile(const char *versionFileURL, const char *localV
     CURL *curl;
     CURLcode res;
 
-    curl_global_init(CURL_GLOBAL_DEFAULT);
     curl = curl_easy_init();
 
     if (curl) {
         FILE *versionFile = fopen("PUT SD CARD FILELIST TXT HERE", "wb");
         if (versionFile == NULL) {
             printf("Error opening version.txt for writing.\n");
+            curl_easy_cleanup(curl);
             return;
         }
 
@@ -160,8 +418,6 @@ void downloadFilesFromVersionFile(const char *versionFileURL, const char *localV
         curl_easy_cleanup(curl);
     }
 
-    curl_global_cleanup();
-
     printf("Contents of version.txt:\n");
     FILE *versionFileContents = fopen("PUT SD CARD FILELIST TXT HERE", "r");
     if (versionFileContents) {
@@ -169,6 +425,8 @@ void downloadFilesFromVersionFile(const char *versionFileURL, const char *localV
         char url[MAX_URL_LENGTH];
         char outputFilename[MAX_FILENAME_LENGTH];
         char directoryName[MAX_FIELD_LENGTH];
+        char newestVersion[MAX_VERSION_LENGTH] = "";
+        vector<DownloadJob> jobs;
 
         while (fscanf(versionFileContents, "%s %s %s %s", onlineVersion, url, outputFilename, directoryName) == 4) {
             // Construct the full path including the directory
@@ -185,9 +443,12 @@ void downloadFilesFromVersionFile(const char *versionFileURL, const char *localV
             int comparisonResult = compareVersions(localVersion, onlineVersion);
 
             if (comparisonResult < 0) {
-                downloadFile(url, outputFilename);
-                printf("Downloaded: %s\n", outputFilename);
-                updateLocalVersion(onlineVersion);
+                DownloadJob job;
+                job.url = url;
+                job.path = outputFilename;
+                jobs.push_back(job);
+                if (newestVersion[0] == '\0' || compareVersions(newestVersion, onlineVersion) < 0)
+                    strcpy(newestVersion, onlineVersion);
             } else if (comparisonResult == 0) {
                 printf("Local version is up-to-date.\n");
             } else {
@@ -196,6 +457,10 @@ void downloadFilesFromVersionFile(const char *versionFileURL, const char *localV
         }
 
         fclose(versionFileContents);
+
+        // Only move the local version forward once everything it needs is on the SD
+        if (downloadFiles(jobs) == 0 && newestVersion[0] != '\0')
+            updateLocalVersion(newestVersion);
     }
 }
 
@@ -203,13 +468,13 @@ void DeleteFilesFromVersionFile(const char *DeleteFileURL) {
     CURL *curl;
     CURLcode res;
 
-    curl_global_init(CURL_GLOBAL_DEFAULT);
     curl = curl_easy_init();
 
     if (curl) {
         FILE *DeleteFile = fopen("PUT DELETION FILE TXT HERE", "wb");
         if (DeleteFile == NULL) {
             printf("Error opening delete.txt for writing.\n");
+            curl_easy_cleanup(curl);
             return;
         }
 
@@ -232,6 +497,7 @@ void DeleteFilesFromVersionFile(const char *DeleteFileURL) {
 
         while (fscanf(DeleteFileContents, "%s", FileToDelete) == 1) {
             unlink(FileToDelete);
+            InvalidateFolderManifests(FileToDelete);
         }
 
         unlink("PUT DELETION FILE TXT HERE");
@@ -239,6 +505,552 @@ void DeleteFilesFromVersionFile(const char *DeleteFileURL) {
     }
 }
 
+// Changed files of at least DELTA_MIN_SIZE that are already on the SD are
+// rebuilt from the local copy, zsync style: <url>.sig (made by deltasig)
+// lists a rolling checksum and a short SHA-1 for every block of the new
+// file, blocks found anywhere in the old file are copied and only the rest
+// is fetched with Range requests. Must match deltasig.c.
+#define DELTA_MAGIC 0x52524453 // 'RRDS'
+#define DELTA_VERSION 1
+#define DELTA_HEADER_SIZE 0x24
+#define DELTA_STRONG_SIZE 8
+#define DELTA_ENTRY_SIZE (4 + DELTA_STRONG_SIZE)
+#define DELTA_MAX_BLOCK_SIZE 0x10000
+#define DELTA_MIN_SIZE 0x40000
+#define DELTA_WINDOW_BLOCKS 16
+#define DELTA_MISSING 0xFFFFFFFF
+
+struct DeltaSink {
+    FILE *fp;
+    SHA1_CTX sha;
+    u32 written;
+    u32 limit;
+};
+
+static size_t MemoryWriteCallback(void *contents, size_t size, size_t nmemb, void *userp) {
+    struct memory *mem = (struct memory *)userp;
+    size_t realsize = size * nmemb;
+    char *ptr = (char *)realloc(mem->response, mem->size + realsize);
+    if (ptr == NULL)
+        return 0;
+
+    memcpy(ptr + mem->size, contents, realsize);
+    mem->response = ptr;
+    mem->size += realsize;
+    return realsize;
+}
+
+static size_t DeltaWriteCallback(void *contents, size_t size, size_t nmemb, void *userp) {
+    DeltaSink *sink = (DeltaSink *)userp;
+    size_t realsize = size * nmemb;
+    // A server ignoring the range would send the whole file
+    if (sink->written + realsize > sink->limit)
+        return 0;
+
+    SHA1Update(&sink->sha, (unsigned char *)contents, realsize);
+    sink->written += realsize;
+    return fwrite(contents, size, nmemb, sink->fp);
+}
+
+static u32 get32(const u8 *p) {
+    return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static u32 weakChecksum(const u8 *data, u32 length, u32 *a, u32 *b) {
+    *a = 0;
+    *b = 0;
+    for (u32 i = 0; i < length; i++) {
+        *a += data[i];
+        *b += (length - i) * data[i];
+    }
+    return (*a & 0xFFFF) | (*b << 16);
+}
+
+// Slides a block sized window over the old file, recording where each block
+// of the new file can be copied from
+static bool deltaMatchBlocks(const char *path, const u8 *entries, u32 blocks, u32 blocksize, u32 size, u32 *found) {
+    // A short last block can't be found by a full sized window, it's always fetched
+    u32 full = size / blocksize;
+
+    u32 bits = 1;
+    while ((1U << bits) < full)
+        bits++;
+    int *heads = (int *)malloc(sizeof(int) << bits);
+    int *next = (int *)malloc(sizeof(int) * (full + 1));
+    u32 buffersize = blocksize * DELTA_WINDOW_BLOCKS;
+    u8 *buffer = (u8 *)malloc(buffersize);
+    FILE *fp = fopen(path, "rb");
+    bool ok = heads && next && buffer && fp;
+
+    for (u32 i = 0; i < blocks; i++)
+        found[i] = DELTA_MISSING;
+
+    if (ok) {
+        memset(heads, 0xFF, sizeof(int) << bits);
+        for (int i = full - 1; i >= 0; i--) {
+            u32 bucket = (get32(entries + i * DELTA_ENTRY_SIZE) * 0x9E3779B1) >> (32 - bits);
+            next[i] = heads[bucket];
+            heads[bucket] = i;
+        }
+
+        u32 offset = 0; // file offset of buffer[0]
+        u32 pos = 0;
+        u32 filled = 0;
+        bool eof = false;
+        bool fresh = true;
+        u32 a = 0, b = 0;
+        while (true) {
+            // The window plus the byte rolling in next have to be buffered
+            if (pos + blocksize >= filled && !eof) {
+                memmove(buffer, buffer + pos, filled - pos);
+                offset += pos;
+                filled -= pos;
+                pos = 0;
+                size_t read = fread(buffer + filled, 1, buffersize - filled, fp);
+                if (read == 0)
+                    eof = true;
+                filled += read;
+            }
+            if (pos + blocksize > filled)
+                break;
+
+            u32 weak;
+            if (fresh) {
+                weak = weakChecksum(buffer + pos, blocksize, &a, &b);
+                fresh = false;
+            } else
+                weak = (a & 0xFFFF) | (b << 16);
+
+            bool matched = false;
+            bool hashed = false;
+            sha1 strong;
+            u32 bucket = (weak * 0x9E3779B1) >> (32 - bits);
+            for (int i = heads[bucket]; i >= 0; i = next[i]) {
+                const u8 *entry = entries + i * DELTA_ENTRY_SIZE;
+                if (get32(entry) != weak)
+                    continue;
+                if (!hashed) {
+                    SHA1(buffer + pos, blocksize, strong);
+                    hashed = true;
+                }
+                if (!memcmp(strong, entry + 4, DELTA_STRONG_SIZE)) {
+                    if (found[i] == DELTA_MISSING)
+                        found[i] = offset + pos;
+                    matched = true;
+                }
+            }
+
+            if (matched) {
+                pos += blocksize;
+                fresh = true;
+                continue;
+            }
+            if (pos + blocksize >= filled)
+                break;
+
+            u8 out = buffer[pos];
+            u8 in = buffer[pos + blocksize];
+            a += in - out;
+            b += a - blocksize * out;
+            pos++;
+        }
+        ok = !ferror(fp);
+    }
+
+    if (fp)
+        fclose(fp);
+    free(buffer);
+    free(next);
+    free(heads);
+    return ok;
+}
+
+// Writes the new file to <path>.part from the matched blocks and ranges of
+// the remote file, then swaps it in if the whole file hash matches
+static bool deltaBuild(CURL *curl, const char *url, const char *path, u32 size, u32 blocksize, u32 blocks,
+                       const u32 *found, const u8 *hash, u64 *fetched) {
+    string part = string(path) + PART_SUFFIX;
+    DeltaSink sink;
+    sink.fp = fopen(part.c_str(), "wb");
+    sink.written = 0;
+    SHA1Init(&sink.sha);
+    FILE *old = fopen(path, "rb");
+    u8 *block = (u8 *)malloc(blocksize);
+    bool ok = sink.fp && old && block;
+
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, DeltaWriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &sink);
+
+    for (u32 i = 0; ok && i < blocks; ) {
+        u32 start = i * blocksize;
+        if (found[i] != DELTA_MISSING) {
+            u32 length = size - start < blocksize ? size - start : blocksize;
+            ok = !fseek(old, found[i], SEEK_SET) && fread(block, 1, length, old) == length &&
+                 fwrite(block, 1, length, sink.fp) == length;
+            SHA1Update(&sink.sha, block, length);
+            sink.written += length;
+            i++;
+            continue;
+        }
+
+        // Fetch the whole run of missing blocks at once
+        u32 end = i;
+        while (end < blocks && found[end] == DELTA_MISSING)
+            end++;
+        u32 length = (end == blocks ? size : end * blocksize) - start;
+
+        char range[32];
+        snprintf(range, sizeof(range), "%u-%u", start, start + length - 1);
+        curl_easy_setopt(curl, CURLOPT_RANGE, range);
+        sink.limit = sink.written + length;
+        long code = 0;
+        ok = curl_easy_perform(curl) == CURLE_OK;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+        ok = ok && code == 206 && sink.written == sink.limit;
+        *fetched += length;
+        i = end;
+    }
+    curl_easy_setopt(curl, CURLOPT_RANGE, NULL);
+
+    free(block);
+    if (old)
+        fclose(old);
+    if (sink.fp && fclose(sink.fp))
+        ok = false;
+
+    if (ok) {
+        sha1 result;
+        SHA1Final(result, &sink.sha);
+        ok = !memcmp(result, hash, sizeof(sha1));
+    }
+    if (ok) {
+        unlink(path);
+        ok = !rename(part.c_str(), path);
+    }
+    if (!ok)
+        unlink(part.c_str());
+    return ok;
+}
+
+static bool deltaDownload(const char *url, const char *path, u32 size, const u8 *hash, u64 *fetched) {
+    struct stat st;
+    if (size < DELTA_MIN_SIZE || stat(path, &st) || st.st_size < DELTA_MIN_SIZE)
+        return false;
+    // Let an interrupted full download resume instead
+    if (!stat((string(path) + ETAG_SUFFIX).c_str(), &st))
+        return false;
+
+    CURL *curl = curl_easy_init();
+    if (curl == NULL)
+        return false;
+
+    struct memory sig = { NULL, 0 };
+    string sigurl = string(url) + ".sig";
+    curl_easy_setopt(curl, CURLOPT_URL, sigurl.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, MemoryWriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &sig);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    bool ok = curl_easy_perform(curl) == CURLE_OK && sig.size >= DELTA_HEADER_SIZE;
+
+    const u8 *header = (const u8 *)sig.response;
+    u32 blocksize = 0;
+    u32 blocks = 0;
+    if (ok) {
+        blocksize = get32(header + 0x08);
+        if (blocksize)
+            blocks = size / blocksize + (size % blocksize ? 1 : 0);
+        // The signature has to describe exactly the file the manifest wants
+        ok = get32(header) == DELTA_MAGIC && get32(header + 0x04) == DELTA_VERSION &&
+             blocksize && blocksize <= DELTA_MAX_BLOCK_SIZE && get32(header + 0x0C) == size &&
+             !memcmp(header + 0x10, hash, sizeof(sha1)) && sig.size == DELTA_HEADER_SIZE + blocks * DELTA_ENTRY_SIZE;
+    }
+
+    u32 *found = NULL;
+    if (ok) {
+        found = (u32 *)malloc(blocks * sizeof(u32));
+        ok = found && deltaMatchBlocks(path, header + DELTA_HEADER_SIZE, blocks, blocksize, size, found);
+    }
+
+    // Nothing in common, a plain download is just as cheap and can resume
+    u32 matched = 0;
+    for (u32 i = 0; ok && i < blocks; i++) {
+        if (found[i] != DELTA_MISSING)
+            matched++;
+    }
+    ok = ok && matched;
+
+    u64 before = *fetched;
+    if (ok)
+        ok = deltaBuild(curl, url, path, size, blocksize, blocks, found, hash, fetched);
+    if (ok)
+        printf("Patched: %s (%llu of %u KB fetched)\n", path, (unsigned long long)((*fetched - before) / 1024), size / 1024);
+    else
+        *fetched = before;
+
+    free(found);
+    free(sig.response);
+    curl_easy_cleanup(curl);
+    return ok;
+}
+
+// The manifest lists "<sha1> <size> <url> <path>" for every file of the
+// current release. The state file remembers the hash of every file we have
+// verified or installed, so unchanged files don't even need to be rehashed.
+#define UPDATE_MANIFEST_PATH "sd:/RetroRewind/manifest.txt"
+#define UPDATE_STATE_PATH "sd:/RetroRewind/manifest_state.txt"
+#define HASH_BUFFER_SIZE 0x10000
+#define HASH_STACK_SIZE 0x4000
+
+struct ManifestEntry {
+    string url;
+    string path;
+    u32 size;
+    sha1 hash;
+    bool current;
+};
+
+struct StateEntry {
+    u32 size;
+    sha1 hash;
+};
+
+static bool parseHash(const char *text, u8 *hash) {
+    if (strlen(text) != sizeof(sha1) * 2)
+        return false;
+    for (u32 i = 0; i < sizeof(sha1); i++) {
+        unsigned int byte;
+        if (sscanf(text + i * 2, "%2x", &byte) != 1)
+            return false;
+        hash[i] = byte;
+    }
+    return true;
+}
+
+static void printHash(FILE *fp, const u8 *hash) {
+    for (u32 i = 0; i < sizeof(sha1); i++)
+        fprintf(fp, "%02x", hash[i]);
+}
+
+static bool hashFile(const char *path, u8 *buffer, u8 *hash) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return false;
+
+    SHA1_CTX sha;
+    SHA1Init(&sha);
+    size_t read;
+    while ((read = fread(buffer, 1, HASH_BUFFER_SIZE, fp)) > 0)
+        SHA1Update(&sha, buffer, read);
+    bool ok = !ferror(fp);
+    fclose(fp);
+
+    SHA1Final(hash, &sha);
+    return ok;
+}
+
+static bool readManifest(const char *path, vector<ManifestEntry> &manifest) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return false;
+
+    char hash[MAX_FIELD_LENGTH];
+    char url[MAX_URL_LENGTH];
+    char filename[MAX_FILENAME_LENGTH];
+    unsigned int size;
+    bool ok = true;
+    while (fscanf(fp, "%111s %u %255s %127s", hash, &size, url, filename) == 4) {
+        ManifestEntry entry;
+        if (!parseHash(hash, entry.hash)) {
+            ok = false;
+            break;
+        }
+        entry.url = url;
+        entry.path = filename;
+        entry.size = size;
+        entry.current = false;
+        manifest.push_back(entry);
+    }
+    if (!feof(fp))
+        ok = false;
+    fclose(fp);
+
+    return ok && !manifest.empty();
+}
+
+static void readState(map<string, StateEntry> &state) {
+    FILE *fp = fopen(UPDATE_STATE_PATH, "r");
+    if (fp == NULL)
+        return;
+
+    char hash[MAX_FIELD_LENGTH];
+    char filename[MAX_FILENAME_LENGTH];
+    unsigned int size;
+    while (fscanf(fp, "%111s %u %127s", hash, &size, filename) == 3) {
+        StateEntry entry;
+        entry.size = size;
+        if (parseHash(hash, entry.hash))
+            state[filename] = entry;
+    }
+    fclose(fp);
+}
+
+static void writeState(const vector<ManifestEntry> &manifest) {
+    FILE *fp = fopen(UPDATE_STATE_PATH, "w");
+    if (fp == NULL)
+        return;
+
+    for (vector<ManifestEntry>::const_iterator entry = manifest.begin(); entry != manifest.end(); entry++) {
+        if (!entry->current)
+            continue;
+        printHash(fp, entry->hash);
+        fprintf(fp, " %u %s\n", entry->size, entry->path.c_str());
+    }
+    if (fclose(fp))
+        unlink(UPDATE_STATE_PATH);
+}
+
+static void createParentDirectories(const char *path) {
+    char directory[MAX_PATH_LENGTH];
+    strncpy(directory, path, sizeof(directory) - 1);
+    directory[sizeof(directory) - 1] = '\0';
+
+    // Skip the device name, then create each level in turn
+    char *slash = strchr(directory, '/');
+    while (slash && (slash = strchr(slash + 1, '/')) != NULL) {
+        *slash = '\0';
+        mkdir(directory, 0777);
+        *slash = '/';
+    }
+}
+
+static void *HashThread(void *arg) {
+    vector<ManifestEntry *> *entries = (vector<ManifestEntry *> *)arg;
+    u8 *buffer = (u8 *)malloc(HASH_BUFFER_SIZE);
+    if (buffer == NULL)
+        return NULL;
+
+    for (vector<ManifestEntry *>::iterator entry = entries->begin(); entry != entries->end(); entry++) {
+        sha1 hash;
+        if (hashFile((*entry)->path.c_str(), buffer, hash))
+            (*entry)->current = !memcmp(hash, (*entry)->hash, sizeof(hash));
+    }
+
+    free(buffer);
+    return NULL;
+}
+
+// Patches the file from the copy on the SD if a signature is published,
+// otherwise queues a full download
+static void queueManifestDownload(ManifestEntry *entry, vector<DownloadJob> &jobs, vector<ManifestEntry *> &queued,
+                                  int *patched, u64 *fetched) {
+    createParentDirectories(entry->path.c_str());
+
+    if (deltaDownload(entry->url.c_str(), entry->path.c_str(), entry->size, entry->hash, fetched)) {
+        InvalidateFolderManifests(entry->path.c_str());
+        entry->current = true;
+        (*patched)++;
+        return;
+    }
+
+    DownloadJob job;
+    job.url = entry->url;
+    job.path = entry->path;
+    job.expected = entry->hash;
+    jobs.push_back(job);
+    queued.push_back(entry);
+    *fetched += entry->size;
+}
+
+static void markDownloaded(vector<DownloadJob> &jobs, vector<ManifestEntry *> &entries) {
+    for (u32 i = 0; i < jobs.size(); i++)
+        entries[i]->current = !jobs[i].failed;
+}
+
+// Brings the SD in line with the manifest, only fetching files whose size or
+// hash differ, and only the changed blocks of large ones where possible.
+// Files whose size matches but aren't in the state cache are hashed on a
+// separate thread while the files known to be stale download.
+// Returns false if the manifest couldn't be fetched.
+static bool updateFromManifest(const char *manifestURL) {
+    unlink(UPDATE_MANIFEST_PATH);
+    downloadFile(manifestURL, UPDATE_MANIFEST_PATH);
+
+    vector<ManifestEntry> manifest;
+    if (!readManifest(UPDATE_MANIFEST_PATH, manifest))
+        return false;
+
+    map<string, StateEntry> state;
+    readState(state);
+
+    vector<ManifestEntry *> stale;
+    vector<ManifestEntry *> unknown;
+    for (vector<ManifestEntry>::iterator entry = manifest.begin(); entry != manifest.end(); entry++) {
+        struct stat st;
+        if (stat(entry->path.c_str(), &st) || (u32)st.st_size != entry->size) {
+            stale.push_back(&*entry);
+            continue;
+        }
+
+        map<string, StateEntry>::iterator known = state.find(entry->path);
+        if (known != state.end() && known->second.size == entry->size) {
+            // Remembered hash differs, the release changed the file but not its size
+            if (memcmp(known->second.hash, entry->hash, sizeof(sha1)))
+                stale.push_back(&*entry);
+            else
+                entry->current = true;
+        } else
+            unknown.push_back(&*entry);
+    }
+
+    printf("%d files changed, %d to check, %d up to date.\n", (int)stale.size(), (int)unknown.size(),
+           (int)(manifest.size() - stale.size() - unknown.size()));
+
+    lwp_t hashthread = LWP_THREAD_NULL;
+    u8 *hashstack = NULL;
+    if (!unknown.empty()) {
+        hashstack = (u8 *)memalign(32, HASH_STACK_SIZE);
+        if (hashstack == NULL || LWP_CreateThread(&hashthread, HashThread, &unknown, hashstack, HASH_STACK_SIZE, 64) < 0) {
+            hashthread = LWP_THREAD_NULL;
+            HashThread(&unknown);
+        }
+    }
+
+    int patched = 0;
+    u64 fetched = 0;
+    vector<DownloadJob> jobs;
+    vector<ManifestEntry *> queued;
+    for (vector<ManifestEntry *>::iterator entry = stale.begin(); entry != stale.end(); entry++)
+        queueManifestDownload(*entry, jobs, queued, &patched, &fetched);
+    int failed = downloadFiles(jobs);
+    markDownloaded(jobs, queued);
+    int downloaded = jobs.size();
+
+    if (hashthread != LWP_THREAD_NULL)
+        LWP_JoinThread(hashthread, NULL);
+    free(hashstack);
+
+    // Whatever didn't hash to the manifest value needs fetching too
+    jobs.clear();
+    queued.clear();
+    for (vector<ManifestEntry *>::iterator entry = unknown.begin(); entry != unknown.end(); entry++) {
+        if (!(*entry)->current)
+            queueManifestDownload(*entry, jobs, queued, &patched, &fetched);
+    }
+    failed += downloadFiles(jobs);
+    markDownloaded(jobs, queued);
+    downloaded += jobs.size();
+
+    writeState(manifest);
+
+    printf("Fetched %d files, patched %d (%llu KB)", downloaded - failed, patched, (unsigned long long)(fetched / 1024));
+    if (failed)
+        printf(", %d failed", failed);
+    printf(".\n");
+
+    return true;
+}
+
 void UpdateIsConfirmed() {
     Haxx_UnMount(&Mounted2);
 	initfat = fatInitDefault();
@@ -294,6 +1106,8 @@ void UpdateIsConfirmed() {
 
         const char *fileListURL = "PUT LINK FOR FILELIST HERE";
 
+        const char *manifestURL = "PUT LINK FOR MANIFEST HERE";
+
         // Read local version from a local file
         FILE *localVersionFile = fopen("PUT SD CARD VERSION TXT HERE", "r");
         if (localVersionFile == NULL) {
@@ -304,6 +1118,12 @@ void UpdateIsConfirmed() {
         // Delete files
         DeleteFilesFromVersionFile(fileToDelete);
 
+        // Releases that publish a manifest only need the files that changed
+        if (updateFromManifest(manifestURL)) {
+            fclose(localVersionFile);
+            return;
+        }
+
         char localVersion[MAX_VERSION_LENGTH];
         fscanf(localVersionFile, "%s", localVersion);
         fclose(localVersionFile);
@@ -319,14 +1139,21 @@ void UpdateIsConfirmed() {
 
         char url[MAX_URL_LENGTH];
         char outputFilename[MAX_FILENAME_LENGTH];
+        vector<DownloadJob> jobs;
 
         // Download files listed in version.txt (filelist.txt)
         while (fscanf(fileListFile, "%s %s", url, outputFilename) == 2) {
-            downloadFile(url, outputFilename);
-            printf("Downloaded: %s\n", outputFilename);
+            DownloadJob job;
+            job.url = url;
+            job.path = outputFilename;
+            jobs.push_back(job);
         }
         unlink("DELETE FILELIST HERE");
         fclose(fileListFile);
+
+        int failed = downloadFiles(jobs);
+        if (failed)
+            printf("%d of %d files failed to download.\n", failed, (int)jobs.size());
     }
     return;
 }
\ No newline at end of file
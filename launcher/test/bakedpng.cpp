@@ -0,0 +1,212 @@
+// Checks the textures baked from BAKE_PNGS against decoding the PNGs at runtime.
+//
+//   bakedpng check image.png baked.tpl ...  both through GuiImageData, texel for texel
+//   bakedpng bake image.png baked.tpl       an RGBA8 TPL as gxtexconv colfmt=6 writes it
+//
+// The Makefile bakes with gxtexconv when devkitPro has it and with "bake"
+// otherwise. AcquireImage reads the TPL header natively, big-endian on the
+// Wii, so the check swaps it to host order before handing it over.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <png.h>
+
+#include <vector>
+
+#include "gui.h"
+
+#define TPL_MAGIC 0x0020AF30
+#define TPL_IMAGE_HEADER 0x14
+#define TPL_DATA 0x40
+
+int ImageCacheIdleSize = 0;
+
+static u32 Get32(const u8* data)
+{
+	return ((u32)data[0] << 24) | ((u32)data[1] << 16) | ((u32)data[2] << 8) | data[3];
+}
+
+static u16 Get16(const u8* data)
+{
+	return (data[0] << 8) | data[1];
+}
+
+static void Set32(u8* data, u32 value)
+{
+	data[0] = value >> 24;
+	data[1] = value >> 16;
+	data[2] = value >> 8;
+	data[3] = value;
+}
+
+static void Set16(u8* data, u16 value)
+{
+	data[0] = value >> 8;
+	data[1] = value;
+}
+
+// RGBA8 is stored in whole 4x4 tiles
+static u32 TiledSize(u32 width, u32 height)
+{
+	return ((width + 3) & ~3) * ((height + 3) & ~3) * 4;
+}
+
+// Files are loaded 32 byte aligned, as bin2s -a 32 embeds them
+static u8* Load(const char* path, u32* size)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return NULL;
+	fseek(file, 0, SEEK_END);
+	*size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	u8* data = (u8*)memalign(32, *size + 32);
+	if (data && fread(data, 1, *size, file) != *size) {
+		free(data);
+		data = NULL;
+	}
+	fclose(file);
+	return data;
+}
+
+static int Bake(const char* input, const char* output)
+{
+	png_image image;
+	memset(&image, 0, sizeof(image));
+	image.version = PNG_IMAGE_VERSION;
+	if (!png_image_begin_read_from_file(&image, input)) {
+		printf("bakedpng: can't read %s\n", input);
+		return 1;
+	}
+	image.format = PNG_FORMAT_RGBA;
+	std::vector<u8> pixels(PNG_IMAGE_SIZE(image));
+	if (!png_image_finish_read(&image, NULL, &pixels[0], 0, NULL)) {
+		printf("bakedpng: can't decode %s\n", input);
+		return 1;
+	}
+
+	// Tiles of 4x4 pixels, the AR pairs of a tile then its GB pairs
+	u32 width = (image.width + 3) & ~3, height = (image.height + 3) & ~3;
+	std::vector<u8> tpl(TPL_DATA + width * height * 4);
+	u8* texels = &tpl[TPL_DATA];
+	for (u32 ty = 0; ty < height; ty += 4) {
+		for (u32 tx = 0; tx < width; tx += 4) {
+			for (u32 i = 0; i < 16; i++) {
+				u32 x = tx + i % 4, y = ty + i / 4;
+				u8 rgba[4] = { 0, 0, 0, 0 };
+				if (x < image.width && y < image.height)
+					memcpy(rgba, &pixels[(y * image.width + x) * 4], 4);
+				texels[i * 2] = rgba[3];
+				texels[i * 2 + 1] = rgba[0];
+				texels[32 + i * 2] = rgba[1];
+				texels[32 + i * 2 + 1] = rgba[2];
+			}
+			texels += 64;
+		}
+	}
+
+	Set32(&tpl[0], TPL_MAGIC);
+	Set32(&tpl[4], 1);
+	Set32(&tpl[8], 0x0C);
+	Set32(&tpl[0x0C], TPL_IMAGE_HEADER);
+	u8* header = &tpl[TPL_IMAGE_HEADER];
+	Set16(header, image.height);
+	Set16(header + 2, image.width);
+	Set32(header + 4, GX_TF_RGBA8);
+	Set32(header + 8, TPL_DATA);
+	Set32(header + 20, 1); // linear filtering
+	Set32(header + 24, 1);
+
+	FILE* file = fopen(output, "wb");
+	if (!file || fwrite(&tpl[0], 1, tpl.size(), file) != tpl.size()) {
+		printf("bakedpng: can't write %s\n", output);
+		return 1;
+	}
+	fclose(file);
+	return 0;
+}
+
+// The header fields AcquireImage reads, swapped in place to host order
+static bool HostOrder(u8* tpl, u32 size, const char* path)
+{
+	if (size < 0x20 || Get32(tpl) != TPL_MAGIC) {
+		printf("bakedpng: %s isn't a TPL\n", path);
+		return false;
+	}
+	u32 table = Get32(tpl + 8);
+	u32 image = table + 4 <= size ? Get32(tpl + table) : size;
+	if (Get32(tpl + 4) != 1 || image + 12 > size) {
+		printf("bakedpng: %s should hold exactly one texture\n", path);
+		return false;
+	}
+	u32 width = Get16(tpl + image + 2), height = Get16(tpl + image);
+	u32 format = Get32(tpl + image + 4), data = Get32(tpl + image + 8);
+	if (format != GX_TF_RGBA8 || data % 32 || data + TiledSize(width, height) > size) {
+		printf("bakedpng: %s: format %u with data at 0x%x, GuiImageData needs aligned RGBA8\n", path, format, data);
+		return false;
+	}
+
+	u32* words[] = { (u32*)tpl, (u32*)(tpl + 4), (u32*)(tpl + 8), (u32*)(tpl + table), (u32*)(tpl + image + 4), (u32*)(tpl + image + 8) };
+	for (u32 i = 0; i < sizeof(words) / sizeof(words[0]); i++)
+		*words[i] = Get32((u8*)words[i]);
+	*(u16*)(tpl + image) = height;
+	*(u16*)(tpl + image + 2) = width;
+	return true;
+}
+
+static int Check(int count, char** files)
+{
+	int failed = 0;
+	for (int i = 0; i + 1 < count; i += 2) {
+		u32 pngsize, tplsize;
+		u8* png = Load(files[i], &pngsize);
+		u8* tpl = Load(files[i + 1], &tplsize);
+		if (!png || !tpl) {
+			printf("bakedpng: can't read %s or %s\n", files[i], files[i + 1]);
+			failed++;
+			continue;
+		}
+		if (!HostOrder(tpl, tplsize, files[i + 1])) {
+			failed++;
+			continue;
+		}
+
+		GuiImageData decoded(png, false);
+		GuiImageData baked(tpl, false);
+		if (!decoded.GetImage() || !baked.GetImage()) {
+			printf("bakedpng: %s: GuiImageData loaded %s\n", files[i], decoded.GetImage() ? "only the PNG" : baked.GetImage() ? "only the TPL" : "neither");
+			failed++;
+			continue;
+		}
+		if (decoded.GetWidth() != baked.GetWidth() || decoded.GetHeight() != baked.GetHeight()) {
+			printf("bakedpng: %s is %dx%d, baked %dx%d\n", files[i], decoded.GetWidth(), decoded.GetHeight(), baked.GetWidth(), baked.GetHeight());
+			failed++;
+			continue;
+		}
+
+		u32 length = TiledSize(decoded.GetWidth(), decoded.GetHeight());
+		if (memcmp(decoded.GetImage(), baked.GetImage(), length)) {
+			u32 differ = 0;
+			for (u32 j = 0; j < length; j++)
+				differ += decoded.GetImage()[j] != baked.GetImage()[j];
+			printf("bakedpng: %s: %u of %u texel bytes differ\n", files[i], differ, length);
+			failed++;
+		}
+	}
+
+	printf("bakedpng: %d textures, %d failed\n", count / 2, failed);
+	return failed ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc == 4 && !strcmp(argv[1], "bake"))
+		return Bake(argv[2], argv[3]);
+	if (argc >= 4 && argc % 2 == 0 && !strcmp(argv[1], "check"))
+		return Check(argc - 2, argv + 2);
+
+	fprintf(stderr, "usage: bakedpng check image.png baked.tpl ...\n       bakedpng bake image.png baked.tpl\n");
+	return 1;
+}
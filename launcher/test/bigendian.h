@@ -0,0 +1,25 @@
+// Forced into the host copy of pngu.c. Its tiling loads and stores whole
+// words the way the Wii's big-endian CPU lays them out, so the Makefile
+// points those accesses at these types instead of plain integers.
+#pragma once
+
+template <typename T>
+struct BigEndian
+{
+	T Raw;
+
+	static T Swap(T value)
+	{
+		T swapped = 0;
+		for (unsigned i = 0; i < sizeof(T); i++, value >>= 8)
+			swapped = (swapped << 8) | (value & 0xFF);
+		return swapped;
+	}
+
+	operator T() const { return Swap(Raw); }
+	BigEndian& operator=(T value) { Raw = Swap(value); return *this; }
+};
+
+typedef BigEndian<unsigned short> PNGU_be16;
+typedef BigEndian<unsigned int> PNGU_be32;
+typedef BigEndian<unsigned long long> PNGU_be64;
@@ -0,0 +1,262 @@
+// Round trips deltasig and the updater's delta path: publishes the signature
+// of a new file, then rebuilds it from an old copy through deltaDownload,
+// fetching the rest from a local server with Range requests.
+//
+//   delta <deltasig> [seed]
+//
+// Each case edits a random file. A block of the new file can be copied when
+// no edit overlaps it, except a short last block which is always fetched, so
+// what has to be fetched follows from where the edits landed. The rebuilt
+// file has to hash to the new one, and the fetched count and the bytes the
+// server sent (less the signature) have to match that.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <errno.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <curl/curl.h>
+#include <openssl/evp.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <gccore.h>
+#include "sha1.h"
+#include "riivolution.h"
+#include "httpserver.h"
+
+using std::vector;
+using std::string;
+using std::map;
+
+#include "update.inc"
+
+// Where an edit left new bytes, in the new file
+struct Edit
+{
+	u32 Start;
+	u32 End; // equal to Start for a deletion, the seam between the kept parts
+};
+
+static const char* DeltaSig;
+static int Port;
+static u32 Seed = 1;
+
+// xorshift32, whose bytes don't repeat within a file as an LCG's low bits would
+static u32 Random()
+{
+	Seed ^= Seed << 13;
+	Seed ^= Seed >> 17;
+	Seed ^= Seed << 5;
+	return Seed;
+}
+
+static string RandomData(u32 size)
+{
+	string data(size, '\0');
+	for (u32 i = 0; i < size; i++)
+		data[i] = Random();
+	return data;
+}
+
+static void WriteFile(const string& path, const string& data)
+{
+	FILE* fp = fopen(path.c_str(), "wb");
+	if (!fp || fwrite(data.data(), 1, data.size(), fp) != data.size()) {
+		printf("delta: can't write %s\n", path.c_str());
+		exit(1);
+	}
+	fclose(fp);
+}
+
+static bool ReadFile(const string& path, string* data)
+{
+	FILE* fp = fopen(path.c_str(), "rb");
+	if (!fp)
+		return false;
+	char buffer[0x10000];
+	size_t got;
+	data->clear();
+	while ((got = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+		data->append(buffer, got);
+	fclose(fp);
+	return true;
+}
+
+static u32 FileSize(const string& path)
+{
+	struct stat st;
+	return stat(path.c_str(), &st) ? 0 : st.st_size;
+}
+
+static u32 Fetched(u32 size, u32 blocksize, const vector<Edit>& edits)
+{
+	u32 fetched = 0;
+	for (u32 start = 0; start < size; start += blocksize) {
+		u32 end = start + blocksize;
+		bool missing = end > size;
+		for (u32 i = 0; !missing && i < edits.size(); i++) {
+			if (edits[i].Start == edits[i].End)
+				missing = start < edits[i].Start && edits[i].Start < end;
+			else
+				missing = start < edits[i].End && edits[i].Start < end;
+		}
+		if (missing)
+			fetched += MIN(end, size) - start;
+	}
+	return fetched;
+}
+
+// Publishes <name> as the new file, puts the old one on the "card" and patches
+// it. The signature is made from <sign> and the server sends <serve> instead
+// if they're given. With expected -1 the delta path must give up and leave
+// the old file.
+static bool Case(const char* name, const string& old, const string& updated, u32 blocksize, int expected,
+	const string* sign = NULL, const string* serve = NULL)
+{
+	string published = string("www/") + name;
+	WriteFile(published, sign ? *sign : updated);
+	char command[512];
+	snprintf(command, sizeof(command), "'%s' -b %u '%s' '%s.sig'", DeltaSig, blocksize, published.c_str(), published.c_str());
+	if (system(command)) {
+		printf("delta: %s: deltasig failed\n", name);
+		return false;
+	}
+	WriteFile(published, serve ? *serve : updated);
+	u32 signature = FileSize(published + ".sig");
+
+	string path = string("sd/") + name;
+	WriteFile(path, old);
+	unlink((path + PART_SUFFIX).c_str());
+
+	u8 hash[EVP_MAX_MD_SIZE];
+	EVP_Digest(updated.data(), updated.size(), hash, NULL, EVP_sha1(), NULL);
+	char url[256];
+	snprintf(url, sizeof(url), "http://127.0.0.1:%d/%s", Port, name);
+
+	HttpServer_Reset();
+	u64 fetched = 0;
+	bool patched = deltaDownload(url, path.c_str(), updated.size(), hash, &fetched);
+	HttpServerStats stats = HttpServer_Stats();
+
+	bool ok = true;
+	string result;
+	ReadFile(path, &result);
+	struct stat st;
+	if (!stat((path + PART_SUFFIX).c_str(), &st)) {
+		printf("delta: %s: left the part behind\n", name);
+		ok = false;
+	}
+	if (expected < 0) {
+		if (patched || result != old || fetched) {
+			printf("delta: %s: %s, fetched %llu bytes\n", name, patched ? "patched anyway" : "changed the old file", (unsigned long long)fetched);
+			ok = false;
+		}
+	} else {
+		if (!patched || result != updated) {
+			printf("delta: %s: %s\n", name, patched ? "the file isn't the new one" : "not patched");
+			ok = false;
+		}
+		if (fetched != (u32)expected || stats.Bytes != signature + fetched) {
+			printf("delta: %s: fetched %llu bytes, server sent %llu, expected %d and a %u byte signature\n", name,
+				(unsigned long long)fetched, (unsigned long long)stats.Bytes, expected, signature);
+			ok = false;
+		}
+	}
+
+	printf("delta: %-10s %7u bytes in %5u byte blocks: %7llu fetched in %2u ranges, %5.1f%% saved%s\n", name,
+		(u32)updated.size(), blocksize, (unsigned long long)fetched, stats.Ranges,
+		patched ? 100.0 - fetched * 100.0 / updated.size() : 0.0, ok ? "" : ", FAILED");
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: delta <deltasig> [seed]\n");
+		return 1;
+	}
+	char* sig = realpath(argv[1], NULL);
+	if (!sig) {
+		printf("delta: no %s\n", argv[1]);
+		return 1;
+	}
+	DeltaSig = sig;
+	Seed = argc > 2 ? atoi(argv[2]) : 1;
+
+	char scratch[] = "/tmp/deltaXXXXXX";
+	if (!mkdtemp(scratch) || chdir(scratch)) {
+		printf("delta: no scratch directory\n");
+		return 1;
+	}
+	mkdir("www", 0777);
+	mkdir("sd", 0777);
+
+	curl_global_init(CURL_GLOBAL_ALL);
+	Port = HttpServer_Start((string(scratch) + "/www").c_str());
+	if (!Port) {
+		printf("delta: can't start the server\n");
+		return 1;
+	}
+
+	bool ok = true;
+	const u32 blocksizes[] = { 0x1000, 0x400, DELTA_MAX_BLOCK_SIZE };
+	for (u32 i = 0; i < sizeof(blocksizes) / sizeof(blocksizes[0]); i++) {
+		u32 blocksize = blocksizes[i];
+		string old = RandomData(DELTA_MIN_SIZE * 2 + Random() % DELTA_MIN_SIZE);
+		vector<Edit> edits;
+
+		// A few bytes inserted in the middle shift everything after them
+		u32 at = old.size() / 3 + Random() % 0x1000;
+		u32 length = 1 + Random() % 300;
+		string inserted = old.substr(0, at) + RandomData(length) + old.substr(at);
+		edits.push_back((Edit){ at, at + length });
+		ok &= Case("inserted", old, inserted, blocksize, Fetched(inserted.size(), blocksize, edits));
+
+		// Data appended at the end
+		string appended = old + RandomData(5000);
+		edits.clear();
+		edits.push_back((Edit){ (u32)old.size(), (u32)appended.size() });
+		ok &= Case("appended", old, appended, blocksize, Fetched(appended.size(), blocksize, edits));
+
+		// A span cut out, one overwritten in place and bytes inserted near the start
+		string edited = old;
+		u32 cut = old.size() / 2 + Random() % 0x1000;
+		edited.erase(cut, 777);
+		u32 overwrite = old.size() * 3 / 4 + Random() % 0x1000;
+		for (u32 j = 0; j < 64; j++)
+			edited[overwrite + j] ^= 0x5A;
+		u32 near = 100 + Random() % 0x1000;
+		edited.insert(near, RandomData(10));
+		edits.clear();
+		edits.push_back((Edit){ near, near + 10 });
+		edits.push_back((Edit){ cut + 10, cut + 10 });
+		edits.push_back((Edit){ overwrite + 10, overwrite + 10 + 64 });
+		ok &= Case("edited", old, edited, blocksize, Fetched(edited.size(), blocksize, edits));
+
+		// Nothing in common, a plain download does better
+		ok &= Case("unrelated", old, RandomData(old.size()), blocksize, -1);
+
+		// Signatures left from another version of the file mustn't be used
+		string changed = appended;
+		changed[changed.size() / 2] ^= 0xFF;
+		ok &= Case("resized", old, appended, blocksize, -1, &inserted);
+		ok &= Case("stale", old, appended, blocksize, -1, &changed);
+
+		// Nor blocks of a file changed on the server since it was signed
+		changed = appended;
+		changed[changed.size() - 1] ^= 0xFF;
+		ok &= Case("replaced", old, appended, blocksize, -1, NULL, &changed);
+	}
+
+	HttpServer_Stop();
+	system((string("rm -rf '") + scratch + "'").c_str());
+	free(sig);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,450 @@
+// Draws text through FreeTypeGX's glyph atlas into a CPU framebuffer and
+// checks it against FreeType's own bitmaps, the packing of the atlas pages and
+// their eviction.
+//
+//   ftgxatlas
+//
+// GX is stood in for by a rasterizer that samples the loaded page for every
+// quad, so a glyph packed over another, copied to the wrong place or evicted
+// while its string still needed it comes out as wrong pixels. Quads stay
+// pending on the "GPU" until GX_DrawDone or the end of the frame, and neither
+// the texels they read nor the buffer holding them may change before then.
+// The Makefile builds it once with the header's page limit and once, as
+// ftgxatlas1, with a single page, which evicts on nearly every string.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#include <map>
+#include <set>
+#include <vector>
+
+#define private public
+#include "FreeTypeGX.h"
+#undef private
+
+extern "C" {
+#include "font_ttf.h"
+}
+
+using std::vector;
+
+#define SCREEN_WIDTH 640
+#define SCREEN_HEIGHT 480
+#define LINE_HEIGHT 80
+
+extern FreeTypeGX* fontSystem[];
+
+struct PendingQuad
+{
+	const u8* Texture;
+	u16 Width;
+	u16 X0, Y0, X1, Y1; // the texels read
+	u32 Sum;
+};
+
+static u8 Screen[SCREEN_HEIGHT][SCREEN_WIDTH];
+static u8 Expected[SCREEN_HEIGHT][SCREEN_WIDTH];
+
+static FT_Library Library;
+static FT_Face Face;
+
+static GXTexObj Loaded;
+static bool Textured = false;
+static int Vertices = 0;
+static s16 QuadX[4], QuadY[4];
+static f32 QuadS[4], QuadT[4];
+static vector<PendingQuad> Pending;
+
+static int Begins, Loads, DrawDones;
+static int Errors = 0;
+
+static void Error(const char* what)
+{
+	if (Errors++ < 10)
+		printf("ftgxatlas: %s\n", what);
+}
+
+static const u8* TexturePointer(const GXTexObj* obj)
+{
+	const u8* texture;
+	memcpy(&texture, obj->val, sizeof(texture));
+	return texture;
+}
+
+// Alpha of an RGBA8 texel, the first half of each 64 byte tile is AR pairs
+static u8 Texel(const u8* texture, u16 width, u32 x, u32 y)
+{
+	return texture[((y / 4) * (width / 4) + x / 4) * 64 + ((y % 4) * 4 + x % 4) * 2];
+}
+
+static u32 Sum(const PendingQuad& quad)
+{
+	u32 sum = 2166136261u;
+	for (u32 y = quad.Y0; y < quad.Y1; y++) {
+		for (u32 x = quad.X0; x < quad.X1; x++)
+			sum = (sum ^ Texel(quad.Texture, quad.Width, x, y)) * 16777619u;
+	}
+	return sum;
+}
+
+static void CheckPending()
+{
+	for (u32 i = 0; i < Pending.size(); i++) {
+		if (Sum(Pending[i]) != Pending[i].Sum) {
+			Error("a page changed while a quad drawn from it was pending");
+			break;
+		}
+	}
+}
+
+extern "C" void __real_free(void* ptr);
+extern "C" void __wrap_free(void* ptr)
+{
+	for (u32 i = 0; ptr && i < Pending.size(); i++) {
+		if (Pending[i].Texture == ptr) {
+			Error("a page was freed while a quad drawn from it was pending");
+			Pending.clear();
+			break;
+		}
+	}
+	__real_free(ptr);
+}
+
+void GX_SetVtxAttrFmt(u8 vtxfmt, u32 vtxattr, u32 comptype, u32 compsize, u32 frac) {}
+void GX_SetTevOp(u8 tevstage, u8 mode) {}
+void GX_InitTexObjFilterMode(GXTexObj* obj, u8 minfilt, u8 magfilt) {}
+void GX_InvalidateTexAll(void) {}
+void GX_Color4u8(u8 r, u8 g, u8 b, u8 a) {}
+void GX_End(void) {}
+
+void GX_SetVtxDesc(u8 attr, u8 type)
+{
+	if (attr == GX_VA_TEX0)
+		Textured = type == GX_DIRECT;
+}
+
+void GX_InitTexObj(GXTexObj* obj, void* img_ptr, u16 wd, u16 ht, u8 fmt, u8 wrap_s, u8 wrap_t, u8 mipmap)
+{
+	memset(obj, 0, sizeof(*obj));
+	memcpy(obj->val, &img_ptr, sizeof(img_ptr));
+	obj->val[2] = wd;
+	obj->val[3] = ht;
+	obj->val[4] = fmt;
+}
+
+void GX_LoadTexObj(GXTexObj* obj, u8 mapid)
+{
+	Loaded = *obj;
+	Loads++;
+}
+
+void GX_DrawDone(void)
+{
+	CheckPending();
+	Pending.clear();
+	DrawDones++;
+}
+
+void GX_Begin(u8 primitve, u8 vtxfmt, u16 vtxcnt)
+{
+	Vertices = 0;
+	Begins++;
+}
+
+void GX_Position2s16(s16 x, s16 y)
+{
+	QuadX[Vertices] = x;
+	QuadY[Vertices] = y;
+}
+
+// The fourth vertex completes a quad, which is sampled texel for texel at the pixel centres
+void GX_TexCoord2f32(f32 s, f32 t)
+{
+	QuadS[Vertices] = s;
+	QuadT[Vertices] = t;
+	if (++Vertices < 4)
+		return;
+	Vertices = 0;
+	if (!Textured)
+		return;
+
+	const u8* texture = TexturePointer(&Loaded);
+	u16 width = Loaded.val[2], height = Loaded.val[3];
+	if (Loaded.val[4] != GX_TF_RGBA8) {
+		Error("a page isn't RGBA8");
+		return;
+	}
+	int w = QuadX[1] - QuadX[0], h = QuadY[2] - QuadY[0];
+	PendingQuad quad = { texture, width, 0xFFFF, 0xFFFF, 0, 0, 0 };
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			u32 u = (QuadS[0] + (QuadS[1] - QuadS[0]) * (x + 0.5f) / w) * width;
+			u32 v = (QuadT[0] + (QuadT[2] - QuadT[0]) * (y + 0.5f) / h) * height;
+			if (u >= width || v >= height) {
+				Error("a quad samples outside its page");
+				return;
+			}
+			quad.X0 = u < quad.X0 ? u : quad.X0;
+			quad.Y0 = v < quad.Y0 ? v : quad.Y0;
+			quad.X1 = u + 1 > quad.X1 ? u + 1 : quad.X1;
+			quad.Y1 = v + 1 > quad.Y1 ? v + 1 : quad.Y1;
+
+			int px = QuadX[0] + x, py = QuadY[0] + y;
+			u8 alpha = Texel(texture, width, u, v);
+			if (px >= 0 && py >= 0 && px < SCREEN_WIDTH && py < SCREEN_HEIGHT && alpha > Screen[py][px])
+				Screen[py][px] = alpha;
+		}
+	}
+	if (w > 0 && h > 0) {
+		quad.Sum = Sum(quad);
+		Pending.push_back(quad);
+	}
+}
+
+// What the string should look like, FreeType's bitmaps placed as FreeTypeGX places them
+static void DrawExpected(int x, int y, const wchar_t* text, u32 size)
+{
+	FT_Set_Pixel_Sizes(Face, 0, size);
+	FT_UInt previous = 0;
+	for (; *text; text++) {
+		FT_UInt index = FT_Get_Char_Index(Face, *text);
+		if (FT_Load_Glyph(Face, index, FT_LOAD_DEFAULT))
+			continue;
+		FT_Render_Glyph(Face->glyph, FT_RENDER_MODE_NORMAL);
+		if (FT_HAS_KERNING(Face) && previous) {
+			FT_Vector delta;
+			FT_Get_Kerning(Face, previous, index, FT_KERNING_DEFAULT, &delta);
+			x += delta.x >> 6;
+		}
+		FT_Bitmap* bitmap = &Face->glyph->bitmap;
+		for (u32 row = 0; row < bitmap->rows; row++) {
+			for (u32 column = 0; column < bitmap->width; column++) {
+				int px = (u16)(x + Face->glyph->bitmap_left + column), py = y - Face->glyph->bitmap_top + row;
+				u8 alpha = bitmap->buffer[row * bitmap->pitch + column];
+				if (px < SCREEN_WIDTH && py >= 0 && py < SCREEN_HEIGHT && alpha > Expected[py][px])
+					Expected[py][px] = alpha;
+			}
+		}
+		x += Face->glyph->advance.x >> 6;
+		previous = index;
+	}
+}
+
+struct Frame
+{
+	int Strings;
+	int Glyphs;
+	int Begins;
+	int Loads;
+	int Evicted;
+};
+
+struct CycleRun
+{
+	u32 Size;
+	u32 Length;  // glyphs to a string
+	u32 Strings; // strings to a frame
+	u32 Columns;
+};
+
+static int MostPagesForAString = 0;
+
+// Draws the strings as one frame, a line each in as many columns as asked for, and checks the result
+static Frame DrawFrame(FreeTypeGX* font, u32 size, const vector<const wchar_t*>& strings, u32 columns = 1)
+{
+	std::set<wchar_t> resident;
+	for (std::map<wchar_t, ftgxCharData>::iterator i = font->fontData.begin(); i != font->fontData.end(); i++) {
+		if (i->second.atlasPage != FTGX_ATLAS_NONE)
+			resident.insert(i->first);
+	}
+
+	memset(Screen, 0, sizeof(Screen));
+	memset(Expected, 0, sizeof(Expected));
+	Frame frame = { 0, 0, 0, 0, 0 };
+	Begins = Loads = 0;
+	for (u32 i = 0; i < strings.size(); i++) {
+		int x = i / (SCREEN_HEIGHT / LINE_HEIGHT) % columns * (SCREEN_WIDTH / columns);
+		int y = LINE_HEIGHT * (i % (SCREEN_HEIGHT / LINE_HEIGHT)) + LINE_HEIGHT * 3 / 4;
+		int begins = Begins;
+		ChangeFontSize(size);
+		font->drawText(x, y, strings[i]);
+		DrawExpected(x, y, strings[i], size);
+
+		// One batch per page the string's glyphs are on, and none of them evicted while it was drawn
+		std::set<u16> pages;
+		for (const wchar_t* c = strings[i]; *c; c++) {
+			std::map<wchar_t, ftgxCharData>::iterator glyph = font->fontData.find(*c);
+			if (glyph == font->fontData.end() || !glyph->second.textureWidth)
+				continue;
+			if (glyph->second.atlasPage == FTGX_ATLAS_NONE)
+				Error("a glyph was evicted by its own string");
+			else
+				pages.insert(glyph->second.atlasPage);
+			frame.Glyphs++;
+		}
+		if (Begins - begins != (int)pages.size())
+			Error("a string wasn't drawn in one batch per page");
+		if ((int)pages.size() > MostPagesForAString)
+			MostPagesForAString = pages.size();
+		frame.Strings++;
+	}
+	frame.Begins = Begins;
+	frame.Loads = Loads;
+
+	// The end of the frame waits for the GPU as the video callback does
+	GX_DrawDone();
+
+	u32 wrong = 0;
+	for (u32 y = 0; y < SCREEN_HEIGHT; y++) {
+		for (u32 x = 0; x < SCREEN_WIDTH; x++)
+			wrong += Screen[y][x] != Expected[y][x];
+	}
+	if (wrong)
+		Error("the text isn't FreeType's");
+
+	// Resident glyphs lie whole tiles inside their page, on a shelf, and apart
+	vector<vector<const ftgxCharData*> > onPage(font->atlasPages.size());
+	for (std::map<wchar_t, ftgxCharData>::iterator i = font->fontData.begin(); i != font->fontData.end(); i++) {
+		const ftgxCharData* glyph = &i->second;
+		if (glyph->atlasPage == FTGX_ATLAS_NONE) {
+			frame.Evicted += resident.count(i->first);
+			continue;
+		}
+		const ftgxAtlasPage* page = &font->atlasPages[glyph->atlasPage];
+		if (glyph->atlasX % 4 || glyph->atlasY % 4 || glyph->atlasX + glyph->textureWidth > font->atlasWidth ||
+			glyph->atlasY + glyph->textureHeight > page->used || page->used > page->height)
+			Error("a glyph lies outside its page");
+		onPage[glyph->atlasPage].push_back(glyph);
+	}
+	for (u32 p = 0; p < onPage.size(); p++) {
+		for (u32 i = 0; i < onPage[p].size(); i++) {
+			const ftgxCharData* a = onPage[p][i];
+			for (u32 j = i + 1; j < onPage[p].size(); j++) {
+				const ftgxCharData* b = onPage[p][j];
+				if (a->atlasX < b->atlasX + b->textureWidth && b->atlasX < a->atlasX + a->textureWidth &&
+					a->atlasY < b->atlasY + b->textureHeight && b->atlasY < a->atlasY + a->textureHeight)
+					Error("two glyphs overlap in a page");
+			}
+		}
+	}
+
+	// Past the limit only for a string that needed more pages than it allows
+	if ((int)font->atlasPages.size() > (MostPagesForAString > FTGX_ATLAS_MAX_PAGES ? MostPagesForAString : FTGX_ATLAS_MAX_PAGES))
+		Error("more pages than the limit");
+	return frame;
+}
+
+static u32 AtlasBytes(FreeTypeGX* font)
+{
+	u32 bytes = 0;
+	for (u32 p = 0; p < font->atlasPages.size(); p++)
+		bytes += font->getAtlasPageSize(font->atlasPages[p].height);
+	return bytes;
+}
+
+// What a texture per glyph took for the same glyphs
+static u32 GlyphBytes(FreeTypeGX* font)
+{
+	u32 bytes = 0;
+	for (std::map<wchar_t, ftgxCharData>::iterator i = font->fontData.begin(); i != font->fontData.end(); i++)
+		bytes += i->second.textureWidth * i->second.textureHeight * 4;
+	return bytes;
+}
+
+int main(int argc, char** argv)
+{
+	InitFreeType((u8*)font_ttf, font_ttf_size);
+	FT_Init_FreeType(&Library);
+	FT_New_Memory_Face(Library, font_ttf, font_ttf_size, 0, &Face);
+	printf("ftgxatlas: %d page%s per size\n", FTGX_ATLAS_MAX_PAGES, FTGX_ATLAS_MAX_PAGES > 1 ? "s" : "");
+
+	// Menu text at the sizes the launcher uses, drawn for two frames: the second
+	// is what every frame after costs
+	vector<const wchar_t*> menu;
+	menu.push_back(L"Retro Rewind");
+	menu.push_back(L"Launch Game");
+	menu.push_back(L"Update available! Download 3.2 MB?");
+	menu.push_back(L"Pack: Retro Rewind v6.0 (Kart & Bike)");
+	menu.push_back(L"The quick brown fox jumps over the lazy dog 0123456789");
+	menu.push_back(L"ÄÖÜ éè ß / Options / Exit");
+	const u32 sizes[] = { 14, 18, 20, 24, 28 };
+	for (u32 i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		u32 size = sizes[i];
+		fontSystem[size] = new FreeTypeGX(size);
+		DrawFrame(fontSystem[size], size, menu);
+		DrawDones = 0;
+		Frame frame = DrawFrame(fontSystem[size], size, menu);
+		if (DrawDones != 1)
+			Error("a frame redrawing the same text had to wait for the GPU");
+		printf("ftgxatlas: menu at %2u px: %2d strings, %3d glyphs in %2d draws and %2d texture loads, "
+			"%3zu glyphs in %u KB of pages, %u KB as textures per glyph\n", size, frame.Strings, frame.Glyphs, frame.Begins,
+			frame.Loads, fontSystem[size]->fontData.size(), AtlasBytes(fontSystem[size]) / 1024, GlyphBytes(fontSystem[size]) / 1024);
+	}
+
+	// Every glyph of the font, three times over. Sixteen to a string, four to a
+	// frame, spreads strings over several pages. One to a string at the largest
+	// size makes a single page too few for the font, and with a frame of a
+	// screenful of them the glyphs after an eviction overwrite ones still pending
+	vector<wchar_t> characters;
+	FT_UInt index;
+	for (FT_ULong c = FT_Get_First_Char(Face, &index); index; c = FT_Get_Next_Char(Face, c, &index))
+		characters.push_back(c);
+
+	const CycleRun runs[] = { { 20, 16, 4, 1 }, { 48, 16, 4, 1 }, { 90, 16, 4, 1 }, { 90, 1, 36, 6 } };
+	for (u32 i = 0; i < sizeof(runs) / sizeof(runs[0]); i++) {
+		u32 size = runs[i].Size;
+		vector<wchar_t> text;
+		for (u32 pass = 0; pass < 3; pass++) {
+			for (u32 j = 0; j < characters.size(); j++) {
+				text.push_back(characters[(j * 7 + pass * 13) % characters.size()]);
+				if (text.size() % (runs[i].Length + 1) == runs[i].Length)
+					text.push_back(0);
+			}
+		}
+		text.push_back(0);
+
+		FreeTypeGX* font = new FreeTypeGX(size);
+		ChangeFontSize(size);
+
+		// Rendering the whole font up front keeps only what the page limit holds
+		u16 cached = font->cacheGlyphDataComplete();
+		u32 dropped = 0;
+		for (std::map<wchar_t, ftgxCharData>::iterator j = font->fontData.begin(); j != font->fontData.end(); j++)
+			dropped += j->second.textureWidth && j->second.atlasPage == FTGX_ATLAS_NONE;
+		if (font->atlasPages.size() > FTGX_ATLAS_MAX_PAGES)
+			Error("rendering the whole font went past the page limit");
+		if (GlyphBytes(font) > FTGX_ATLAS_MAX_PAGES * font->getAtlasPageSize(FTGX_ATLAS_MAX_WIDTH) && !dropped)
+			Error("rendering more of the font than fits evicted nothing");
+
+		MostPagesForAString = 0;
+		DrawDones = 0;
+		int frames = 0, evicted = 0, begins = 0, glyphs = 0;
+		vector<const wchar_t*> strings;
+		for (const wchar_t* s = &text[0]; s < &text[0] + text.size(); s += wcslen(s) + 1) {
+			strings.push_back(s);
+			if (strings.size() == runs[i].Strings || s + wcslen(s) + 1 >= &text[0] + text.size()) {
+				Frame frame = DrawFrame(font, size, strings, runs[i].Columns);
+				evicted += frame.Evicted;
+				begins += frame.Begins;
+				glyphs += frame.Glyphs;
+				frames++;
+				strings.clear();
+			}
+		}
+		u32 pages = MostPagesForAString > FTGX_ATLAS_MAX_PAGES ? MostPagesForAString : FTGX_ATLAS_MAX_PAGES;
+		if (GlyphBytes(font) > pages * font->getAtlasPageSize(FTGX_ATLAS_MAX_WIDTH) && !evicted)
+			Error("glyphs that can't all fit were never evicted");
+		printf("ftgxatlas: font at %2u px, %2u to a string: %u glyphs cached, %u evicted, then %3d frames of %3d glyphs in "
+			"%3d draws, %3d evicted, %3d waits for the GPU, %zu pages of %4u KB, %4u KB as textures per glyph\n", size,
+			runs[i].Length, cached, dropped, frames, glyphs, begins, evicted, DrawDones - frames, font->atlasPages.size(),
+			AtlasBytes(font) / 1024, GlyphBytes(font) / 1024);
+		delete font;
+	}
+
+	if (Errors)
+		printf("ftgxatlas: %d errors\n", Errors);
+	return Errors ? 1 : 0;
+}
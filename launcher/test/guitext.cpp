@@ -0,0 +1,462 @@
+// Checks GuiText's cached line layout draws what GuiText::Draw drew when it
+// wrapped and measured the text every frame, and times the two.
+//
+//   guitext [frames]
+//
+// FreeTypeGX is replaced by a stub with made up metrics that logs every
+// drawText with its position, text, color, style and the width and offsets
+// it was given or measured. ReferenceText::Draw is GuiText::Draw as it was
+// before the cache, so each pair of items has to log the same calls frame
+// for frame while their text, size, width, wrapping, scrolling and scale
+// change underneath them.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include "gui.h"
+
+using std::string;
+using std::vector;
+
+#define TEXT_SCROLL_INITIAL_DELAY 6
+
+// The rows the reference can wrap into, the launcher had 20 and overran them on longer texts
+#define REFERENCE_ROWS 256
+
+// video.cpp's, which needs the real GX
+u32 FrameTimer = 0;
+int screenwidth = 640;
+int screenheight = 480;
+FreeTypeGX* fontSystem[MAX_FONT_SIZE + 1];
+
+static vector<string>* Log = NULL;
+static u32 Measures = 0;
+
+void ChangeFontSize(FT_UInt pixelSize) {}
+
+wchar_t* charToWideChar(const char* strChar)
+{
+	wchar_t* strWChar = new wchar_t[strlen(strChar) + 1];
+	for (size_t i = 0; (strWChar[i] = (unsigned char)strChar[i]); i++)
+		;
+	return strWChar;
+}
+
+wchar_t* shortToWideChar(const short* strShort)
+{
+	size_t length = 0;
+	while (strShort[length])
+		length++;
+	wchar_t* strWChar = new wchar_t[length + 1];
+	for (size_t i = 0; i <= length; i++)
+		strWChar[i] = strShort[i];
+	return strWChar;
+}
+
+// Metrics that differ from glyph to glyph and size to size, with kerning between equal glyphs
+FreeTypeGX::FreeTypeGX(FT_UInt pixelSize, uint8_t textureFormat, uint8_t vertexIndex)
+{
+	this->ftPointSize = pixelSize;
+}
+
+FreeTypeGX::~FreeTypeGX() {}
+
+uint16_t FreeTypeGX::getWidth(wchar_t* text)
+{
+	Measures++;
+	uint16_t width = 0;
+	for (size_t i = 0; text[i]; i++)
+		width += this->ftPointSize / 2 + text[i] % 7 - (i && text[i - 1] == text[i]);
+	return width;
+}
+
+uint16_t FreeTypeGX::getWidth(wchar_t const* text)
+{
+	return this->getWidth((wchar_t*)text);
+}
+
+void FreeTypeGX::getOffset(wchar_t* text, ftgxDataOffset* offset)
+{
+	Measures++;
+	int16_t strMax = 0, strMin = 9999;
+	for (size_t i = 0; text[i]; i++) {
+		int16_t top = this->ftPointSize * 3 / 4 + text[i] % 3, bottom = -(text[i] % 4);
+		strMax = top > strMax ? top : strMax;
+		strMin = bottom < strMin ? bottom : strMin;
+	}
+	offset->ascender = this->ftPointSize * 4 / 5;
+	offset->descender = -(int16_t)this->ftPointSize / 5;
+	offset->max = strMax;
+	offset->min = strMin;
+}
+
+void FreeTypeGX::getOffset(wchar_t const* text, ftgxDataOffset* offset)
+{
+	this->getOffset((wchar_t*)text, offset);
+}
+
+// As FreeTypeGX measures a string for the styles that need it
+uint16_t FreeTypeGX::drawText(int16_t x, int16_t y, wchar_t* text, GXColor color, uint16_t textStyle)
+{
+	uint16_t textWidth = 0;
+	ftgxDataOffset offset;
+
+	if (textStyle & (FTGX_JUSTIFY_MASK | FTGX_STYLE_MASK))
+		textWidth = this->getWidth(text);
+	if (textStyle & (FTGX_ALIGN_MASK | FTGX_STYLE_MASK))
+		this->getOffset(text, &offset);
+
+	return this->drawText(x, y, text, textWidth, &offset, color, textStyle);
+}
+
+uint16_t FreeTypeGX::drawText(int16_t x, int16_t y, wchar_t const* text, GXColor color, uint16_t textStyle)
+{
+	return this->drawText(x, y, (wchar_t*)text, color, textStyle);
+}
+
+// Logs only what FreeTypeGX would use of the width and offsets for the style
+uint16_t FreeTypeGX::drawText(int16_t x, int16_t y, wchar_t* text, uint16_t textWidth, ftgxDataOffset* textOffset, GXColor color, uint16_t textStyle)
+{
+	if (!Log)
+		return wcslen(text);
+	char entry[64];
+	snprintf(entry, sizeof(entry), "%u px at %d,%d, %02x%02x%02x%02x, style %04x", this->ftPointSize, x, y,
+		color.r, color.g, color.b, color.a, textStyle);
+	string line = entry;
+	if (textStyle & (FTGX_JUSTIFY_MASK | FTGX_STYLE_MASK)) {
+		snprintf(entry, sizeof(entry), ", %u wide", textWidth);
+		line += entry;
+	}
+	if (textStyle & (FTGX_ALIGN_MASK | FTGX_STYLE_MASK)) {
+		snprintf(entry, sizeof(entry), ", offsets %d %d %d %d", textOffset->ascender, textOffset->descender,
+			textOffset->max, textOffset->min);
+		line += entry;
+	}
+	line += ": ";
+	for (size_t i = 0; text[i]; i++)
+		line += text[i] < 0x80 ? (char)text[i] : '?';
+	Log->push_back(line);
+	return wcslen(text);
+}
+
+// GuiText::Draw before the layout was cached, wrapping and measuring every frame
+class ReferenceText : public GuiText
+{
+	public:
+		ReferenceText(const char* t, int s, GXColor c) : GuiText(t, s, c) {}
+		void Draw();
+};
+
+static int referenceSize = 0;
+
+void ReferenceText::Draw()
+{
+	if(!origText)
+		return;
+
+	if(!IsVisible())
+		return;
+
+	GXColor c = color;
+	c.a = this->GetAlpha();
+
+	int newSize = size*GetScale();
+
+	if(newSize > MAX_FONT_SIZE)
+		newSize = MAX_FONT_SIZE;
+
+	if(newSize != referenceSize)
+	{
+		ChangeFontSize(newSize);
+		if(!fontSystem[newSize])
+			fontSystem[newSize] = new FreeTypeGX(newSize);
+		referenceSize = newSize;
+	}
+
+	if(maxWidth > 0)
+	{
+		wchar_t * tmpText = wcsdup(origText);
+		u8 maxChar = (maxWidth*2.0) / newSize;
+
+		if(!textDyn)
+		{
+			if(wcslen(tmpText) > maxChar)
+				tmpText[maxChar] = L'\0';
+			textDyn = wcsdup(tmpText);
+		}
+
+		if(textScroll == SCROLL_HORIZONTAL)
+		{
+			int textlen = wcslen(origText);
+
+			if(textlen > maxChar && (FrameTimer % textScrollDelay == 0))
+			{
+				if(textScrollInitialDelay)
+				{
+					textScrollInitialDelay--;
+				}
+				else
+				{
+					textScrollPos++;
+					if(textScrollPos > textlen-1)
+					{
+						textScrollPos = 0;
+						textScrollInitialDelay = TEXT_SCROLL_INITIAL_DELAY;
+					}
+
+					wcsncpy(tmpText, &origText[textScrollPos], maxChar-1);
+					tmpText[maxChar-1] = L'\0';
+
+					int dynlen = wcslen(tmpText);
+
+					if(dynlen+2 < maxChar)
+					{
+						tmpText[dynlen] = L' ';
+						tmpText[dynlen+1] = L' ';
+						wcsncat(&tmpText[dynlen+2], origText, maxChar - dynlen - 2);
+					}
+					free(textDyn);
+					textDyn = wcsdup(tmpText);
+				}
+			}
+			if(textDyn)
+				fontSystem[referenceSize]->drawText(this->GetLeft(), this->GetTop(), textDyn, c, style);
+		}
+		else if(wrap)
+		{
+			int lineheight = newSize + 6;
+			int txtlen = wcslen(origText);
+			int i = 0;
+			int ch = 0;
+			int linenum = 0;
+			int lastSpace = -1;
+			int lastSpaceIndex = -1;
+			wchar_t * textrow[REFERENCE_ROWS];
+
+			while(ch < txtlen)
+			{
+				if(i == 0)
+					textrow[linenum] = new wchar_t[txtlen + 1];
+
+				if (origText[ch] == L'\n') {
+					textrow[linenum][i] = L'\0';
+					i = 0;
+					linenum++;
+					ch++;
+					continue;
+				}
+
+				textrow[linenum][i] = origText[ch];
+				textrow[linenum][i+1] = L'\0';
+
+				if(origText[ch] == L' ' || ch == txtlen-1)
+				{
+					if(wcslen(textrow[linenum]) >= maxChar)
+					{
+						if(lastSpace >= 0)
+						{
+							textrow[linenum][lastSpaceIndex] = 0; // discard space, and everything after
+							ch = lastSpace; // go backwards to the last space
+							lastSpace = -1; // we have used this space
+							lastSpaceIndex = -1;
+						}
+						linenum++;
+						i = -1;
+					}
+					else if(ch == txtlen-1)
+					{
+						linenum++;
+					}
+				}
+				if(origText[ch] == L' ' && i >= 0)
+				{
+					lastSpace = ch;
+					lastSpaceIndex = i;
+				}
+				ch++;
+				i++;
+			}
+
+			int voffset = 0;
+
+			if(alignmentVert == ALIGN_MIDDLE)
+				voffset = -(lineheight*linenum)/2 + lineheight/2;
+
+			for(i=0; i < linenum; i++)
+			{
+				fontSystem[referenceSize]->drawText(GetLeft(), GetTop()+voffset+i*lineheight, textrow[i], c, style);
+				delete[] textrow[i];
+			}
+		}
+		else
+		{
+			fontSystem[referenceSize]->drawText(GetLeft(), GetTop(), textDyn, c, style);
+		}
+		free(tmpText);
+	}
+	else
+	{
+		fontSystem[referenceSize]->drawText(GetLeft(), GetTop(), origText, c, style);
+	}
+	UpdateEffects();
+}
+
+static const char* const Texts[] = {
+	"Retro Rewind",
+	"Check for updates and install the newest Retro Rewind release now",
+	"Line one\nLine two\n\nafter a blank line",
+	"averyveryveryverylongwordwithoutanyspacesatall and then some more words",
+	"trailing newline\n",
+	"\n\nleading newlines",
+	"",
+	"x",
+	"Pack: Retro Rewind v6.0 (Kart & Bike) - Online mode with custom tracks",
+	"double  spaces  between  words  and  a  space  at  the  end ",
+	// More rows than the launcher's old textrow[20] held
+	"one two three four five six seven eight nine ten eleven twelve thirteen fourteen fifteen sixteen "
+	"seventeen eighteen nineteen twenty twenty-one twenty-two twenty-three twenty-four twenty-five",
+};
+
+enum { PLAIN, TRUNCATED, WRAPPED, SCROLLING, MODES };
+
+// The same text set up the same way as a GuiText and as the reference
+struct Pair
+{
+	GuiText* Text;
+	ReferenceText* Reference;
+};
+
+static void Setup(GuiText* text, int mode, int index)
+{
+	if (mode == TRUNCATED)
+		text->SetMaxWidth(150);
+	else if (mode == WRAPPED)
+		text->SetWrap(true, 100 + index % 3 * 60);
+	else if (mode == SCROLLING) {
+		text->SetMaxWidth(120);
+		text->SetScroll(SCROLL_HORIZONTAL);
+	}
+	const int horizontal[] = { ALIGN_LEFT, ALIGN_CENTRE, ALIGN_RIGHT };
+	const int vertical[] = { ALIGN_TOP, ALIGN_MIDDLE, ALIGN_BOTTOM };
+	text->SetAlignment(horizontal[index % 3], vertical[index / 3 % 3]);
+	if (index % 4 == 3)
+		text->SetStyle(FTGX_STYLE_UNDERLINE);
+	text->SetPosition(index % 7 * 10, mode * 40);
+}
+
+// What happens to the items between frames, picked so that each change reaches every mode
+static void Change(GuiText* text, u32 frame, u32 index)
+{
+	static const s16 wide[] = { 'W', 'i', 'd', 'e', ' ', 't', 'e', 'x', 't', ' ', 's', 'e', 't', ' ', 'f', 'r', 'o', 'm',
+		' ', 's', '1', '6', ' ', 'c', 'h', 'a', 'r', 'a', 'c', 't', 'e', 'r', 's', 0 };
+	if (frame == 100 && index % 5 == 0)
+		text->SetText("Changed text for this entry, long enough to wrap and scroll");
+	if (frame == 120 && index % 5 == 1)
+		text->SetText(wide);
+	if (frame == 150 && index % 5 == 2)
+		text->SetText("");
+	if (frame == 200 && index % 3 == 0)
+		text->SetFontSize(18);
+	if (frame == 250 && index % 7 == 2)
+		text->SetScale(1.5);
+	if (frame == 270 && index % 7 == 2)
+		text->SetScale(1);
+	if (frame == 300 && index % 3 == 1)
+		text->SetMaxWidth(90);
+	if (frame == 350 && index % 5 == 3)
+		text->SetWrap(index % 2, 200);
+	if (frame == 400 && index % 7 == 4)
+		text->SetScroll(index % 2 ? SCROLL_HORIZONTAL : SCROLL_NONE);
+	if (frame == 450 && index % 3 == 2)
+		text->SetColor((GXColor){ 0x10, 0x20, 0x30, 0xff });
+}
+
+static vector<Pair> Items()
+{
+	vector<Pair> items;
+	u32 index = 0;
+	for (u32 t = 0; t < sizeof(Texts) / sizeof(Texts[0]); t++) {
+		for (int mode = 0; mode < MODES; mode++, index++) {
+			Pair pair;
+			pair.Text = new GuiText(Texts[t], 20 + index % 3 * 2, (GXColor){ 0xff, 0xff, 0xff, 0xff });
+			pair.Reference = new ReferenceText(Texts[t], 20 + index % 3 * 2, (GXColor){ 0xff, 0xff, 0xff, 0xff });
+			Setup(pair.Text, mode, index);
+			Setup(pair.Reference, mode, index);
+			items.push_back(pair);
+		}
+	}
+	return items;
+}
+
+int main(int argc, char** argv)
+{
+	u32 frames = argc > 1 ? atoi(argv[1]) : 500;
+
+	// Frame by frame, every item draws what the reference does
+	vector<Pair> items = Items();
+	vector<string> drawn, expected;
+	u32 calls = 0, longest = 0, mismatches = 0;
+	for (FrameTimer = 0; FrameTimer < frames; FrameTimer++) {
+		for (u32 i = 0; i < items.size(); i++) {
+			Change(items[i].Text, FrameTimer, i);
+			Change(items[i].Reference, FrameTimer, i);
+			drawn.clear();
+			expected.clear();
+			Log = &drawn;
+			items[i].Text->Draw();
+			Log = &expected;
+			items[i].Reference->Draw();
+			Log = NULL;
+
+			calls += drawn.size();
+			longest = drawn.size() > longest ? drawn.size() : longest;
+			if (drawn != expected && mismatches++ < 5) {
+				printf("guitext: frame %u, item %u (\"%.20s\") drew\n", FrameTimer, i, Texts[i / MODES]);
+				for (u32 j = 0; j < drawn.size(); j++)
+					printf("  %s\n", drawn[j].c_str());
+				printf("guitext: instead of\n");
+				for (u32 j = 0; j < expected.size(); j++)
+					printf("  %s\n", expected[j].c_str());
+			}
+		}
+	}
+	if (longest <= 20) {
+		printf("guitext: no text wrapped to more than 20 lines\n");
+		mismatches++;
+	}
+	printf("guitext: %zu items over %u frames, %u drawText calls, up to %u lines%s\n", items.size(), frames, calls, longest,
+		mismatches ? ", MISMATCHED" : "");
+
+	// The time a frame of the same items takes either way, and the measuring it does
+	for (int reference = 0; reference < 2; reference++) {
+		vector<Pair> bench = Items();
+		Measures = 0;
+		clock_t start = clock();
+		for (FrameTimer = 0; FrameTimer < frames; FrameTimer++) {
+			for (u32 i = 0; i < bench.size(); i++) {
+				if (reference)
+					bench[i].Reference->Draw();
+				else
+					bench[i].Text->Draw();
+			}
+		}
+		double ms = (double)(clock() - start) * 1000 / CLOCKS_PER_SEC;
+		printf("guitext: %-9s %.3f ms and %4.1f measures a frame\n", reference ? "per frame" : "cached", ms / frames,
+			(double)Measures / frames);
+		for (u32 i = 0; i < bench.size(); i++) {
+			delete bench[i].Text;
+			delete bench[i].Reference;
+		}
+	}
+
+	for (u32 i = 0; i < items.size(); i++) {
+		delete items[i].Text;
+		delete items[i].Reference;
+	}
+	return mismatches ? 1 : 0;
+}
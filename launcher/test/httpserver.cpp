@@ -0,0 +1,245 @@
+// A thread per connection, which is plenty for the handful curl opens.
+
+#include "httpserver.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <string>
+#include <vector>
+
+using std::string;
+
+#define HEADER_LIMIT 0x2000
+#define SEND_CHUNK 0x10000
+
+static string Root;
+static int Listener = -1;
+static pthread_t AcceptThread;
+static pthread_mutex_t Lock = PTHREAD_MUTEX_INITIALIZER;
+static HttpServerStats Stats;
+static std::vector<int> Open;
+
+static bool SendAll(int fd, const void* data, size_t length)
+{
+	const char* pos = (const char*)data;
+	while (length) {
+		ssize_t sent = send(fd, pos, length, MSG_NOSIGNAL);
+		if (sent <= 0)
+			return false;
+		pos += sent;
+		length -= sent;
+	}
+	return true;
+}
+
+static string Header(const string& request, const char* name)
+{
+	size_t length = strlen(name);
+	for (size_t line = request.find("\r\n"); line != string::npos; line = request.find("\r\n", line + 2)) {
+		if (!strncasecmp(request.c_str() + line + 2, name, length) && request[line + 2 + length] == ':') {
+			size_t start = request.find_first_not_of(" \t", line + 3 + length);
+			size_t end = request.find("\r\n", start);
+			return start == string::npos ? string() : request.substr(start, end - start);
+		}
+	}
+	return string();
+}
+
+static bool Respond(int fd, const char* status, const string& headers, bool keepalive, const char* body = "")
+{
+	char response[HEADER_LIMIT];
+	snprintf(response, sizeof(response), "HTTP/1.1 %s\r\n%sConnection: %s\r\nContent-Length: %u\r\n\r\n%s",
+		status, headers.c_str(), keepalive ? "keep-alive" : "close", (u32)strlen(body), body);
+	return SendAll(fd, response, strlen(response));
+}
+
+// Answers one request, returns whether the connection stays open
+static bool Serve(int fd, const string& request)
+{
+	char method[16], target[1024], version[16];
+	if (sscanf(request.c_str(), "%15s %1023s %15s", method, target, version) != 3)
+		return false;
+	bool keepalive = strcmp(version, "HTTP/1.0") && strcasecmp(Header(request, "Connection").c_str(), "close");
+	bool head = !strcmp(method, "HEAD");
+
+	pthread_mutex_lock(&Lock);
+	Stats.Requests++;
+	pthread_mutex_unlock(&Lock);
+
+	string path = Root + target;
+	struct stat st;
+	int file = -1;
+	if ((strcmp(method, "GET") && !head) || strstr(target, "..") || stat(path.c_str(), &st) || !S_ISREG(st.st_mode) ||
+		(file = open(path.c_str(), O_RDONLY)) < 0) {
+		pthread_mutex_lock(&Lock);
+		Stats.Missing++;
+		pthread_mutex_unlock(&Lock);
+		return Respond(fd, "404 Not Found", "", keepalive, "not found\n") && keepalive;
+	}
+
+	char etag[64];
+	snprintf(etag, sizeof(etag), "\"%llx-%llx\"", (unsigned long long)st.st_size,
+		(unsigned long long)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec);
+
+	// A single range, and only while the file is the one the client has the rest of
+	u64 size = st.st_size, start = 0, end = size;
+	bool partial = false;
+	string range = Header(request, "Range");
+	string ifrange = Header(request, "If-Range");
+	if (!range.empty() && (ifrange.empty() || ifrange == etag)) {
+		unsigned long long first, last;
+		int fields = sscanf(range.c_str(), "bytes=%llu-%llu", &first, &last);
+		if (fields >= 1) {
+			if (first >= size) {
+				close(file);
+				char headers[64];
+				snprintf(headers, sizeof(headers), "Content-Range: bytes */%llu\r\n", (unsigned long long)size);
+				return Respond(fd, "416 Range Not Satisfiable", headers, keepalive) && keepalive;
+			}
+			start = first;
+			end = fields == 2 && last + 1 < size ? last + 1 : size;
+			partial = true;
+		}
+	}
+
+	char headers[HEADER_LIMIT];
+	int length = snprintf(headers, sizeof(headers), "HTTP/1.1 %s\r\nETag: %s\r\nAccept-Ranges: bytes\r\nConnection: %s\r\nContent-Length: %llu\r\n",
+		partial ? "206 Partial Content" : "200 OK", etag, keepalive ? "keep-alive" : "close", (unsigned long long)(end - start));
+	if (partial)
+		length += snprintf(headers + length, sizeof(headers) - length, "Content-Range: bytes %llu-%llu/%llu\r\n",
+			(unsigned long long)start, (unsigned long long)end - 1, (unsigned long long)size);
+	strcpy(headers + length, "\r\n");
+	bool ok = SendAll(fd, headers, strlen(headers));
+
+	pthread_mutex_lock(&Lock);
+	if (partial)
+		Stats.Ranges++;
+	pthread_mutex_unlock(&Lock);
+
+	static __thread char buffer[SEND_CHUNK];
+	lseek(file, start, SEEK_SET);
+	for (u64 pos = start; ok && !head && pos < end; ) {
+		ssize_t got = read(file, buffer, end - pos < SEND_CHUNK ? end - pos : SEND_CHUNK);
+		ok = got > 0 && SendAll(fd, buffer, got);
+		if (ok) {
+			pthread_mutex_lock(&Lock);
+			Stats.Bytes += got;
+			pthread_mutex_unlock(&Lock);
+			pos += got;
+		}
+	}
+	close(file);
+	return ok && keepalive;
+}
+
+static void* ConnectionThread(void* arg)
+{
+	int fd = (int)(intptr_t)arg;
+	string pending;
+	char buffer[0x1000];
+	bool open = true;
+	while (open) {
+		size_t end;
+		while ((end = pending.find("\r\n\r\n")) == string::npos) {
+			ssize_t got = pending.size() < HEADER_LIMIT ? recv(fd, buffer, sizeof(buffer), 0) : 0;
+			if (got <= 0)
+				break;
+			pending.append(buffer, got);
+		}
+		if (end == string::npos)
+			break;
+		open = Serve(fd, pending.substr(0, end + 2));
+		pending.erase(0, end + 4);
+	}
+
+	pthread_mutex_lock(&Lock);
+	for (size_t i = 0; i < Open.size(); i++) {
+		if (Open[i] == fd) {
+			Open.erase(Open.begin() + i);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&Lock);
+	close(fd);
+	return NULL;
+}
+
+static void* AcceptLoop(void* arg)
+{
+	int fd;
+	while ((fd = accept(Listener, NULL, NULL)) >= 0) {
+		pthread_mutex_lock(&Lock);
+		Stats.Connections++;
+		Open.push_back(fd);
+		pthread_mutex_unlock(&Lock);
+
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, ConnectionThread, (void*)(intptr_t)fd))
+			close(fd);
+		else
+			pthread_detach(thread);
+	}
+	return NULL;
+}
+
+int HttpServer_Start(const char* root)
+{
+	Root = root;
+	HttpServer_Reset();
+
+	Listener = socket(AF_INET, SOCK_STREAM, 0);
+	if (Listener < 0)
+		return 0;
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t length = sizeof(address);
+	if (bind(Listener, (struct sockaddr*)&address, sizeof(address)) || listen(Listener, 16) ||
+		getsockname(Listener, (struct sockaddr*)&address, &length) || pthread_create(&AcceptThread, NULL, AcceptLoop, NULL)) {
+		close(Listener);
+		Listener = -1;
+		return 0;
+	}
+	return ntohs(address.sin_port);
+}
+
+void HttpServer_Stop()
+{
+	if (Listener < 0)
+		return;
+	shutdown(Listener, SHUT_RDWR);
+	pthread_join(AcceptThread, NULL);
+	close(Listener);
+	Listener = -1;
+
+	pthread_mutex_lock(&Lock);
+	for (size_t i = 0; i < Open.size(); i++)
+		shutdown(Open[i], SHUT_RDWR);
+	pthread_mutex_unlock(&Lock);
+}
+
+void HttpServer_Reset()
+{
+	pthread_mutex_lock(&Lock);
+	memset(&Stats, 0, sizeof(Stats));
+	pthread_mutex_unlock(&Lock);
+}
+
+HttpServerStats HttpServer_Stats()
+{
+	pthread_mutex_lock(&Lock);
+	HttpServerStats stats = Stats;
+	pthread_mutex_unlock(&Lock);
+	return stats;
+}
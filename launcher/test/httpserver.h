@@ -0,0 +1,23 @@
+// A local HTTP/1.1 server for the updater tests. Serves the files under a
+// directory with keep-alive, single Range requests guarded by If-Range and
+// an ETag per file, and counts what it sends so tests can check how much an
+// update transferred.
+#pragma once
+
+#include <gctypes.h>
+
+struct HttpServerStats
+{
+	u64 Bytes;        // body bytes of 200 and 206 responses
+	u32 Requests;
+	u32 Ranges;       // requests answered with 206
+	u32 Missing;      // requests answered with 404
+	u32 Connections;
+};
+
+// Returns the port it listens on at 127.0.0.1, or 0
+int HttpServer_Start(const char* root);
+void HttpServer_Stop();
+
+void HttpServer_Reset();
+HttpServerStats HttpServer_Stats();
@@ -0,0 +1,456 @@
+// Streams responses through http.cpp from a scripted server behind the net_
+// calls, which hands out reads in random pieces, throws in EAGAIN and takes
+// writes a part at a time.
+//
+//   httpstream [seed] [-v]
+//
+// The path of a request says what the server answers:
+//   /len/<n>      a Content-Length body of n bytes
+//   /chunked/<n>  the same body in chunks of random sizes, some with
+//                 extensions, then a trailer
+// followed by any of
+//   ?small      chunks of at most 64 bytes
+//   ?straddle   chunks sized so each size line crosses the end of the ring
+//   ?close      Connection: close, though the server leaves it open
+//   ?http10     an HTTP/1.0 reply, likewise left open
+//   ?cut        the connection closes halfway through the body
+//   ?drop       keep-alive, but the connection is closed once idle
+//   ?badchunk   a chunk size that isn't hex
+//   ?badlength  a chunk a byte longer than its size says
+// /reset closes without answering, anything else is a 404. -v shows
+// http.cpp's own messages.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/param.h>
+
+#include <string>
+#include <vector>
+
+#include <network.h>
+#include "http.h"
+
+using std::string;
+using std::vector;
+
+#define SOCKET_BASE 3
+
+extern http_res result;
+
+struct Connection
+{
+	string Request;   // written by the client and not answered yet
+	string Incoming;  // the response bytes the client hasn't read
+	u32 Read;         // bytes the client has, mod HTTP_RING_SIZE where they are in its ring
+	bool Closing;     // the server closes once Incoming is read
+	bool Connected;
+	bool Open;
+};
+
+static vector<Connection> Connections;
+static u32 Seed = 1;
+static bool Verbose = false;
+static int Requests = 0;
+
+static u32 Random()
+{
+	Seed ^= Seed << 13;
+	Seed ^= Seed >> 17;
+	Seed ^= Seed << 5;
+	return Seed;
+}
+
+// Hashed, so stale data from a lap of the ring before never looks right
+static u8 Body(u32 size, u32 i)
+{
+	u32 x = (i + size * 0x9E3779B9) * 0x85EBCA6B;
+	return x ^ (x >> 13) ^ (x >> 24);
+}
+
+static void Respond(Connection* conn, const char* path)
+{
+	Requests++;
+	u32 size = 0;
+	char kind[16] = "";
+	if (sscanf(path, "/%15[a-z]/%u", kind, &size) != 2 || (strcmp(kind, "len") && strcmp(kind, "chunked")) || !size) {
+		if (!strcmp(path, "/reset"))
+			conn->Closing = true;
+		else
+			conn->Incoming += "HTTP/1.1 404 Not Found\r\nContent-Length: 10\r\n\r\nnot found\n";
+		return;
+	}
+	bool chunked = !strcmp(kind, "chunked");
+	const char* options = strchr(path, '?');
+	options = options ? options : "";
+	bool cut = strstr(options, "cut");
+
+	string body(size, '\0');
+	for (u32 i = 0; i < size; i++)
+		body[i] = Body(size, i);
+	if (cut)
+		body.resize(size / 2);
+
+	char header[256];
+	conn->Incoming += strstr(options, "http10") ? "HTTP/1.0 200 OK\r\n" : "HTTP/1.1 200 OK\r\n";
+	conn->Incoming += "Server: shim\r\nContent-Type: application/octet-stream\r\n";
+	if (strstr(options, "close"))
+		conn->Incoming += "Connection: close\r\n";
+	if (chunked)
+		conn->Incoming += "Transfer-Encoding: chunked\r\n\r\n";
+	else {
+		snprintf(header, sizeof(header), "Content-Length: %u\r\n\r\n", size);
+		conn->Incoming += header;
+	}
+
+	if (!chunked)
+		conn->Incoming += body;
+	else {
+		bool straddle = strstr(options, "straddle");
+		for (u32 pos = 0, count = 0; pos < body.size(); count++) {
+			u32 length = 1 + Random() % (strstr(options, "small") ? 64 : 20000);
+			if (straddle) {
+				// Padded to a known length, so the next size line can be put a few bytes before the end
+				u32 line = (conn->Read + conn->Incoming.size()) % HTTP_RING_SIZE + strlen("00000;name=value\r\n");
+				length = (2 * HTTP_RING_SIZE - line - 2 - (1 + Random() % 12)) % HTTP_RING_SIZE;
+				length = length ? length : 1;
+			}
+			if (length > body.size() - pos)
+				length = body.size() - pos;
+			if (strstr(options, "badchunk") && count == 1)
+				conn->Incoming += "zz\r\n";
+			else {
+				u32 declared = strstr(options, "badlength") && count == 1 ? length - 1 : length;
+				snprintf(header, sizeof(header), straddle ? "%05x;name=value\r\n" : count % 2 ? "%x;name=value;flag\r\n" : "%X\r\n", declared);
+				conn->Incoming += header;
+			}
+			conn->Incoming += body.substr(pos, length) + "\r\n";
+			pos += length;
+		}
+		if (!cut)
+			conn->Incoming += "0\r\nX-Checksum: 0123456789abcdef\r\nX-Other: trailer\r\n\r\n";
+	}
+
+	if (cut || strstr(options, "drop"))
+		conn->Closing = true;
+}
+
+static Connection* Get(s32 s)
+{
+	u32 index = s - SOCKET_BASE;
+	return index < Connections.size() && Connections[index].Open ? &Connections[index] : NULL;
+}
+
+s32 net_socket(u32 domain, u32 type, u32 protocol)
+{
+	Connection conn = { "", "", 0, false, false, true };
+	Connections.push_back(conn);
+	return SOCKET_BASE + Connections.size() - 1;
+}
+
+s32 net_fcntl(s32 s, u32 cmd, u32 flags)
+{
+	return Get(s) ? 0 : -EBADF;
+}
+
+struct hostent* net_gethostbyname(const char* addrString)
+{
+	static char address[4] = { 127, 0, 0, 1 };
+	static char* addresses[] = { address, NULL };
+	static struct hostent host = { (char*)"shim", NULL, PF_INET, 4, addresses };
+	return strcmp(addrString, "shim") ? NULL : &host;
+}
+
+// The handshake takes one poll
+s32 net_connect(s32 s, struct sockaddr* addr, u32 addrlen)
+{
+	Connection* conn = Get(s);
+	if (!conn)
+		return -EBADF;
+	if (conn->Connected)
+		return -EISCONN;
+	conn->Connected = true;
+	return -EINPROGRESS;
+}
+
+s32 net_read(s32 s, void* mem, s32 len)
+{
+	Connection* conn = Get(s);
+	if (!conn)
+		return -EBADF;
+	if (conn->Incoming.empty())
+		return conn->Closing ? 0 : -EAGAIN;
+	if (Random() % 8 == 0)
+		return -EAGAIN;
+
+	u32 piece;
+	switch (Random() % 4) {
+		case 0: piece = 1 + Random() % 16; break;
+		case 1: piece = conn->Incoming.size(); break;
+		default: piece = 1 + Random() % 0x1000; break;
+	}
+	piece = MIN(piece, MIN((u32)len, conn->Incoming.size()));
+	memcpy(mem, conn->Incoming.data(), piece);
+	conn->Incoming.erase(0, piece);
+	conn->Read += piece;
+	return piece;
+}
+
+s32 net_write(s32 s, const void* data, s32 size)
+{
+	Connection* conn = Get(s);
+	if (!conn)
+		return -EBADF;
+	if (Random() % 8 == 0)
+		return -EAGAIN;
+
+	// A closed connection takes the write, the reset only shows when reading
+	u32 length = 1 + Random() % 64;
+	length = MIN(length, (u32)size);
+	if (conn->Closing)
+		return length;
+	conn->Request.append((const char*)data, length);
+
+	size_t end;
+	while ((end = conn->Request.find("\r\n\r\n")) != string::npos) {
+		char path[256];
+		if (sscanf(conn->Request.c_str(), "GET %255s HTTP/1.1", path) == 1)
+			Respond(conn, path);
+		conn->Request.erase(0, end + 4);
+	}
+	return length;
+}
+
+s32 net_close(s32 s)
+{
+	Connection* conn = Get(s);
+	if (!conn)
+		return -EBADF;
+	conn->Open = false;
+	return 0;
+}
+
+// Nothing happens while the client waits, so what isn't ready now never will be
+s32 net_poll(struct pollsd* sds, s32 nsds, s32 timeout)
+{
+	s32 ready = 0;
+	for (s32 i = 0; i < nsds; i++) {
+		Connection* conn = Get(sds[i].socket);
+		sds[i].revents = 0;
+		if (conn && (sds[i].events & POLLIN) && (!conn->Incoming.empty() || conn->Closing))
+			sds[i].revents |= POLLIN;
+		if (conn && (sds[i].events & POLLOUT))
+			sds[i].revents |= POLLOUT;
+		ready += sds[i].revents != 0;
+	}
+	return ready;
+}
+
+static int OpenConnections()
+{
+	int open = 0;
+	for (u32 i = 0; i < Connections.size(); i++)
+		open += Connections[i].Open;
+	return open;
+}
+
+struct Received
+{
+	u32 Size;     // of the whole body, to check it against
+	u32 Length;
+	u32 Pieces;
+	u32 Wraps;    // pieces that started back at the beginning of the ring
+	u32 AbortAt;  // give up once this much came in, 0 never
+	bool Corrupt;
+	const u8* Last;
+};
+
+static bool Sink(void* userdata, const u8* data, const u32 length)
+{
+	Received* received = (Received*)userdata;
+	if (length > HTTP_RING_SIZE || received->Length + length > received->Size)
+		received->Corrupt = true;
+	for (u32 i = 0; i < length && !received->Corrupt; i++)
+		received->Corrupt = data[i] != Body(received->Size, received->Length + i);
+	if (received->Last && data < received->Last)
+		received->Wraps++;
+	received->Last = data + length;
+	received->Length += length;
+	received->Pieces++;
+	return !received->AbortAt || received->Length < received->AbortAt;
+}
+
+static int Quiet()
+{
+	fflush(stdout);
+	int saved = dup(1);
+	if (!Verbose) {
+		int null = open("/dev/null", O_WRONLY);
+		dup2(null, 1);
+		close(null);
+	}
+	return saved;
+}
+
+static void Loud(int saved)
+{
+	fflush(stdout);
+	dup2(saved, 1);
+	close(saved);
+}
+
+static const char* const Results[] = { "OK", "ERR_CONNECT", "ERR_REQUEST", "ERR_STATUS", "ERR_TOOBIG", "ERR_RECEIVE", "ERR_ABORTED" };
+
+// Streams a request and checks how it ended, the body and how many
+// connections it opened
+static bool Stream(const char* path, http_res expected, u32 size, int connections, Received* received, u32 abort = 0)
+{
+	char url[256];
+	snprintf(url, sizeof(url), "http://shim%s", path);
+	memset(received, 0, sizeof(Received));
+	received->Size = size;
+	received->AbortAt = abort;
+
+	u32 before = Connections.size();
+	int saved = Quiet();
+	bool ok = http_request_stream(url, Sink, received);
+	Loud(saved);
+	u32 status = 0, length;
+	u8* content;
+	http_get_result(&status, &content, &length);
+
+	bool passed = ok == (expected == HTTPR_OK) && result == expected && (int)(Connections.size() - before) == connections &&
+		!received->Corrupt && (expected != HTTPR_OK || received->Length == size) &&
+		(expected != HTTPR_ERR_ABORTED || received->Length >= abort);
+	if (!passed)
+		printf("httpstream: %s: %s with %u of %u bytes%s over %d new connections, expected %s over %d\n", path,
+			Results[result], received->Length, size, received->Corrupt ? " (corrupt)" : "", (int)(Connections.size() - before),
+			Results[expected], connections);
+	return passed;
+}
+
+// Buffers a request with http_request and checks what came back
+static bool Buffer(const char* path, u32 max_size, http_res expected, u32 size)
+{
+	char url[256];
+	snprintf(url, sizeof(url), "http://shim%s", path);
+	int saved = Quiet();
+	bool ok = http_request(url, max_size);
+	Loud(saved);
+	u32 status = 0, length = 0;
+	u8* content = NULL;
+	http_get_result(&status, &content, &length);
+
+	bool passed = ok == (expected == HTTPR_OK) && result == expected && OpenConnections() == 0;
+	if (expected == HTTPR_OK) {
+		passed = passed && content && length == size && status == 200 && (u32)content % 32 == 0;
+		for (u32 i = 0; passed && i < size; i++)
+			passed = content[i] == Body(size, i);
+	} else
+		passed = passed && !content && !length;
+	free(content);
+
+	if (!passed)
+		printf("httpstream: %s in %u bytes: %s with %u bytes, expected %s with %u\n", path, max_size,
+			Results[result], length, Results[expected], expected == HTTPR_OK ? size : 0);
+	return passed;
+}
+
+int main(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-v"))
+			Verbose = true;
+		else
+			Seed = atoi(argv[i]);
+	}
+	u32 seed = Seed;
+
+	bool ok = true;
+	Received received;
+	const u32 sizes[] = { 1, 1000, HTTP_RING_SIZE - 1, HTTP_RING_SIZE, HTTP_RING_SIZE + 1, 3 * HTTP_RING_SIZE + 123 };
+	const u32 count = sizeof(sizes) / sizeof(sizes[0]);
+	char path[64];
+
+	// Both framings, buffered and streamed, one connection each for buffered
+	int bodies = 0;
+	for (u32 i = 0; i < count; i++) {
+		const char* kinds[] = { "len", "chunked" };
+		for (int kind = 0; kind < 2; kind++) {
+			snprintf(path, sizeof(path), "/%s/%u", kinds[kind], sizes[i]);
+			ok &= Buffer(path, sizes[i], HTTPR_OK, sizes[i]);
+			ok &= Buffer(path, sizes[i] + 1, HTTPR_OK, sizes[i]);
+			bodies += 2;
+		}
+	}
+	http_close();
+	printf("httpstream: %d buffered bodies\n", bodies);
+
+	// Streamed requests share one connection, whose ring wraps around
+	u32 wraps = 0, pieces = 0;
+	for (u32 round = 0; round < 3; round++) {
+		for (u32 i = 0; i < count; i++) {
+			snprintf(path, sizeof(path), "/%s/%u", (i + round) % 2 ? "chunked" : "len", sizes[i]);
+			ok &= Stream(path, HTTPR_OK, sizes[i], round == 0 && i == 0 ? 1 : 0, &received);
+			wraps += received.Wraps;
+			pieces += received.Pieces;
+		}
+	}
+	if (!wraps) {
+		printf("httpstream: the ring never wrapped\n");
+		ok = false;
+	}
+	printf("httpstream: %u streamed bodies on one connection in %u pieces, %u across the end of the ring\n", count * 3, pieces, wraps);
+
+	// Size lines split by the end of the ring, and a whole lot of them
+	ok &= Stream("/chunked/400000?straddle", HTTPR_OK, 400000, 0, &received);
+	ok &= Stream("/chunked/150000?small", HTTPR_OK, 150000, 0, &received);
+
+	// A response saying the connection ends must be enough for the client to close it, the shim leaves it open
+	ok &= Stream("/len/5000?close", HTTPR_OK, 5000, 0, &received);
+	ok &= Stream("/chunked/5000?http10", HTTPR_OK, 5000, 1, &received);
+	ok &= Stream("/len/5000", HTTPR_OK, 5000, 1, &received);
+
+	// A kept connection the server dropped in the meantime is retried once on a fresh one
+	ok &= Stream("/len/7000?drop", HTTPR_OK, 7000, 0, &received);
+	ok &= Stream("/chunked/7000", HTTPR_OK, 7000, 1, &received);
+	ok &= Stream("/reset", HTTPR_ERR_REQUEST, 0, 1, &received);
+	ok &= Stream("/len/7000?drop", HTTPR_OK, 7000, 1, &received);
+	ok &= Stream("/reset", HTTPR_ERR_REQUEST, 0, 1, &received);
+	if (OpenConnections()) {
+		printf("httpstream: a failed request left its connection open\n");
+		ok = false;
+	}
+	printf("httpstream: closed and dropped connections reopened\n");
+
+	// Bodies that don't fit, whether the length is known up front or not
+	ok &= Buffer("/len/100000", 99999, HTTPR_ERR_TOOBIG, 0);
+	ok &= Buffer("/chunked/100000", 99999, HTTPR_ERR_TOOBIG, 0);
+	ok &= Buffer("/chunked/100000", 1000, HTTPR_ERR_TOOBIG, 0);
+
+	// A sink giving up, which leaves the body in flight so the connection can't be kept
+	ok &= Stream("/len/3000", HTTPR_OK, 3000, 1, &received);
+	ok &= Stream("/len/200000", HTTPR_ERR_ABORTED, 200000, 0, &received, 70000);
+	ok &= Stream("/chunked/200000", HTTPR_ERR_ABORTED, 200000, 1, &received, 70000);
+	ok &= Stream("/len/3000", HTTPR_OK, 3000, 1, &received);
+
+	// Broken responses
+	ok &= Stream("/len/50000?cut", HTTPR_ERR_RECEIVE, 50000, 0, &received);
+	ok &= Stream("/chunked/50000?cut", HTTPR_ERR_RECEIVE, 50000, 1, &received);
+	ok &= Stream("/chunked/50000?badchunk", HTTPR_ERR_RECEIVE, 50000, 1, &received);
+	ok &= Stream("/chunked/50000?badlength", HTTPR_ERR_RECEIVE, 50000, 1, &received);
+	ok &= Stream("/missing", HTTPR_ERR_STATUS, 0, 1, &received);
+	ok &= Buffer("/missing", 1000, HTTPR_ERR_STATUS, 0);
+	printf("httpstream: oversized, aborted and broken bodies rejected\n");
+
+	http_close();
+	if (OpenConnections()) {
+		printf("httpstream: http_close left a connection open\n");
+		ok = false;
+	}
+
+	printf("httpstream: seed %u, %d requests over %u connections%s\n", seed, Requests, (u32)Connections.size(), ok ? "" : ", FAILED");
+	return ok ? 0 : 1;
+}
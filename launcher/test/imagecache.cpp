@@ -0,0 +1,237 @@
+// Times menu construction with and without the shared image cache.
+//
+//   imagecache sizes
+//   imagecache none|sync|async [idle KiB] [dwell ms]
+//
+// none decodes every image each time a screen is built, as before the cache.
+// sync shares and keeps textures but decodes in the constructor, and async is
+// what the launcher does. The screens and their prefetch lists are the ones
+// menu_main.cpp builds. Widgets in BAKE_PNGS never decode on the Wii, so they
+// are left out. Each screen stays up for the dwell time before the next one.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/param.h>
+#include <sys/wait.h>
+
+#include "gui.h"
+
+extern "C" {
+#include "background_png.h"
+#include "optionsover_png.h"
+#include "optionsover2_png.h"
+#include "updateover_png.h"
+#include "updateover2_png.h"
+#include "launchover_png.h"
+#include "launchover2_png.h"
+#include "exitover_png.h"
+#include "exitover2_png.h"
+#include "installover_png.h"
+#include "installover2_png.h"
+#include "back_png.h"
+#include "backover_png.h"
+#include "updateconfirm_png.h"
+#include "updating_png.h"
+#include "rebooting_png.h"
+#include "credit1_png.h"
+#include "credit2_png.h"
+#include "credit3_png.h"
+#include "credit4_png.h"
+}
+
+#define RUNS 3
+
+int ImageCacheIdleSize;
+
+static volatile int Decodes = 0;
+static volatile u32 DecodedBytes = 0;
+
+extern "C" int __real_PNGU_DecodeTo4x4RGBA8(IMGCTX ctx, PNGU_u32 width, PNGU_u32 height, void* buffer, PNGU_u8 default_alpha);
+extern "C" int __wrap_PNGU_DecodeTo4x4RGBA8(IMGCTX ctx, PNGU_u32 width, PNGU_u32 height, void* buffer, PNGU_u8 default_alpha)
+{
+	__sync_fetch_and_add(&Decodes, 1);
+	__sync_fetch_and_add(&DecodedBytes, width * height * 4);
+	return __real_PNGU_DecodeTo4x4RGBA8(ctx, width, height, buffer, default_alpha);
+}
+
+static const u8* const MainMenuImages[] = {
+	optionsover_png, optionsover2_png, updateover_png, updateover2_png, launchover_png, launchover2_png,
+	exitover_png, exitover2_png, installover_png, installover2_png, NULL
+};
+static const u8* const MainMenuNextImages[] = {
+	back_png, backover_png, updateconfirm_png, NULL
+};
+static const u8* const OptionsImages[] = {
+	back_png, backover_png, NULL
+};
+static const u8* const UpdateConfirmImages[] = {
+	updateconfirm_png, NULL
+};
+static const u8* const UpdateConfirmNextImages[] = {
+	updating_png, rebooting_png, NULL
+};
+static const u8* const CreditsImages[] = {
+	credit1_png, credit2_png, credit3_png, credit4_png, NULL
+};
+static const u8* const NoImages[] = {
+	NULL
+};
+
+struct Screen
+{
+	const char* Name;
+	const u8* const* Prefetch;
+	const u8* const* Images;
+};
+
+// From mounting to the main menu, then around it as someone setting up a launch would
+static const Screen Session[] = {
+	{ "mount", MainMenuImages, NoImages },
+	{ "main", MainMenuNextImages, MainMenuImages },
+	{ "options", NoImages, OptionsImages },
+	{ "main", MainMenuNextImages, MainMenuImages },
+	{ "options", NoImages, OptionsImages },
+	{ "main", MainMenuNextImages, MainMenuImages },
+	{ "update", UpdateConfirmNextImages, UpdateConfirmImages },
+	{ "main", MainMenuNextImages, MainMenuImages },
+	{ "credits", NoImages, CreditsImages },
+	{ "main", MainMenuNextImages, MainMenuImages },
+	{ "options", NoImages, OptionsImages },
+	{ "main", MainMenuNextImages, MainMenuImages },
+};
+
+struct Result
+{
+	double Built;
+	double Ready;
+	double Slowest;
+	int Decodes;
+	u32 DecodedBytes;
+};
+
+static double Milliseconds(u64 start, u64 end)
+{
+	return diff_usec(start, end) / 1000.0;
+}
+
+static void RunSession(bool cache, bool async, int dwell, Result* result)
+{
+	// The background is built once at startup and held for the whole session
+	GuiImageData* background = new GuiImageData(background_png, false);
+	Decodes = 0;
+	DecodedBytes = 0;
+
+	memset(result, 0, sizeof(Result));
+	for (u32 i = 0; i < sizeof(Session) / sizeof(Session[0]); i++) {
+		const Screen* screen = &Session[i];
+		std::vector<GuiImageData*> images;
+
+		u64 start = gettime();
+		if (cache) {
+			for (const u8* const* image = screen->Prefetch; *image; image++)
+				GuiImageData::Prefetch(*image);
+		}
+		for (const u8* const* image = screen->Images; *image; image++)
+			images.push_back(new GuiImageData(*image, async));
+		u64 constructed = gettime();
+		for (u32 j = 0; j < images.size(); j++)
+			images[j]->Wait();
+		u64 drawn = gettime();
+
+		result->Built += Milliseconds(start, constructed);
+		result->Ready += Milliseconds(start, drawn);
+		result->Slowest = MAX(result->Slowest, Milliseconds(start, drawn));
+
+		usleep(dwell * 1000);
+		for (u32 j = 0; j < images.size(); j++)
+			delete images[j];
+	}
+	delete background;
+
+	result->Decodes = Decodes;
+	result->DecodedBytes = DecodedBytes;
+}
+
+static int CompareResults(const void* a, const void* b)
+{
+	double left = ((const Result*)a)->Ready, right = ((const Result*)b)->Ready;
+	return left < right ? -1 : left > right;
+}
+
+static u32 TextureBytes(const u8* const* images)
+{
+	u32 bytes = 0;
+	for (; *images; images++) {
+		GuiImageData data(*images, false);
+		bytes += data.GetWidth() * data.GetHeight() * 4;
+	}
+	return bytes;
+}
+
+// What each screen holds while it's shown and what it prefetches for the next
+static int Sizes()
+{
+	const char* shown[sizeof(Session) / sizeof(Session[0])];
+	u32 count = 0;
+	for (u32 i = 0; i < sizeof(Session) / sizeof(Session[0]); i++) {
+		u32 j;
+		for (j = 0; j < count && strcmp(shown[j], Session[i].Name); j++)
+			;
+		if (j < count)
+			continue;
+		shown[count++] = Session[i].Name;
+		printf("imagecache: %-8s holds %5u KiB, prefetches %5u KiB\n", Session[i].Name,
+			TextureBytes(Session[i].Images) / 1024, TextureBytes(Session[i].Prefetch) / 1024);
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc == 2 && !strcmp(argv[1], "sizes"))
+		return Sizes();
+
+	if (argc < 2 || (strcmp(argv[1], "none") && strcmp(argv[1], "sync") && strcmp(argv[1], "async"))) {
+		fprintf(stderr, "usage: imagecache sizes\n       imagecache none|sync|async [idle KiB] [dwell ms]\n");
+		return 1;
+	}
+	bool cache = strcmp(argv[1], "none");
+	bool async = !strcmp(argv[1], "async");
+	ImageCacheIdleSize = cache ? (argc > 2 ? atoi(argv[2]) : 4096) * 1024 : 0;
+	int dwell = argc > 3 ? atoi(argv[3]) : 50;
+
+	// One CPU as on the Wii, so background decodes compete with the menu
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(0, &cpus);
+	sched_setaffinity(0, sizeof(cpus), &cpus);
+
+	// Every session starts from a cold cache in its own process, the median by ready time is shown
+	Result results[RUNS];
+	for (int run = 0; run < RUNS; run++) {
+		int pipes[2];
+		if (pipe(pipes))
+			return 1;
+		pid_t child = fork();
+		if (!child) {
+			RunSession(cache, async, dwell, &results[run]);
+			write(pipes[1], &results[run], sizeof(Result));
+			_exit(0);
+		}
+		close(pipes[1]);
+		int got = read(pipes[0], &results[run], sizeof(Result));
+		close(pipes[0]);
+		waitpid(child, NULL, 0);
+		if (got != sizeof(Result))
+			return 1;
+	}
+	qsort(results, RUNS, sizeof(Result), CompareResults);
+	Result* median = &results[RUNS / 2];
+
+	printf("imagecache: %-5s %5d KiB idle: built %7.2f ms, ready %7.2f ms, slowest screen %6.2f ms, %3d decodes (%5u KiB)\n",
+		argv[1], ImageCacheIdleSize / 1024, median->Built, median->Ready, median->Slowest, median->Decodes, median->DecodedBytes / 1024);
+	return 0;
+}
@@ -0,0 +1,55 @@
+// Host stand-in for libogc's asndlib.h, the tests provide whatever they call
+#pragma once
+
+#include <gctypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SND_OK					0
+#define SND_INVALID				-1
+#define SND_ISNOTASONGVOICE		-2
+#define SND_BUSY				1
+
+#define SND_UNUSED				0
+#define SND_WORKING				1
+#define SND_WAITING				2
+
+#define VOICE_MONO_8BIT			0
+#define VOICE_MONO_16BIT		1
+#define VOICE_MONO_16BIT_BE		1
+#define VOICE_STEREO_8BIT		2
+#define VOICE_STEREO_16BIT		3
+#define VOICE_STEREO_16BIT_BE	3
+#define VOICE_MONO_8BIT_U		4
+#define VOICE_MONO_16BIT_LE		5
+#define VOICE_STEREO_8BIT_U		6
+#define VOICE_STEREO_16BIT_LE	7
+
+#define MIN_PITCH				1
+#define INIT_RATE_48000
+
+typedef void (*ASNDVoiceCallback)(s32 voice);
+
+void ASND_Init(void);
+void ASND_End(void);
+void ASND_Pause(s32 paused);
+s32 ASND_SetVoice(s32 voice, s32 format, s32 pitch, s32 delay, void* snd, s32 size_snd, s32 volume_l, s32 volume_r, ASNDVoiceCallback callback);
+s32 ASND_AddVoice(s32 voice, void* snd, s32 size_snd);
+s32 ASND_StopVoice(s32 voice);
+s32 ASND_PauseVoice(s32 voice, s32 pause);
+s32 ASND_StatusVoice(s32 voice);
+s32 ASND_GetFirstUnusedVoice(void);
+s32 ASND_ChangeVolumeVoice(s32 voice, s32 volume_l, s32 volume_r);
+s32 ASND_TestPointer(s32 voice, void* pointer);
+s32 ASND_TestVoiceBufferReady(s32 voice);
+u32 ASND_GetTickCounterVoice(s32 voice);
+u32 ASND_GetTimerVoice(s32 voice);
+u32 ASND_GetTime(void);
+u32 ASND_GetSampleCounter(void);
+u32 ASND_GetSamplesPerTick(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,138 @@
+// Host stand-in for libogc's gccore.h, only what the code under test uses.
+// The tests provide the functions, ogc.cpp has the common ones.
+#pragma once
+
+#include <gctypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _gxcolor {
+	u8 r, g, b, a;
+} GXColor;
+
+typedef struct _gx_texobj {
+	u32 val[8];
+} GXTexObj;
+
+typedef f32 Mtx[3][4];
+typedef f32 Mtx44[4][4];
+
+typedef u8 sha1[20];
+
+typedef struct _guVector {
+	f32 x, y, z;
+} guVector;
+
+#define GX_TF_I4		0x0
+#define GX_TF_I8		0x1
+#define GX_TF_IA4		0x2
+#define GX_TF_IA8		0x3
+#define GX_TF_RGB565	0x4
+#define GX_TF_RGB5A3	0x5
+#define GX_TF_RGBA8		0x6
+
+#define GX_VTXFMT0		0
+#define GX_VTXFMT1		1
+
+#define GX_CLAMP		0
+#define GX_REPEAT		1
+#define GX_FALSE		0
+#define GX_TRUE			1
+#define GX_NEAR			0
+#define GX_LINEAR		1
+
+#define GX_VA_POS		9
+#define GX_VA_CLR0		11
+#define GX_VA_TEX0		13
+#define GX_POS_XY		0
+#define GX_TEX_ST		1
+#define GX_CLR_RGBA		1
+#define GX_S16			3
+#define GX_F32			4
+#define GX_RGBA8		5
+
+#define GX_NONE			0
+#define GX_DIRECT		1
+#define GX_INDEX8		2
+#define GX_INDEX16		3
+
+#define GX_TEVSTAGE0	0
+#define GX_MODULATE		0
+#define GX_DECAL		1
+#define GX_BLEND		2
+#define GX_REPLACE		3
+#define GX_PASSCLR		4
+
+#define GX_TEXMAP0		0
+#define GX_QUADS		0x80
+
+// GX, drawn on the CPU by the tests that use it
+void GX_SetVtxAttrFmt(u8 vtxfmt, u32 vtxattr, u32 comptype, u32 compsize, u32 frac);
+void GX_SetVtxDesc(u8 attr, u8 type);
+void GX_SetTevOp(u8 tevstage, u8 mode);
+void GX_InitTexObj(GXTexObj* obj, void* img_ptr, u16 wd, u16 ht, u8 fmt, u8 wrap_s, u8 wrap_t, u8 mipmap);
+void GX_InitTexObjFilterMode(GXTexObj* obj, u8 minfilt, u8 magfilt);
+void GX_LoadTexObj(GXTexObj* obj, u8 mapid);
+void GX_InvalidateTexAll(void);
+void GX_DrawDone(void);
+void GX_Begin(u8 primitve, u8 vtxfmt, u16 vtxcnt);
+void GX_End(void);
+void GX_Position2s16(s16 x, s16 y);
+void GX_Color4u8(u8 r, u8 g, u8 b, u8 a);
+void GX_TexCoord2f32(f32 s, f32 t);
+
+#define PAD_BUTTON_LEFT		0x0001
+#define PAD_BUTTON_RIGHT	0x0002
+#define PAD_BUTTON_DOWN		0x0004
+#define PAD_BUTTON_UP		0x0008
+#define PAD_BUTTON_A		0x0100
+#define PAD_BUTTON_B		0x0200
+
+void DCFlushRange(void* start, u32 length);
+void DCInvalidateRange(void* start, u32 length);
+
+// Threads, run on pthreads
+typedef u32 lwp_t;
+typedef u32 mutex_t;
+typedef u32 cond_t;
+typedef u32 lwpq_t;
+typedef u32 sem_t;
+
+#define LWP_THREAD_NULL	0xFFFFFFFF
+#define LWP_MUTEX_NULL	0xFFFFFFFF
+#define LWP_COND_NULL	0xFFFFFFFF
+#define LWP_TQUEUE_NULL	0xFFFFFFFF
+#define LWP_SEM_NULL	0xFFFFFFFF
+
+s32 LWP_CreateThread(lwp_t* thethread, void* (*entry)(void*), void* arg, void* stackbase, u32 stack_size, u8 prio);
+s32 LWP_JoinThread(lwp_t thethread, void** value_ptr);
+void LWP_YieldThread(void);
+s32 LWP_MutexInit(mutex_t* mutex, bool use_recursive);
+s32 LWP_MutexDestroy(mutex_t mutex);
+s32 LWP_MutexLock(mutex_t mutex);
+s32 LWP_MutexUnlock(mutex_t mutex);
+s32 LWP_CondInit(cond_t* cond);
+s32 LWP_CondDestroy(cond_t cond);
+s32 LWP_CondWait(cond_t cond, mutex_t mutex);
+s32 LWP_CondSignal(cond_t cond);
+s32 LWP_CondBroadcast(cond_t cond);
+s32 LWP_InitQueue(lwpq_t* thequeue);
+void LWP_CloseQueue(lwpq_t thequeue);
+s32 LWP_ThreadSleep(lwpq_t thequeue);
+void LWP_ThreadSignal(lwpq_t thequeue);
+
+// Semaphores, provided by the tests that use them
+s32 LWP_SemInit(sem_t* sem, u32 start, u32 max);
+s32 LWP_SemDestroy(sem_t sem);
+s32 LWP_SemWait(sem_t sem);
+s32 LWP_SemPost(sem_t sem);
+
+u64 gettime(void);
+u32 diff_usec(u64 start, u64 end);
+u32 diff_msec(u64 start, u64 end);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,66 @@
+// Host stand-in for libogc's network.h, the tests provide the net_ calls.
+// As on the Wii they return a negative errno on failure.
+#pragma once
+
+#include <gctypes.h>
+#include <errno.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PF_INET			2
+#define AF_INET			PF_INET
+#define SOCK_STREAM		1
+
+#define POLLIN			0x0001
+#define POLLOUT			0x0004
+
+// Big-endian like the Wii, addresses are never put on a wire
+#define htons(x)		(x)
+#define htonl(x)		(x)
+
+struct in_addr {
+	u32 s_addr;
+};
+
+struct sockaddr {
+	u8 sa_len;
+	u8 sa_family;
+	char sa_data[14];
+};
+
+struct sockaddr_in {
+	u8 sin_len;
+	u8 sin_family;
+	u16 sin_port;
+	struct in_addr sin_addr;
+	s8 sin_zero[8];
+};
+
+struct hostent {
+	char* h_name;
+	char** h_aliases;
+	u16 h_addrtype;
+	u16 h_length;
+	char** h_addr_list;
+};
+
+struct pollsd {
+	s32 socket;
+	u32 events;
+	u32 revents;
+};
+
+s32 net_socket(u32 domain, u32 type, u32 protocol);
+s32 net_fcntl(s32 s, u32 cmd, u32 flags);
+struct hostent* net_gethostbyname(const char* addrString);
+s32 net_connect(s32 s, struct sockaddr* addr, u32 addrlen);
+s32 net_read(s32 s, void* mem, s32 len);
+s32 net_write(s32 s, const void* data, s32 size);
+s32 net_close(s32 s);
+s32 net_poll(struct pollsd* sds, s32 nsds, s32 timeout);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,10 @@
+// Host stand-in for libogc's lwp_watchdog.h, on ogc.cpp's time base
+#pragma once
+
+#include <gccore.h>
+
+#define TB_TIMER_CLOCK				60750
+
+#define diff_ticks(tick0, tick1)	((tick1) - (tick0))
+#define ticks_to_millisecs(ticks)	((u64)(ticks) / TB_TIMER_CLOCK)
+#define millisecs_to_ticks(msec)	((u64)(msec) * TB_TIMER_CLOCK)
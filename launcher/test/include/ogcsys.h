@@ -0,0 +1,4 @@
+// Host stand-in for libogc's ogcsys.h
+#pragma once
+
+#include <gccore.h>
@@ -0,0 +1,12 @@
+// Host stand-in for tremor, the tests that need it provide the decoder
+#pragma once
+
+#include <gctypes.h>
+
+typedef s64 ogg_int64_t;
+
+typedef struct vorbis_info {
+	int version;
+	int channels;
+	long rate;
+} vorbis_info;
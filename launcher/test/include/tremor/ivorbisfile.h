@@ -0,0 +1,42 @@
+// Host stand-in for tremor, the tests that need it provide the decoder
+#pragma once
+
+#include <stddef.h>
+#include <tremor/ivorbiscodec.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OV_FALSE	-1
+#define OV_EOF		-2
+#define OV_HOLE		-3
+#define OV_EREAD	-128
+#define OV_EINVAL	-131
+
+typedef struct {
+	size_t (*read_func)(void* ptr, size_t size, size_t nmemb, void* datasource);
+	int (*seek_func)(void* datasource, ogg_int64_t offset, int whence);
+	int (*close_func)(void* datasource);
+	long (*tell_func)(void* datasource);
+} ov_callbacks;
+
+// Only what the tests' decoders keep
+typedef struct OggVorbis_File {
+	void* datasource;
+	ov_callbacks callbacks;
+	vorbis_info vi;
+	ogg_int64_t pcm_offset; // next frame ov_read decodes
+	ogg_int64_t pcm_total; // frames in the stream
+} OggVorbis_File;
+
+int ov_open_callbacks(void* datasource, OggVorbis_File* vf, char* initial, long ibytes, ov_callbacks callbacks);
+int ov_clear(OggVorbis_File* vf);
+vorbis_info* ov_info(OggVorbis_File* vf, int link);
+long ov_read(OggVorbis_File* vf, void* buffer, int length, int* bitstream);
+int ov_time_seek(OggVorbis_File* vf, ogg_int64_t pos);
+ogg_int64_t ov_time_tell(OggVorbis_File* vf);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,73 @@
+// Host stand-in for libogc's wiiuse/wpad.h
+#pragma once
+
+#include <gctypes.h>
+
+#define WPAD_MAX_WIIMOTES	4
+
+#define WPAD_BUTTON_2						0x0001
+#define WPAD_BUTTON_1						0x0002
+#define WPAD_BUTTON_B						0x0004
+#define WPAD_BUTTON_A						0x0008
+#define WPAD_BUTTON_MINUS					0x0010
+#define WPAD_BUTTON_HOME					0x0080
+#define WPAD_BUTTON_LEFT					0x0100
+#define WPAD_BUTTON_RIGHT					0x0200
+#define WPAD_BUTTON_DOWN					0x0400
+#define WPAD_BUTTON_UP						0x0800
+#define WPAD_BUTTON_PLUS					0x1000
+
+#define WPAD_CLASSIC_BUTTON_UP				(0x0001 << 16)
+#define WPAD_CLASSIC_BUTTON_LEFT			(0x0002 << 16)
+#define WPAD_CLASSIC_BUTTON_B				(0x0040 << 16)
+#define WPAD_CLASSIC_BUTTON_DOWN			(0x4000 << 16)
+#define WPAD_CLASSIC_BUTTON_RIGHT			(0x8000 << 16)
+
+#define WPAD_GUITAR_HERO_3_BUTTON_STRUM_UP	(0x0001 << 16)
+#define WPAD_GUITAR_HERO_3_BUTTON_YELLOW	(0x0008 << 16)
+#define WPAD_GUITAR_HERO_3_BUTTON_RED		(0x0040 << 16)
+#define WPAD_GUITAR_HERO_3_BUTTON_STRUM_DOWN	(0x4000 << 16)
+
+#define WPAD_EXP_NONE		0
+#define WPAD_EXP_NUNCHUK	1
+#define WPAD_EXP_CLASSIC	2
+#define WPAD_EXP_GUITARHERO3	3
+
+#define EXP_NONE			0
+#define EXP_NUNCHUK			1
+#define EXP_CLASSIC			2
+#define EXP_GUITAR_HERO_3	3
+
+typedef struct joystick_t {
+	f32 ang;
+	f32 mag;
+} joystick_t;
+
+typedef struct _wpad_data {
+	s16 err;
+	u32 data_present;
+	u8 battery_level;
+	u32 btns_h;
+	u32 btns_l;
+	u32 btns_d;
+	u32 btns_u;
+	struct { int valid; f32 x, y; f32 angle; int smooth_valid; f32 sx, sy; } ir;
+	struct {
+		u32 type;
+		union {
+			struct { joystick_t js; } nunchuk;
+			struct { joystick_t ljs, rjs; } classic;
+			struct { joystick_t js; } gh3;
+		};
+	} exp;
+} WPADData;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+WPADData* WPAD_Data(int chan);
+
+#ifdef __cplusplus
+}
+#endif
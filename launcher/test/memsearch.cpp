@@ -0,0 +1,326 @@
+// Checks the single pass memory search against the patch at a time loop it
+// replaced, and times the two over a DOL.
+//
+//   memsearch [seed] [rounds]        random patch sets, compared byte for byte
+//   memsearch bench [dol] [patches]  both loops over a DOL loaded into MEM1
+//
+// The search code is riivolution.cpp's own, cut out by the Makefile into
+// memsearch.inc. MEM1 is a static buffer, so patch offsets are host addresses.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/param.h>
+
+#include <string>
+#include <vector>
+
+#include "riivolution_config.h"
+
+using namespace std;
+
+#define MEM1_SIZE 0x01800000
+
+static u8 Memory[MEM1_SIZE] ATTRIBUTE_ALIGN(32);
+static u8* Mem1End;
+
+#define MEM_PHYSICAL_OR_K0(addr) (addr)
+#define MEM1_END ((void*)Mem1End)
+
+#include "memsearch.inc"
+
+u8* RiiMemoryPatch::GetValue(std::string path)
+{
+	return Value;
+}
+
+// What RVL_PatchMemory did before the single pass, one FindInBuffer per patch
+static void Reference_Patch(RiiMemoryPatch* memory, vector<MemoryWrite>* writes, int* overlapped)
+{
+	if (memory->Ocarina || (memory->Search && !memory->Original) || !memory->Offset || !memory->GetLength())
+		return;
+
+	if (memory->Search) {
+		void* ret = FindInBuffer((void*)memory->Offset, MEM1_END, memory->Original, memory->Length, memory->Align);
+		if (!ret)
+			return;
+		for (vector<MemoryWrite>::iterator write = writes->begin(); write != writes->end(); write++) {
+			if (write->Start < (u8*)ret + memory->Length && write->Start + write->Length > (u8*)memory->Offset) {
+				(*overlapped)++;
+				break;
+			}
+		}
+		memory->Offset = (int)ret;
+	}
+
+	if (memory->Original && memcmp((void*)memory->Offset, memory->Original, memory->GetLength()))
+		return;
+
+	memcpy((void*)memory->Offset, memory->Value, memory->GetLength());
+	MemorySearch_Wrote(writes, (void*)memory->Offset, memory->GetLength());
+}
+
+static void Reference_Patch(RiiMemoryPatch* memory, void* mem, u32 length)
+{
+	if ((!memory->Ocarina && !memory->Search) || (memory->Search && (!memory->Align || !memory->Original)) || (memory->Ocarina && !memory->Offset) || !memory->GetLength())
+		return;
+
+	if (memory->Ocarina) {
+		void* ocarina = FindInBuffer(mem, (u8*)mem + length, memory->Value, memory->GetLength(), 4);
+		if (ocarina) {
+			u32* blr;
+			for (blr = (u32*)ocarina; (u8*)blr < (u8*)mem + length && *blr != 0x4E800020; blr++)
+				;
+			if ((u8*)blr < (u8*)mem + length)
+				*blr = ((memory->Offset - (int)blr) & 0x03FFFFFC) | 0x48000000;
+		}
+	} else {
+		void* ret = FindInBuffer(mem, (u8*)mem + length, memory->Original, memory->Length, memory->Align);
+		if (ret)
+			memcpy(ret, memory->Value, memory->GetLength());
+	}
+}
+
+static vector<PendingMemoryPatch> Pending(vector<RiiMemoryPatch>* patches)
+{
+	vector<PendingMemoryPatch> pending;
+	for (vector<RiiMemoryPatch>::iterator patch = patches->begin(); patch != patches->end(); patch++) {
+		PendingMemoryPatch entry;
+		entry.Patch = &*patch;
+		entry.Value = NULL;
+		entry.Search = -1;
+		pending.push_back(entry);
+	}
+	return pending;
+}
+
+static const u32 Aligns[] = { 1, 2, 3, 4, 4, 4, 6, 8, 12 };
+
+static u8* Bytes(vector<vector<u8> >* store, const u8* data, u32 length)
+{
+	store->push_back(vector<u8>(data, data + length));
+	return &store->back()[0];
+}
+
+static int Round(int seed, int* patched, int* overlapped, bool* ocarina)
+{
+	srand(seed);
+	u32 length = 256 + rand() % 1792;
+	u32 symbols = 2 + rand() % 3;
+	bool words = rand() & 1;
+	for (u32 i = 0; i < length + 64; i++)
+		Memory[i] = (words && (i & 3) != 3) ? 0 : rand() % symbols;
+	for (int i = rand() % 8; i > 0; i--) {
+		u32 blr = 0x4E800020;
+		memcpy(Memory + (rand() % (length / 4)) * 4, &blr, sizeof(blr));
+	}
+	Mem1End = Memory + length;
+
+	// Buffer mode is the DOL patcher (search and ocarina), otherwise it's MEM1 after loading
+	bool buffer = rand() & 1;
+	u32 count = 1 + rand() % 24;
+	vector<vector<u8> > store;
+	store.reserve(count * 2);
+	vector<RiiMemoryPatch> patches;
+	for (u32 i = 0; i < count; i++) {
+		RiiMemoryPatch patch;
+		patch.Length = 1 + rand() % 12;
+		int kind = rand() % 4;
+		if (buffer && kind == 0) {
+			patch.Ocarina = true;
+			patch.Length = 4 * (1 + rand() % 3);
+			patch.Offset = (int)(Memory + rand() % length);
+		} else if (!buffer && kind == 0) {
+			patch.Offset = (int)(Memory + rand() % (length - patch.Length));
+		} else {
+			patch.Search = true;
+			patch.Align = Aligns[rand() % (sizeof(Aligns) / sizeof(Aligns[0]))];
+			patch.Offset = buffer ? 0 : (int)(Memory + rand() % 64);
+		}
+
+		// Mostly patterns that are there, and values that make or break other patches' matches
+		u8 pattern[12];
+		if (rand() % 3 || !patches.size()) {
+			u32 at = rand() % (length - patch.Length);
+			memcpy(pattern, Memory + (patch.Ocarina ? at & ~3 : at), patch.Length);
+		} else {
+			for (u32 j = 0; j < patch.Length; j++)
+				pattern[j] = rand() % symbols;
+		}
+		u8 value[12];
+		RiiMemoryPatch* other = patches.size() ? &patches[rand() % patches.size()] : NULL;
+		for (u32 j = 0; j < patch.Length; j++)
+			value[j] = (other && other->Original && j < other->Length && rand() % 2) ? other->Original[j] : rand() % symbols;
+
+		if (patch.Ocarina)
+			patch.Value = Bytes(&store, pattern, patch.Length);
+		else {
+			patch.Value = Bytes(&store, value, patch.Length);
+			if (patch.Search || rand() % 2)
+				patch.Original = Bytes(&store, pattern, patch.Length);
+		}
+		*ocarina |= patch.Ocarina;
+		patches.push_back(patch);
+	}
+
+	vector<u8> initial(Memory, Memory + length + 64);
+	vector<RiiMemoryPatch> reference = patches;
+	vector<MemoryWrite> writes;
+	for (vector<RiiMemoryPatch>::iterator patch = reference.begin(); patch != reference.end(); patch++) {
+		if (buffer)
+			Reference_Patch(&*patch, Memory, length);
+		else
+			Reference_Patch(&*patch, &writes, overlapped);
+	}
+	vector<u8> expected(Memory, Memory + length + 64);
+
+	memcpy(Memory, &initial[0], initial.size());
+	vector<PendingMemoryPatch> pending = Pending(&patches);
+	if (buffer)
+		RVL_PatchMemory(&pending, Memory, length);
+	else
+		RVL_PatchMemory(&pending);
+	*patched += count;
+
+	if (memcmp(Memory, &expected[0], expected.size())) {
+		u32 at = 0;
+		while (Memory[at] == expected[at])
+			at++;
+		printf("memsearch: seed %d (%s, %u patches): differs at 0x%x\n", seed, buffer ? "buffer" : "MEM1", count, at);
+		return 1;
+	}
+	return 0;
+}
+
+static u32 Get32(const u8* data)
+{
+	return ((u32)data[0] << 24) | ((u32)data[1] << 16) | ((u32)data[2] << 8) | data[3];
+}
+
+static double Now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Loads a DOL's sections where they'd be in MEM1, returns the end of the loaded image
+static u32 LoadDol(const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return 0;
+	fseek(file, 0, SEEK_END);
+	vector<u8> dol(ftell(file));
+	fseek(file, 0, SEEK_SET);
+	size_t read = fread(&dol[0], 1, dol.size(), file);
+	fclose(file);
+	if (read != dol.size() || dol.size() < 0x100)
+		return 0;
+
+	u32 top = 0;
+	for (int i = 0; i < 18; i++) {
+		u32 offset = Get32(&dol[i * 4]);
+		u32 address = Get32(&dol[0x48 + i * 4]) & 0x01FFFFFF;
+		u32 size = Get32(&dol[0x90 + i * 4]);
+		if (!size)
+			continue;
+		if (offset + size > dol.size() || address + size > MEM1_SIZE)
+			return 0;
+		memcpy(Memory + address, &dol[offset], size);
+		if (address + size > top)
+			top = address + size;
+	}
+	return top;
+}
+
+// Without a DOL, 4 MiB of made-up code: a few common opcodes with a blr every so often
+static u32 MakeImage()
+{
+	static const u32 Opcodes[] = { 0x7C0802A6, 0x9421FFF0, 0x38600000, 0x80010014, 0x7C0803A6, 0x38210010, 0x4BFFFFF1, 0x90010014, 0x3C608000, 0x60000000 };
+	srand(1);
+	for (u32 i = 0x3100; i < 0x403100; i += 4) {
+		u32 word = rand() % 40 ? Opcodes[rand() % 10] ^ (rand() & 0xFF) : 0x4E800020;
+		Memory[i] = word >> 24;
+		Memory[i + 1] = word >> 16;
+		Memory[i + 2] = word >> 8;
+		Memory[i + 3] = word;
+	}
+	return 0x403100;
+}
+
+static int Bench(const char* dol, int count)
+{
+	u32 top = dol ? LoadDol(dol) : MakeImage();
+	if (!top) {
+		printf("memsearch: can't load %s\n", dol);
+		return 1;
+	}
+	Mem1End = Memory + MEM1_SIZE - 1; // As MEM1_END on the Wii
+
+	// Patches search from the start of MEM1 for 16 byte runs of code, a quarter
+	// for code that isn't there, as a pack's patches for other regions would be
+	srand(2);
+	vector<vector<u8> > store;
+	store.reserve(count);
+	vector<RiiMemoryPatch> patches;
+	for (int i = 0; i < count; i++) {
+		RiiMemoryPatch patch;
+		patch.Search = true;
+		patch.Align = 4;
+		patch.Length = 16;
+		patch.Offset = (int)Memory;
+		u8 pattern[16];
+		if (i % 4 == 3) {
+			for (int j = 0; j < 16; j++)
+				pattern[j] = rand();
+		} else
+			memcpy(pattern, Memory + 0x3100 + (rand() % ((top - 0x3100 - 16) / 4)) * 4, 16);
+		patch.Original = Bytes(&store, pattern, 16);
+		patch.Value = patch.Original; // Leaves MEM1 as it was for the next run
+		patches.push_back(patch);
+	}
+
+	double best[2] = { 1e9, 1e9 };
+	for (int run = 0; run < 3; run++) {
+		vector<RiiMemoryPatch> reference = patches;
+		vector<MemoryWrite> writes;
+		int overlapped = 0;
+		double start = Now();
+		for (vector<RiiMemoryPatch>::iterator patch = reference.begin(); patch != reference.end(); patch++)
+			Reference_Patch(&*patch, &writes, &overlapped);
+		double middle = Now();
+		vector<RiiMemoryPatch> single = patches;
+		vector<PendingMemoryPatch> pending = Pending(&single);
+		RVL_PatchMemory(&pending);
+		double end = Now();
+		best[0] = MIN(best[0], middle - start);
+		best[1] = MIN(best[1], end - middle);
+	}
+
+	printf("memsearch: %d patches over %u KiB of %s\n", count, top / 1024, dol ? dol : "made-up code");
+	printf("  patch at a time  %8.2f ms\n", best[0] * 1000);
+	printf("  single pass      %8.2f ms (%.1fx)\n", best[1] * 1000, best[0] / best[1]);
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1 && !strcmp(argv[1], "bench"))
+		return Bench(argc > 2 ? argv[2] : NULL, argc > 3 ? atoi(argv[3]) : 64);
+
+	int seed = argc > 1 ? atoi(argv[1]) : 1;
+	int rounds = argc > 2 ? atoi(argv[2]) : 2000;
+	int failed = 0, patched = 0, overlapped = 0;
+	bool ocarina = false;
+	for (int i = 0; i < rounds; i++)
+		failed += Round(seed * rounds + i, &patched, &overlapped, &ocarina);
+
+	printf("memsearch: %d rounds, %d patches, %d searches after an overlapping write, %d failed\n", rounds, patched, overlapped, failed);
+	if (!overlapped || !ocarina) {
+		printf("memsearch: the rounds never exercised %s\n", overlapped ? "an ocarina patch" : "a write before a search");
+		return 1;
+	}
+	return failed ? 1 : 0;
+}
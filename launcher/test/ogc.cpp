@@ -0,0 +1,179 @@
+// The libogc calls the launcher tests share: LWP threads on pthreads, the
+// time base on the host's monotonic clock and no-op cache flushes.
+
+#include <gccore.h>
+
+#include <pthread.h>
+#include <time.h>
+
+#define MAX_HANDLES 64
+
+static pthread_mutex_t Mutexes[MAX_HANDLES];
+static pthread_cond_t Conds[MAX_HANDLES];
+static pthread_t Threads[MAX_HANDLES];
+static int MutexCount = 0;
+static int CondCount = 0;
+static int ThreadCount = 0;
+
+// Thread queues are a generation count, LWP_ThreadSignal wakes every sleeper
+struct ThreadQueue
+{
+	pthread_mutex_t Lock;
+	pthread_cond_t Wake;
+	u32 Generation;
+};
+static ThreadQueue Queues[MAX_HANDLES];
+static int QueueCount = 0;
+
+static pthread_mutex_t HandleLock = PTHREAD_MUTEX_INITIALIZER;
+
+static int NewHandle(int* count)
+{
+	pthread_mutex_lock(&HandleLock);
+	int handle = *count < MAX_HANDLES ? (*count)++ : -1;
+	pthread_mutex_unlock(&HandleLock);
+	return handle;
+}
+
+s32 LWP_CreateThread(lwp_t* thethread, void* (*entry)(void*), void* arg, void* stackbase, u32 stack_size, u8 prio)
+{
+	int handle = NewHandle(&ThreadCount);
+	if (handle < 0 || pthread_create(&Threads[handle], NULL, entry, arg))
+		return -1;
+	*thethread = handle;
+	return 0;
+}
+
+s32 LWP_JoinThread(lwp_t thethread, void** value_ptr)
+{
+	return pthread_join(Threads[thethread], value_ptr) ? -1 : 0;
+}
+
+void LWP_YieldThread(void)
+{
+	sched_yield();
+}
+
+s32 LWP_MutexInit(mutex_t* mutex, bool use_recursive)
+{
+	int handle = NewHandle(&MutexCount);
+	if (handle < 0)
+		return -1;
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	if (use_recursive)
+		pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&Mutexes[handle], &attr);
+	pthread_mutexattr_destroy(&attr);
+	*mutex = handle;
+	return 0;
+}
+
+s32 LWP_MutexDestroy(mutex_t mutex)
+{
+	return 0;
+}
+
+s32 LWP_MutexLock(mutex_t mutex)
+{
+	return pthread_mutex_lock(&Mutexes[mutex]);
+}
+
+s32 LWP_MutexUnlock(mutex_t mutex)
+{
+	return pthread_mutex_unlock(&Mutexes[mutex]);
+}
+
+s32 LWP_CondInit(cond_t* cond)
+{
+	int handle = NewHandle(&CondCount);
+	if (handle < 0)
+		return -1;
+	pthread_cond_init(&Conds[handle], NULL);
+	*cond = handle;
+	return 0;
+}
+
+s32 LWP_CondDestroy(cond_t cond)
+{
+	return 0;
+}
+
+s32 LWP_CondWait(cond_t cond, mutex_t mutex)
+{
+	return pthread_cond_wait(&Conds[cond], &Mutexes[mutex]);
+}
+
+s32 LWP_CondSignal(cond_t cond)
+{
+	return pthread_cond_signal(&Conds[cond]);
+}
+
+s32 LWP_CondBroadcast(cond_t cond)
+{
+	return pthread_cond_broadcast(&Conds[cond]);
+}
+
+s32 LWP_InitQueue(lwpq_t* thequeue)
+{
+	int handle = NewHandle(&QueueCount);
+	if (handle < 0)
+		return -1;
+	pthread_mutex_init(&Queues[handle].Lock, NULL);
+	pthread_cond_init(&Queues[handle].Wake, NULL);
+	Queues[handle].Generation = 0;
+	*thequeue = handle;
+	return 0;
+}
+
+void LWP_CloseQueue(lwpq_t thequeue)
+{
+}
+
+s32 LWP_ThreadSleep(lwpq_t thequeue)
+{
+	ThreadQueue* queue = &Queues[thequeue];
+	pthread_mutex_lock(&queue->Lock);
+	u32 generation = queue->Generation;
+	while (generation == queue->Generation)
+		pthread_cond_wait(&queue->Wake, &queue->Lock);
+	pthread_mutex_unlock(&queue->Lock);
+	return 0;
+}
+
+void LWP_ThreadSignal(lwpq_t thequeue)
+{
+	ThreadQueue* queue = &Queues[thequeue];
+	pthread_mutex_lock(&queue->Lock);
+	queue->Generation++;
+	pthread_cond_broadcast(&queue->Wake);
+	pthread_mutex_unlock(&queue->Lock);
+}
+
+void DCFlushRange(void* start, u32 length)
+{
+}
+
+void DCInvalidateRange(void* start, u32 length)
+{
+}
+
+// The Wii's time base ticks at 60.75 MHz
+#define TB_TIMER_CLOCK 60750
+
+u64 gettime(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * TB_TIMER_CLOCK * 1000 + (u64)ts.tv_nsec * TB_TIMER_CLOCK / 1000000;
+}
+
+u32 diff_usec(u64 start, u64 end)
+{
+	return (end - start) * 1000 / TB_TIMER_CLOCK;
+}
+
+u32 diff_msec(u64 start, u64 end)
+{
+	return (end - start) / TB_TIMER_CLOCK;
+}
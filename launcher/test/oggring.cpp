@@ -0,0 +1,566 @@
+// Plays oggplayer.c's PCM ring through a simulated ASND voice on a simulated
+// clock, and checks that every frame is heard once and in order through
+// loops, seeks, pauses and decoder stalls.
+//
+//   oggring
+//
+// tremor is replaced by a decoder that makes up a track whose samples count
+// its frames, so whatever the voice plays says where in the track it is. On
+// each tick of the clock the voice plays a tick's worth of frames and, as
+// ASND does, calls back for another buffer while none is queued behind the
+// playing one. Between ticks the decode thread runs until it waits for work,
+// so a run comes out the same every time. A stall holds the decoder in
+// ov_read for a number of ticks, as a busy main thread would on the Wii.
+//
+// oggplayer.c is included whole so the checks can see the ring.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "oggplayer.c"
+
+#define TICKS_PER_SECOND 200
+
+// What PlayOgg is given in place of an Ogg file
+struct Track
+{
+	u32 Channels;
+	u32 Rate;
+	u32 Frames;
+};
+
+// The decode thread, as far as the clock has to know about it
+static pthread_mutex_t Lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t Changed = PTHREAD_COND_INITIALIZER;
+static u32 SemCount = 0;
+static u32 SemMax = 0;
+static bool SemWaiting = false;
+static u32 StallTicks = 0;
+static bool Stalled = false;
+static bool Finished = false;
+static u32 Waits = 0;
+static double DecoderTime = 0;
+static u32 DecoderSeed = 1;
+
+// ASND voice 0
+static struct
+{
+	bool Working;
+	short* Buffer;
+	u32 Length; // in samples
+	u32 Position;
+	short* Next;
+	u32 NextLength;
+	ASNDVoiceCallback Callback;
+	u32 Channels;
+	u32 Rate;
+	u32 Due; // ticks times frames owed, so a tick plays Rate / TICKS_PER_SECOND on average
+} Voice;
+
+// What has been heard of the current track
+static struct
+{
+	Track Playing;
+	int Mode;
+	u64 Expected; // frame the next one heard has to be
+	bool Started;
+	bool Paused;
+	bool Ended; // the last frame of a track played once was heard
+	u32 Loops;
+	s64 SeekFrames[4]; // frames the pending seeks jump to, the last one has to be heard
+	u32 Pending;
+	u32 Stale; // frames heard since the last seek
+	u32 StaleLimit; // frames ASND still had when the last seek was made
+	u32 Seeks;
+	u32 Underruns;
+	u32 DryTicks;
+	bool Dry;
+	u64 Frames;
+	u32 Errors;
+} Heard;
+
+static u32 Random(u32* seed)
+{
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 17;
+	*seed ^= *seed << 5;
+	return *seed;
+}
+
+static void Fail(const char* message, long long a, long long b)
+{
+	if (Heard.Errors++ < 10)
+		printf("oggring: %s, %lld and %lld\n", message, a, b);
+}
+
+s32 LWP_SemInit(sem_t* sem, u32 start, u32 max)
+{
+	pthread_mutex_lock(&Lock);
+	SemCount = start;
+	SemMax = max;
+	pthread_mutex_unlock(&Lock);
+	*sem = 1;
+	return 0;
+}
+
+s32 LWP_SemDestroy(sem_t sem)
+{
+	return 0;
+}
+
+s32 LWP_SemWait(sem_t sem)
+{
+	pthread_mutex_lock(&Lock);
+	Waits++;
+	SemWaiting = true;
+	pthread_cond_broadcast(&Changed);
+	while (!SemCount)
+		pthread_cond_wait(&Changed, &Lock);
+	SemCount--;
+	SemWaiting = false;
+	pthread_mutex_unlock(&Lock);
+	return 0;
+}
+
+s32 LWP_SemPost(sem_t sem)
+{
+	pthread_mutex_lock(&Lock);
+	if (SemCount < SemMax)
+		SemCount++;
+	pthread_cond_broadcast(&Changed);
+	pthread_mutex_unlock(&Lock);
+	return 0;
+}
+
+// Until the decoder has nothing to do before the next tick. One that never
+// waits would spin on the Wii too
+static void WaitIdle()
+{
+	struct timespec deadline;
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += 10;
+	pthread_mutex_lock(&Lock);
+	while (!(SemWaiting && !SemCount) && !Stalled && !Finished) {
+		if (pthread_cond_timedwait(&Changed, &Lock, &deadline)) {
+			printf("oggring: the decoder has not waited for work in 10 s\n");
+			exit(1);
+		}
+	}
+	pthread_mutex_unlock(&Lock);
+}
+
+int ov_open_callbacks(void* datasource, OggVorbis_File* vf, char* initial, long ibytes, ov_callbacks callbacks)
+{
+	Track track;
+	if (callbacks.read_func(&track, sizeof(track), 1, datasource) != 1)
+		return OV_EREAD;
+	memset(vf, 0, sizeof(*vf));
+	vf->datasource = datasource;
+	vf->callbacks = callbacks;
+	vf->vi.channels = track.Channels;
+	vf->vi.rate = track.Rate;
+	vf->pcm_total = track.Frames;
+	Finished = false;
+	return 0;
+}
+
+int ov_clear(OggVorbis_File* vf)
+{
+	if (vf->callbacks.close_func)
+		vf->callbacks.close_func(vf->datasource);
+	memset(vf, 0, sizeof(*vf));
+	pthread_mutex_lock(&Lock);
+	Finished = true;
+	pthread_cond_broadcast(&Changed);
+	pthread_mutex_unlock(&Lock);
+	return 0;
+}
+
+vorbis_info* ov_info(OggVorbis_File* vf, int link)
+{
+	return &vf->vi;
+}
+
+static bool Owned(const short* block, u32 length, const short* samples)
+{
+	return Voice.Working && block && samples >= block && samples < block + length;
+}
+
+// Up to a packet's worth of frames, each sample its frame number: the low 15
+// bits in the first channel, the rest in the second
+long ov_read(OggVorbis_File* vf, void* buffer, int length, int* bitstream)
+{
+	pthread_mutex_lock(&Lock);
+	if (StallTicks) {
+		Stalled = true;
+		pthread_cond_broadcast(&Changed);
+		while (StallTicks)
+			pthread_cond_wait(&Changed, &Lock);
+	}
+	pthread_mutex_unlock(&Lock);
+
+	struct timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	DecoderTime = now.tv_sec + now.tv_nsec / 1e9;
+
+	if (vf->pcm_offset >= vf->pcm_total)
+		return 0;
+	if (Random(&DecoderSeed) % 64 == 0)
+		return OV_HOLE;
+
+	u32 channels = vf->vi.channels;
+	u32 frames = length / (2 * channels);
+	u32 packet = 64 + Random(&DecoderSeed) % 1024;
+	if (frames > packet)
+		frames = packet;
+	if (frames > vf->pcm_total - vf->pcm_offset)
+		frames = vf->pcm_total - vf->pcm_offset;
+
+	short* samples = (short*)buffer;
+	if (Owned(Voice.Buffer, Voice.Length, samples) || Owned(Voice.Next, Voice.NextLength, samples))
+		Fail("frames decoded into a block ASND has, at", vf->pcm_offset, 0);
+	for (u32 i = 0; i < frames; i++) {
+		u64 frame = vf->pcm_offset + i;
+		samples[i * channels] = frame & 0x7FFF;
+		if (channels > 1)
+			samples[i * channels + 1] = frame >> 15;
+	}
+	vf->pcm_offset += frames;
+	return frames * 2 * channels;
+}
+
+// As tremor, a cleared file is refused: GetTimeOgg may ask between the
+// decoder clearing it at the end and closing the file
+int ov_time_seek(OggVorbis_File* vf, ogg_int64_t pos)
+{
+	if (!vf->vi.rate)
+		return OV_EINVAL;
+	vf->pcm_offset = pos * vf->vi.rate / 1000;
+	return 0;
+}
+
+ogg_int64_t ov_time_tell(OggVorbis_File* vf)
+{
+	if (!vf->vi.rate)
+		return OV_EINVAL;
+	return vf->pcm_offset * 1000 / vf->vi.rate;
+}
+
+void ASND_Pause(s32 paused)
+{
+}
+
+s32 ASND_SetVoice(s32 voice, s32 format, s32 pitch, s32 delay, void* snd, s32 size_snd, s32 volume_l, s32 volume_r, ASNDVoiceCallback callback)
+{
+	Voice.Working = true;
+	Voice.Buffer = (short*)snd;
+	Voice.Length = size_snd / 2;
+	Voice.Position = 0;
+	Voice.Next = NULL;
+	Voice.Callback = callback;
+	Voice.Channels = format == VOICE_STEREO_16BIT ? 2 : 1;
+	Voice.Rate = pitch;
+	return SND_OK;
+}
+
+s32 ASND_AddVoice(s32 voice, void* snd, s32 size_snd)
+{
+	if (!Voice.Working)
+		return SND_INVALID;
+	if (Voice.Next)
+		return SND_BUSY;
+	Voice.Next = (short*)snd;
+	Voice.NextLength = size_snd / 2;
+	return SND_OK;
+}
+
+s32 ASND_StopVoice(s32 voice)
+{
+	Voice.Working = false;
+	Voice.Buffer = Voice.Next = NULL;
+	return SND_OK;
+}
+
+s32 ASND_StatusVoice(s32 voice)
+{
+	return Voice.Working ? SND_WORKING : SND_UNUSED;
+}
+
+s32 ASND_ChangeVolumeVoice(s32 voice, s32 volume_l, s32 volume_r)
+{
+	return SND_OK;
+}
+
+static double BlockTime()
+{
+	return (double)RING_SAMPLES / Heard.Playing.Channels * 1000 / Heard.Playing.Rate;
+}
+
+static s64 HeardTime()
+{
+	return (s64)Heard.Expected * 1000 / Heard.Playing.Rate;
+}
+
+static void Hear(const short* samples)
+{
+	u32 channels = Heard.Playing.Channels;
+	u64 frame = (u16)samples[0];
+	u64 expected = Heard.Expected;
+	if (channels > 1)
+		frame |= (u64)(u16)samples[1] << 15;
+	else
+		expected &= 0x7FFF;
+
+	// A seek made while an earlier one was still playing out may leave a block
+	// of the earlier one in ASND
+	u32 seek = 0;
+	while (seek < Heard.Pending && frame != (Heard.SeekFrames[seek] & (channels > 1 ? ~0ULL : 0x7FFF)))
+		seek++;
+
+	if (seek < Heard.Pending) {
+		// Only what ASND had when the seek was made may be heard before it
+		if (seek == Heard.Pending - 1 && Heard.Stale > Heard.StaleLimit)
+			Fail("frames decoded before a seek heard after it", Heard.Stale, Heard.StaleLimit);
+		Heard.Expected = Heard.SeekFrames[seek];
+		memmove(Heard.SeekFrames, Heard.SeekFrames + seek + 1, (Heard.Pending - seek - 1) * sizeof(*Heard.SeekFrames));
+		Heard.Pending -= seek + 1;
+	} else if (Heard.Ended) {
+		Fail("a frame heard after the end", frame, Heard.Playing.Frames);
+	} else if (Heard.Started && frame != expected) {
+		if (Heard.Errors < 10)
+			printf("oggring: %sheard frame %llu at %.3f s instead of %llu\n", Heard.Pending ? "seeking, " : "",
+				(unsigned long long)frame, (double)Heard.Frames / Heard.Playing.Rate, (unsigned long long)expected);
+		Heard.Errors++;
+	} else if (!Heard.Started) {
+		Heard.Expected = frame;
+	}
+	if (Heard.Pending)
+		Heard.Stale++;
+
+	Heard.Started = true;
+	Heard.Frames++;
+	Heard.Expected++;
+	if (Heard.Expected == Heard.Playing.Frames) {
+		if (Heard.Mode == OGG_INFINITE_TIME) {
+			Heard.Expected = 0;
+			Heard.Loops++;
+		} else
+			Heard.Ended = true;
+	}
+}
+
+// One tick of the voice, then a check of what the player reports
+static void Tick()
+{
+	WaitIdle();
+
+	Voice.Due += Voice.Rate;
+	u32 due = Voice.Due / TICKS_PER_SECOND;
+	Voice.Due -= due * TICKS_PER_SECOND;
+	u32 played = 0;
+	while (Voice.Working && played < due) {
+		if (Voice.Position >= Voice.Length) {
+			if (!Voice.Next) {
+				Voice.Working = false;
+				break;
+			}
+			Voice.Buffer = Voice.Next;
+			Voice.Length = Voice.NextLength;
+			Voice.Position = 0;
+			Voice.Next = NULL;
+		}
+		Hear(Voice.Buffer + Voice.Position);
+		Voice.Position += Voice.Channels;
+		played++;
+	}
+
+	// Silence is an underrun unless the track is paused or over
+	bool dry = played < due && Heard.Started && !Heard.Paused && !Heard.Ended;
+	if (dry && !Heard.Dry)
+		Heard.Underruns++;
+	Heard.DryTicks += dry;
+	Heard.Dry = dry;
+
+	if (Voice.Working && !Voice.Next && Voice.Callback)
+		Voice.Callback(0);
+
+	pthread_mutex_lock(&Lock);
+	if (StallTicks && !--StallTicks) {
+		Stalled = false;
+		pthread_cond_broadcast(&Changed);
+	}
+	pthread_mutex_unlock(&Lock);
+
+	WaitIdle();
+	if (!Voice.Working || Heard.Paused || StallTicks)
+		return;
+
+	// A seek is reported as soon as it is made, and the time otherwise
+	// follows what is heard: it is the start of the block queued behind the
+	// playing one, at most a block ahead. Near the end of the track the
+	// decoder has already looped
+	s32 time = GetTimeOgg();
+	double block = BlockTime();
+	if (Heard.Pending) {
+		s64 target = Heard.SeekFrames[Heard.Pending - 1] * 1000 / Heard.Playing.Rate;
+		if (time < target - 1 || time > target + block + 1)
+			Fail("GetTimeOgg during a seek and the time sought", time, target);
+	} else if ((HeardTime() + OGG_LEAD_TIME + 3 * block) * Heard.Playing.Rate / 1000 < Heard.Playing.Frames) {
+		if (time < HeardTime() - 1 || time > HeardTime() + block + 1)
+			Fail("GetTimeOgg and the time heard", time, HeardTime());
+	}
+}
+
+// Once the decoder is idle it has OGG_LEAD_TIME decoded ahead and not a block
+// more. After a seek the blocks decoded before it keep their place in the
+// ring until ASND has moved on from the last of them that it was given
+static void CheckLead()
+{
+	WaitIdle();
+	if (private_ogg.eof || Stalled || StallTicks || private_ogg.ring_epoch[private_ogg.ring_free % RING_BLOCKS] != private_ogg.epoch)
+		return;
+	u32 queued = private_ogg.ring_write - private_ogg.ring_read;
+	double lead = queued * BlockTime();
+	if (queued < RING_BLOCKS - RING_IN_FLIGHT - 1 && (lead < OGG_LEAD_TIME || lead >= OGG_LEAD_TIME + BlockTime()))
+		Fail("milliseconds decoded ahead with the lead", lead, OGG_LEAD_TIME);
+}
+
+static void Run(u32 ticks)
+{
+	for (u32 i = 0; i < ticks; i++) {
+		Tick();
+		if (i % 7 == 0)
+			CheckLead();
+	}
+}
+
+static void Play(const Track& track, int mode, int start)
+{
+	static Track file ATTRIBUTE_ALIGN(32);
+	file = track;
+	memset(&Heard, 0, sizeof(Heard));
+	Heard.Playing = track;
+	Heard.Mode = mode;
+	Heard.Expected = (u64)start * track.Rate / 1000;
+	Heard.Started = start > 0;
+	Voice.Due = 0;
+	Waits = 0;
+	DecoderTime = 0;
+	DecoderSeed = track.Rate + track.Frames;
+	if (PlayOgg((char*)&file, sizeof(file), start, mode)) {
+		Fail("PlayOgg failed", track.Rate, track.Channels);
+		return;
+	}
+	WaitIdle();
+}
+
+static void Seek(s32 time)
+{
+	SetTimeOgg(time);
+	if (Heard.Pending == sizeof(Heard.SeekFrames) / sizeof(*Heard.SeekFrames))
+		Fail("more seeks pending than the test keeps", Heard.Pending, time);
+	else
+		Heard.SeekFrames[Heard.Pending++] = (s64)time * Heard.Playing.Rate / 1000;
+	Heard.Stale = 0;
+	Heard.StaleLimit = 0;
+	if (Voice.Working)
+		Heard.StaleLimit = (Voice.Length - Voice.Position + (Voice.Next ? Voice.NextLength : 0)) / Voice.Channels;
+	Heard.Seeks++;
+	WaitIdle();
+}
+
+// Paused for ticks, with a seek to time before it resumes unless that is negative
+static void Pause(u32 ticks, s32 time)
+{
+	PauseOgg(1);
+	Heard.Paused = true;
+	Run(ticks);
+	if (Voice.Working)
+		Fail("the voice still playing after a pause of ticks", ticks, 0);
+	if (time >= 0)
+		Seek(time);
+	PauseOgg(0);
+	Heard.Paused = false;
+	WaitIdle();
+}
+
+static void Stall(u32 ticks)
+{
+	pthread_mutex_lock(&Lock);
+	StallTicks = ticks;
+	pthread_mutex_unlock(&Lock);
+}
+
+static bool Stop(const char* name, u32 underruns)
+{
+	if (Heard.Pending)
+		Fail("a seek never heard, to frame", Heard.SeekFrames[Heard.Pending - 1], Heard.Pending);
+	if (Heard.Underruns != underruns)
+		Fail("underruns where there should have been", Heard.Underruns, underruns);
+	StopOgg();
+	if (Voice.Working)
+		Fail("the voice still playing after StopOgg", 0, 0);
+	printf("oggring: %-14s %6.2f s heard, %u loops, %u seeks, %u underruns (%3u silent ticks), %4u decoder waits, %3.0f ms decoder CPU%s\n",
+		name, (double)Heard.Frames / Heard.Playing.Rate, Heard.Loops, Heard.Seeks, Heard.Underruns, Heard.DryTicks, Waits,
+		DecoderTime * 1000, Heard.Errors ? ", FAILED" : "");
+	return !Heard.Errors;
+}
+
+int main(int argc, char** argv)
+{
+	bool ok = true;
+	const Track stereo = { 2, 48000, 48000 * 3 };
+	const Track mono = { 1, 22050, 22050 * 4 };
+
+	// Looping with seeks, the second while a seek is still playing out
+	Play(stereo, OGG_INFINITE_TIME, 0);
+	Run(TICKS_PER_SECOND * 4);
+	Seek(2200);
+	Run(TICKS_PER_SECOND);
+	Seek(2900);
+	Run(3);
+	Seek(500);
+	Run(TICKS_PER_SECOND * 3);
+	ok &= Stop("loop and seek", 0);
+
+	// Stalls shorter than the lead are not heard, a longer one is and playback recovers
+	Play(stereo, OGG_INFINITE_TIME, 700);
+	Run(TICKS_PER_SECOND);
+	Stall(TICKS_PER_SECOND * 45 / 100);
+	Run(TICKS_PER_SECOND * 2);
+	Stall(TICKS_PER_SECOND / 4);
+	Run(TICKS_PER_SECOND / 2);
+	Stall(TICKS_PER_SECOND * 45 / 100);
+	Run(TICKS_PER_SECOND * 2);
+	ok &= Stop("short stalls", 0);
+
+	Play(stereo, OGG_INFINITE_TIME, 0);
+	Run(TICKS_PER_SECOND);
+	Stall(TICKS_PER_SECOND);
+	Run(TICKS_PER_SECOND * 3);
+	ok &= Stop("long stall", 1);
+
+	// Paused, then resumed where it left off, and paused again and resumed
+	// somewhere else
+	Play(mono, OGG_INFINITE_TIME, 0);
+	Run(TICKS_PER_SECOND);
+	Pause(TICKS_PER_SECOND / 2, -1);
+	Run(TICKS_PER_SECOND);
+	Pause(TICKS_PER_SECOND / 2, 3300);
+	Run(TICKS_PER_SECOND);
+	Stall(TICKS_PER_SECOND * 45 / 100);
+	Run(TICKS_PER_SECOND * 5);
+	ok &= Stop("mono and pause", 0);
+
+	// Played once, to the last frame
+	Play(mono, OGG_ONE_TIME, 2500);
+	Run(TICKS_PER_SECOND * 2);
+	if (!Heard.Ended || StatusOgg() != OGG_STATUS_EOF)
+		Fail("not at the end, status", Heard.Ended, StatusOgg());
+	ok &= Stop("once", 0);
+
+	return ok ? 0 : 1;
+}
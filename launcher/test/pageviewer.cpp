@@ -0,0 +1,730 @@
+// Checks that PageViewer, which keeps one set of option rows and rebinds them
+// to each page, shows what the viewer that built a page's rows on every flip
+// showed, and times the two over 5,000 options.
+//
+//   pageviewer [steps]
+//
+// The viewer is menu_main.cpp's own, cut out by the Makefile into
+// pageviewer.inc, and runs on the real GuiWindow, GuiButton, GuiImage and
+// GuiText. Reference::PageViewer is the viewer as it was before. Both are put
+// through the same page flips and choice changes, and after each one the
+// subtitle and every visible element of the window have to match, as do the
+// choices left in the options at the end.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <new>
+#include <string>
+#include <vector>
+
+#define protected public
+#include "menu.h"
+#undef protected
+#include "riivolution_config.h"
+
+#include "arrow_left_png.h"
+#include "arrow_active_left_png.h"
+#include "arrow_right_png.h"
+#include "arrow_active_right_png.h"
+
+using std::string;
+using std::vector;
+
+#define OPTIONS_PER_PAGE 12
+#define OPTION_FONT_SIZE 45
+#define OPTION_FONT_HEIGHT 28
+#define OPTION_ARROW_OFFSET 0
+
+// menu.cpp's and video.cpp's, which need the real GX and input
+GuiWindow* Window;
+GuiText* Subtitle;
+GuiTrigger Trigger[Triggers::Down + 1];
+u32 FrameTimer = 0;
+int screenwidth = 640;
+int screenheight = 480;
+FreeTypeGX* fontSystem[MAX_FONT_SIZE + 1];
+int ImageCacheIdleSize = 4 * 1024 * 1024;
+
+RiiDisc Disc;
+
+static u32 Allocations = 0;
+
+void HaltGui() {}
+void ResumeGui() {}
+void ChangeFontSize(FT_UInt pixelSize) {}
+void Menu_DrawImg(f32 xpos, f32 ypos, u16 width, u16 height, u8 data[], f32 degrees, f32 scaleX, f32 scaleY, u8 alphaF) {}
+void Menu_DrawRectangle(f32 x, f32 y, f32 width, f32 height, GXColor color, u8 filled) {}
+
+// gui_sound.cpp's, which needs ASND
+void GuiSound::Play() {}
+
+wchar_t* charToWideChar(const char* strChar)
+{
+	wchar_t* strWChar = new wchar_t[strlen(strChar) + 1];
+	for (size_t i = 0; (strWChar[i] = (unsigned char)strChar[i]); i++)
+		;
+	return strWChar;
+}
+
+wchar_t* shortToWideChar(const short* strShort)
+{
+	size_t length = 0;
+	while (strShort[length])
+		length++;
+	wchar_t* strWChar = new wchar_t[length + 1];
+	for (size_t i = 0; i <= length; i++)
+		strWChar[i] = strShort[i];
+	return strWChar;
+}
+
+// Nothing is drawn, GuiText only needs FreeTypeGX to link
+FreeTypeGX::FreeTypeGX(FT_UInt pixelSize, uint8_t textureFormat, uint8_t vertexIndex) {}
+FreeTypeGX::~FreeTypeGX() {}
+uint16_t FreeTypeGX::getWidth(wchar_t* text) { return 0; }
+uint16_t FreeTypeGX::getWidth(wchar_t const* text) { return 0; }
+void FreeTypeGX::getOffset(wchar_t* text, ftgxDataOffset* offset) {}
+void FreeTypeGX::getOffset(wchar_t const* text, ftgxDataOffset* offset) {}
+uint16_t FreeTypeGX::drawText(int16_t x, int16_t y, wchar_t* text, GXColor color, uint16_t textStyle) { return 0; }
+uint16_t FreeTypeGX::drawText(int16_t x, int16_t y, wchar_t const* text, GXColor color, uint16_t textStyle) { return 0; }
+uint16_t FreeTypeGX::drawText(int16_t x, int16_t y, wchar_t* text, uint16_t textWidth, ftgxDataOffset* textOffset, GXColor color, uint16_t textStyle) { return 0; }
+
+// Every allocation, to count what a page flip makes
+void* operator new(size_t size)
+{
+	Allocations++;
+	void* p = malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t size) noexcept { free(p); }
+void operator delete[](void* p, size_t size) noexcept { free(p); }
+
+namespace Launcher {
+#include "pageviewer.inc"
+}
+
+// menu_main.cpp's pages and viewer before the rows were kept
+namespace Reference {
+struct Page {
+	string Name;
+	vector<RiiOption*> Options;
+};
+
+static vector<Page> Pages;
+
+#define PAGENUM(page, pagenum) { \
+	char num[0x10]; sprintf(num, "", pagenum); \
+	page.Name = section->Name + " [" + num + "]"; \
+}
+
+static void PreparePages()
+{
+	Pages.clear();
+	for (vector<RiiSection>::iterator section = Disc.Sections.begin(); section != Disc.Sections.end(); section++) {
+		Page page;
+		int pagenum = 1;
+		for (vector<RiiOption>::iterator option = section->Options.begin(); option != section->Options.end(); option++) {
+			if (page.Options.size() == OPTIONS_PER_PAGE) {
+				PAGENUM(page, pagenum++);
+				Pages.push_back(page);
+				page = Page();
+			}
+
+			page.Options.push_back(&*option);
+		}
+
+		if (pagenum > 1) {
+			PAGENUM(page, pagenum);
+		} else
+			page.Name = section->Name;
+		Pages.push_back(page);
+	}
+}
+
+struct PageViewer {
+	u32 PageNumber;
+	Page* Current;
+
+	GuiText** Title;
+	GuiText** ChoiceText;
+	GuiText** ChoiceOverText;
+	GuiButton** Choice;
+	GuiImage** LeftArrowImage;
+	GuiImage** LeftArrowOverImage;
+	GuiImage** RightArrowImage;
+	GuiImage** RightArrowOverImage;
+	GuiButton** LeftArrow;
+	GuiButton** RightArrow;
+
+	GuiText* PageText;
+	GuiText* PageNumberText;
+	GuiImage* LeftButtonImage;
+	GuiImage* LeftButtonOverImage;
+	GuiImage* RightButtonImage;
+	GuiImage* RightButtonOverImage;
+	GuiButton* LeftButton;
+	GuiButton* RightButton;
+
+	GuiImageData* LeftArrowImageData;
+	GuiImageData* LeftArrowOverImageData;
+	GuiImageData* RightArrowImageData;
+	GuiImageData* RightArrowOverImageData;
+
+	PageViewer()
+	{
+		Current = NULL;
+
+		Subtitle->SetText(RIIVOLUTION_TITLE);
+
+		LeftArrowImageData = new GuiImageData(arrow_left_png);
+		LeftArrowOverImageData = new GuiImageData(arrow_active_left_png);
+		RightArrowImageData = new GuiImageData(arrow_right_png);
+		RightArrowOverImageData = new GuiImageData(arrow_active_right_png);
+
+		if (Pages.size() > 1) {
+			PageText = new GuiText("", 18, (GXColor){255, 255, 255, 255});
+			PageText->SetAlignment(ALIGN_LEFT, ALIGN_TOP);
+			PageText->SetPosition(372, 67);
+			Window->Append(PageText);
+
+			PageNumberText = new GuiText(" ", 26, (GXColor){255, 255, 255, 255});
+			PageNumberText->SetAlignment(ALIGN_LEFT, ALIGN_TOP);
+			PageNumberText->SetPosition(400 + 67 / 2, 48);
+			Window->Append(PageNumberText);
+
+			LeftButtonImage = new GuiImage(LeftArrowImageData);
+			LeftButtonOverImage = new GuiImage(LeftArrowOverImageData);
+			RightButtonImage = new GuiImage(RightArrowImageData);
+			RightButtonOverImage = new GuiImage(RightArrowOverImageData);
+
+			LeftButton = new GuiButton(LeftArrowImageData->GetWidth(), LeftArrowImageData->GetHeight());
+			LeftButton->SetImage(LeftButtonImage);
+			LeftButton->SetImageOver(LeftButtonOverImage);
+			LeftButton->SetAlignment(ALIGN_LEFT, ALIGN_TOP);
+			LeftButton->SetPosition(419, 72);
+			LeftButton->SetTrigger(&Trigger[Triggers::Select]);
+			LeftButton->SetTrigger(&Trigger[Triggers::PageLeft]);
+			Window->Append(LeftButton);
+
+			RightButton = new GuiButton(RightArrowImageData->GetWidth(), RightArrowImageData->GetHeight());
+			RightButton->SetImage(RightButtonImage);
+			RightButton->SetImageOver(RightButtonOverImage);
+			RightButton->SetAlignment(ALIGN_LEFT, ALIGN_TOP);
+			RightButton->SetPosition(604, 72);
+			RightButton->SetTrigger(&Trigger[Triggers::Select]);
+			RightButton->SetTrigger(&Trigger[Triggers::PageRight]);
+			Window->Append(RightButton);
+		}
+
+		if (Pages.size())
+			SetPage(0);
+	}
+
+	~PageViewer()
+	{
+		if (Pages.size() > 1) {
+			Window->Remove(RightButton);
+			Window->Remove(LeftButton);
+			Window->Remove(PageText);
+			Window->Remove(PageNumberText);
+
+			delete RightButton;
+			delete LeftButton;
+			delete RightButtonOverImage;
+			delete RightButtonImage;
+			delete LeftButtonOverImage;
+			delete LeftButtonImage;
+			delete PageNumberText;
+			delete PageText;
+			delete LeftArrowImageData;
+			delete LeftArrowOverImageData;
+			delete RightArrowImageData;
+			delete RightArrowOverImageData;
+		}
+
+		CleanPage();
+	}
+
+	const char* GetChoiceText(RiiOption* option)
+	{
+		if (option->Default > option->Choices.size())
+			option->Default = 0; // NOTE: Should this really happen here? Probably not
+
+		if (option->Default == 0)
+			return "Disabled";
+
+		return option->Choices[option->Default - 1].Name.c_str();
+	}
+
+	void CleanPage()
+	{
+		if (!Current)
+			return;
+
+		HaltGui();
+
+		for (u32 i = 0; i < Current->Options.size(); i++) {
+			Window->Remove(Title[i]);
+			Window->Remove(Choice[i]);
+			Window->Remove(LeftArrow[i]);
+			Window->Remove(RightArrow[i]);
+
+			delete Title[i];
+			delete Choice[i];
+			delete ChoiceText[i];
+			delete ChoiceOverText[i];
+			delete LeftArrowImage[i];
+			delete LeftArrowOverImage[i];
+			delete RightArrowImage[i];
+			delete RightArrowOverImage[i];
+			delete RightArrow[i];
+			delete LeftArrow[i];
+		}
+
+		delete[] Title;
+		delete[] ChoiceText;
+		delete[] ChoiceOverText;
+		delete[] Choice;
+		delete[] LeftArrowImage;
+		delete[] LeftArrowOverImage;
+		delete[] RightArrowImage;
+		delete[] RightArrowOverImage;
+		delete[] LeftArrow;
+		delete[] RightArrow;
+
+		Current = NULL;
+
+		ResumeGui();
+	}
+
+	void SetPage(u32 page)
+	{
+		CleanPage();
+
+		if (page >= Pages.size())
+			return;
+
+		HaltGui();
+
+		PageNumber = page;
+		Current = &Pages[PageNumber];
+
+		Subtitle->SetText(Current->Name.c_str());
+
+		if (Pages.size() > 1) {
+			char pagenum[0x10];
+			sprintf(pagenum, "", PageNumber + 1);
+			PageNumberText->SetText(pagenum);
+		}
+
+		int options = Current->Options.size();
+		Title = new GuiText*[options];
+		ChoiceText = new GuiText*[options];
+		ChoiceOverText = new GuiText*[options];
+		Choice = new GuiButton*[options];
+		LeftArrowImage = new GuiImage*[options];
+		LeftArrowOverImage = new GuiImage*[options];
+		RightArrowImage = new GuiImage*[options];
+		RightArrowOverImage = new GuiImage*[options];
+		LeftArrow = new GuiButton*[options];
+		RightArrow = new GuiButton*[options];
+
+
+		u32 i = 0;
+		for (vector<RiiOption*>::iterator iter = Current->Options.begin(); iter != Current->Options.end(); iter++, i++) {
+			int y = 72 + i * OPTION_FONT_HEIGHT;
+			RiiOption* option = *iter;
+
+			GuiText* title = new GuiText(option->Name.c_str(), OPTION_FONT_SIZE, (GXColor){255, 255, 255, 255}); Title[i] = title;
+			title->SetAlignment(ALIGN_LEFT, ALIGN_TOP);
+			title->SetPosition(39, y);
+			Window->Append(title);
+
+			GuiText* choiceText = new GuiText(GetChoiceText(option), OPTION_FONT_SIZE, (GXColor){255, 255, 255, 255}); ChoiceText[i] = choiceText;
+			choiceText->SetAlignment(ALIGN_LEFT, ALIGN_TOP);
+			choiceText->SetPosition(0, 0);
+			GuiText* choiceOverText = new GuiText(GetChoiceText(option), OPTION_FONT_SIZE, (GXColor){0, 140, 255, 255}); ChoiceOverText[i] = choiceOverText;
+			choiceOverText->SetAlignment(ALIGN_LEFT, ALIGN_TOP);
+			choiceOverText->SetPosition(0, 0);
+
+			GuiButton* choice = new GuiButton(152, OPTION_FONT_HEIGHT); Choice[i] = choice;
+			choice->SetLabel(choiceText);
+			choice->SetLabelOver(choiceOverText);
+			choice->SetTrigger(&Trigger[Triggers::Select]);
+			choice->SetAlignment(ALIGN_LEFT, ALIGN_TOP);
+			choice->SetPosition(450, y);
+			Window->Append(choice);
+
+			GuiImage* leftArrowImage = new GuiImage(LeftArrowImageData); LeftArrowImage[i] = leftArrowImage;
+			GuiImage* leftArrowOverImage = new GuiImage(LeftArrowOverImageData); LeftArrowOverImage[i] = leftArrowOverImage;
+			GuiImage* rightArrowImage = new GuiImage(RightArrowImageData); RightArrowImage[i] = rightArrowImage;
+			GuiImage* rightArrowOverImage = new GuiImage(RightArrowOverImageData); RightArrowOverImage[i] = rightArrowOverImage;
+
+			GuiButton* leftArrow = new GuiButton(LeftArrowImageData->GetWidth(), LeftArrowImageData->GetHeight()); LeftArrow[i] = leftArrow;
+			leftArrow->SetImage(leftArrowImage);
+			leftArrow->SetImageOver(leftArrowOverImage);
+			leftArrow->SetAlignment(ALIGN_LEFT, ALIGN_TOP);
+			leftArrow->SetPosition(419, y + OPTION_ARROW_OFFSET);
+			leftArrow->SetTrigger(&Trigger[Triggers::Select]);
+			Window->Append(leftArrow);
+
+			GuiButton* rightArrow = new GuiButton(RightArrowImageData->GetWidth(), RightArrowImageData->GetHeight()); RightArrow[i] = rightArrow;
+			rightArrow->SetImage(rightArrowImage);
+			rightArrow->SetImageOver(rightArrowOverImage);
+			rightArrow->SetAlignment(ALIGN_LEFT, ALIGN_TOP);
+			rightArrow->SetPosition(604, y + OPTION_ARROW_OFFSET);
+			rightArrow->SetTrigger(&Trigger[Triggers::Select]);
+			Window->Append(rightArrow);
+		}
+
+		ResumeGui();
+	}
+
+	void Update()
+	{
+		if (Pages.size() > 1) {
+			if (LeftButton->GetState() == STATE_CLICKED) {
+				UNSELECT_ALL();
+				LeftButton->SetState(STATE_SELECTED, LeftButton->GetStateChan());
+				SetPage(Wrap(PageNumber - 1, Pages.size()));
+			}
+			if (RightButton->GetState() == STATE_CLICKED) {
+				UNSELECT_ALL();
+				RightButton->SetState(STATE_SELECTED, RightButton->GetStateChan());
+				SetPage(Wrap(PageNumber + 1, Pages.size()));
+			}
+		}
+
+		if (!Current)
+			return;
+
+		for (u32 i = 0; i < Current->Options.size(); i++) {
+			if (RightArrow[i]->GetState() == STATE_CLICKED || Choice[i]->GetState() == STATE_CLICKED) {
+				UNSELECT_ALL();
+				if (RightArrow[i]->GetState() == STATE_CLICKED)
+					RightArrow[i]->SetState(STATE_SELECTED, RightArrow[i]->GetStateChan());
+				if (Choice[i]->GetState() == STATE_CLICKED)
+					Choice[i]->SetState(STATE_SELECTED, Choice[i]->GetStateChan());
+				SetOption(i, Current->Options[i], Wrap(Current->Options[i]->Default + 1, Current->Options[i]->Choices.size() + 1));
+			}
+			if (LeftArrow[i]->GetState() == STATE_CLICKED) {
+				UNSELECT_ALL();
+				LeftArrow[i]->SetState(STATE_SELECTED, LeftArrow[i]->GetStateChan());
+				SetOption(i, Current->Options[i], Wrap(Current->Options[i]->Default - 1, Current->Options[i]->Choices.size() + 1));
+			}
+		}
+	}
+
+	void SetOption(int index, RiiOption* option, u32 choice)
+	{
+		if (choice >= option->Choices.size() + 1)
+			return;
+
+		option->Default = choice;
+
+		ChoiceText[index]->SetText(GetChoiceText(option));
+		ChoiceOverText[index]->SetText(GetChoiceText(option));
+	}
+
+	int Wrap(int page, int pages)
+	{
+		if (page < 0)
+			page = pages - 1;
+		if (page >= pages)
+			page = 0;
+
+		return page;
+	}
+};
+}
+
+// What either namespace's viewer has open, for the script and the benchmark
+static u32 PageCount(Launcher::PageViewer* viewer) { return Launcher::Pages.size(); }
+static u32 PageCount(Reference::PageViewer* viewer) { return Reference::Pages.size(); }
+static u32 RowCount(Launcher::PageViewer* viewer) { return viewer->Current ? viewer->Current->Count : 0; }
+static u32 RowCount(Reference::PageViewer* viewer) { return viewer->Current ? viewer->Current->Options.size() : 0; }
+static void PreparePages(Launcher::PageViewer* viewer) { Launcher::PreparePages(); }
+static void PreparePages(Reference::PageViewer* viewer) { Reference::PreparePages(); }
+
+static u32 Seed;
+
+static u32 Random()
+{
+	Seed ^= Seed << 13;
+	Seed ^= Seed >> 17;
+	Seed ^= Seed << 5;
+	return Seed;
+}
+
+static string Text(GuiText* text)
+{
+	string value;
+	for (wchar_t* c = text ? text->origText : NULL; c && *c; c++)
+		value += (char)*c;
+	return value;
+}
+
+template <typename Viewer> static const char* ImageName(Viewer* viewer, GuiImage* image)
+{
+	if (!image)
+		return "none";
+	GuiImageData* data[] = { viewer->LeftArrowImageData, viewer->LeftArrowOverImageData, viewer->RightArrowImageData,
+		viewer->RightArrowOverImageData };
+	const char* names[] = { "left", "left over", "right", "right over" };
+	for (u32 i = 0; i < sizeof(data) / sizeof(*data); i++) {
+		if (image->image == data[i]->GetImage())
+			return names[i];
+	}
+	return "other";
+}
+
+// A visible element as it would be drawn and as it reacts to input
+template <typename Viewer> static string Describe(Viewer* viewer, GuiElement* element)
+{
+	char entry[256];
+	GuiText* text = dynamic_cast<GuiText*>(element);
+	GuiButton* button = dynamic_cast<GuiButton*>(element);
+	snprintf(entry, sizeof(entry), "%s at %d,%d %dx%d, state %d, triggers %d %d", text ? "text" : button ? "button" : "element",
+		element->GetLeft(), element->GetTop(), element->GetWidth(), element->GetHeight(), element->GetState(),
+		element->trigger[0] ? (int)(element->trigger[0] - Trigger) : -1, element->trigger[1] ? (int)(element->trigger[1] - Trigger) : -1);
+	string line = entry;
+	GuiText* texts[] = { text, button ? button->label[0] : NULL, button ? button->labelOver[0] : NULL };
+	for (u32 i = 0; i < sizeof(texts) / sizeof(*texts); i++) {
+		if (!texts[i])
+			continue;
+		snprintf(entry, sizeof(entry), ", %u px %02x%02x%02x%02x \"%s\"", texts[i]->size, texts[i]->color.r, texts[i]->color.g,
+			texts[i]->color.b, texts[i]->color.a, Text(texts[i]).c_str());
+		line += entry;
+	}
+	if (button)
+		line += string(", ") + ImageName(viewer, button->image) + " / " + ImageName(viewer, button->imageOver);
+	return line;
+}
+
+// The subtitle and the visible elements of the window, in no particular order
+// as the reference appended a page's rows again on every flip
+template <typename Viewer> static string Screen(Viewer* viewer)
+{
+	vector<string> lines;
+	for (u32 i = 0; i < Window->GetSize(); i++) {
+		GuiElement* element = Window->GetGuiElementAt(i);
+		if (element->IsVisible())
+			lines.push_back(Describe(viewer, element));
+	}
+	std::sort(lines.begin(), lines.end());
+
+	string screen = "subtitle \"" + Text(Subtitle) + "\"\n";
+	for (u32 i = 0; i < lines.size(); i++)
+		screen += "  " + lines[i] + "\n";
+	return screen;
+}
+
+static void Click(GuiButton* button)
+{
+	button->SetState(STATE_CLICKED);
+}
+
+// Opens the viewer on disc and clicks through it, logging the screen after each click
+template <typename Viewer> static vector<string> Run(const RiiDisc& disc, u32 steps, u32 seed)
+{
+	vector<string> log;
+	Disc = disc;
+	Seed = seed;
+
+	PreparePages((Viewer*)NULL);
+	Viewer* viewer = new Viewer;
+	log.push_back(Screen(viewer));
+
+	for (u32 step = 0; step < steps; step++) {
+		u32 action = Random() % 8;
+		u32 rows = RowCount(viewer);
+		u32 row = rows ? Random() % rows : 0;
+		if (action < 3 && PageCount(viewer) > 1)
+			Click(action ? viewer->RightButton : viewer->LeftButton);
+		else if (action == 3 && rows)
+			Click(viewer->LeftArrow[row]);
+		else if (action == 4 && rows)
+			Click(viewer->RightArrow[row]);
+		else if (action == 5 && rows)
+			Click(viewer->Choice[row]);
+		else if (action == 6 && rows) {
+			// Both arrows of a row in the same frame
+			Click(viewer->LeftArrow[row]);
+			Click(viewer->RightArrow[row]);
+		}
+		viewer->Update();
+		log.push_back(Screen(viewer));
+	}
+
+	delete viewer;
+	char entry[32];
+	snprintf(entry, sizeof(entry), "%u elements left", Window->GetSize());
+	log.push_back(entry);
+
+	string choices = "choices";
+	for (u32 i = 0; i < Disc.Sections.size(); i++) {
+		for (u32 j = 0; j < Disc.Sections[i].Options.size(); j++) {
+			snprintf(entry, sizeof(entry), " %u", Disc.Sections[i].Options[j].Default);
+			choices += entry;
+		}
+	}
+	log.push_back(choices);
+	return log;
+}
+
+// options split into sections of sizes either side of a page, every fifth one
+// short and some empty, each option with up to four choices and a default
+// that may be out of range
+static RiiDisc MakeDisc(u32 options, u32 sections)
+{
+	RiiDisc disc;
+	Seed = options * 31 + sections;
+	const u32 sizes[] = { 0, 1, OPTIONS_PER_PAGE - 1, OPTIONS_PER_PAGE, OPTIONS_PER_PAGE + 1, OPTIONS_PER_PAGE * 2, OPTIONS_PER_PAGE * 2 + 1 };
+	char name[64];
+	for (u32 i = 0; i < sections && options; i++) {
+		u32 size = i % 5 == 4 ? sizes[Random() % (sizeof(sizes) / sizeof(*sizes))] : options / (sections - i);
+		size = std::min(size, options);
+		if (i == sections - 1)
+			size = options;
+		options -= size;
+
+		RiiSection section;
+		snprintf(name, sizeof(name), "Section %u", i);
+		section.Name = name;
+		for (u32 j = 0; j < size; j++) {
+			RiiOption option;
+			snprintf(name, sizeof(name), "Option %u of section %u", j, i);
+			option.Name = name;
+			u32 choices = Random() % 5;
+			for (u32 k = 0; k < choices; k++) {
+				RiiChoice choice;
+				snprintf(name, sizeof(name), "Choice %u", k + 1);
+				choice.Name = name;
+				option.Choices.push_back(choice);
+			}
+			option.Default = Random() % (choices + 2);
+			section.Options.push_back(option);
+		}
+		disc.Sections.push_back(section);
+	}
+	return disc;
+}
+
+static bool Compare(const char* name, const RiiDisc& disc, u32 steps)
+{
+	vector<string> shown = Run<Launcher::PageViewer>(disc, steps, 7);
+	vector<string> expected = Run<Reference::PageViewer>(disc, steps, 7);
+
+	for (u32 i = 0; i < shown.size() && i < expected.size(); i++) {
+		if (shown[i] != expected[i]) {
+			printf("pageviewer: %s, step %u showed\n%sinstead of\n%s", name, i, shown[i].c_str(), expected[i].c_str());
+			return false;
+		}
+	}
+	if (shown.size() != expected.size()) {
+		printf("pageviewer: %s, %zu steps logged instead of %zu\n", name, shown.size(), expected.size());
+		return false;
+	}
+	u32 options = 0;
+	for (u32 i = 0; i < disc.Sections.size(); i++)
+		options += disc.Sections[i].Options.size();
+	printf("pageviewer: %-12s %4u options in %3zu pages, %u steps the same\n", name, options, Launcher::Pages.size(), steps);
+	return true;
+}
+
+// Flips through every page of the launcher's viewer, which has to keep the
+// rows and window it opened with
+static bool Recycled(const RiiDisc& disc)
+{
+	Disc = disc;
+	Launcher::PreparePages();
+	Launcher::PageViewer* viewer = new Launcher::PageViewer;
+	u32 elements = Window->GetSize();
+	GuiText* title = viewer->Title[OPTIONS_PER_PAGE - 1];
+	GuiButton* choice = viewer->Choice[0];
+
+	bool ok = true;
+	for (u32 i = 0; i < Launcher::Pages.size() && ok; i++) {
+		Click(viewer->RightButton);
+		viewer->Update();
+		if (Window->GetSize() != elements || viewer->Title[OPTIONS_PER_PAGE - 1] != title || viewer->Choice[0] != choice) {
+			printf("pageviewer: page %u has new rows, %u elements in the window after %u\n", viewer->PageNumber,
+				Window->GetSize(), elements);
+			ok = false;
+		}
+	}
+
+	delete viewer;
+	if (Window->GetSize()) {
+		printf("pageviewer: %u elements left in the window\n", Window->GetSize());
+		ok = false;
+	}
+	return ok;
+}
+
+// The time it takes to open the options and to flip a page either way, and the allocations a flip makes
+template <typename Viewer> static void Bench(const char* name, const RiiDisc& disc)
+{
+	const u32 opens = 200;
+	Disc = disc;
+	clock_t start = clock();
+	for (u32 i = 0; i < opens; i++) {
+		PreparePages((Viewer*)NULL);
+		delete new Viewer;
+	}
+	double open = (double)(clock() - start) * 1000 / CLOCKS_PER_SEC / opens;
+
+	PreparePages((Viewer*)NULL);
+	Viewer* viewer = new Viewer;
+	u32 flips = PageCount(viewer) * 20;
+	Allocations = 0;
+	start = clock();
+	for (u32 i = 0; i < flips; i++) {
+		Click(viewer->RightButton);
+		viewer->Update();
+	}
+	double flip = (double)(clock() - start) * 1000000 / CLOCKS_PER_SEC / flips;
+	printf("pageviewer: %-9s open %.3f ms, page flip %.2f us and %.1f allocations\n", name, open, flip,
+		(double)Allocations / flips);
+	delete viewer;
+}
+
+int main(int argc, char** argv)
+{
+	u32 steps = argc > 1 ? atoi(argv[1]) : 2000;
+
+	Window = new GuiWindow(screenwidth, screenheight);
+	Subtitle = new GuiText("", 18, (GXColor){255, 255, 255, 255});
+
+	RiiDisc large = MakeDisc(5000, 50);
+	bool ok = true;
+	ok &= Compare("large", large, steps);
+	ok &= Compare("one page", MakeDisc(OPTIONS_PER_PAGE - 3, 1), 200);
+	ok &= Compare("a full page", MakeDisc(OPTIONS_PER_PAGE, 1), 200);
+	ok &= Compare("no options", RiiDisc(), 20);
+	ok &= Recycled(large);
+
+	// Sections of 100 options, nine pages each
+	RiiDisc bench;
+	for (u32 i = 0; i < 50; i++)
+		bench.Sections.push_back(MakeDisc(100, 1).Sections[0]);
+	Bench<Reference::PageViewer>("reference", bench);
+	Bench<Launcher::PageViewer>("recycled", bench);
+
+	delete Subtitle;
+	delete Window;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,308 @@
+// Runs the manifest updater against a local server and a fake SD card, and
+// checks each update transfers exactly the files that changed.
+//
+//   updater [-v]
+//
+// The release is served from www/ in a scratch directory whose "sd:"
+// directory is the SD card, so the updater's paths work unchanged. Each step
+// changes the release or the card and lists the files that have to come
+// down; the bytes the server sent must add up to those and the manifest, and
+// only files the state can't vouch for may be read back to hash them.
+// -v shows the updater's own output.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <curl/curl.h>
+#include <openssl/evp.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <gccore.h>
+#include "sha1.h"
+#include "riivolution.h"
+#include "httpserver.h"
+
+using std::vector;
+using std::string;
+using std::map;
+
+#include "update.inc"
+
+#define SD_DIRECTORY "sd:/RetroRewind/"
+
+struct ReleaseFile
+{
+	string Name;
+	string Data;
+};
+
+static vector<ReleaseFile> Release;
+static int Port;
+static bool Verbose = false;
+static u32 Seed = 1;
+static volatile bool Updating = false;
+static volatile int Hashed = 0;
+
+// Counts the card's files the updater opens for reading, only hashFile does outside of delta updates
+extern "C" FILE* __real_fopen(const char* path, const char* mode);
+extern "C" FILE* __wrap_fopen(const char* path, const char* mode)
+{
+	if (Updating && !strncmp(path, SD_DIRECTORY, strlen(SD_DIRECTORY)) && !strcmp(mode, "rb"))
+		__sync_fetch_and_add(&Hashed, 1);
+	return __real_fopen(path, mode);
+}
+
+static u32 Random()
+{
+	Seed = Seed * 1103515245 + 12345;
+	return Seed >> 8;
+}
+
+static string RandomData(u32 size)
+{
+	string data(size, '\0');
+	for (u32 i = 0; i < size; i++)
+		data[i] = Random();
+	return data;
+}
+
+static void MakeDirectories(const string& path)
+{
+	for (size_t slash = path.find('/'); slash != string::npos; slash = path.find('/', slash + 1))
+		mkdir(path.substr(0, slash).c_str(), 0777);
+}
+
+static void WriteFile(const string& path, const string& data)
+{
+	MakeDirectories(path);
+	FILE* fp = fopen(path.c_str(), "wb");
+	if (!fp || fwrite(data.data(), 1, data.size(), fp) != data.size()) {
+		printf("updater: can't write %s\n", path.c_str());
+		exit(1);
+	}
+	fclose(fp);
+}
+
+static bool ReadFile(const string& path, string* data)
+{
+	FILE* fp = fopen(path.c_str(), "rb");
+	if (!fp)
+		return false;
+	char buffer[0x10000];
+	size_t got;
+	data->clear();
+	while ((got = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+		data->append(buffer, got);
+	fclose(fp);
+	return true;
+}
+
+static ReleaseFile* Find(const char* name)
+{
+	for (u32 i = 0; i < Release.size(); i++) {
+		if (Release[i].Name == name)
+			return &Release[i];
+	}
+	return NULL;
+}
+
+// Writes the release and its manifest to www/, returns the manifest's size
+static u32 Publish()
+{
+	string manifest;
+	for (u32 i = 0; i < Release.size(); i++) {
+		const ReleaseFile* file = &Release[i];
+		WriteFile("www/" + file->Name, file->Data);
+
+		u8 hash[EVP_MAX_MD_SIZE];
+		EVP_Digest(file->Data.data(), file->Data.size(), hash, NULL, EVP_sha1(), NULL);
+		char line[MAX_URL_LENGTH + MAX_PATH_LENGTH];
+		for (u32 j = 0; j < sizeof(sha1); j++)
+			sprintf(line + j * 2, "%02x", hash[j]);
+		snprintf(line + sizeof(sha1) * 2, sizeof(line) - sizeof(sha1) * 2, " %u http://127.0.0.1:%d/%s " SD_DIRECTORY "%s\n",
+			(u32)file->Data.size(), Port, file->Name.c_str(), file->Name.c_str());
+		manifest += line;
+	}
+	WriteFile("www/manifest.txt", manifest);
+	return manifest.size();
+}
+
+static bool Leftovers(const char* directory)
+{
+	bool found = false;
+	string cmd = string("find '") + directory + "' -name '*" PART_SUFFIX "' -o -name '*" ETAG_SUFFIX "'";
+	FILE* pipe = popen(cmd.c_str(), "r");
+	char line[MAX_PATH_LENGTH];
+	while (pipe && fgets(line, sizeof(line), pipe)) {
+		printf("updater: left behind %s", line);
+		found = true;
+	}
+	if (pipe)
+		pclose(pipe);
+	return found;
+}
+
+// Runs the updater on the current release, then checks the card matches it,
+// that the files named (a NULL terminated list) were the only ones sent and
+// that as many files were hashed as expected
+static bool Step(const char* step, const char* const* changed, int hashes)
+{
+	u32 manifest = Publish();
+	u64 expected = manifest;
+	int count = 0;
+	for (; changed[count]; count++)
+		expected += Find(changed[count])->Data.size();
+
+	HttpServer_Reset();
+	Hashed = 0;
+	fflush(stdout);
+	int saved = dup(1);
+	if (!Verbose) {
+		int null = open("/dev/null", O_WRONLY);
+		dup2(null, 1);
+		close(null);
+	}
+	char url[64];
+	snprintf(url, sizeof(url), "http://127.0.0.1:%d/manifest.txt", Port);
+	Updating = true;
+	bool ran = updateFromManifest(url);
+	Updating = false;
+	fflush(stdout);
+	dup2(saved, 1);
+	close(saved);
+	HttpServerStats stats = HttpServer_Stats();
+
+	bool ok = ran;
+	if (!ran)
+		printf("updater: %s: the manifest couldn't be read\n", step);
+	for (u32 i = 0; i < Release.size(); i++) {
+		string data;
+		if (!ReadFile(SD_DIRECTORY + Release[i].Name, &data) || data != Release[i].Data) {
+			printf("updater: %s: %s isn't the released file\n", step, Release[i].Name.c_str());
+			ok = false;
+		}
+	}
+	if (Leftovers("sd:"))
+		ok = false;
+
+	string state;
+	u32 lines = 0;
+	ReadFile(UPDATE_STATE_PATH, &state);
+	for (size_t i = 0; i < state.size(); i++)
+		lines += state[i] == '\n';
+	if (lines != Release.size()) {
+		printf("updater: %s: the state lists %u of %u files\n", step, lines, (u32)Release.size());
+		ok = false;
+	}
+
+	if (stats.Bytes != expected) {
+		printf("updater: %s: sent %llu bytes, the manifest and %d changed files are %llu\n", step,
+			(unsigned long long)stats.Bytes, count, (unsigned long long)expected);
+		ok = false;
+	}
+
+	if (Hashed != hashes) {
+		printf("updater: %s: hashed %d files, expected %d\n", step, Hashed, hashes);
+		ok = false;
+	}
+
+	printf("updater: %-10s %2d files, %7llu bytes sent in %u requests over %u connections, %2d hashed%s\n", step, count,
+		(unsigned long long)stats.Bytes, stats.Requests, stats.Connections, Hashed, ok ? "" : ", FAILED");
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	Verbose = argc > 1 && !strcmp(argv[1], "-v");
+
+	char scratch[] = "/tmp/updaterXXXXXX";
+	if (!mkdtemp(scratch) || chdir(scratch)) {
+		printf("updater: no scratch directory\n");
+		return 1;
+	}
+	string www = string(scratch) + "/www";
+	mkdir("www", 0777);
+	mkdir("sd:", 0777);
+	mkdir(SD_DIRECTORY, 0777);
+
+	curl_global_init(CURL_GLOBAL_ALL);
+	Port = HttpServer_Start(www.c_str());
+	if (!Port) {
+		printf("updater: can't start the server\n");
+		return 1;
+	}
+
+	// A release of small files in a few folders and two over DELTA_MIN_SIZE
+	const char* folders[] = { "Tracks", "Race/Course", "Scene/UI", "Sound" };
+	for (int i = 0; i < 24; i++) {
+		ReleaseFile file;
+		char name[64];
+		snprintf(name, sizeof(name), "%s/file%02d.szs", folders[i % 4], i);
+		file.Name = name;
+		file.Data = RandomData(1 + Random() % 0x10000);
+		Release.push_back(file);
+	}
+	for (int i = 0; i < 2; i++) {
+		ReleaseFile file;
+		char name[64];
+		snprintf(name, sizeof(name), "Tracks/large%d.szs", i);
+		file.Name = name;
+		file.Data = RandomData(DELTA_MIN_SIZE + Random() % 0x20000);
+		Release.push_back(file);
+	}
+
+	bool ok = true;
+
+	// Nothing on the card yet, everything comes down
+	vector<const char*> everything;
+	for (u32 i = 0; i < Release.size(); i++)
+		everything.push_back(Release[i].Name.c_str());
+	everything.push_back(NULL);
+	ok &= Step("fresh", &everything[0], 0);
+
+	// The state remembers every hash
+	const char* nothing[] = { NULL };
+	ok &= Step("unchanged", nothing, 0);
+
+	// Without it, the files are hashed but none is fetched
+	unlink(UPDATE_STATE_PATH);
+	ok &= Step("rehash", nothing, Release.size());
+
+	// A release changing a file in place, growing one, adding one and changing a large one
+	Find("Tracks/file00.szs")->Data[100] ^= 0xFF;
+	Find("Sound/file03.szs")->Data += "appended";
+	Find("Tracks/large1.szs")->Data[DELTA_MIN_SIZE / 2] ^= 0xFF;
+	ReleaseFile added = { "Scene/UI/added.szs", RandomData(0x8000) };
+	Release.push_back(added);
+	const char* release[] = { "Tracks/file00.szs", "Sound/file03.szs", "Tracks/large1.szs", "Scene/UI/added.szs", NULL };
+	ok &= Step("release", release, 0);
+
+	// Files damaged or lost on the card, which the state can't know about, are found by size or hash
+	WriteFile(SD_DIRECTORY "Race/Course/file05.szs", "short");
+	unlink(SD_DIRECTORY "Scene/UI/file06.szs");
+	const char* damaged[] = { "Race/Course/file05.szs", "Scene/UI/file06.szs", NULL };
+	ok &= Step("damaged", damaged, 0);
+
+	string data = Find("Sound/file07.szs")->Data;
+	data[0] ^= 0xFF;
+	WriteFile(SD_DIRECTORY "Sound/file07.szs", data);
+	unlink(UPDATE_STATE_PATH);
+	const char* corrupt[] = { "Sound/file07.szs", NULL };
+	ok &= Step("corrupt", corrupt, Release.size());
+
+	HttpServer_Stop();
+	if (ok)
+		system((string("rm -rf '") + scratch + "'").c_str());
+	else
+		printf("updater: the files are left in %s\n", scratch);
+	return ok ? 0 : 1;
+}